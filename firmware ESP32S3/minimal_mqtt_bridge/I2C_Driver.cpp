@@ -1,36 +1,412 @@
 #include "I2C_Driver.h"
+#include <esp_timer.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "Mill_Supervisor.h"
+#include "Mill_Memory.h"
 
+typedef enum {
+  I2C_Op_Read = 0,
+  I2C_Op_Write,
+  I2C_Op_Update,
+  I2C_Op_Toggle,
+} I2C_Op;
 
-void I2C_Init(void) {
-  Wire.begin( I2C_SDA_PIN, I2C_SCL_PIN);                       
-}
+typedef struct {
+  uint8_t  Op;
+  uint8_t  Addr;
+  uint8_t  Reg;
+  uint8_t  Len;
+  uint8_t  Mask;
+  uint8_t  Value;
+  uint8_t  Data[I2C_Max_Len];
+  bool     Failed;
+  bool     Completed;
+  bool     Abandoned;                           // caller timed out; manager frees the slot
+  int64_t  Queued_us;
+  SemaphoreHandle_t Done;
+} I2C_Request;
 
+typedef struct {
+  I2C_Device_Stats Stats;
+  I2C_Priority     Prio;
+  bool             Auto_Inc;
+} I2C_Device;
 
-bool I2C_Read(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length)
+static I2C_Request   I2C_Pool[I2C_Pool_Size];
+static QueueHandle_t I2C_Free = NULL;             // free pool indices
+static QueueHandle_t I2C_Queue[2] = {NULL, NULL}; // [I2C_Prio_Normal], [I2C_Prio_High]
+static SemaphoreHandle_t I2C_Pending = NULL;      // one count per queued request
+static TaskHandle_t  I2C_Task_Handle = NULL;
+static portMUX_TYPE  I2C_Mux = portMUX_INITIALIZER_UNLOCKED;
+
+static I2C_Device    I2C_Devices[I2C_Max_Devices];
+static uint8_t       I2C_Device_Num = 0;
+
+static volatile uint32_t I2C_Transactions = 0;
+static volatile uint32_t I2C_Recoveries = 0;
+static uint8_t       I2C_Fail_Streak = 0;
+
+/*************************************************************  Devices  *************************************************************/
+static I2C_Device *I2C_Find_Device(uint8_t Addr)
+{
+  for (uint8_t i = 0; i < I2C_Device_Num; i++) {
+    if(I2C_Devices[i].Stats.Addr == Addr)
+      return &I2C_Devices[i];
+  }
+  if(I2C_Device_Num >= I2C_Max_Devices)
+    return NULL;
+  I2C_Device *d = &I2C_Devices[I2C_Device_Num++];
+  memset(d, 0, sizeof(*d));
+  d->Stats.Addr = Addr;
+  d->Stats.Name = "?";
+  return d;
+}
+
+void I2C_Add_Device(uint8_t Driver_addr, const char *Name, I2C_Priority Prio, bool Auto_Inc)
 {
-  Wire.beginTransmission(Driver_addr);
-  Wire.write(Reg_addr); 
-  if ( Wire.endTransmission(true)){
-    printf("The I2C transmission fails. - I2C Read\r\n");
-    return -1;
+  portENTER_CRITICAL(&I2C_Mux);
+  I2C_Device *d = I2C_Find_Device(Driver_addr);
+  if(d != NULL){
+    d->Stats.Name = Name;
+    d->Prio       = Prio;
+    d->Auto_Inc   = Auto_Inc;
   }
-  Wire.requestFrom(Driver_addr, Length);
-  for (int i = 0; i < Length; i++) {
-    *Reg_data++ = Wire.read();
+  portEXIT_CRITICAL(&I2C_Mux);
+}
+
+/*************************************************************  Bus access (manager task only)  *************************************************************/
+// Frees a slave that holds SDA low mid-byte: up to 9 SCL pulses, then STOP
+static void I2C_Bus_Recover(void)
+{
+  Wire.end();
+  pinMode(I2C_SDA_PIN, INPUT_PULLUP);
+  pinMode(I2C_SCL_PIN, OUTPUT_OPEN_DRAIN);
+  digitalWrite(I2C_SCL_PIN, HIGH);
+  delayMicroseconds(5);
+  int pulses = 0;
+  while (pulses < 9 && digitalRead(I2C_SDA_PIN) == LOW) {
+    digitalWrite(I2C_SCL_PIN, LOW);
+    delayMicroseconds(5);
+    digitalWrite(I2C_SCL_PIN, HIGH);
+    delayMicroseconds(5);
+    pulses++;
   }
+  pinMode(I2C_SDA_PIN, OUTPUT_OPEN_DRAIN);
+  digitalWrite(I2C_SDA_PIN, LOW);
+  delayMicroseconds(5);
+  digitalWrite(I2C_SCL_PIN, HIGH);
+  delayMicroseconds(5);
+  digitalWrite(I2C_SDA_PIN, HIGH);                // STOP
+  delayMicroseconds(5);
+  Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
+  I2C_Recoveries++;
+  I2C_Fail_Streak = 0;
+  printf("I2C : bus recovery, %d SCL pulse(s)\r\n", pulses);
+}
+
+// Wire status: 0 ok, 2/3 NACK, 4 other, 5 timeout
+static uint8_t I2C_Bus_Read(uint8_t Addr, uint8_t Reg, uint8_t *Data, uint8_t Len)
+{
+  I2C_Transactions++;
+  Wire.beginTransmission(Addr);
+  Wire.write(Reg);
+  uint8_t err = Wire.endTransmission(true);
+  if(err)
+    return err;
+  if(Wire.requestFrom(Addr, Len) != Len)
+    return 4;
+  for (int i = 0; i < Len; i++)
+    Data[i] = Wire.read();
   return 0;
 }
-bool I2C_Write(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length)
+
+static uint8_t I2C_Bus_Write(uint8_t Addr, uint8_t Reg, const uint8_t *Data, uint8_t Len)
 {
-  Wire.beginTransmission(Driver_addr);
-  Wire.write(Reg_addr);       
-  for (int i = 0; i < Length; i++) {
-    Wire.write(*Reg_data++);
+  I2C_Transactions++;
+  Wire.beginTransmission(Addr);
+  Wire.write(Reg);
+  for (int i = 0; i < Len; i++)
+    Wire.write(Data[i]);
+  return Wire.endTransmission(true);
+}
+
+static uint8_t I2C_Bus_Execute(I2C_Request *r)
+{
+  switch(r->Op){
+    case I2C_Op_Read:
+      return I2C_Bus_Read(r->Addr, r->Reg, r->Data, r->Len);
+    case I2C_Op_Write:
+      return I2C_Bus_Write(r->Addr, r->Reg, r->Data, r->Len);
+    default: {
+      uint8_t old;
+      uint8_t err = I2C_Bus_Read(r->Addr, r->Reg, &old, 1);
+      if(err)
+        return err;
+      r->Data[0] = (r->Op == I2C_Op_Toggle) ? (uint8_t)(old ^ r->Mask)
+                                            : (uint8_t)((old & ~r->Mask) | (r->Value & r->Mask));
+      return I2C_Bus_Write(r->Addr, r->Reg, r->Data, 1);
+    }
   }
-  if ( Wire.endTransmission(true))
-  {
-    printf("The I2C transmission fails. - I2C Write\r\n");
-    return -1;
+}
+
+// One try, a recovery when the bus looks stuck, then one retry
+static bool I2C_Bus_Run(I2C_Request *r)
+{
+  uint8_t err = I2C_Bus_Execute(r);
+  if(err == 0){
+    I2C_Fail_Streak = 0;
+    return true;
   }
-  return 0;
-}
\ No newline at end of file
+  I2C_Fail_Streak++;
+  printf("I2C : 0x%02X reg 0x%02X %s failed (%d)\r\n", r->Addr, r->Reg, r->Op == I2C_Op_Read ? "read" : "write", err);
+  if(err == 5 || I2C_Fail_Streak >= I2C_Recover_After){
+    I2C_Bus_Recover();
+    if(I2C_Bus_Execute(r) == 0)
+      return true;
+    I2C_Fail_Streak++;
+  }
+  return false;
+}
+
+/*************************************************************  Manager task  *************************************************************/
+// How a batch shares one transaction
+typedef enum {
+  I2C_Merge_None = 0,
+  I2C_Merge_Same,                                 // identical reads / same-register writes (last value wins)
+  I2C_Merge_Burst,                                // writes to adjacent registers, auto-increment devices
+} I2C_Merge;
+
+static uint8_t I2C_Can_Merge(const I2C_Request *first, const I2C_Request *next, uint8_t Mode, uint8_t Burst_Len, bool Auto_Inc)
+{
+  if(next->Addr != first->Addr || next->Op != first->Op)
+    return I2C_Merge_None;
+  if(first->Op == I2C_Op_Read)
+    return (next->Reg == first->Reg && next->Len == first->Len) ? I2C_Merge_Same : I2C_Merge_None;
+  if(first->Op != I2C_Op_Write)
+    return I2C_Merge_None;                        // read-modify-writes stay one by one
+  if(Mode != I2C_Merge_Burst && next->Reg == first->Reg && next->Len == first->Len)
+    return I2C_Merge_Same;
+  if(Mode != I2C_Merge_Same && Auto_Inc && next->Reg == (uint8_t)(first->Reg + Burst_Len) &&
+     Burst_Len + next->Len <= I2C_Max_Len)
+    return I2C_Merge_Burst;
+  return I2C_Merge_None;
+}
+
+static void I2C_Finish(uint8_t Idx, bool Ok, I2C_Device *d, bool Merged)
+{
+  I2C_Request *r = &I2C_Pool[Idx];
+  int64_t lat = esp_timer_get_time() - r->Queued_us;
+  if(d != NULL){
+    portENTER_CRITICAL(&I2C_Mux);
+    if(Ok) d->Stats.Ok++; else d->Stats.Errors++;
+    if(Merged) d->Stats.Merged++;
+    uint32_t us = (lat > 0) ? (uint32_t)lat : 0;
+    d->Stats.Lat_Avg_us = (d->Stats.Ok + d->Stats.Errors == 1) ? us : d->Stats.Lat_Avg_us - d->Stats.Lat_Avg_us / 8 + us / 8;
+    if(us > d->Stats.Lat_Max_us) d->Stats.Lat_Max_us = us;
+    portEXIT_CRITICAL(&I2C_Mux);
+  }
+
+  bool Abandoned;
+  portENTER_CRITICAL(&I2C_Mux);
+  r->Failed    = !Ok;
+  r->Completed = true;
+  Abandoned    = r->Abandoned;
+  portEXIT_CRITICAL(&I2C_Mux);
+  if(Abandoned)
+    xQueueSend(I2C_Free, &Idx, 0);
+  else
+    xSemaphoreGive(r->Done);
+}
+
+void I2CTask(void *parameter)
+{
+  uint8_t batch[I2C_Pool_Size];
+  while(1){
+    supervisor_park(SUP_TASK_I2C);
+    xSemaphoreTake(I2C_Pending, portMAX_DELAY);
+    supervisor_checkin(SUP_TASK_I2C);
+
+    QueueHandle_t q = I2C_Queue[I2C_Prio_High];
+    if(xQueueReceive(q, &batch[0], 0) != pdTRUE){
+      q = I2C_Queue[I2C_Prio_Normal];
+      if(xQueueReceive(q, &batch[0], 0) != pdTRUE)
+        continue;
+    }
+    I2C_Request *first = &I2C_Pool[batch[0]];
+    portENTER_CRITICAL(&I2C_Mux);
+    I2C_Device *d = I2C_Find_Device(first->Addr);
+    bool Auto_Inc = d != NULL && d->Auto_Inc;
+    portEXIT_CRITICAL(&I2C_Mux);
+
+    // Pull mergeable followers off the same queue
+    uint8_t n = 1;
+    uint8_t Mode = I2C_Merge_None;
+    uint8_t Burst_Len = first->Len;
+    I2C_Request run = *first;
+    while(n < I2C_Pool_Size){
+      uint8_t next;
+      if(xQueuePeek(q, &next, 0) != pdTRUE)
+        break;
+      I2C_Request *nr = &I2C_Pool[next];
+      uint8_t m = I2C_Can_Merge(first, nr, Mode, Burst_Len, Auto_Inc);
+      if(m == I2C_Merge_None)
+        break;
+      xQueueReceive(q, &next, 0);
+      xSemaphoreTake(I2C_Pending, 0);
+      Mode = m;
+      if(Mode == I2C_Merge_Burst){
+        memcpy(&run.Data[Burst_Len], nr->Data, nr->Len);
+        Burst_Len += nr->Len;
+        run.Len = Burst_Len;
+      } else if(run.Op == I2C_Op_Write){
+        memcpy(run.Data, nr->Data, run.Len);      // last value wins
+      }
+      batch[n++] = next;
+    }
+
+    // One transaction for the whole batch
+    bool Ok = I2C_Bus_Run(&run);
+    for (uint8_t i = 0; i < n; i++) {
+      I2C_Request *r = &I2C_Pool[batch[i]];
+      if(r->Op != I2C_Op_Write)
+        memcpy(r->Data, run.Data, r->Len);
+      I2C_Finish(batch[i], Ok, d, i > 0);
+    }
+  }
+  vTaskDelete(NULL);
+}
+
+/*************************************************************  Callers  *************************************************************/
+static bool I2C_Submit(uint8_t Op, uint8_t Addr, uint8_t Reg, uint8_t *Data, uint32_t Len, uint8_t Mask, uint8_t Value)
+{
+  if(Len == 0 || Len > I2C_Max_Len){
+    printf("I2C : bad length %lu for 0x%02X\r\n", (unsigned long)Len, Addr);
+    return false;
+  }
+
+  // Before I2C_Init() or from the manager itself: straight to the bus
+  if(I2C_Task_Handle == NULL || xTaskGetCurrentTaskHandle() == I2C_Task_Handle){
+    I2C_Request r;
+    memset(&r, 0, sizeof(r));
+    r.Op = Op; r.Addr = Addr; r.Reg = Reg; r.Len = (uint8_t)Len; r.Mask = Mask; r.Value = Value;
+    if(Op != I2C_Op_Read) memcpy(r.Data, Data, Len);
+    bool Ok = I2C_Bus_Run(&r);
+    if(Ok && Op != I2C_Op_Write) memcpy(Data, r.Data, Len);
+    return Ok;
+  }
+
+  uint8_t Idx;
+  if(xQueueReceive(I2C_Free, &Idx, pdMS_TO_TICKS(I2C_Request_Timeout_MS)) != pdTRUE){
+    printf("I2C : request pool exhausted (0x%02X)\r\n", Addr);
+    return false;
+  }
+  I2C_Request *r = &I2C_Pool[Idx];
+  xSemaphoreTake(r->Done, 0);                     // drop a give left by an abandoned request
+  r->Op = Op; r->Addr = Addr; r->Reg = Reg; r->Len = (uint8_t)Len; r->Mask = Mask; r->Value = Value;
+  if(Op != I2C_Op_Read) memcpy(r->Data, Data, Len);
+  r->Failed = false; r->Completed = false; r->Abandoned = false;
+  r->Queued_us = esp_timer_get_time();
+
+  portENTER_CRITICAL(&I2C_Mux);
+  I2C_Device *d = I2C_Find_Device(Addr);
+  I2C_Priority Prio = (d != NULL) ? d->Prio : I2C_Prio_Normal;
+  portEXIT_CRITICAL(&I2C_Mux);
+  xQueueSend(I2C_Queue[Prio], &Idx, portMAX_DELAY);
+  xSemaphoreGive(I2C_Pending);
+
+  if(xSemaphoreTake(r->Done, pdMS_TO_TICKS(I2C_Request_Timeout_MS)) != pdTRUE){
+    bool Completed;
+    portENTER_CRITICAL(&I2C_Mux);
+    Completed = r->Completed;
+    if(!Completed) r->Abandoned = true;
+    portEXIT_CRITICAL(&I2C_Mux);
+    if(!Completed){
+      printf("I2C : 0x%02X reg 0x%02X timed out in queue\r\n", Addr, Reg);
+      return false;
+    }
+  }
+  bool Ok = !r->Failed;
+  if(Ok && Op != I2C_Op_Write) memcpy(Data, r->Data, Len);
+  xQueueSend(I2C_Free, &Idx, 0);
+  return Ok;
+}
+
+void I2C_Init(void) {
+  Wire.begin( I2C_SDA_PIN, I2C_SCL_PIN);
+  if(I2C_Task_Handle != NULL)
+    return;
+  I2C_Free                     = xQueueCreate(I2C_Pool_Size, sizeof(uint8_t));
+  I2C_Queue[I2C_Prio_Normal]   = xQueueCreate(I2C_Pool_Size, sizeof(uint8_t));
+  I2C_Queue[I2C_Prio_High]     = xQueueCreate(I2C_Pool_Size, sizeof(uint8_t));
+  I2C_Pending                  = xSemaphoreCreateCounting(I2C_Pool_Size, 0);
+  for (uint8_t i = 0; i < I2C_Pool_Size; i++) {
+    I2C_Pool[i].Done = xSemaphoreCreateBinary();
+    xQueueSend(I2C_Free, &i, 0);
+  }
+  MILL_TASK_CREATE(
+    I2CTask,
+    "I2CTask",
+    3072,
+    NULL,
+    5,
+    &I2C_Task_Handle,
+    0
+  );
+}
+
+bool I2C_Read(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length)
+{
+  return !I2C_Submit(I2C_Op_Read, Driver_addr, Reg_addr, Reg_data, Length, 0, 0);
+}
+bool I2C_Write(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length)
+{
+  return !I2C_Submit(I2C_Op_Write, Driver_addr, Reg_addr, (uint8_t *)Reg_data, Length, 0, 0);
+}
+bool I2C_Update_Bits(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t Mask, uint8_t Value, uint8_t *Result)
+{
+  uint8_t v = 0;
+  bool Ok = I2C_Submit(I2C_Op_Update, Driver_addr, Reg_addr, &v, 1, Mask, Value);
+  if(Ok && Result != NULL) *Result = v;
+  return !Ok;
+}
+bool I2C_Toggle_Bits(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t Mask, uint8_t *Result)
+{
+  uint8_t v = 0;
+  bool Ok = I2C_Submit(I2C_Op_Toggle, Driver_addr, Reg_addr, &v, 1, Mask, 0);
+  if(Ok && Result != NULL) *Result = v;
+  return !Ok;
+}
+
+bool I2C_Emergency_Write(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length)
+{
+  if(Length == 0 || Length > I2C_Max_Len)
+    return true;
+  if(I2C_Task_Handle != NULL && xTaskGetCurrentTaskHandle() != I2C_Task_Handle)
+    vTaskSuspend(I2C_Task_Handle);                // nobody else on the bus from here
+  I2C_Bus_Recover();
+  uint8_t err = I2C_Bus_Write(Driver_addr, Reg_addr, Reg_data, (uint8_t)Length);
+  if(err != 0){
+    I2C_Bus_Recover();
+    err = I2C_Bus_Write(Driver_addr, Reg_addr, Reg_data, (uint8_t)Length);
+  }
+  printf("I2C : emergency write 0x%02X reg 0x%02X %s\r\n", Driver_addr, Reg_addr, err ? "FAILED" : "ok");
+  return err != 0;
+}
+
+/*************************************************************  Statistics  *************************************************************/
+uint32_t I2C_Get_Transactions(void) {
+  return I2C_Transactions;
+}
+uint32_t I2C_Get_Recoveries(void) {
+  return I2C_Recoveries;
+}
+uint8_t I2C_Get_Stats(I2C_Device_Stats *Out, uint8_t Max)
+{
+  portENTER_CRITICAL(&I2C_Mux);
+  uint8_t n = (I2C_Device_Num < Max) ? I2C_Device_Num : Max;
+  for (uint8_t i = 0; i < n; i++)
+    Out[i] = I2C_Devices[i].Stats;
+  portEXIT_CRITICAL(&I2C_Mux);
+  return n;
+}
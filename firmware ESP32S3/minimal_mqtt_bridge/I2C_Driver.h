@@ -1,10 +1,60 @@
 #pragma once
-#include <Wire.h> 
+#include <Wire.h>
 
 #define I2C_SCL_PIN       41
 #define I2C_SDA_PIN       42
 
+/*
+ * All bus traffic goes through one manager task (I2CTask). Callers block
+ * on their own request; relay-expander requests overtake RTC ones, and
+ * queued requests to the same device are merged:
+ *   - identical reads share one transaction,
+ *   - writes of the same register length: the last value wins,
+ *   - on auto-increment devices, writes to adjacent registers become one
+ *     burst.
+ * A stuck bus (timeout, or I2C_Recover_After failures in a row) is freed
+ * by clocking SCL until SDA is released, then the request is retried once.
+ */
+#define I2C_Max_Devices         4
+#define I2C_Max_Len             16              // bytes per request / merged burst
+#define I2C_Pool_Size           8               // requests in flight
+#define I2C_Request_Timeout_MS  500
+#define I2C_Recover_After       3               // consecutive failures before SCL clocking
+
+typedef enum {
+  I2C_Prio_Normal = 0,
+  I2C_Prio_High   = 1,                          // relay expander
+} I2C_Priority;
+
+typedef struct {
+  uint8_t     Addr;
+  const char *Name;
+  uint32_t    Ok;
+  uint32_t    Errors;
+  uint32_t    Merged;                           // requests served by another request's transaction
+  uint32_t    Lat_Avg_us;                       // queue + bus, EWMA
+  uint32_t    Lat_Max_us;
+} I2C_Device_Stats;
+
 void I2C_Init(void);
+// Optional per device: request priority and register auto-increment.
+// Unregistered addresses are Normal, no auto-increment.
+void I2C_Add_Device(uint8_t Driver_addr, const char *Name, I2C_Priority Prio, bool Auto_Inc);
 
+// true on failure (as before)
 bool I2C_Read(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length);
-bool I2C_Write(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length);
\ No newline at end of file
+bool I2C_Write(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length);
+// Atomic read-modify-write of one register: new = (old & ~Mask) | (Value & Mask),
+// or old ^ Mask for the toggle. *Result (optional) = value written.
+bool I2C_Update_Bits(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t Mask, uint8_t Value, uint8_t *Result);
+bool I2C_Toggle_Bits(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t Mask, uint8_t *Result);
+// Emergency only (supervisor trip, shutdown hook): suspends the manager
+// task, frees the bus and writes with Wire directly, so it works with
+// I2CTask stalled. The manager stays suspended; only on the way to a reset.
+// true on failure (as above)
+bool I2C_Emergency_Write(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length);
+
+// Bus transactions actually performed (merged requests count once)
+uint32_t I2C_Get_Transactions(void);
+uint32_t I2C_Get_Recoveries(void);
+uint8_t  I2C_Get_Stats(I2C_Device_Stats *Out, uint8_t Max);   // returns devices copied
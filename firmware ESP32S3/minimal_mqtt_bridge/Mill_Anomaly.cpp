@@ -0,0 +1,179 @@
+#include "Mill_Anomaly.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void anom_default_config(AnomConfig &cfg) {
+  cfg.stuck_ms      = 120000;
+  cfg.stuck_mv      = 50;       // 5 %
+  cfg.roc_limit     = 100;      // 10 °C/s, well past what LN2 can do
+  cfg.roc_hold_ms   = 30000;
+  cfg.osc_band      = 10;       // ±1 °C
+  cfg.osc_amp       = 20;       // 2 °C
+  cfg.osc_window_ms = 600000;
+  cfg.sat_mv        = 995;
+  cfg.sat_ms        = 300000;
+  cfg.runaway_err   = 50;       // 5 °C
+}
+
+void anom_init(AnomDetector &d, const AnomConfig &cfg) {
+  memset(&d, 0, sizeof(d));
+  d.cfg = cfg;
+}
+
+void anom_gap(AnomDetector &d) {
+  d.primed    = false;
+  d.roc_armed = false;
+  d.side      = 0;
+  d.cross_n   = 0;
+  d.sat       = false;
+  d.flags     = 0;
+}
+
+static inline int32_t absi(int32_t v) { return v < 0 ? -v : v; }
+
+static void statsAndStuck(AnomDetector &d, int16_t pv, uint16_t mv, uint32_t now_ms) {
+  int32_t dev = pv - (d.mean_q4 >> 4);
+  d.mean_q4 += ((int32_t)pv * 16 - d.mean_q4) >> 4;
+  d.var     += (dev * dev - d.var) >> 4;
+
+  if (pv != d.pv_prev) {
+    d.same_since_ms = now_ms;
+    d.mv_min = d.mv_max = mv;
+    return;
+  }
+  if (mv < d.mv_min) d.mv_min = mv;
+  if (mv > d.mv_max) d.mv_max = mv;
+}
+
+static bool stuck(const AnomDetector &d, uint32_t now_ms) {
+  return now_ms - d.same_since_ms >= d.cfg.stuck_ms &&
+         (uint16_t)(d.mv_max - d.mv_min) >= d.cfg.stuck_mv;
+}
+
+static bool rateOfChange(AnomDetector &d, int16_t pv, uint32_t now_ms) {
+  uint32_t dt = now_ms - d.prev_ms;
+  if (dt > 0) {
+    d.roc_last = (int32_t)(pv - d.pv_prev) * 1000 / (int32_t)dt;
+    if (absi(d.roc_last) > d.cfg.roc_limit) {
+      d.roc_until_ms = now_ms + d.cfg.roc_hold_ms;
+      d.roc_armed    = true;
+    }
+  }
+  return d.roc_armed && (int32_t)(d.roc_until_ms - now_ms) > 0;
+}
+
+// Zero crossings of PV − SV with a hysteresis band; the last four
+// crossing times / preceding swing peaks live in a small ring.
+static bool oscillation(AnomDetector &d, int32_t err, uint32_t now_ms) {
+  uint16_t mag = (uint16_t)(absi(err) > 0xFFFF ? 0xFFFF : absi(err));
+  if (mag > d.swing_peak) d.swing_peak = mag;
+
+  int8_t side = 0;
+  if (err >  (int32_t)d.cfg.osc_band) side =  1;
+  if (err < -(int32_t)d.cfg.osc_band) side = -1;
+
+  if (side != 0 && side != d.side) {
+    if (d.side != 0) {
+      d.cross_ms[d.cross_head]  = now_ms;
+      d.cross_amp[d.cross_head] = d.swing_peak;
+      d.cross_head = (uint8_t)((d.cross_head + 1) % ANOM_OSC_CROSSINGS);
+      if (d.cross_n < ANOM_OSC_CROSSINGS) d.cross_n++;
+    }
+    d.side       = side;
+    d.swing_peak = mag;
+  }
+
+  if (d.cross_n < ANOM_OSC_CROSSINGS) return false;
+
+  uint8_t  newest = (uint8_t)((d.cross_head + ANOM_OSC_CROSSINGS - 1) % ANOM_OSC_CROSSINGS);
+  uint8_t  oldest = d.cross_head;
+  if (now_ms - d.cross_ms[newest] > d.cfg.osc_window_ms / 2) return false;   // died out
+  if (d.cross_ms[newest] - d.cross_ms[oldest] > d.cfg.osc_window_ms) return false;
+
+  // The oldest entry's peak belongs to the swing before the window
+  for (uint8_t i = 1; i < ANOM_OSC_CROSSINGS; ++i) {
+    if (d.cross_amp[(oldest + i) % ANOM_OSC_CROSSINGS] < d.cfg.osc_amp) return false;
+  }
+  return true;
+}
+
+static uint8_t saturation(AnomDetector &d, int32_t err, uint16_t mv, uint32_t now_ms,
+                          uint32_t dt) {
+  bool satNow = mv >= d.cfg.sat_mv;
+  if (!satNow) {
+    d.sat = false;
+    return 0;
+  }
+  if (!d.sat) {
+    d.sat          = true;
+    d.sat_since_ms = now_ms;
+    d.sat_err0     = err;
+  }
+  d.sat_total_ms += dt;
+
+  if (now_ms - d.sat_since_ms < d.cfg.sat_ms) return 0;
+
+  uint8_t f = ANOM_SAT;
+  if (err >= (int32_t)d.cfg.runaway_err && err >= d.sat_err0) f |= ANOM_RUNAWAY;
+  return f;
+}
+
+uint8_t anom_sample(AnomDetector &d, int16_t pv_x10, int16_t sv_x10,
+                    uint16_t mv1_x10, uint32_t now_ms) {
+  int32_t err = (int32_t)pv_x10 - sv_x10;
+  d.samples++;
+
+  if (!d.primed) {
+    d.primed        = true;
+    d.mean_q4       = (int32_t)pv_x10 * 16;
+    d.var           = 0;
+    d.same_since_ms = now_ms;
+    d.mv_min = d.mv_max = mv1_x10;
+    d.side          = 0;
+    d.swing_peak    = 0;
+    d.pv_prev       = pv_x10;
+    d.prev_ms       = now_ms;
+    saturation(d, err, mv1_x10, now_ms, 0);
+    return d.flags;
+  }
+
+  uint32_t dt = now_ms - d.prev_ms;
+  uint8_t  f  = 0;
+
+  statsAndStuck(d, pv_x10, mv1_x10, now_ms);
+  if (stuck(d, now_ms))                 f |= ANOM_STUCK;
+  if (rateOfChange(d, pv_x10, now_ms))  f |= ANOM_ROC;
+  if (oscillation(d, err, now_ms))      f |= ANOM_OSC;
+  f |= saturation(d, err, mv1_x10, now_ms, dt);
+
+  uint8_t rising = f & (uint8_t)~d.flags;
+  for (uint8_t b = 0; b < 5; ++b) {
+    if (rising & (1u << b)) d.raised[b]++;
+  }
+
+  d.flags   = f;
+  d.pv_prev = pv_x10;
+  d.prev_ms = now_ms;
+  return f;
+}
+
+uint32_t anom_osc_period_ms(const AnomDetector &d) {
+  if (!(d.flags & ANOM_OSC)) return 0;
+  uint8_t newest = (uint8_t)((d.cross_head + ANOM_OSC_CROSSINGS - 1) % ANOM_OSC_CROSSINGS);
+  uint32_t span  = d.cross_ms[newest] - d.cross_ms[d.cross_head];
+  return span * 2 / (ANOM_OSC_CROSSINGS - 1);   // 3 half periods
+}
+
+void anom_flags_str(uint8_t flags, char *buf, uint16_t len) {
+  static const char *const kNames[5] = { "STUCK", "ROC", "OSC", "SAT", "RUNAWAY" };
+  if (len == 0) return;
+  buf[0] = '\0';
+  uint16_t n = 0;
+  for (uint8_t b = 0; b < 5; ++b) {
+    if (!(flags & (1u << b))) continue;
+    int w = snprintf(buf + n, len - n, "%s%s", n ? "," : "", kNames[b]);
+    if (w < 0 || n + w >= len) break;
+    n += (uint16_t)w;
+  }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+/*
+ * Mill_Anomaly.h
+ *
+ * Streaming plausibility checks on one LC108's process data, fed with the
+ * raw integer registers on every successful poll (PV / SV in °C × 10,
+ * MV1 in 0.1 %). Integer arithmetic and a fixed-size state only:
+ *
+ *   STUCK    – PV identical for stuck_ms while MV1 moved by ≥ stuck_mv
+ *              (the controller is acting, the sensor does not respond)
+ *   ROC      – |ΔPV/Δt| above roc_limit; held for roc_hold_ms
+ *   OSC      – PV − SV crossed the ±osc_band band four times within
+ *              osc_window_ms with every half swing ≥ osc_amp
+ *   SAT      – MV1 pinned at 100 % for sat_ms
+ *   RUNAWAY  – SAT, and PV − SV ≥ runaway_err and not improving since
+ *              the output saturated
+ *
+ * An exponentially weighted PV mean / variance is kept for diagnostics.
+ * STUCK and RUNAWAY are "serious" (ANOM_SERIOUS): the sketch may turn
+ * their rising edge into a FAULT_DEVICE.
+ *
+ * Plain C++, no Arduino headers.
+ */
+
+#include <stdint.h>
+
+enum AnomFlag : uint8_t {
+  ANOM_STUCK   = 1u << 0,
+  ANOM_ROC     = 1u << 1,
+  ANOM_OSC     = 1u << 2,
+  ANOM_SAT     = 1u << 3,
+  ANOM_RUNAWAY = 1u << 4
+};
+
+static const uint8_t ANOM_SERIOUS = ANOM_STUCK | ANOM_RUNAWAY;
+
+struct AnomConfig {
+  uint32_t stuck_ms;
+  uint16_t stuck_mv;         // 0.1 %
+  uint16_t roc_limit;        // 0.1 °C per s
+  uint32_t roc_hold_ms;
+  uint16_t osc_band;         // 0.1 °C
+  uint16_t osc_amp;          // 0.1 °C
+  uint32_t osc_window_ms;
+  uint16_t sat_mv;           // 0.1 %, MV1 at or above = saturated
+  uint32_t sat_ms;
+  uint16_t runaway_err;      // 0.1 °C
+};
+
+static const uint8_t ANOM_OSC_CROSSINGS = 4;
+
+struct AnomDetector {
+  AnomConfig cfg;
+
+  bool     primed;
+  int16_t  pv_prev;
+  uint32_t prev_ms;
+
+  // EW mean / variance, α = 1/16; mean in (0.1 °C) << 4
+  int32_t  mean_q4;
+  int32_t  var;              // (0.1 °C)²
+
+  // stuck
+  uint32_t same_since_ms;
+  uint16_t mv_min, mv_max;
+
+  // rate of change
+  int32_t  roc_last;         // 0.1 °C / s, last sample
+  uint32_t roc_until_ms;
+  bool     roc_armed;
+
+  // oscillation on PV − SV
+  int8_t   side;             // -1 below band, +1 above, 0 not yet known
+  uint16_t swing_peak;       // |PV − SV| peak since the last crossing
+  uint32_t cross_ms[ANOM_OSC_CROSSINGS];
+  uint16_t cross_amp[ANOM_OSC_CROSSINGS];
+  uint8_t  cross_n;
+  uint8_t  cross_head;
+
+  // saturation
+  bool     sat;
+  uint32_t sat_since_ms;
+  int32_t  sat_err0;         // PV − SV when saturation began
+  uint32_t sat_total_ms;
+
+  uint8_t  flags;
+  uint32_t samples;
+  uint32_t raised[5];        // rising edges per flag bit
+};
+
+void anom_default_config(AnomConfig &cfg);
+void anom_init(AnomDetector &d, const AnomConfig &cfg);
+
+// Comm gap: restart the time-based detectors (flags clear).
+void anom_gap(AnomDetector &d);
+
+// One LC108 sample; returns the flag word after this sample.
+uint8_t anom_sample(AnomDetector &d, int16_t pv_x10, int16_t sv_x10,
+                    uint16_t mv1_x10, uint32_t now_ms);
+
+// Oscillation period estimate in ms (0 = none).
+uint32_t anom_osc_period_ms(const AnomDetector &d);
+
+// "STUCK,OSC" style list into buf ("" when clear).
+void anom_flags_str(uint8_t flags, char *buf, uint16_t len);
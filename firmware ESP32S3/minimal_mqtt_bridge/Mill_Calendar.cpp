@@ -0,0 +1,366 @@
+#include "Mill_Calendar.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Mill_TimeSync.h"
+
+// -------------------------------------------------------------------
+// Heap
+// -------------------------------------------------------------------
+
+static inline bool before(const Calendar &c, uint16_t i, uint16_t j) {
+  return c.ev[c.heap[i]].next_s < c.ev[c.heap[j]].next_s;
+}
+
+static inline void place(Calendar &c, uint16_t i, uint16_t slot) {
+  c.heap[i]    = slot;
+  c.pos[slot]  = i;
+}
+
+static void siftUp(Calendar &c, uint16_t i) {
+  uint16_t slot = c.heap[i];
+  while (i > 0) {
+    uint16_t parent = (uint16_t)((i - 1) / 2);
+    if (c.ev[c.heap[parent]].next_s <= c.ev[slot].next_s) break;
+    place(c, i, c.heap[parent]);
+    i = parent;
+  }
+  place(c, i, slot);
+}
+
+static void siftDown(Calendar &c, uint16_t i) {
+  for (;;) {
+    uint16_t l = (uint16_t)(2 * i + 1), r = (uint16_t)(l + 1), m = i;
+    if (l < c.count && before(c, l, m)) m = l;
+    if (r < c.count && before(c, r, m)) m = r;
+    if (m == i) return;
+    uint16_t slot = c.heap[i];
+    place(c, i, c.heap[m]);
+    place(c, m, slot);
+    i = m;
+  }
+}
+
+// Drop a slot from the heap, then move the last slot into the hole so
+// slots stay packed.
+static void removeSlot(Calendar &c, uint16_t slot) {
+  uint16_t hole = c.pos[slot];
+  uint16_t last = (uint16_t)(c.count - 1);
+
+  uint16_t tail = c.heap[last];
+  c.count--;
+  if (hole != last) {
+    place(c, hole, tail);
+    siftDown(c, hole);
+    siftUp(c, c.pos[tail]);
+  }
+
+  if (slot != last) {
+    c.ev[slot] = c.ev[last];
+    place(c, c.pos[last], slot);
+  }
+}
+
+// -------------------------------------------------------------------
+// Recurrence
+// -------------------------------------------------------------------
+
+static uint8_t daysInMonth(uint16_t y, uint8_t m) {
+  static const uint8_t kDays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  if (m == 2 && ((y % 4 == 0 && y % 100 != 0) || y % 400 == 0)) return 29;
+  return kDays[m - 1];
+}
+
+uint32_t cal_next_fire(const CalEvent &ev, uint32_t after) {
+  uint32_t day0 = after - after % 86400;
+  uint32_t at   = day0 + ev.when;
+
+  switch (ev.repeat) {
+    case CAL_ONCE:
+      return ev.when;
+    case CAL_DAILY:
+      return (at >= after) ? at : at + 86400;
+    case CAL_WEEKLY: {
+      uint8_t dotw = (uint8_t)((day0 / 86400 + 4) % 7);   // 1970-01-01 was a Thursday
+      at += (uint32_t)((ev.day + 7 - dotw) % 7) * 86400;
+      return (at >= after) ? at : at + 7 * 86400;
+    }
+    case CAL_MONTHLY: {
+      TsCivil t;
+      timesync_to_civil((int64_t)after * 1000, t);
+      t.hour = t.minute = t.second = 0;
+      t.ms = 0;
+      for (uint8_t i = 0; i < 13; ++i) {                  // 31st: at most 2 months skipped
+        if (ev.day <= daysInMonth(t.year, t.month)) {
+          t.day = ev.day;
+          at = (uint32_t)(timesync_from_civil(t) / 1000) + ev.when;
+          if (at >= after) return at;
+        }
+        if (++t.month > 12) { t.month = 1; t.year++; }
+      }
+      break;
+    }
+  }
+  return UINT32_MAX;
+}
+
+// -------------------------------------------------------------------
+// Public API
+// -------------------------------------------------------------------
+
+void cal_init(Calendar &c, CalEvent *ev, uint16_t *heap, uint16_t *pos, uint16_t cap) {
+  memset(&c, 0, sizeof(c));
+  c.ev           = ev;
+  c.heap         = heap;
+  c.pos          = pos;
+  c.cap          = cap;
+  c.next_id      = 1;
+  c.late_limit_s = 60;
+}
+
+uint16_t cal_add(Calendar &c, const CalEvent &spec, uint32_t now_s) {
+  if (c.count >= c.cap) return 0;
+  if (spec.repeat > CAL_MONTHLY || spec.action > CAL_ACT_STOP) return 0;
+  if (spec.repeat != CAL_ONCE && spec.when >= 86400) return 0;
+  if (spec.repeat == CAL_WEEKLY && spec.day > 6) return 0;
+  if (spec.repeat == CAL_MONTHLY && (spec.day < 1 || spec.day > 31)) return 0;
+
+  uint16_t slot = c.count++;
+  CalEvent &e = c.ev[slot];
+  e        = spec;
+  e.id     = c.next_id++;
+  if (c.next_id == 0) c.next_id = 1;
+  e.next_s = cal_next_fire(e, now_s);
+
+  place(c, slot, slot);
+  siftUp(c, slot);
+  return e.id;
+}
+
+bool cal_remove(Calendar &c, uint16_t id) {
+  for (uint16_t s = 0; s < c.count; ++s) {
+    if (c.ev[s].id == id) {
+      removeSlot(c, s);
+      return true;
+    }
+  }
+  return false;
+}
+
+void cal_clear(Calendar &c) {
+  c.count = 0;
+}
+
+uint32_t cal_next_s(const Calendar &c) {
+  return c.count ? c.ev[c.heap[0]].next_s : 0;
+}
+
+uint16_t cal_poll(Calendar &c, uint32_t now_s, CalFireFn fn, void *ctx) {
+  uint16_t n = 0;
+  while (c.count && c.ev[c.heap[0]].next_s <= now_s) {
+    uint16_t slot = c.heap[0];
+    CalEvent ev   = c.ev[slot];
+    uint32_t late = now_s - ev.next_s;
+
+    // Reschedule / drop before the callback so it sees a consistent heap
+    if (ev.repeat == CAL_ONCE) {
+      removeSlot(c, slot);
+    } else {
+      c.ev[slot].next_s = cal_next_fire(ev, now_s + 1);
+      siftDown(c, 0);
+    }
+
+    if (late > c.late_limit_s) {
+      c.missed++;
+    } else {
+      c.fired++;
+      if (fn) fn(ev, late, ctx);
+    }
+    n++;
+  }
+  return n;
+}
+
+void cal_resync(Calendar &c, uint32_t now_s) {
+  for (uint16_t s = 0; s < c.count; ++s) {
+    if (c.ev[s].repeat != CAL_ONCE) c.ev[s].next_s = cal_next_fire(c.ev[s], now_s);
+    place(c, s, s);
+  }
+  for (int i = c.count / 2 - 1; i >= 0; --i) siftDown(c, (uint16_t)i);
+}
+
+// -------------------------------------------------------------------
+// Text (on request only)
+// -------------------------------------------------------------------
+
+static const char *const kDotw[7] = { "SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT" };
+
+const char *cal_repeat_str(CalRepeat r) {
+  switch (r) {
+    case CAL_ONCE:    return "ONCE";
+    case CAL_DAILY:   return "DAILY";
+    case CAL_WEEKLY:  return "WEEKLY";
+    case CAL_MONTHLY: return "MONTHLY";
+  }
+  return "?";
+}
+
+const char *cal_action_str(CalAction a) {
+  switch (a) {
+    case CAL_ACT_RELAYS: return "RELAYS";
+    case CAL_ACT_START:  return "START";
+    case CAL_ACT_STOP:   return "STOP";
+  }
+  return "?";
+}
+
+bool cal_repeat_from_str(const char *s, CalRepeat &out) {
+  if (s == nullptr) return false;
+  for (uint8_t r = CAL_ONCE; r <= CAL_MONTHLY; ++r) {
+    if (strcmp(s, cal_repeat_str((CalRepeat)r)) == 0) { out = (CalRepeat)r; return true; }
+  }
+  return false;
+}
+
+bool cal_action_from_str(const char *s, CalAction &out) {
+  if (s == nullptr) return false;
+  for (uint8_t a = CAL_ACT_RELAYS; a <= CAL_ACT_STOP; ++a) {
+    if (strcmp(s, cal_action_str((CalAction)a)) == 0) { out = (CalAction)a; return true; }
+  }
+  return false;
+}
+
+size_t cal_format(const CalEvent &ev, char *out, size_t len) {
+  if (len == 0) return 0;
+  uint32_t sod = ev.when % 86400;
+  char hms[16];
+  char when[32];
+  snprintf(hms, sizeof(hms), "%02u:%02u:%02u", (unsigned)(sod / 3600),
+           (unsigned)(sod / 60 % 60), (unsigned)(sod % 60));
+
+  switch (ev.repeat) {
+    case CAL_ONCE: {
+      TsCivil t;
+      timesync_to_civil((int64_t)ev.when * 1000, t);
+      snprintf(when, sizeof(when), "%04u-%02u-%02u %s", t.year, t.month, t.day, hms);
+      break;
+    }
+    case CAL_WEEKLY:
+      snprintf(when, sizeof(when), "%s %s", kDotw[ev.day % 7], hms);
+      break;
+    case CAL_MONTHLY:
+      snprintf(when, sizeof(when), "day %u %s", ev.day, hms);
+      break;
+    default:
+      snprintf(when, sizeof(when), "%s", hms);
+      break;
+  }
+
+  int n = 0;
+  switch (ev.action) {
+    case CAL_ACT_RELAYS:
+      n = snprintf(out, len, "#%u %s %s RELAYS open=0x%02X close=0x%02X", ev.id,
+                   cal_repeat_str(ev.repeat), when, ev.a, (unsigned)(ev.b & 0xFF));
+      break;
+    case CAL_ACT_START:
+      n = snprintf(out, len, "#%u %s %s START cycles=%u cycle_s=%u", ev.id,
+                   cal_repeat_str(ev.repeat), when, ev.a, ev.b);
+      break;
+    default:
+      n = snprintf(out, len, "#%u %s %s %s", ev.id, cal_repeat_str(ev.repeat), when,
+                   cal_action_str(ev.action));
+      break;
+  }
+  if (n < 0) { out[0] = '\0'; return 0; }
+  return ((size_t)n < len) ? (size_t)n : len - 1;
+}
+
+// -------------------------------------------------------------------
+// Host benchmark
+// -------------------------------------------------------------------
+#ifdef MILL_CAL_BENCH_MAIN
+#include <chrono>
+#include <stdlib.h>
+
+static uint32_t benchFired = 0;
+static void countFire(const CalEvent &, uint32_t, void *) { benchFired++; }
+
+static bool heapOk(const Calendar &c) {
+  for (uint16_t i = 1; i < c.count; ++i) {
+    if (c.ev[c.heap[(i - 1) / 2]].next_s > c.ev[c.heap[i]].next_s) return false;
+  }
+  for (uint16_t s = 0; s < c.count; ++s) {
+    if (c.heap[c.pos[s]] != s) return false;
+  }
+  return true;
+}
+
+static double nsSince(std::chrono::steady_clock::time_point t0, uint32_t n) {
+  auto dt = std::chrono::steady_clock::now() - t0;
+  return std::chrono::duration<double, std::nano>(dt).count() / n;
+}
+
+int main() {
+  const uint32_t t0 = 1767254400;      // 2026-01-01 08:00:00 UTC
+  printf("record %u B + 4 B index per event (WS_RTC before: %u B per event)\n",
+         (unsigned)sizeof(CalEvent), 1000u + 24u);
+  printf("%6s %8s %10s %10s %10s\n", "events", "RAM_B", "insert_ns", "fire_ns", "remove_ns");
+
+  const uint16_t sizes[] = { 16, 64, 256, 1024 };
+  for (uint16_t n : sizes) {
+    CalEvent *ev   = new CalEvent[n];
+    uint16_t *heap = new uint16_t[n];
+    uint16_t *pos  = new uint16_t[n];
+    Calendar c;
+    cal_init(c, ev, heap, pos, n);
+    srand(n);
+
+    // insert: mix of one-shots over the next week and repeating events
+    auto ti = std::chrono::steady_clock::now();
+    for (uint16_t i = 0; i < n; ++i) {
+      CalEvent s = {};
+      s.repeat = (CalRepeat)(i % 4);
+      s.when   = (s.repeat == CAL_ONCE) ? t0 + (uint32_t)(rand() % (7 * 86400)) : (uint32_t)(rand() % 86400);
+      s.day    = (s.repeat == CAL_WEEKLY) ? (uint8_t)(rand() % 7) : (uint8_t)(1 + rand() % 31);
+      s.action = (CalAction)(i % 3);
+      cal_add(c, s, t0);
+    }
+    double insNs = nsSince(ti, n);
+    if (!heapOk(c)) { printf("heap broken after insert\n"); return 1; }
+
+    // fire: step the clock a minute at a time across 8 days
+    benchFired = 0;
+    uint32_t prev = 0;
+    auto tf = std::chrono::steady_clock::now();
+    for (uint32_t t = t0; t < t0 + 8 * 86400; t += 60) {
+      uint32_t next = cal_next_s(c);
+      if (next > t) continue;
+      cal_poll(c, t, countFire, nullptr);
+      if (next < prev) { printf("fired out of order\n"); return 1; }
+      prev = next;
+    }
+    double fireNs = benchFired ? nsSince(tf, benchFired) : 0;
+    if (!heapOk(c)) { printf("heap broken after fire\n"); return 1; }
+
+    // remove the rest by id
+    uint16_t left = c.count;
+    auto tr = std::chrono::steady_clock::now();
+    while (c.count) cal_remove(c, c.ev[c.count / 2].id);
+    double remNs = left ? nsSince(tr, left) : 0;
+
+    printf("%6u %8u %10.0f %10.0f %10.0f\n", n,
+           (unsigned)(n * (sizeof(CalEvent) + 2 * sizeof(uint16_t))), insNs, fireNs, remNs);
+    delete[] ev; delete[] heap; delete[] pos;
+  }
+
+  CalEvent s = { 0, 6 * 3600, 0, CAL_MONTHLY, 31, CAL_ACT_START, 5, 300 };
+  Calendar c; CalEvent e1[1]; uint16_t h1[1], p1[1];
+  cal_init(c, e1, h1, p1, 1);
+  cal_add(c, s, t0);
+  char line[80];
+  cal_format(c.ev[0], line, sizeof(line));
+  printf("%s → next %u\n", line, (unsigned)cal_next_s(c));
+  return 0;
+}
+#endif
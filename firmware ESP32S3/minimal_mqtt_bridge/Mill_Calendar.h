@@ -0,0 +1,97 @@
+#pragma once
+
+/*
+ * Mill_Calendar.h
+ *
+ * Timed events ("calendar") in a binary min-heap keyed by next fire time.
+ *
+ *  - One 16-byte CalEvent per event; storage is supplied by the caller, so
+ *    the WS relay timers and the mill schedule can size theirs separately.
+ *  - Insert, fire and remove are O(log n) heap operations (remove by id
+ *    first finds the slot, O(n)). Events stay packed in slots 0..count-1.
+ *  - Text is only produced on request (cal_format); nothing is stored.
+ *  - Times are UTC Unix seconds. Repeating events keep a second-of-day
+ *    plus weekday / day of month; monthly events skip months that do not
+ *    have that day.
+ *  - cal_poll() fires everything due. An event found later than
+ *    late_limit_s (clock stepped, task stalled) is counted as missed and
+ *    not passed on; one-shot events are then gone, repeating ones move to
+ *    their next occurrence.
+ *
+ * Plain C++. Host benchmark (RAM per event, insert / fire cost):
+ *
+ *   g++ -std=c++17 -O2 -DMILL_CAL_BENCH_MAIN Mill_Calendar.cpp Mill_TimeSync.cpp -o cal_bench
+ *   ./cal_bench
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum CalRepeat : uint8_t {
+  CAL_ONCE = 0,
+  CAL_DAILY,
+  CAL_WEEKLY,
+  CAL_MONTHLY
+};
+
+enum CalAction : uint8_t {
+  CAL_ACT_RELAYS = 0,      // a = channels to open (bit 0 = CH1), b = channels to close
+  CAL_ACT_START,           // recipe start: a = cycles, b = seconds per cycle (0 = keep)
+  CAL_ACT_STOP
+};
+
+struct CalEvent {
+  uint32_t next_s;         // next fire (UTC Unix s); maintained by the calendar
+  uint32_t when;           // ONCE: UTC Unix s; otherwise second of day
+  uint16_t id;             // assigned by cal_add, never reused within a boot
+  CalRepeat repeat;
+  uint8_t  day;            // WEEKLY: 0 = Sunday; MONTHLY: 1..31
+  CalAction action;
+  uint8_t  a;
+  uint16_t b;
+};
+
+struct Calendar {
+  CalEvent *ev;            // slots 0..count-1
+  uint16_t *heap;          // heap position → slot
+  uint16_t *pos;           // slot → heap position
+  uint16_t  cap;
+  uint16_t  count;
+  uint16_t  next_id;
+
+  uint32_t  late_limit_s;
+  uint32_t  fired;
+  uint32_t  missed;
+};
+
+// Called for each due event (a copy: the callback may add / remove).
+typedef void (*CalFireFn)(const CalEvent &ev, uint32_t late_s, void *ctx);
+
+void cal_init(Calendar &c, CalEvent *ev, uint16_t *heap, uint16_t *pos, uint16_t cap);
+
+// Adds `spec` (next_s / id ignored); returns the new id, 0 if the calendar
+// is full or the spec invalid. A one-shot in the past fires on next poll.
+uint16_t cal_add(Calendar &c, const CalEvent &spec, uint32_t now_s);
+bool     cal_remove(Calendar &c, uint16_t id);
+void     cal_clear(Calendar &c);
+
+// Next fire time, 0 if empty.
+uint32_t cal_next_s(const Calendar &c);
+
+// Fires everything due at now_s; returns the number of events taken off
+// the top (fired + missed).
+uint16_t cal_poll(Calendar &c, uint32_t now_s, CalFireFn fn, void *ctx);
+
+// Recompute every repeating event after a clock step (O(n)).
+void cal_resync(Calendar &c, uint32_t now_s);
+
+// First occurrence of `ev` at or after `after`.
+uint32_t cal_next_fire(const CalEvent &ev, uint32_t after);
+
+// "#12 DAILY 06:00:00 START cycles=5 cycle_s=300"; returns strlen.
+size_t cal_format(const CalEvent &ev, char *out, size_t len);
+
+const char *cal_repeat_str(CalRepeat r);
+const char *cal_action_str(CalAction a);
+bool cal_repeat_from_str(const char *s, CalRepeat &out);
+bool cal_action_from_str(const char *s, CalAction &out);
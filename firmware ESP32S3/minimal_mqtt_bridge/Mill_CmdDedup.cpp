@@ -0,0 +1,96 @@
+#include "Mill_CmdDedup.h"
+
+#include <string.h>
+
+static uint32_t cmdHash(const char *s) {
+  uint32_t h = 2166136261u;   // FNV-1a
+  while (s && *s) {
+    h ^= (uint8_t)*s++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+void cmd_dedup_init(CmdDedup &d, uint32_t ttl_ms) {
+  memset(&d, 0, sizeof(d));
+  d.ttl_ms = ttl_ms;
+}
+
+bool cmd_dedup_seen(CmdDedup &d, uint32_t seq, const char *cmd, uint32_t now_ms) {
+  uint32_t h = cmdHash(cmd);
+  CmdDedupEntry *set = d.e[seq & (CMD_DEDUP_SETS - 1)];
+
+  // Hit, or pick a victim: a free / expired way first, else the oldest
+  CmdDedupEntry *victim = nullptr;
+  bool victimLive = true;
+  for (uint8_t w = 0; w < CMD_DEDUP_WAYS; ++w) {
+    CmdDedupEntry &x = set[w];
+    bool live = x.used && (now_ms - x.t_ms) < d.ttl_ms;
+    if (live && x.seq == seq && x.cmd_hash == h) {
+      d.duplicates++;
+      return true;
+    }
+    if (!live) {
+      if (victimLive) { victim = &x; victimLive = false; }
+    } else if (victimLive && (!victim || (now_ms - x.t_ms) > (now_ms - victim->t_ms))) {
+      victim = &x;
+    }
+  }
+
+  if (victimLive) d.evicted++;
+  victim->seq      = seq;
+  victim->cmd_hash = h;
+  victim->t_ms     = now_ms;
+  victim->used     = true;
+  d.accepted++;
+  return false;
+}
+
+// -------------------------------------------------------------------
+// Host demo: what a QoS 1 subscriber sees after reconnects and retries
+// -------------------------------------------------------------------
+#ifdef MILL_DEDUP_DEMO_MAIN
+#include <stdio.h>
+
+static int failures = 0;
+
+static void deliver(CmdDedup &d, uint32_t seq, const char *cmd, uint32_t now, bool expectRun, const char *why) {
+  bool run = !cmd_dedup_seen(d, seq, cmd, now);
+  printf("t=%7lu  seq %4lu %-6s %-9s %s%s\n", (unsigned long)now, (unsigned long)seq, cmd,
+         run ? "EXECUTE" : "DUPLICATE", why, run == expectRun ? "" : "   <-- UNEXPECTED");
+  if (run != expectRun) failures++;
+}
+
+int main() {
+  CmdDedup d;
+  cmd_dedup_init(d);
+  printf("table %u B (%u sets x %u ways), ttl %lu ms\n\n", (unsigned)sizeof(d),
+         CMD_DEDUP_SETS, CMD_DEDUP_WAYS, (unsigned long)d.ttl_ms);
+
+  deliver(d, 1, "START", 1000, true,  "");
+  deliver(d, 2, "HOLD",  2000, true,  "");
+  deliver(d, 2, "HOLD",  9000, false, "broker redelivery (DUP) after reconnect");
+  deliver(d, 2, "HOLD",  9500, false, "HMI resend, ack was lost");
+  deliver(d, 3, "RESUME", 10000, true, "");
+
+  // Out of order: 5 overtakes 4, then a stale copy of 4
+  deliver(d, 5, "STOP",  11000, true,  "arrives before 4");
+  deliver(d, 4, "HOLD",  11010, true,  "late but new");
+  deliver(d, 4, "HOLD",  11020, false, "second copy of 4");
+
+  // HMI restarted, counter back at 1 with another command
+  deliver(d, 1, "STOP",  12000, true,  "same seq, different cmd");
+  deliver(d, 1, "START", 12000 + d.ttl_ms, true, "same seq + cmd after the TTL");
+
+  // A burst that wraps the table: only the newest SETS x WAYS are remembered
+  uint32_t t = 400000;
+  for (uint32_t s = 100; s < 300; ++s) cmd_dedup_seen(d, s, "START", t++);
+  deliver(d, 299, "START", t, false, "newest of a 200-command burst");
+  deliver(d, 300 - CMD_DEDUP_SETS * CMD_DEDUP_WAYS, "START", t, false, "oldest still in the window");
+  deliver(d, 100, "START", t, true, "pushed out by the burst");
+
+  printf("\naccepted %lu  duplicates %lu  evicted %lu  ->  %s\n", (unsigned long)d.accepted,
+         (unsigned long)d.duplicates, (unsigned long)d.evicted, failures ? "FAIL" : "OK");
+  return failures ? 1 : 0;
+}
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+ * Mill_CmdDedup.h
+ *
+ * Idempotency window for commands on the QoS 1 command topics. QoS 1 is
+ * at-least-once: the broker redelivers a command whose PUBACK it did not
+ * see (lost on a reconnect), and an HMI that got no ack resends the same
+ * "seq". Either way the second copy must not run again.
+ *
+ * A command is identified by (seq, hash of the cmd string), so an HMI
+ * that restarts its counter at 1 is not mistaken for a redelivery unless
+ * it also repeats the command. Entries live ttl_ms. No high-water mark:
+ * reordered deliveries (7 before 6) both run, each exactly once.
+ *
+ * Table: CMD_DEDUP_SETS sets x CMD_DEDUP_WAYS ways, set = seq mod SETS,
+ * so the last SETS commands of a counting sender never collide; one set
+ * lookup per command, no allocation. When a set is full the oldest way
+ * goes (counted in `evicted` if it was still inside the TTL).
+ *
+ * Plain C++. Host demo (duplicates, reordering, HMI restart, overflow):
+ *
+ *   g++ -std=c++17 -DMILL_DEDUP_DEMO_MAIN Mill_CmdDedup.cpp -o dedup_demo
+ *   ./dedup_demo
+ */
+
+#include <stdint.h>
+
+static const uint8_t  CMD_DEDUP_SETS   = 32;      // power of two
+static const uint8_t  CMD_DEDUP_WAYS   = 2;
+static const uint32_t CMD_DEDUP_TTL_MS = 300000;  // 5 min
+
+struct CmdDedupEntry {
+  uint32_t seq;
+  uint32_t cmd_hash;
+  uint32_t t_ms;
+  bool     used;
+};
+
+struct CmdDedup {
+  CmdDedupEntry e[CMD_DEDUP_SETS][CMD_DEDUP_WAYS];
+  uint32_t      ttl_ms;
+
+  uint32_t      accepted;      // first deliveries
+  uint32_t      duplicates;    // redeliveries suppressed
+  uint32_t      evicted;       // live entries pushed out by a full set
+};
+
+void cmd_dedup_init(CmdDedup &d, uint32_t ttl_ms = CMD_DEDUP_TTL_MS);
+
+// true: (seq, cmd) was seen within the TTL – do not execute it again.
+// false: first delivery, now recorded.
+bool cmd_dedup_seen(CmdDedup &d, uint32_t seq, const char *cmd, uint32_t now_ms);
@@ -0,0 +1,337 @@
+#include "Mill_Config.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// -------------------------------------------------------------------
+// Schema v1
+// -------------------------------------------------------------------
+
+#define CFG_AT(field) (uint16_t)offsetof(MillConfig, field)
+
+const CfgKey MILL_CONFIG_KEYS[] = {
+  // key            alias             type               min      max      target                hot
+  { "run_time_s",   "cycle_target_s", CFG_UINT,          0,       86400,   CFG_AT(run_time_s),   false },
+  { "cool_time_s",  nullptr,          CFG_UINT,          0,       86400,   CFG_AT(cool_time_s),  false },
+  { "total_cycles", "cycle_target",   CFG_UINT,          0,       9999,    CFG_AT(total_cycles), false },
+  { "ln2_mode",     nullptr,          CFG_LN2_MODE,      0,       0,       CFG_AT(ln2.mode),     false },
+  { "ln2_sv_c",     nullptr,          CFG_FLOAT_OR_NULL, -200.0f, 50.0f,   CFG_AT(ln2.sv_c),     true  },
+  { "ln2_band_c",   nullptr,          CFG_FLOAT,         0.1f,    20.0f,   CFG_AT(ln2.band_c),   true  },
+  { "ln2_kp",       nullptr,          CFG_FLOAT,         0.001f,  1.0f,    CFG_AT(ln2.kp),       true  },
+  { "ln2_ti_s",     nullptr,          CFG_FLOAT,         0.0f,    3600.0f, CFG_AT(ln2.ti_s),     true  },
+  { "anom_fault",   nullptr,          CFG_BOOL,          0,       1,       CFG_AT(anom_fault),   true  },
+};
+
+#undef CFG_AT
+
+const uint8_t MILL_CONFIG_KEY_COUNT = sizeof(MILL_CONFIG_KEYS) / sizeof(MILL_CONFIG_KEYS[0]);
+
+static_assert(sizeof(MILL_CONFIG_KEYS) / sizeof(MILL_CONFIG_KEYS[0]) <= 16,
+              "CfgResult.changed has one bit per key");
+
+static const char *const ENVELOPE_KEYS[] = { "cmd", "seq", "ts", "source" };
+
+// -------------------------------------------------------------------
+// Flat JSON object scanner (string / number / literal values only)
+// -------------------------------------------------------------------
+
+struct Scan {
+  const char *p;
+  const char *end;
+};
+
+static void skipWs(Scan &s) {
+  while (s.p < s.end && (*s.p == ' ' || *s.p == '\t' || *s.p == '\r' || *s.p == '\n')) ++s.p;
+}
+
+// Copies a "..." string (no escapes) into out; false if malformed / too long
+static bool readString(Scan &s, char *out, size_t cap) {
+  if (s.p >= s.end || *s.p != '"') return false;
+  ++s.p;
+  size_t n = 0;
+  while (s.p < s.end && *s.p != '"') {
+    if (*s.p == '\\' || n + 1 >= cap) return false;
+    out[n++] = *s.p++;
+  }
+  if (s.p >= s.end) return false;
+  ++s.p;
+  out[n] = '\0';
+  return true;
+}
+
+// Value: "string" or a bare token up to , } or whitespace. Quotes are
+// dropped: older HMIs send numbers as strings ("300"), which the
+// pre-schema parser accepted.
+static bool readValue(Scan &s, char *out, size_t cap) {
+  if (s.p < s.end && *s.p == '"') return readString(s, out, cap);
+  size_t n = 0;
+  while (s.p < s.end && *s.p != ',' && *s.p != '}' &&
+         *s.p != ' ' && *s.p != '\t' && *s.p != '\r' && *s.p != '\n') {
+    if (*s.p == '{' || *s.p == '[' || n + 1 >= cap) return false;
+    out[n++] = *s.p++;
+  }
+  out[n] = '\0';
+  return n > 0;
+}
+
+// Envelope values ("source" can be any length) are only stepped over
+static bool skipValue(Scan &s) {
+  if (s.p < s.end && *s.p == '"') {
+    ++s.p;
+    while (s.p < s.end && *s.p != '"') {
+      if (*s.p == '\\' && s.p + 1 < s.end) ++s.p;
+      ++s.p;
+    }
+    if (s.p >= s.end) return false;
+    ++s.p;
+    return true;
+  }
+  const char *start = s.p;
+  while (s.p < s.end && *s.p != ',' && *s.p != '}' &&
+         *s.p != ' ' && *s.p != '\t' && *s.p != '\r' && *s.p != '\n') {
+    if (*s.p == '{' || *s.p == '[') return false;
+    ++s.p;
+  }
+  return s.p > start;
+}
+
+// -------------------------------------------------------------------
+// Typed values
+// -------------------------------------------------------------------
+
+static bool sameFloat(float a, float b) {
+  return (isnan(a) && isnan(b)) || a == b;
+}
+
+// Validates one value and stores it into `staged`; returns CFG_OK or why not
+static CfgStatus storeValue(const CfgKey &k, const char *v, MillConfig &staged) {
+  uint8_t *field = (uint8_t *)&staged + k.offset;
+  char *end = nullptr;
+
+  switch (k.type) {
+    case CFG_UINT: {
+      if (*v == '-') return CFG_BAD_VALUE;
+      unsigned long x = strtoul(v, &end, 10);
+      if (end == v || *end != '\0') return CFG_BAD_VALUE;
+      if (x < (unsigned long)k.min || x > (unsigned long)k.max) return CFG_OUT_OF_RANGE;
+      *(uint32_t *)field = (uint32_t)x;
+      return CFG_OK;
+    }
+    case CFG_FLOAT:
+    case CFG_FLOAT_OR_NULL: {
+      if (strcmp(v, "null") == 0) {
+        if (k.type != CFG_FLOAT_OR_NULL) return CFG_BAD_VALUE;
+        *(float *)field = NAN;
+        return CFG_OK;
+      }
+      float x = strtof(v, &end);
+      if (end == v || *end != '\0' || isnan(x) || isinf(x)) return CFG_BAD_VALUE;
+      if (x < k.min || x > k.max) return CFG_OUT_OF_RANGE;
+      *(float *)field = x;
+      return CFG_OK;
+    }
+    case CFG_BOOL:
+      if (strcmp(v, "true") == 0 || strcmp(v, "1") == 0)  { *(bool *)field = true;  return CFG_OK; }
+      if (strcmp(v, "false") == 0 || strcmp(v, "0") == 0) { *(bool *)field = false; return CFG_OK; }
+      return CFG_BAD_VALUE;
+    case CFG_LN2_MODE: {
+      Ln2Mode m;
+      if (!ln2ctl_mode_from_str(v, m)) return CFG_BAD_VALUE;
+      *(Ln2Mode *)field = m;
+      return CFG_OK;
+    }
+  }
+  return CFG_BAD_VALUE;
+}
+
+static bool sameValue(const CfgKey &k, const MillConfig &a, const MillConfig &b) {
+  const uint8_t *fa = (const uint8_t *)&a + k.offset;
+  const uint8_t *fb = (const uint8_t *)&b + k.offset;
+  switch (k.type) {
+    case CFG_UINT:          return *(const uint32_t *)fa == *(const uint32_t *)fb;
+    case CFG_FLOAT:
+    case CFG_FLOAT_OR_NULL: return sameFloat(*(const float *)fa, *(const float *)fb);
+    case CFG_BOOL:          return *(const bool *)fa == *(const bool *)fb;
+    case CFG_LN2_MODE:      return *(const Ln2Mode *)fa == *(const Ln2Mode *)fb;
+  }
+  return false;
+}
+
+static int findKey(const char *name) {
+  for (uint8_t i = 0; i < MILL_CONFIG_KEY_COUNT; ++i) {
+    const CfgKey &k = MILL_CONFIG_KEYS[i];
+    if (strcmp(name, k.key) == 0 || (k.alias && strcmp(name, k.alias) == 0)) return i;
+  }
+  return -1;
+}
+
+static bool isEnvelope(const char *name) {
+  for (const char *e : ENVELOPE_KEYS) {
+    if (strcmp(name, e) == 0) return true;
+  }
+  return false;
+}
+
+static bool fail(CfgResult &res, CfgStatus st, const char *key) {
+  res.status = st;
+  snprintf(res.key, sizeof(res.key), "%s", key ? key : "");
+  return false;
+}
+
+// -------------------------------------------------------------------
+// API
+// -------------------------------------------------------------------
+
+bool mill_config_parse(const char *json, size_t len, MillState state,
+                       const MillConfig &live, MillConfig &staged, CfgResult &res) {
+  memset(&res, 0, sizeof(res));
+  staged = live;
+
+  Scan s = { json, json + len };
+  skipWs(s);
+  if (s.p >= s.end || *s.p != '{') return fail(res, CFG_BAD_JSON, nullptr);
+  ++s.p;
+  skipWs(s);
+  bool first = true;
+
+  while (true) {
+    skipWs(s);
+    if (s.p < s.end && *s.p == '}') break;
+    if (!first) {
+      if (s.p >= s.end || *s.p != ',') return fail(res, CFG_BAD_JSON, nullptr);
+      ++s.p;
+      skipWs(s);
+    }
+    first = false;
+
+    char key[24], val[24];
+    if (!readString(s, key, sizeof(key))) return fail(res, CFG_BAD_JSON, nullptr);
+    skipWs(s);
+    if (s.p >= s.end || *s.p != ':') return fail(res, CFG_BAD_JSON, key);
+    ++s.p;
+    skipWs(s);
+    if (isEnvelope(key)) {
+      if (!skipValue(s)) return fail(res, CFG_BAD_JSON, key);
+      continue;
+    }
+    if (!readValue(s, val, sizeof(val))) return fail(res, CFG_BAD_VALUE, key);
+    if (strcmp(key, "schema") == 0) {
+      if (strcmp(val, "1") != 0) return fail(res, CFG_BAD_SCHEMA, key);
+      continue;
+    }
+    int i = findKey(key);
+    if (i < 0) return fail(res, CFG_UNKNOWN_KEY, key);
+    CfgStatus st = storeValue(MILL_CONFIG_KEYS[i], val, staged);
+    if (st != CFG_OK) return fail(res, st, key);
+  }
+
+  // Decide on the staged result, so a key sent twice counts once
+  for (uint8_t i = 0; i < MILL_CONFIG_KEY_COUNT; ++i) {
+    const CfgKey &k = MILL_CONFIG_KEYS[i];
+    if (sameValue(k, live, staged)) continue;
+    if (state == MILL_RUN && !k.hot) {
+      res.changed = 0;
+      return fail(res, CFG_NOT_HOT, k.key);
+    }
+    res.changed |= (uint16_t)(1u << i);
+  }
+  res.status = CFG_OK;
+  return true;
+}
+
+const char *mill_config_status_str(CfgStatus s) {
+  switch (s) {
+    case CFG_OK:           return "OK";
+    case CFG_BAD_JSON:     return "BAD_JSON";
+    case CFG_BAD_SCHEMA:   return "BAD_SCHEMA";
+    case CFG_UNKNOWN_KEY:  return "UNKNOWN_KEY";
+    case CFG_BAD_VALUE:    return "BAD_VALUE";
+    case CFG_OUT_OF_RANGE: return "OUT_OF_RANGE";
+    case CFG_NOT_HOT:      return "LOCKED_IN_RUN";
+  }
+  return "?";
+}
+
+size_t mill_config_json(const MillConfig &cfg, char *buf, size_t cap) {
+  if (!buf || cap == 0) return 0;
+  size_t len = 0;
+  int n = snprintf(buf, cap, "\"schema\":%u", MILL_CONFIG_SCHEMA);
+  if (n < 0 || (size_t)n >= cap) return 0;
+  len = (size_t)n;
+
+  for (uint8_t i = 0; i < MILL_CONFIG_KEY_COUNT; ++i) {
+    const CfgKey  &k     = MILL_CONFIG_KEYS[i];
+    const uint8_t *field = (const uint8_t *)&cfg + k.offset;
+    char *o   = buf + len;
+    size_t rm = cap - len;
+    switch (k.type) {
+      case CFG_UINT:
+        n = snprintf(o, rm, ",\"%s\":%lu", k.key, (unsigned long)*(const uint32_t *)field);
+        break;
+      case CFG_FLOAT:
+      case CFG_FLOAT_OR_NULL: {
+        float v = *(const float *)field;
+        n = isnan(v) ? snprintf(o, rm, ",\"%s\":null", k.key)
+                     : snprintf(o, rm, ",\"%s\":%g", k.key, (double)v);
+        break;
+      }
+      case CFG_BOOL:
+        n = snprintf(o, rm, ",\"%s\":%s", k.key, *(const bool *)field ? "true" : "false");
+        break;
+      case CFG_LN2_MODE:
+        n = snprintf(o, rm, ",\"%s\":\"%s\"", k.key, ln2ctl_mode_str(*(const Ln2Mode *)field));
+        break;
+    }
+    if (n < 0 || (size_t)n >= rm) return 0;
+    len += (size_t)n;
+  }
+  return len;
+}
+
+// -------------------------------------------------------------------
+// Host demo: messages an HMI might send, in IDLE and in RUN
+// -------------------------------------------------------------------
+#ifdef MILL_CFG_DEMO_MAIN
+
+static void show(const char *label, MillState state, MillConfig &live, const char *msg) {
+  MillConfig staged;
+  CfgResult  r;
+  bool ok = mill_config_parse(msg, strlen(msg), state, live, staged, r);
+  printf("%-5s %-28s %s", state == MILL_RUN ? "RUN" : "IDLE", label, ok ? "APPLIED" : "REJECTED");
+  if (!ok) printf(" (%s %s)", r.key, mill_config_status_str(r.status));
+  else     printf(" changed=0x%03x", r.changed);
+  printf("\n      %s\n", msg);
+  if (ok) live = staged;
+
+  char body[MILL_CONFIG_JSON_MAX];
+  mill_config_json(live, body, sizeof(body));
+  printf("   -> {%s}\n\n", body);
+}
+
+int main() {
+  MillConfig live;
+  memset(&live, 0, sizeof(live));
+  ln2ctl_default_config(live.ln2);
+  printf("schema v%u, %u keys, MillConfig %u B\n\n", MILL_CONFIG_SCHEMA, MILL_CONFIG_KEY_COUNT,
+         (unsigned)sizeof(MillConfig));
+
+  show("recipe", MILL_IDLE, live,
+       "{\"cmd\":\"SET_CONFIG\",\"seq\":7,\"source\":\"HMI panel, line 2 (\\\"north\\\")\",\"run_time_s\":300,\"cool_time_s\":120,\"total_cycles\":5}");
+  show("documented names (§4)", MILL_IDLE, live,
+       "{\"run_time_s\": 240, \"cool_time_s\": 90, \"cycle_target\": 4, \"ln2_sv_c\": -90.0}");
+  show("half valid: nothing applied", MILL_IDLE, live,
+       "{\"run_time_s\":600,\"ln2_kp\":5}");
+  show("typo", MILL_IDLE, live, "{\"run_tme_s\":600}");
+  show("SV is hot", MILL_RUN, live, "{\"ln2_sv_c\":-120,\"ln2_kp\":0.05}");
+  show("run time is not", MILL_RUN, live, "{\"run_time_s\":200}");
+  show("full form, only SV new", MILL_RUN, live,
+       "{\"schema\":1,\"run_time_s\":240,\"cool_time_s\":90,\"total_cycles\":4,\"ln2_sv_c\":null}");
+  show("wrong schema", MILL_IDLE, live, "{\"schema\":2,\"run_time_s\":1}");
+  show("quoted numbers (older HMIs)", MILL_IDLE, live, "{\"total_cycles\":\"3\",\"anom_fault\":\"1\"}");
+  show("negative count", MILL_IDLE, live, "{\"total_cycles\":-3}");
+  return 0;
+}
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+/*
+ * Mill_Config.h
+ *
+ * Configuration schema v1. One table of keys (type, range, target field,
+ * hot-changeable) drives SET_CONFIG / mill/<id>/cmd/config parsing and the
+ * retained config echo, so the two can't drift apart.
+ *
+ * A message is parsed in a single pass into a staging copy of the live
+ * MillConfig. Every key must be known and in range; the caller commits the
+ * copy only if the whole message passed, so a half-valid message changes
+ * nothing. While the mill is in RUN a key that is not hot-changeable may
+ * only repeat its current value (an HMI can always send its full form).
+ *
+ * Envelope keys ("cmd", "seq", "ts", "source") are skipped; "schema", if
+ * given, must be MILL_CONFIG_SCHEMA.
+ *
+ * Plain C++. Host demo (valid, half-valid, RUN lock, aliases):
+ *
+ *   g++ -std=c++17 -DMILL_CFG_DEMO_MAIN Mill_Config.cpp Mill_Ln2Control.cpp -o cfg_demo
+ *   ./cfg_demo
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Mill_Ln2Control.h"
+#include "Mill_Snapshot.h"
+
+static const uint8_t MILL_CONFIG_SCHEMA   = 1;
+static const size_t  MILL_CONFIG_JSON_MAX = 256;   // mill_config_json() body
+
+struct MillConfig {
+  uint32_t  run_time_s;      // motor-on seconds per cycle (FSM cycle_target)
+  uint32_t  cool_time_s;     // RUN_COOLING seconds between cycles, 0 = none
+  uint32_t  total_cycles;    // 0 = no recipe
+  Ln2Config ln2;             // mode / sv_c / band_c / kp / ti_s from the schema
+  bool      anom_fault;      // PID anomaly latches FAULT_DEVICE
+};
+
+enum CfgType : uint8_t {
+  CFG_UINT = 0,
+  CFG_FLOAT,
+  CFG_FLOAT_OR_NULL,         // null → NAN
+  CFG_BOOL,                  // true / false / 1 / 0
+  CFG_LN2_MODE               // "STATE" / "HYST" / "PID"
+};
+
+struct CfgKey {
+  const char *key;
+  const char *alias;         // older / documented name, nullptr = none
+  CfgType     type;
+  float       min;
+  float       max;
+  uint16_t    offset;        // into MillConfig
+  bool        hot;           // may change while RUN
+};
+
+extern const CfgKey  MILL_CONFIG_KEYS[];
+extern const uint8_t MILL_CONFIG_KEY_COUNT;
+
+enum CfgStatus : uint8_t {
+  CFG_OK = 0,
+  CFG_BAD_JSON,              // not a flat JSON object
+  CFG_BAD_SCHEMA,            // "schema" other than MILL_CONFIG_SCHEMA
+  CFG_UNKNOWN_KEY,
+  CFG_BAD_VALUE,             // wrong type
+  CFG_OUT_OF_RANGE,
+  CFG_NOT_HOT                // would change a RUN-locked key while RUN
+};
+
+struct CfgResult {
+  CfgStatus status;
+  uint16_t  changed;         // bit i = MILL_CONFIG_KEYS[i] got a new value
+  char      key[24];         // offending key (CFG_OK: empty)
+};
+
+// false: `staged` must be discarded; res says which key and why.
+bool mill_config_parse(const char *json, size_t len, MillState state,
+                       const MillConfig &live, MillConfig &staged, CfgResult &res);
+
+const char *mill_config_status_str(CfgStatus s);
+
+// "schema":1,"run_time_s":300,… in table order, no braces (the caller
+// wraps it, e.g. with id / fw for the retained echo). 0 on overflow.
+size_t mill_config_json(const MillConfig &cfg, char *buf, size_t cap);
@@ -0,0 +1,136 @@
+#include "Mill_Eta.h"
+
+#include <math.h>
+#include <string.h>
+
+// EWMA weights: cycles are few and long, PV steps are many and noisy
+static const float ETA_CYCLE_ALPHA = 0.25f;
+static const float ETA_RATE_ALPHA  = 0.125f;
+
+// PV steps shorter than this are merged (LC108 resolution is 0.1 °C)
+static const uint32_t ETA_PV_MIN_STEP_MS = 1000;
+
+// Closer than this to SV counts as "at temperature"
+static const float ETA_AT_SV_C = 1.0f;
+
+void eta_init(MillEta &e) {
+  memset(&e, 0, sizeof(e));
+  e.cycle_ratio = 1.0f;
+}
+
+static void recipeStart(MillEta &e, const EtaInputs &in, uint32_t now_ms) {
+  e.active         = true;
+  e.last_index     = in.cycle_index;
+  e.cycle_start_ms = now_ms;
+  e.recipe_ms      = 0;
+  e.stall_ms       = 0;
+  e.ln2_open_ms    = 0;
+  e.cycles_timed   = 0;
+  e.last_cycle_ms  = 0;
+  e.cycle_ratio    = 1.0f;
+}
+
+static void cycleDone(MillEta &e, const EtaInputs &in, uint32_t now_ms) {
+  uint32_t d = now_ms - e.cycle_start_ms;
+  e.last_cycle_ms  = d;
+  e.cycle_start_ms = now_ms;
+  // Cycles that end here had their cooling phase (only the last has none)
+  uint32_t nominal = in.cycle_target + in.cool_target;
+  if (nominal == 0) return;
+
+  float r = (d / 1000.0f) / nominal;
+  if (r < 1.0f) r = 1.0f;                 // tick quantization, never faster
+  e.cycle_ratio = (e.cycles_timed == 0)
+                    ? r
+                    : e.cycle_ratio + ETA_CYCLE_ALPHA * (r - e.cycle_ratio);
+  e.cycles_timed++;
+}
+
+static void trackPv(MillEta &e, const EtaInputs &in, uint32_t now_ms) {
+  if (!in.pv_ok || isnan(in.pv_c)) {
+    e.pv_valid = false;                   // restart the trend after a gap
+    return;
+  }
+  if (!e.pv_valid) {
+    e.pv_valid  = true;
+    e.pv_ref_c  = in.pv_c;
+    e.pv_ref_ms = now_ms;
+    return;
+  }
+  uint32_t dt = now_ms - e.pv_ref_ms;
+  if (dt < ETA_PV_MIN_STEP_MS) return;
+
+  float rate = (in.pv_c - e.pv_ref_c) * 1000.0f / dt;
+  e.cool_rate_cps = e.rate_valid
+                      ? e.cool_rate_cps + ETA_RATE_ALPHA * (rate - e.cool_rate_cps)
+                      : rate;
+  e.rate_valid = true;
+  e.pv_ref_c   = in.pv_c;
+  e.pv_ref_ms  = now_ms;
+}
+
+void eta_update(MillEta &e, const EtaInputs &in, uint32_t now_ms) {
+  uint32_t dt = (e.last_ms != 0) ? now_ms - e.last_ms : 0;
+  e.last_ms = now_ms;
+
+  trackPv(e, in, now_ms);
+
+  bool inRecipe = (in.state != MILL_IDLE) && in.cycle_total > 0 && in.cycle_index > 0;
+  if (!inRecipe) {
+    e.active = false;                     // keep the last recipe's numbers
+    return;
+  }
+  if (!e.active || in.cycle_index < e.last_index) {
+    recipeStart(e, in, now_ms);           // fresh START (or restart from HOLD)
+    return;
+  }
+
+  e.recipe_ms += dt;
+  if (in.state != MILL_RUN) e.stall_ms += dt;
+  if (in.ln2_open)          e.ln2_open_ms += dt;
+
+  if (in.cycle_index > e.last_index) {
+    cycleDone(e, in, now_ms);
+    e.last_index = in.cycle_index;
+  }
+}
+
+void eta_snapshot(const MillEta &e, const EtaInputs &in, EtaSnapshot &out) {
+  memset(&out, 0, sizeof(out));
+
+  out.cycle_ratio   = e.cycle_ratio;
+  out.last_cycle_s  = e.last_cycle_ms / 1000;
+  out.stall_s       = e.stall_ms / 1000;
+  out.cool_rate_cpm = e.rate_valid ? e.cool_rate_cps * 60.0f : 0.0f;
+
+  // Time until PV reaches SV at the current cooling rate
+  out.time_to_sv_s = -1;
+  if (in.pv_ok && e.rate_valid && !isnan(in.pv_c) && !isnan(in.sv_c)) {
+    float gap = in.pv_c - in.sv_c;
+    if (gap <= ETA_AT_SV_C) {
+      out.time_to_sv_s = 0;
+    } else if (e.cool_rate_cps < -0.001f) {
+      out.time_to_sv_s = (int32_t)lroundf(gap / -e.cool_rate_cps);
+    }
+  }
+
+  out.valid = e.active;
+  if (!e.active) return;
+
+  // Run + cooling seconds still to go × observed wall / nominal ratio;
+  // every cycle but the last cools
+  uint32_t left   = (in.cycle_index < in.cycle_total) ? in.cycle_total - in.cycle_index : 0;
+  uint32_t cools  = left ? left - 1 + (in.cooling ? 0 : 1) : 0;
+  float    runS   = (float)in.time_remaining_s + (float)left * in.cycle_target +
+                    (float)cools * in.cool_target;
+  float    etaS   = runS * e.cycle_ratio;
+  out.recipe_s    = (uint32_t)lroundf(etaS);
+
+  // LN2 duty so far, applied to what is left (no history → unknown)
+  if (e.recipe_ms >= 10000) {
+    float duty       = (float)e.ln2_open_ms / e.recipe_ms;
+    out.ln2_open_s   = (int32_t)lroundf(duty * etaS);
+  } else {
+    out.ln2_open_s   = -1;
+  }
+}
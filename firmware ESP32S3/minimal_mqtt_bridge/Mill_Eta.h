@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ * Mill_Eta.h
+ *
+ * Recipe-level time-to-finish and LN2 estimate, updated incrementally
+ * from the control loop.
+ *
+ *  - Per-cycle wall-clock duration (HOLD / FAULT dwell included) is
+ *    measured at every cycle boundary; the ratio actual / nominal (run +
+ *    cooling) is smoothed (EWMA) and scales the time still to go.
+ *  - Cool-down rate is an EWMA of dPV/dt over ≥ 1 s PV steps; with it the
+ *    estimator projects time until PV reaches SV.
+ *  - LN2 valve-open time over the recipe so far gives a duty that is
+ *    applied to the remaining time.
+ *
+ * Every update is O(1) with a fixed-size state; no history buffers.
+ * Plain C++, no Arduino headers.
+ */
+
+#include <stdint.h>
+
+#include "Mill_Snapshot.h"
+
+struct EtaInputs {
+  MillState state;
+  uint32_t  cycle_index;        // 0 = no recipe
+  uint32_t  cycle_total;
+  uint32_t  cycle_target;       // s of RUN per cycle
+  uint32_t  cool_target;        // s of cooling between cycles
+  bool      cooling;            // time_remaining_s is the cooling phase's
+  uint32_t  time_remaining_s;   // time left in the current phase
+  bool      pv_ok;
+  float     pv_c;
+  float     sv_c;
+  bool      ln2_open;           // LN2 relay actually energized
+};
+
+struct MillEta {
+  // recipe tracking
+  bool      active;
+  uint32_t  last_ms;
+  uint32_t  last_index;
+  uint32_t  cycle_start_ms;
+  uint32_t  recipe_ms;          // wall time since recipe start
+  uint32_t  stall_ms;           // HOLD + FAULT time since recipe start
+  uint32_t  ln2_open_ms;        // valve-open time since recipe start
+  uint32_t  cycles_timed;
+  uint32_t  last_cycle_ms;
+  float     cycle_ratio;        // EWMA of actual / cycle_target (≥ 1)
+
+  // PV trend
+  bool      pv_valid;
+  float     pv_ref_c;
+  uint32_t  pv_ref_ms;
+  float     cool_rate_cps;      // EWMA dPV/dt (°C/s), < 0 while cooling
+  bool      rate_valid;
+};
+
+void eta_init(MillEta &e);
+
+// Once per loop pass.
+void eta_update(MillEta &e, const EtaInputs &in, uint32_t now_ms);
+
+// Current estimate (cheap; call when publishing).
+void eta_snapshot(const MillEta &e, const EtaInputs &in, EtaSnapshot &out);
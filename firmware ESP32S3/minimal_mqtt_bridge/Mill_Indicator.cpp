@@ -0,0 +1,202 @@
+#include "Mill_Indicator.h"
+
+#include <string.h>
+
+// -------------------------------------------------------------------
+// Internals
+// -------------------------------------------------------------------
+
+// Zero-length pulses would never move the edge forward
+static void sanitize(IndPattern &p, bool queued) {
+  if (p.blinks == 0) p.blinks = 1;
+  if (p.on_ms == 0)  p.on_ms  = 1;
+  if (queued && p.groups == 0) p.groups = 1;
+}
+
+static bool ringPop(IndRing &r, IndPattern &out) {
+  if (r.head == r.tail) return false;
+  out = r.slot[r.tail & (IND_QUEUE_LEN - 1)];
+  r.tail++;
+  return true;
+}
+
+static void load(IndChannel &c, const IndPattern &p, bool bg, uint8_t prio, uint32_t at) {
+  c.cur      = p;
+  c.active   = true;
+  c.cur_bg   = bg;
+  c.cur_prio = prio;
+  c.lit      = true;
+  c.done     = false;
+  c.pulse    = 0;
+  c.group    = 0;
+  c.edge_ms  = at + p.on_ms;
+}
+
+// Highest non-empty ring, else the background, else dark
+static void loadNext(IndChannel &c, uint32_t at) {
+  IndPattern p;
+  for (int prio = IND_PRIO_COUNT - 1; prio >= 0; --prio) {
+    if (ringPop(c.q[prio], p)) {
+      load(c, p, false, (uint8_t)prio, at);
+      c.played++;
+      return;
+    }
+  }
+  if (c.bg_set) {
+    load(c, c.bg, true, 0, at);
+    return;
+  }
+  c.active = false;
+  c.lit    = false;
+}
+
+// One edge, at c.edge_ms
+static void advance(IndChannel &c) {
+  const IndPattern &p = c.cur;
+  if (c.lit) {
+    c.lit = false;
+    if (++c.pulse < p.blinks) {
+      c.edge_ms += p.off_ms;
+      return;
+    }
+    c.pulse = 0;
+    if (p.groups != 0 && ++c.group >= p.groups) c.done = true;
+    c.edge_ms += p.gap_ms;
+    return;
+  }
+  if (c.done) {
+    loadNext(c, c.edge_ms);
+    return;
+  }
+  c.lit      = true;
+  c.edge_ms += p.on_ms;
+}
+
+// -------------------------------------------------------------------
+// API
+// -------------------------------------------------------------------
+
+void ind_init(IndChannel &c) {
+  memset(&c, 0, sizeof(c));
+}
+
+bool ind_push(IndChannel &c, const IndPattern &p, IndPrio prio) {
+  IndRing &r = c.q[prio];
+  if ((uint8_t)(r.head - r.tail) >= IND_QUEUE_LEN) {
+    c.dropped++;
+    return false;
+  }
+  IndPattern s = p;
+  sanitize(s, true);
+  r.slot[r.head & (IND_QUEUE_LEN - 1)] = s;
+  r.head++;
+
+  // Next ind_step() loads the highest ring at once
+  if (c.active && (c.cur_bg || c.cur_prio < prio)) {
+    if (!c.cur_bg && !c.done) c.preempted++;
+    c.active = false;
+  }
+  return true;
+}
+
+void ind_set_background(IndChannel &c, const IndPattern *p) {
+  if (p == nullptr) {
+    if (!c.bg_set) return;
+    c.bg_set = false;
+  } else {
+    IndPattern s = *p;
+    sanitize(s, false);
+    if (c.bg_set && memcmp(&s, &c.bg, sizeof(s)) == 0) return;
+    c.bg     = s;
+    c.bg_set = true;
+  }
+  if (c.active && c.cur_bg) c.active = false;
+}
+
+uint32_t ind_step(IndChannel &c, uint32_t now_ms, IndLevel &out) {
+  if (!c.active) loadNext(c, now_ms);
+
+  // Catch up edge by edge; after a long stall restart the phase instead
+  uint8_t guard = 0;
+  while (c.active && (int32_t)(now_ms - c.edge_ms) >= 0) {
+    if (++guard > 64) {
+      c.edge_ms = now_ms;
+      advance(c);
+      break;
+    }
+    advance(c);
+  }
+
+  if (c.active && c.lit) {
+    out.r = c.cur.r;
+    out.g = c.cur.g;
+    out.b = c.cur.b;
+  } else {
+    out.r = out.g = out.b = 0;
+  }
+  if (!c.active) return IND_IDLE;
+  return ((int32_t)(c.edge_ms - now_ms) > 0) ? c.edge_ms - now_ms : 0;
+}
+
+uint8_t ind_queued(const IndChannel &c, IndPrio prio) {
+  return (uint8_t)(c.q[prio].head - c.q[prio].tail);
+}
+
+IndPattern ind_steady(uint8_t r, uint8_t g, uint8_t b, uint16_t ms) {
+  return ind_blink(r, g, b, ms, 0, 1, 0, 1);
+}
+
+IndPattern ind_blink(uint8_t r, uint8_t g, uint8_t b, uint16_t on_ms, uint16_t off_ms,
+                     uint8_t blinks, uint16_t gap_ms, uint16_t groups) {
+  IndPattern p;
+  p.r      = r;
+  p.g      = g;
+  p.b      = b;
+  p.blinks = blinks;
+  p.on_ms  = on_ms;
+  p.off_ms = off_ms;
+  p.gap_ms = gap_ms;
+  p.groups = groups;
+  return p;
+}
+
+// -------------------------------------------------------------------
+// Host demo: RUN background, a relay click, then a SAFETY fault code
+// -------------------------------------------------------------------
+#ifdef MILL_IND_DEMO_MAIN
+#include <stdio.h>
+
+int main() {
+  IndChannel c;
+  ind_init(c);
+  printf("descriptor %u B, channel %u B\n", (unsigned)sizeof(IndPattern), (unsigned)sizeof(IndChannel));
+
+  IndPattern run   = ind_blink(0, 60, 0, 500, 0, 1, 500, 0);
+  IndPattern click = ind_steady(0, 0, 60, 200);
+  IndPattern fault = ind_blink(60, 0, 0, 250, 250, 3, 1500, 2);
+  ind_set_background(c, &run);
+
+  uint32_t now = 0, wakeups = 0;
+  bool pushedClick = false, pushedFault = false;
+  IndLevel last = { 1, 1, 1 };
+  while (now < 9000) {
+    if (!pushedClick && now >= 1200) { ind_push(c, click, IND_PRIO_NORMAL); pushedClick = true; }
+    if (!pushedFault && now >= 1300) { ind_push(c, fault, IND_PRIO_SAFETY); pushedFault = true; }
+
+    IndLevel lv;
+    uint32_t wait = ind_step(c, now, lv);
+    wakeups++;
+    if (lv.r != last.r || lv.g != last.g || lv.b != last.b) {
+      printf("%6u ms  rgb %3u %3u %3u\n", (unsigned)now, lv.r, lv.g, lv.b);
+      last = lv;
+    }
+    uint32_t nextPush = !pushedClick ? 1200 : (!pushedFault ? 1300 : 0xFFFFFFFFu);
+    uint32_t next = (wait == IND_IDLE) ? 9000 : now + wait;
+    if (nextPush < next) next = nextPush;
+    now = next;
+  }
+  printf("wakeups %u in 9 s (two tasks polling every 50 ms: 360), played %u, preempted %u, dropped %u\n",
+         (unsigned)wakeups, (unsigned)c.played, (unsigned)c.preempted, (unsigned)c.dropped);
+  return 0;
+}
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+/*
+ * Mill_Indicator.h
+ *
+ * Pattern player for the on-board RGB LED and buzzer. Drives no hardware:
+ * the caller asks for the level at `now` and is told how long it may
+ * sleep until the next edge.
+ *
+ *  - A pattern is a 12-byte descriptor: `blinks` pulses of on_ms with
+ *    off_ms between them, then gap_ms dark; that group repeats `groups`
+ *    times (blink codes: 3 blinks + gap = fault 3).
+ *  - Queued patterns (notifications) sit in one ring per priority:
+ *    push / pop are O(1), a full ring drops the new pattern.
+ *  - A SAFETY push cuts the pattern playing at a lower priority short;
+ *    any push cuts the background short. The cut pattern is not resumed.
+ *  - The background pattern (mill state, comm loss) loops whenever both
+ *    rings are empty; setting the same one again does not restart it.
+ *
+ * Plain C++. Print an edge timeline on a host with
+ *
+ *   g++ -std=c++17 -DMILL_IND_DEMO_MAIN Mill_Indicator.cpp -o ind_demo
+ *   ./ind_demo
+ */
+
+#include <stdint.h>
+
+enum IndPrio : uint8_t {
+  IND_PRIO_NORMAL = 0,     // relay clicks, Ethernet up, RTC timers
+  IND_PRIO_SAFETY,         // relay failure, FAULT entry
+  IND_PRIO_COUNT
+};
+
+struct IndPattern {
+  uint8_t  r, g, b;        // buzzer channel: any non-zero = on
+  uint8_t  blinks;         // pulses per group (≥ 1)
+  uint16_t on_ms;
+  uint16_t off_ms;         // between pulses of a group
+  uint16_t gap_ms;         // after each group
+  uint16_t groups;         // 0 = until replaced (background only)
+};
+
+static const uint8_t  IND_QUEUE_LEN = 8;            // per priority; power of two
+static const uint32_t IND_IDLE      = 0xFFFFFFFFu;  // ind_step: nothing scheduled
+
+struct IndRing {
+  IndPattern slot[IND_QUEUE_LEN];
+  uint8_t    head;         // free running; count = head - tail
+  uint8_t    tail;
+};
+
+struct IndChannel {
+  IndRing    q[IND_PRIO_COUNT];
+  IndPattern bg;
+  bool       bg_set;
+
+  // pattern being played
+  IndPattern cur;
+  bool       active;
+  bool       cur_bg;       // cur is the background
+  uint8_t    cur_prio;
+  bool       lit;
+  bool       done;         // last group played, waiting out its gap
+  uint8_t    pulse;
+  uint16_t   group;
+  uint32_t   edge_ms;      // next edge
+
+  uint32_t   played;       // queued patterns started
+  uint32_t   dropped;      // ring full
+  uint32_t   preempted;    // cut short by a SAFETY push
+};
+
+struct IndLevel {
+  uint8_t r, g, b;
+};
+
+void ind_init(IndChannel &c);
+
+// Queue a pattern; false (and counted) if that priority's ring is full.
+bool ind_push(IndChannel &c, const IndPattern &p, IndPrio prio);
+
+// nullptr = dark when nothing is queued.
+void ind_set_background(IndChannel &c, const IndPattern *p);
+
+// Play every edge due at now_ms; `out` = level from now on. Returns ms to
+// the next edge, IND_IDLE when nothing is playing.
+uint32_t ind_step(IndChannel &c, uint32_t now_ms, IndLevel &out);
+
+uint8_t ind_queued(const IndChannel &c, IndPrio prio);
+
+// Descriptors. Steady: one pulse of `ms`. Blink: groups of `blinks`
+// pulses (on / off), gap_ms after each group.
+IndPattern ind_steady(uint8_t r, uint8_t g, uint8_t b, uint16_t ms);
+IndPattern ind_blink(uint8_t r, uint8_t g, uint8_t b, uint16_t on_ms, uint16_t off_ms,
+                     uint8_t blinks, uint16_t gap_ms, uint16_t groups);
@@ -0,0 +1,177 @@
+#include "Mill_IoMap.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// -------------------------------------------------------------------
+// Names
+// -------------------------------------------------------------------
+
+static const char *const ioSignalNames[IO_SIG_COUNT] = {
+  "estop", "lid", "door", "overtemp", "aux"
+};
+
+static const char *const ioRelayNames[IO_RELAY_COUNT] = {
+  "motor", "fault", "ln2", "fan"
+};
+
+const char *io_signal_str(IoSignal s) {
+  return (s < IO_SIG_COUNT) ? ioSignalNames[s] : "?";
+}
+
+const char *io_relay_role_str(IoRelayRole r) {
+  return (r < IO_RELAY_COUNT) ? ioRelayNames[r] : "?";
+}
+
+// Name of length len at p → index in names[], or -1
+static int lookup(const char *const *names, int count, const char *p, size_t len) {
+  for (int i = 0; i < count; ++i) {
+    if (strlen(names[i]) == len && strncmp(names[i], p, len) == 0) return i;
+  }
+  return -1;
+}
+
+// -------------------------------------------------------------------
+// Defaults
+// -------------------------------------------------------------------
+
+void io_map_default(IoMapConfig &cfg) {
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.version = IO_MAP_VERSION;
+
+  cfg.din_ch[IO_SIG_ESTOP] = 1;    // CH1 E-stop OK (LOW)
+  cfg.din_ch[IO_SIG_LID]   = 2;    // CH2 lid locked (LOW)
+  cfg.din_ch[IO_SIG_DOOR]  = 2;    // door switch not wired yet → mirror lid
+
+  cfg.relay_ch[IO_RELAY_MOTOR] = 1;
+  cfg.relay_ch[IO_RELAY_FAULT] = 2;
+  cfg.relay_ch[IO_RELAY_LN2]   = 3;
+  cfg.relay_ch[IO_RELAY_FAN]   = 4;
+}
+
+// -------------------------------------------------------------------
+// Parse
+// -------------------------------------------------------------------
+
+bool io_map_parse(const char *spec, IoMapConfig &cfg, const char **err) {
+  const char *dummy;
+  if (err == nullptr) err = &dummy;
+  if (spec == nullptr) { *err = "empty spec"; return false; }
+
+  IoMapConfig c;
+  memset(&c, 0, sizeof(c));
+  c.version = IO_MAP_VERSION;
+
+  bool relays = false;              // after ';'
+  const char *p = spec;
+  while (*p) {
+    while (*p == ' ') ++p;
+    if (*p == ';') { relays = true; ++p; continue; }
+    if (*p == ',') { ++p; continue; }
+    if (*p == '\0') break;
+
+    const char *name = p;
+    while (*p && *p != '=' && *p != ',' && *p != ';') ++p;
+    if (*p != '=') { *err = "expected name=value"; return false; }
+    size_t nameLen = (size_t)(p - name);
+    ++p;
+
+    if (*p < '0' || *p > '8') { *err = "channel must be 0..8"; return false; }
+    uint8_t ch = (uint8_t)(*p++ - '0');
+
+    if (!relays) {
+      int s = lookup(ioSignalNames, IO_SIG_COUNT, name, nameLen);
+      if (s < 0) { *err = "unknown signal"; return false; }
+      uint8_t high = 0;
+      if (*p == 'H' || *p == 'h')      { high = 1; ++p; }
+      else if (*p == 'L' || *p == 'l') { ++p; }
+      else if (ch != 0) { *err = "polarity must be L or H"; return false; }
+      c.din_ch[s]      = ch;
+      c.din_ok_high[s] = high;
+    } else {
+      int r = lookup(ioRelayNames, IO_RELAY_COUNT, name, nameLen);
+      if (r < 0) { *err = "unknown relay role"; return false; }
+      c.relay_ch[r] = ch;
+    }
+
+    if (*p && *p != ',' && *p != ';' && *p != ' ') {
+      *err = "trailing characters";
+      return false;
+    }
+  }
+
+  cfg = c;
+  return true;
+}
+
+// -------------------------------------------------------------------
+// Compile
+// -------------------------------------------------------------------
+
+bool io_map_compile(const IoMapConfig &cfg, IoMapCompiled &out, const char **err) {
+  const char *dummy;
+  if (err == nullptr) err = &dummy;
+
+  if (cfg.version != IO_MAP_VERSION) { *err = "version mismatch"; return false; }
+  if (cfg.din_ch[IO_SIG_ESTOP] == 0) { *err = "estop must be mapped"; return false; }
+
+  IoMapCompiled m;
+  memset(&m, 0, sizeof(m));
+
+  for (uint8_t s = 0; s < IO_SIG_COUNT; ++s) {
+    uint8_t ch = cfg.din_ch[s];
+    if (ch == 0) continue;
+    if (ch > 8) { *err = "DIN channel out of range"; return false; }
+
+    uint8_t bit = (uint8_t)(1u << (ch - 1));
+    uint8_t ok  = cfg.din_ok_high[s] ? bit : 0;
+    if ((m.ilk_mask & bit) && (m.ilk_ok & bit) != ok) {
+      *err = "conflicting polarity on a shared DIN channel";
+      return false;
+    }
+    m.ilk_mask   |= bit;
+    m.ilk_ok     |= ok;
+    m.sig_mask[s] = bit;
+    m.sig_ok[s]   = ok;
+  }
+
+  uint8_t used = 0;
+  for (uint8_t r = 0; r < IO_RELAY_COUNT; ++r) {
+    uint8_t ch = cfg.relay_ch[r];
+    if (ch == 0) continue;
+    if (ch > 8) { *err = "relay channel out of range"; return false; }
+    uint8_t bit = (uint8_t)(1u << (ch - 1));
+    if (used & bit) { *err = "two relay roles on one channel"; return false; }
+    used |= bit;
+    m.relay_ch[r] = ch;
+  }
+
+  out = m;
+  return true;
+}
+
+// -------------------------------------------------------------------
+// Format
+// -------------------------------------------------------------------
+
+size_t io_map_format(const IoMapConfig &cfg, char *buf, size_t cap) {
+  if (buf == nullptr || cap == 0) return 0;
+  size_t n = 0;
+  buf[0] = '\0';
+
+  for (uint8_t s = 0; s < IO_SIG_COUNT && n < cap; ++s) {
+    if (cfg.din_ch[s] == 0) continue;
+    n += (size_t)snprintf(buf + n, cap - n, "%s%s=%u%c",
+                          n ? "," : "", ioSignalNames[s], cfg.din_ch[s],
+                          cfg.din_ok_high[s] ? 'H' : 'L');
+  }
+  if (n < cap) n += (size_t)snprintf(buf + n, cap - n, ";");
+  bool first = true;
+  for (uint8_t r = 0; r < IO_RELAY_COUNT && n < cap; ++r) {
+    if (cfg.relay_ch[r] == 0) continue;
+    n += (size_t)snprintf(buf + n, cap - n, "%s%s=%u",
+                          first ? "" : ",", ioRelayNames[r], cfg.relay_ch[r]);
+    first = false;
+  }
+  return (n < cap) ? n : cap - 1;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+ * Mill_IoMap.h
+ *
+ * Runtime I/O mapping: logical interlock signals → DIN channel + polarity,
+ * relay roles → relay channel.
+ *
+ * A mapping is written as a short text spec (MQTT SET_IOMAP, NVS):
+ *
+ *   "estop=1L,lid=2L,door=2L;motor=1,fault=2,ln2=3,fan=4"
+ *
+ * Before ';' : <signal>=<channel 1..8><L|H>, L = OK when the input is LOW
+ *              (contact closed to GND), H = OK when HIGH. Signals mapped to
+ *              the same channel share that input (door=2L mirrors the lid).
+ * After ';'  : <role>=<relay channel 1..8>. Omitted / 0 = not assigned.
+ *
+ * io_map_compile() flattens a config into masks, so checking every
+ * interlock is one XOR-and-mask on the debounced 8-bit DIN word no matter
+ * how many signals are mapped. Plain C++, no Arduino headers.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum IoSignal : uint8_t {
+  IO_SIG_ESTOP = 0,
+  IO_SIG_LID,
+  IO_SIG_DOOR,
+  IO_SIG_OVERTEMP,
+  IO_SIG_AUX,
+  IO_SIG_COUNT
+};
+
+enum IoRelayRole : uint8_t {
+  IO_RELAY_MOTOR = 0,      // shaker motor contactor
+  IO_RELAY_FAULT,          // fault lamp / buzzer
+  IO_RELAY_LN2,            // LN2 solenoid
+  IO_RELAY_FAN,            // enclosure / cabinet fan
+  IO_RELAY_COUNT
+};
+
+static const uint8_t IO_MAP_VERSION = 1;
+static const size_t  IO_MAP_SPEC_MAX = 128;   // formatted spec incl. NUL
+
+// Source form (what is parsed, stored in NVS and echoed)
+struct IoMapConfig {
+  uint8_t version;
+  uint8_t din_ch[IO_SIG_COUNT];        // 1..8, 0 = not used
+  uint8_t din_ok_high[IO_SIG_COUNT];   // 1 = OK when HIGH
+  uint8_t relay_ch[IO_RELAY_COUNT];    // 1..8, 0 = not assigned
+};
+
+// Flat lookup form used at run time
+struct IoMapCompiled {
+  uint8_t ilk_mask;                    // DIN bits taking part in the interlock
+  uint8_t ilk_ok;                      // required levels on those bits
+  uint8_t sig_mask[IO_SIG_COUNT];      // 0 for unmapped signals (always OK)
+  uint8_t sig_ok[IO_SIG_COUNT];
+  uint8_t relay_ch[IO_RELAY_COUNT];
+};
+
+// All mapped interlocks OK: one compare on the DIN word
+static inline bool io_interlocks_ok(const IoMapCompiled &m, uint8_t din) {
+  return ((din ^ m.ilk_ok) & m.ilk_mask) == 0;
+}
+
+static inline bool io_signal_ok(const IoMapCompiled &m, uint8_t din, IoSignal s) {
+  return ((din ^ m.sig_ok[s]) & m.sig_mask[s]) == 0;
+}
+
+static inline uint8_t io_relay_channel(const IoMapCompiled &m, IoRelayRole r) {
+  return m.relay_ch[r];
+}
+
+// Factory wiring (v0.5 bring-up: door mirrored to the lid switch on CH2)
+void io_map_default(IoMapConfig &cfg);
+
+// Parse a spec; unknown names, bad channels or polarity fail with a
+// static error string. Signals / roles not listed are left unmapped.
+bool io_map_parse(const char *spec, IoMapConfig &cfg, const char **err);
+
+// Validate + flatten. Fails if estop is unmapped, two signals disagree on
+// one channel's polarity, or two relay roles share a channel.
+bool io_map_compile(const IoMapConfig &cfg, IoMapCompiled &out, const char **err);
+
+// Spec string for diagnostics / round trip (buf >= IO_MAP_SPEC_MAX).
+size_t io_map_format(const IoMapConfig &cfg, char *buf, size_t cap);
+
+const char *io_signal_str(IoSignal s);
+const char *io_relay_role_str(IoRelayRole r);
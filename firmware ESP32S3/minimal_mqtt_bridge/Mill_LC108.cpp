@@ -0,0 +1,367 @@
+#include "Mill_LC108.h"
+
+// Bound by lc108_begin(); the transceiver is assumed to be auto-direction.
+static HardwareSerial *lc108Port = nullptr;
+static uint32_t        lc108CharUs = 1042;     // one 8N1 character at the bus rate
+
+// -------------------------------------------------------------------
+// Bus bring-up
+// -------------------------------------------------------------------
+
+void lc108_begin(HardwareSerial &port, int rxPin, int txPin, uint32_t baud) {
+  lc108Port = &port;
+  lc108Port->begin(baud, SERIAL_8N1, rxPin, txPin);
+  lc108Port->setTimeout(LC108_TIMEOUT_INIT_MS);
+  lc108CharUs = (10u * 1000000u + baud - 1) / baud;
+}
+
+void lc108_slave_init(Lc108Slave &slave, uint8_t addr, const char *name) {
+  slave.addr = addr;
+  slave.name = name;
+  memset(&slave.h, 0, sizeof(slave.h));
+  memset(&slave.txn, 0, sizeof(slave.txn));
+  slave.h.timeout_ms = LC108_TIMEOUT_INIT_MS;
+  slave.h.score      = LC108_SCORE_ONLINE - 1;   // one clean poll → online
+  slave.h.online     = false;
+  slave.h.last_error = LC108_OK;
+}
+
+// -------------------------------------------------------------------
+// Modbus CRC-16 (standard polynomial 0xA001, initial 0xFFFF)
+// -------------------------------------------------------------------
+uint16_t modbus_crc16(const uint8_t *data, uint16_t len) {
+  uint16_t crc = 0xFFFF;
+  for (uint16_t pos = 0; pos < len; ++pos) {
+    crc ^= data[pos];
+    for (uint8_t i = 0; i < 8; ++i) {
+      if (crc & 0x0001) {
+        crc >>= 1;
+        crc ^= 0xA001;
+      } else {
+        crc >>= 1;
+      }
+    }
+  }
+  return crc;
+}
+
+// -------------------------------------------------------------------
+// Health bookkeeping
+// -------------------------------------------------------------------
+
+static uint32_t clampTimeout(uint32_t ms) {
+  if (ms < LC108_TIMEOUT_MIN_MS) return LC108_TIMEOUT_MIN_MS;
+  if (ms > LC108_TIMEOUT_MAX_MS) return LC108_TIMEOUT_MAX_MS;
+  return ms;
+}
+
+// Response time sample from a good frame (Jacobson/Karels, gains 1/8, 1/4).
+static void noteResponseTime(Lc108Health &h, uint32_t rtt_us) {
+  if (h.srtt_us == 0) {
+    h.srtt_us   = rtt_us;
+    h.rttvar_us = rtt_us / 2;
+  } else {
+    int32_t err = (int32_t)rtt_us - (int32_t)h.srtt_us;
+    h.srtt_us   = (uint32_t)((int32_t)h.srtt_us + err / 8);
+    uint32_t absErr = (err < 0) ? (uint32_t)(-err) : (uint32_t)err;
+    h.rttvar_us = (uint32_t)((int32_t)h.rttvar_us +
+                             ((int32_t)absErr - (int32_t)h.rttvar_us) / 4);
+  }
+  uint32_t rto_us = h.srtt_us + 4 * h.rttvar_us;
+  h.timeout_ms = clampTimeout((rto_us + 999) / 1000 + LC108_TIMEOUT_MARGIN_MS);
+}
+
+static void noteError(Lc108Health &h, Lc108Error e) {
+  h.last_error = e;
+  switch (e) {
+    case LC108_ERR_TIMEOUT:
+      h.timeouts++;
+      // Back off the timer until the next good sample re-derives it
+      h.timeout_ms = clampTimeout(h.timeout_ms * 2);
+      break;
+    case LC108_ERR_SHORT:  h.short_frames++; break;
+    case LC108_ERR_HEADER: h.bad_header++;   break;
+    case LC108_ERR_CRC:    h.crc_errors++;   break;
+    default: break;
+  }
+}
+
+static void notePollResult(Lc108Slave &slave, bool ok, uint8_t attempts) {
+  Lc108Health &h = slave.h;
+
+  if (ok) {
+    uint8_t up = (attempts > 1) ? LC108_SCORE_OK_RETRY : LC108_SCORE_OK;
+    h.score = (h.score + up > LC108_SCORE_MAX) ? LC108_SCORE_MAX : h.score + up;
+    h.fail_streak = 0;
+  } else {
+    h.score = (h.score > LC108_SCORE_FAIL) ? h.score - LC108_SCORE_FAIL : 0;
+    if (h.fail_streak < 0xFF) h.fail_streak++;
+  }
+
+  bool wasOnline = h.online;
+  if (!h.online && h.score >= LC108_SCORE_ONLINE) {
+    h.online = true;
+  } else if (h.online && h.score < LC108_SCORE_OFFLINE) {
+    h.online = false;
+  }
+
+  if (wasOnline != h.online) {
+    Serial.print("[LC108] ");
+    Serial.print(slave.name);
+    Serial.print(" (ID=");
+    Serial.print(slave.addr);
+    Serial.println(h.online ? ") → ONLINE" : ") → OFFLINE");
+  }
+}
+
+// -------------------------------------------------------------------
+// Single FC03 attempt, split in two: send, then check what arrived
+// (no retries, no score update)
+// -------------------------------------------------------------------
+static void sendAttempt(Lc108Slave &slave) {
+  HardwareSerial &rs485 = *lc108Port;
+  Lc108Txn &t = slave.txn;
+
+  // Build request: [slave][0x03][reg hi][reg lo][cnt hi][cnt lo][CRClo][CRChi]
+  uint8_t req[8];
+  req[0] = slave.addr;
+  req[1] = 0x03;               // Read Holding Registers
+  req[2] = (t.reg >> 8) & 0xFF;
+  req[3] = (t.reg     ) & 0xFF;
+  req[4] = (t.count >> 8) & 0xFF;
+  req[5] = (t.count     ) & 0xFF;
+
+  uint16_t crc = modbus_crc16(req, 6);
+  req[6] = crc & 0xFF;
+  req[7] = (crc >> 8) & 0xFF;
+
+  // Clear any stale bytes in RX buffer (late replies from a timed-out try)
+  while (rs485.available()) {
+    (void)rs485.read();
+  }
+
+  // 8 bytes fit the UART FIFO: no flush(), the end of the frame on the
+  // wire is estimated instead
+  rs485.write(req, sizeof(req));
+  t.tx_done_us = micros() + sizeof(req) * lc108CharUs;
+  t.got        = 0;
+  t.attempt++;
+  if (t.attempt > 1) {
+    slave.h.retries++;
+  }
+}
+
+// False while the response is still due; then e is LC108_OK for a
+// complete, valid frame or the error.
+static bool checkAttempt(Lc108Slave &slave, uint16_t *out, Lc108Error &e) {
+  HardwareSerial &rs485 = *lc108Port;
+  Lc108Txn &t = slave.txn;
+
+  while (t.got < t.expected && rs485.available()) {
+    t.resp[t.got++] = (uint8_t)rs485.read();
+  }
+  // Signed: the estimated end of the request may still be ahead
+  int32_t rttUs = (int32_t)(micros() - t.tx_done_us);
+
+  if (t.got < t.expected) {
+    if (rttUs <= (int32_t)(slave.h.timeout_ms * 1000)) {
+      return false;
+    }
+    if (t.got == 0) {
+      e = LC108_ERR_TIMEOUT;
+      return true;
+    }
+    Serial.print("[LC108] read_holding: short read got=");
+    Serial.print(t.got);
+    Serial.print(" expected=");
+    Serial.println(t.expected);
+    e = LC108_ERR_SHORT;
+    return true;
+  }
+
+  // Expected response:
+  // [slave][0x03][byteCount][data ...][CRClo][CRChi]
+  // byteCount = 2 * count
+  const uint8_t *resp = t.resp;
+  const uint8_t  expectedByteCount = 2 * t.count;
+  if (resp[0] != slave.addr || resp[1] != 0x03 || resp[2] != expectedByteCount) {
+    Serial.print("[LC108] read_holding: bad header id=");
+    Serial.print(resp[0]);
+    Serial.print(" func=");
+    Serial.print(resp[1]);
+    Serial.print(" bc=");
+    Serial.println(resp[2]);
+    e = LC108_ERR_HEADER;
+    return true;
+  }
+
+  // Check CRC
+  uint16_t crcRx   = resp[t.expected - 2] | (uint16_t(resp[t.expected - 1]) << 8);
+  uint16_t crcCalc = modbus_crc16(resp, t.expected - 2);
+  if (crcRx != crcCalc) {
+    Serial.print("[LC108] read_holding: CRC mismatch resp=0x");
+    Serial.print(crcRx, HEX);
+    Serial.print(" calc=0x");
+    Serial.println(crcCalc, HEX);
+    e = LC108_ERR_CRC;
+    return true;
+  }
+
+  // Extract registers
+  for (uint8_t i = 0; i < t.count; ++i) {
+    uint8_t hi = resp[3 + 2 * i];
+    uint8_t lo = resp[4 + 2 * i];
+    out[i] = (uint16_t(hi) << 8) | lo;
+  }
+
+  noteResponseTime(slave.h, rttUs > 0 ? (uint32_t)rttUs : 0);
+  e = LC108_OK;
+  return true;
+}
+
+// -------------------------------------------------------------------
+// LC108: Read holding registers via RS-485 (function 0x03)
+//
+// reg     = start register *address* (0-based)
+// count   = number of 16-bit registers
+// out[]   = caller-provided array of length >= count
+//
+// A failed attempt is followed by the next one on the following call,
+// so no call waits longer than reading the UART buffer.
+// -------------------------------------------------------------------
+Lc108PollStatus lc108_poll_holding(Lc108Slave &slave,
+                                   uint16_t reg,
+                                   uint16_t count,
+                                   uint16_t *out) {
+  Lc108Txn &t = slave.txn;
+
+  if (!t.active) {
+    if (lc108Port == nullptr || out == nullptr || count == 0 || count > 16) {
+      slave.h.last_error = LC108_ERR_ARG;
+      return LC108_POLL_FAILED;  // sanity limit (response must fit resp[64])
+    }
+    // A slave that is already known dead gets a single attempt per poll so
+    // it stops eating bus time; healthy slaves get the retries.
+    t.active       = true;
+    t.attempt      = 0;
+    t.max_attempts = (slave.h.fail_streak >= LC108_BACKOFF_AFTER)
+                       ? 1 : (1 + LC108_MAX_RETRIES);
+    t.reg          = reg;
+    t.count        = count;
+    t.expected     = 5 + 2 * count;
+    sendAttempt(slave);
+    return LC108_POLL_BUSY;
+  }
+
+  Lc108Error e;
+  if (!checkAttempt(slave, out, e)) {
+    return LC108_POLL_BUSY;
+  }
+  if (e == LC108_OK) {
+    t.active = false;
+    slave.h.ok++;
+    slave.h.last_error = LC108_OK;
+    notePollResult(slave, true, t.attempt);
+    return LC108_POLL_OK;
+  }
+
+  noteError(slave.h, e);
+  if (t.attempt < t.max_attempts) {
+    sendAttempt(slave);
+    return LC108_POLL_BUSY;
+  }
+  t.active = false;
+  notePollResult(slave, false, t.attempt);
+  return LC108_POLL_FAILED;
+}
+
+Lc108PollStatus lc108_poll_live_block(Lc108Slave &slave, Lc108LiveBlock &out) {
+  uint16_t regs[LC108_REG_LIVE_COUNT];
+
+  Lc108PollStatus st = lc108_poll_holding(slave, LC108_REG_LIVE_BASE,
+                                          LC108_REG_LIVE_COUNT, regs);
+  if (st != LC108_POLL_OK) {
+    return st;
+  }
+
+  out.pv_x10     = (int16_t)regs[0];
+  out.mv1_raw    = regs[1];
+  out.mv2_raw    = regs[2];
+  out.mvfb_raw   = regs[3];
+  out.status_raw = regs[4];
+  out.sv_x10     = (int16_t)regs[5];
+
+  return LC108_POLL_OK;
+}
+
+// Blocking: spins on the poll (1 ms steps) until it completes.
+// Returns true on success, false once every attempt has failed.
+bool lc108_read_holding(Lc108Slave &slave,
+                        uint16_t reg,
+                        uint16_t count,
+                        uint16_t *out) {
+  Lc108PollStatus st;
+  while ((st = lc108_poll_holding(slave, reg, count, out)) == LC108_POLL_BUSY) {
+    delay(1);
+  }
+  return st == LC108_POLL_OK;
+}
+
+// -------------------------------------------------------------------
+// Low-level: read one holding register (function 0x03) as uint16_t
+//  reg   = starting register *address* (0-based)
+//  out   = filled with raw 16-bit value on success
+// Returns true on success, false on timeout/CRC/protocol error.
+// -------------------------------------------------------------------
+bool lc108_read_u16(Lc108Slave &slave, uint16_t reg, uint16_t *out) {
+  if (!out) return false;
+
+  uint16_t tmp = 0;
+  if (!lc108_read_holding(slave, reg, 1, &tmp)) {
+    return false;
+  }
+
+  *out = tmp;
+  return true;
+}
+
+// -------------------------------------------------------------------
+// LC108: read the "live" block (PV..SV) in one transaction
+// -------------------------------------------------------------------
+bool lc108_read_live_block(Lc108Slave &slave, Lc108LiveBlock &out) {
+  Lc108PollStatus st;
+  while ((st = lc108_poll_live_block(slave, out)) == LC108_POLL_BUSY) {
+    delay(1);
+  }
+  return st == LC108_POLL_OK;
+}
+
+// -------------------------------------------------------------------
+// Poll scheduling / reporting helpers
+// -------------------------------------------------------------------
+
+uint32_t lc108_poll_interval_ms(const Lc108Slave &slave, uint32_t base_ms) {
+  if (slave.h.fail_streak < LC108_BACKOFF_AFTER) {
+    return base_ms;
+  }
+  uint8_t shift = slave.h.fail_streak - LC108_BACKOFF_AFTER + 1;
+  if (shift > 5) shift = 5;
+  uint32_t ms = base_ms << shift;
+  return (ms > LC108_BACKOFF_MAX_MS) ? LC108_BACKOFF_MAX_MS : ms;
+}
+
+uint32_t lc108_error_total(const Lc108Health &h) {
+  return h.timeouts + h.short_frames + h.bad_header + h.crc_errors;
+}
+
+const char *lc108_error_str(Lc108Error e) {
+  switch (e) {
+    case LC108_OK:          return "OK";
+    case LC108_ERR_TIMEOUT: return "TIMEOUT";
+    case LC108_ERR_SHORT:   return "SHORT_FRAME";
+    case LC108_ERR_HEADER:  return "BAD_HEADER";
+    case LC108_ERR_CRC:     return "CRC";
+    case LC108_ERR_ARG:     return "ARG";
+  }
+  return "?";
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+/*
+ * Mill_LC108.h
+ *
+ * LC108 PID controllers on the shared RS-485 bus (Modbus RTU master, FC03).
+ *
+ * Every slave carries its own health record:
+ *  - adaptive response timeout from smoothed response-time statistics
+ *    (srtt + 4 * rttvar, doubled after a timeout, clamped),
+ *  - bounded retries inside one poll,
+ *  - error counters by class (timeout / short frame / bad header / CRC),
+ *  - a 0..100 health score with hysteresis that drives `online`,
+ *  - exponential poll backoff once a slave stays dead.
+ *
+ * loop() uses the non-blocking lc108_poll_*() calls: a pass either sends
+ * a request or collects what has arrived, never waits for the slave, so
+ * a dead LC108 costs loop() microseconds instead of timeouts (interlock
+ * → relay latency does not depend on the bus). Response times are then
+ * measured at loop() granularity. The blocking lc108_read_*() wrappers
+ * spin on the same state machine for code outside loop().
+ */
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+
+// -------------------------------------------------------------------
+// Register map
+// -------------------------------------------------------------------
+
+// LC108 manual uses 1-based register numbering; Modbus FC03 uses 0-based
+// addresses. If the PV is register 1, SV is register 6 in the manual,
+// their FC03 addresses are 0 and 5 respectively.
+static const uint16_t LC108_REG_PV_ADDR = 0;   // PV  (°C × 10), register 1 → address 0
+static const uint16_t LC108_REG_SV_ADDR = 5;   // SV  (°C × 10), register 6 → address 5
+
+// "Live block" as per your map: PV, MV1, MV2, MVFB, STATUS, SV
+static const uint16_t LC108_REG_LIVE_BASE  = 0;  // PV
+static const uint16_t LC108_REG_LIVE_COUNT = 6;  // PV..SV (0..5)
+
+// STATUS bit masks (adjust if your map differs)
+static const uint16_t LC108_STAT_RUN  = 0x0001;
+static const uint16_t LC108_STAT_MAN  = 0x0002;
+static const uint16_t LC108_STAT_PRG  = 0x0004;
+static const uint16_t LC108_STAT_OP1  = 0x0010;
+static const uint16_t LC108_STAT_OP2  = 0x0020;
+static const uint16_t LC108_STAT_AU1  = 0x0040;
+static const uint16_t LC108_STAT_AU2  = 0x0080;
+static const uint16_t LC108_STAT_ATU  = 0x0100;
+
+// -------------------------------------------------------------------
+// Timeout / retry / health policy
+// -------------------------------------------------------------------
+
+static const uint32_t LC108_TIMEOUT_INIT_MS   = 50;   // before any sample
+static const uint32_t LC108_TIMEOUT_MIN_MS    = 20;
+static const uint32_t LC108_TIMEOUT_MAX_MS    = 250;
+static const uint32_t LC108_TIMEOUT_MARGIN_MS = 5;    // ~3.5 char times @ 9600
+
+static const uint8_t  LC108_MAX_RETRIES       = 2;    // retries per poll (next loop passes)
+
+static const uint8_t  LC108_SCORE_MAX         = 100;
+static const uint8_t  LC108_SCORE_OK          = 20;   // clean poll
+static const uint8_t  LC108_SCORE_OK_RETRY    = 10;   // poll needed a retry
+static const uint8_t  LC108_SCORE_FAIL        = 25;   // all attempts failed
+static const uint8_t  LC108_SCORE_ONLINE      = 60;   // rise above → online
+static const uint8_t  LC108_SCORE_OFFLINE     = 40;   // fall below → offline
+
+static const uint8_t  LC108_BACKOFF_AFTER     = 3;    // failed polls before backoff
+static const uint32_t LC108_BACKOFF_MAX_MS    = 30000;
+
+// -------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------
+
+enum Lc108Error : uint8_t {
+  LC108_OK = 0,
+  LC108_ERR_TIMEOUT,   // nothing received
+  LC108_ERR_SHORT,     // some bytes, fewer than expected
+  LC108_ERR_HEADER,    // wrong id / function / byte count
+  LC108_ERR_CRC,
+  LC108_ERR_ARG        // caller error, not counted against the slave
+};
+
+struct Lc108Health {
+  uint32_t srtt_us;        // smoothed response time
+  uint32_t rttvar_us;      // smoothed mean deviation
+  uint32_t timeout_ms;     // timeout used for the next attempt
+
+  uint32_t ok;             // successful transactions
+  uint32_t timeouts;
+  uint32_t short_frames;
+  uint32_t bad_header;
+  uint32_t crc_errors;
+  uint32_t retries;        // extra attempts spent inside polls
+
+  uint8_t  score;          // 0..LC108_SCORE_MAX
+  bool     online;         // hysteresis on score
+  uint8_t  fail_streak;    // consecutive failed polls
+  Lc108Error last_error;
+};
+
+// The transaction in flight (one per slave; the bus carries one at a time)
+struct Lc108Txn {
+  bool     active;
+  uint8_t  attempt;        // 1-based, of max_attempts
+  uint8_t  max_attempts;
+  uint16_t reg;
+  uint16_t count;
+  uint8_t  expected;       // response length
+  uint8_t  got;
+  uint32_t tx_done_us;     // estimated end of the request on the wire
+  uint8_t  resp[64];
+};
+
+struct Lc108Slave {
+  uint8_t     addr;        // Modbus device address (1..247)
+  const char *name;        // for logs / diag
+  Lc108Health h;
+  Lc108Txn    txn;
+};
+
+enum Lc108PollStatus : uint8_t {
+  LC108_POLL_BUSY = 0,     // request out or retry pending; call again next pass
+  LC108_POLL_OK,
+  LC108_POLL_FAILED        // every attempt failed (health updated)
+};
+
+// Live-block struct for a single FC03 read
+struct Lc108LiveBlock {
+  int16_t  pv_x10;      // signed PV (°C × 10)
+  uint16_t mv1_raw;     // 0..1000 => 0..100 %
+  uint16_t mv2_raw;
+  uint16_t mvfb_raw;
+  uint16_t status_raw;
+  int16_t  sv_x10;      // signed SV (°C × 10)
+};
+
+// -------------------------------------------------------------------
+// API
+// -------------------------------------------------------------------
+
+void lc108_begin(HardwareSerial &port, int rxPin, int txPin, uint32_t baud);
+void lc108_slave_init(Lc108Slave &slave, uint8_t addr, const char *name);
+
+uint16_t modbus_crc16(const uint8_t *data, uint16_t len);
+
+// One poll: first attempt plus up to LC108_MAX_RETRIES, health updated
+// once. Starts the transaction when none is in flight, otherwise advances
+// it; out is written only with LC108_POLL_OK. Keep calling with the same
+// reg / count until the result is not BUSY.
+Lc108PollStatus lc108_poll_holding(Lc108Slave &slave,
+                                   uint16_t reg,
+                                   uint16_t count,
+                                   uint16_t *out);
+Lc108PollStatus lc108_poll_live_block(Lc108Slave &slave, Lc108LiveBlock &out);
+
+static inline bool lc108_busy(const Lc108Slave &slave) {
+  return slave.txn.active;
+}
+
+// Blocking forms of the same poll (setup / tools, not loop())
+bool lc108_read_holding(Lc108Slave &slave,
+                        uint16_t reg,
+                        uint16_t count,
+                        uint16_t *out);
+bool lc108_read_u16(Lc108Slave &slave, uint16_t reg, uint16_t *out);
+bool lc108_read_live_block(Lc108Slave &slave, Lc108LiveBlock &out);
+
+// Poll period for this slave: base_ms while healthy, exponential backoff
+// (capped at LC108_BACKOFF_MAX_MS) once it has failed LC108_BACKOFF_AFTER
+// polls in a row.
+uint32_t lc108_poll_interval_ms(const Lc108Slave &slave, uint32_t base_ms);
+
+// Sum of all counted error classes (the `rs485_errors` diag field).
+uint32_t lc108_error_total(const Lc108Health &h);
+
+const char *lc108_error_str(Lc108Error e);
@@ -0,0 +1,208 @@
+#include "Mill_Ln2Control.h"
+
+#include <math.h>
+#include <string.h>
+
+// -------------------------------------------------------------------
+// Config
+// -------------------------------------------------------------------
+
+// Defaults picked with the plant model below (ln2_sim): ~1 °C RMS around
+// SV. Longer windows cut valve cycles but the 2 s minimum pulse then
+// costs resolution (30 s window: ~5 °C RMS).
+void ln2ctl_default_config(Ln2Config &cfg) {
+  cfg.mode         = LN2_MODE_STATE;
+  cfg.sv_c         = NAN;
+  cfg.band_c       = 2.0f;
+  cfg.kp           = 0.08f;
+  cfg.ti_s         = 180.0f;
+  cfg.window_ms    = 10000;
+  cfg.min_pulse_ms = 2000;
+}
+
+void ln2ctl_configure(Ln2Controller &c, const Ln2Config &cfg) {
+  c.cfg          = cfg;
+  c.integ        = 0.0f;
+  c.duty         = 0.0f;
+  c.hyst_on      = false;
+  c.window_valid = false;
+}
+
+void ln2ctl_init(Ln2Controller &c, const Ln2Config &cfg) {
+  memset(&c, 0, sizeof(c));
+  c.sv_c = NAN;
+  ln2ctl_configure(c, cfg);
+}
+
+const char *ln2ctl_mode_str(Ln2Mode m) {
+  switch (m) {
+    case LN2_MODE_STATE: return "STATE";
+    case LN2_MODE_HYST:  return "HYST";
+    case LN2_MODE_PID:   return "PID";
+  }
+  return "?";
+}
+
+bool ln2ctl_mode_from_str(const char *s, Ln2Mode &out) {
+  if (s == nullptr) return false;
+  if (strcmp(s, "STATE") == 0) { out = LN2_MODE_STATE; return true; }
+  if (strcmp(s, "HYST") == 0)  { out = LN2_MODE_HYST;  return true; }
+  if (strcmp(s, "PID") == 0)   { out = LN2_MODE_PID;   return true; }
+  return false;
+}
+
+// -------------------------------------------------------------------
+// Control
+// -------------------------------------------------------------------
+
+static bool hysteresis(Ln2Controller &c, float pv) {
+  if (pv > c.sv_c + c.cfg.band_c) {
+    c.hyst_on = true;
+  } else if (pv < c.sv_c - c.cfg.band_c) {
+    c.hyst_on = false;
+  }
+  return c.hyst_on;
+}
+
+// PI once per window; conditional integration keeps the integral from
+// winding up while the duty is pinned at 0 or 1.
+static void startWindow(Ln2Controller &c, float pv, uint32_t now_ms) {
+  float dt_s = c.window_valid ? (now_ms - c.window_start_ms) / 1000.0f
+                              : c.cfg.window_ms / 1000.0f;
+  float err  = pv - c.sv_c;                       // warm → positive → open
+  float u    = c.cfg.kp * err + c.integ;
+
+  bool pushUp   = (err > 0.0f);
+  bool saturate = (u >= 1.0f && pushUp) || (u <= 0.0f && !pushUp);
+  if (!saturate && c.cfg.ti_s > 0.0f) {
+    c.integ += c.cfg.kp * err * dt_s / c.cfg.ti_s;
+    if (c.integ > 1.0f) c.integ = 1.0f;
+    if (c.integ < 0.0f) c.integ = 0.0f;
+    u = c.cfg.kp * err + c.integ;
+  }
+  if (u > 1.0f) u = 1.0f;
+  if (u < 0.0f) u = 0.0f;
+  c.duty = u;
+
+  uint32_t on = (uint32_t)(u * c.cfg.window_ms);
+  if (on < c.cfg.min_pulse_ms) {
+    on = 0;                                       // too short to bother the valve
+  } else if (c.cfg.window_ms - on < c.cfg.min_pulse_ms) {
+    on = c.cfg.window_ms;                         // off gap too short: stay open
+  }
+  c.on_ms           = on;
+  c.window_start_ms = now_ms;
+  c.window_valid    = true;
+}
+
+static bool timeProportioning(Ln2Controller &c, float pv, uint32_t now_ms) {
+  if (!c.window_valid || now_ms - c.window_start_ms >= c.cfg.window_ms) {
+    startWindow(c, pv, now_ms);
+  }
+  return (now_ms - c.window_start_ms) < c.on_ms;
+}
+
+bool ln2ctl_update(Ln2Controller &c, const Ln2Inputs &in, uint32_t now_ms) {
+  // Usage accounting on the actual relay state
+  if (c.last_ms != 0 && in.valve_open) {
+    c.open_ms_total += now_ms - c.last_ms;
+  }
+  if (in.valve_open && !c.last_valve) c.valve_cycles++;
+  c.last_valve = in.valve_open;
+  c.last_ms    = now_ms;
+
+  c.sv_c = isnan(c.cfg.sv_c) ? in.lc108_sv_c : c.cfg.sv_c;
+
+  bool usable = in.comm_ok && !isnan(in.pv_c) && !isnan(c.sv_c);
+  if (c.cfg.mode == LN2_MODE_STATE || !in.wanted || !usable) {
+    // Legacy behaviour; next closed-loop entry starts clean
+    c.closed_loop  = false;
+    c.integ        = 0.0f;
+    c.duty         = in.wanted ? 1.0f : 0.0f;
+    c.hyst_on      = false;
+    c.window_valid = false;
+    c.demand       = in.wanted;
+    return c.demand;
+  }
+
+  c.closed_loop = true;
+  c.demand = (c.cfg.mode == LN2_MODE_HYST) ? hysteresis(c, in.pv_c)
+                                           : timeProportioning(c, in.pv_c, now_ms);
+  return c.demand;
+}
+
+// -------------------------------------------------------------------
+// Host plant-model simulation
+// -------------------------------------------------------------------
+#ifdef MILL_LN2_SIM_MAIN
+#include <stdio.h>
+
+// Lumped chamber: LN2 pulls towards -196 °C when the valve is open, the
+// room leaks heat in, the running shaker adds a little. Valve timing is
+// limited like Mill_Outputs (2 s minimum on / off).
+struct Plant {
+  float t_c;
+  float k_ln2;      // 1/s while open
+  float tau_leak;   // s
+  float q_motor;    // °C/s while running
+};
+
+struct SimResult {
+  float open_s;
+  uint32_t cycles;
+  float settle_s;
+  float rms_c;
+  float min_c;
+};
+
+static SimResult simulate(Ln2Mode mode) {
+  Plant p = { 20.0f, 0.010f, 600.0f, 0.05f };
+
+  Ln2Config cfg;
+  ln2ctl_default_config(cfg);
+  cfg.mode = mode;
+  cfg.sv_c = -90.0f;
+
+  Ln2Controller c;
+  ln2ctl_init(c, cfg);
+
+  const uint32_t step_ms = 100, batch_ms = 3600u * 1000u;
+  bool valve = false;
+  uint32_t changed = 0;
+  SimResult r = { 0, 0, -1.0f, 0, 100.0f };
+  double sq = 0; uint32_t n = 0;
+
+  for (uint32_t t = step_ms; t <= batch_ms; t += step_ms) {
+    Ln2Inputs in = { true, true, p.t_c, -90.0f, valve };
+    bool want = ln2ctl_update(c, in, t);
+    if (want != valve && t - changed >= 2000) { valve = want; changed = t; }
+
+    float dt = step_ms / 1000.0f;
+    float dT = (20.0f - p.t_c) / p.tau_leak + p.q_motor;
+    if (valve) dT -= p.k_ln2 * (p.t_c + 196.0f);
+    p.t_c += dT * dt;
+
+    if (r.settle_s < 0 && fabsf(p.t_c + 90.0f) < 3.0f) r.settle_s = t / 1000.0f;
+    if (r.settle_s >= 0) {
+      sq += (p.t_c + 90.0f) * (p.t_c + 90.0f); n++;
+      if (p.t_c < r.min_c) r.min_c = p.t_c;
+    }
+  }
+  r.open_s = c.open_ms_total / 1000.0f;
+  r.cycles = c.valve_cycles;
+  r.rms_c  = n ? (float)sqrt(sq / n) : 0.0f;
+  return r;
+}
+
+int main() {
+  printf("1 h batch, SV -90 °C, plant k=0.010/s tau=600 s\n");
+  printf("%-6s %10s %8s %10s %8s %8s\n", "mode", "open_s", "cycles", "settle_s", "rms_c", "min_c");
+  const Ln2Mode modes[] = { LN2_MODE_STATE, LN2_MODE_HYST, LN2_MODE_PID };
+  for (Ln2Mode m : modes) {
+    SimResult r = simulate(m);
+    printf("%-6s %10.0f %8u %10.0f %8.2f %8.1f\n", ln2ctl_mode_str(m),
+           r.open_s, (unsigned)r.cycles, r.settle_s, r.rms_c, r.min_c);
+  }
+  return 0;
+}
+#endif
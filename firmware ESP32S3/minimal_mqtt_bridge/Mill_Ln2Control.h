@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+ * Mill_Ln2Control.h
+ *
+ * Optional on-MCU control of the LN2 solenoid from the LC108 PV.
+ *
+ *   STATE – legacy: valve follows the mill state (open in RUN / HOLD) and
+ *           the LC108's own output does the temperature control.
+ *   HYST  – on/off with a band around SV: open above SV + band, close
+ *           below SV - band.
+ *   PID   – PI on (PV - SV) → duty, time-proportioned over a fixed window,
+ *           conditional-integration anti-windup, pulses shorter than the
+ *           minimum valve time dropped (or stretched to a full window).
+ *
+ * The controller only ever *removes* valve demand: the mill state still
+ * decides whether LN2 is allowed at all, and Mill_Outputs still applies
+ * the LN2 minimum on/off times. Without a healthy PV (comm_ok false) or a
+ * usable SV it falls back to STATE behaviour and resets the integrator.
+ *
+ * Plain C++. Build the plant-model simulation on a host with
+ *
+ *   g++ -std=c++17 -DMILL_LN2_SIM_MAIN Mill_Ln2Control.cpp -o ln2_sim
+ *   ./ln2_sim
+ */
+
+#include <stdint.h>
+
+enum Ln2Mode : uint8_t {
+  LN2_MODE_STATE = 0,
+  LN2_MODE_HYST,
+  LN2_MODE_PID
+};
+
+struct Ln2Config {
+  Ln2Mode  mode;
+  float    sv_c;           // recipe SV; NAN = use the LC108's SV
+  float    band_c;         // HYST half band
+  float    kp;             // PID: duty per °C of (PV - SV)
+  float    ti_s;           // PID: integral time
+  uint32_t window_ms;      // PID: time-proportioning window
+  uint32_t min_pulse_ms;   // PID: shortest on / off pulse in a window
+};
+
+struct Ln2Inputs {
+  bool  wanted;            // mill state allows LN2 (RUN / HOLD)
+  bool  comm_ok;           // LC108 health
+  float pv_c;
+  float lc108_sv_c;
+  bool  valve_open;        // actual relay state, for usage accounting
+};
+
+struct Ln2Controller {
+  Ln2Config cfg;
+
+  bool      closed_loop;   // last update ran HYST / PID (not fallback)
+  bool      demand;
+  bool      hyst_on;
+  float     sv_c;          // SV in use
+  float     duty;          // PID duty of the current window (0..1)
+  float     integ;         // PID integral term (duty units)
+  uint32_t  window_start_ms;
+  uint32_t  on_ms;         // PID on-time of the current window
+  bool      window_valid;
+
+  uint32_t  last_ms;
+  uint32_t  open_ms_total; // valve-open time while this controller ran
+  uint32_t  valve_cycles;  // closed → open transitions
+  bool      last_valve;
+};
+
+void ln2ctl_default_config(Ln2Config &cfg);
+void ln2ctl_init(Ln2Controller &c, const Ln2Config &cfg);
+
+// Change tuning / mode at run time (integrator and window restart).
+void ln2ctl_configure(Ln2Controller &c, const Ln2Config &cfg);
+
+// Returns true if the valve may be open this pass.
+bool ln2ctl_update(Ln2Controller &c, const Ln2Inputs &in, uint32_t now_ms);
+
+const char *ln2ctl_mode_str(Ln2Mode m);
+bool ln2ctl_mode_from_str(const char *s, Ln2Mode &out);
@@ -0,0 +1,74 @@
+#include "Mill_Memory.h"
+
+#include <esp_heap_caps.h>
+
+struct MemTaskSlot {
+  TaskHandle_t handle;
+  const char  *name;
+  uint32_t     stack_bytes;
+};
+
+// Written during setup() only (all tasks are started there), read by the
+// loop task's diag publish
+static MemTaskSlot memTasks[MEM_TASK_MAX];
+static uint8_t     memTaskCount   = 0;
+static uint32_t    memStaticBytes = 0;
+static uint32_t    memHeapSetup   = 0;
+
+static volatile uint32_t memAllocFailures = 0;
+
+// Runs in the failing caller's context (any task, maybe with a lock
+// held): count only
+static void memAllocFailed(size_t size, uint32_t caps, const char *function_name) {
+  (void)size;
+  (void)caps;
+  (void)function_name;
+  memAllocFailures++;
+}
+
+bool mem_task_created(TaskHandle_t h, const char *name, uint32_t stack_bytes,
+                      bool is_static, TaskHandle_t *out) {
+  if (out) *out = h;
+  if (h == NULL) {
+    Serial.print("[MEM] task create failed: ");
+    Serial.println(name);
+    return false;
+  }
+  if (is_static) memStaticBytes += stack_bytes + sizeof(StaticTask_t);
+  if (memTaskCount < MEM_TASK_MAX) {
+    memTasks[memTaskCount++] = { h, name, stack_bytes };
+  }
+  return true;
+}
+
+void mem_setup_done(void) {
+  heap_caps_register_failed_alloc_callback(memAllocFailed);
+  mem_task_created(xTaskGetCurrentTaskHandle(), "loop", getArduinoLoopTaskStackSize(), false, NULL);
+  memHeapSetup = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+
+  Serial.print("[MEM] heap free ");
+  Serial.print(memHeapSetup);
+  Serial.print(" B after setup, largest block ");
+  Serial.print((uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+  Serial.print(" B; static task stacks ");
+  Serial.print(memStaticBytes);
+  Serial.print(" B (");
+  Serial.print(memTaskCount);
+  Serial.println(" tasks)");
+}
+
+void mem_report(MemReport &r) {
+  r.heap_free      = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  r.heap_min       = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  r.heap_largest   = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  r.heap_setup     = memHeapSetup;
+  r.alloc_failures = memAllocFailures;
+  r.static_bytes   = memStaticBytes;
+  r.task_count     = memTaskCount;
+  for (uint8_t i = 0; i < memTaskCount; ++i) {
+    r.task[i].name        = memTasks[i].name;
+    r.task[i].stack_bytes = memTasks[i].stack_bytes;
+    // ESP-IDF: StackType_t is a byte, so the mark is in bytes
+    r.task[i].hwm_bytes   = uxTaskGetStackHighWaterMark(memTasks[i].handle);
+  }
+}
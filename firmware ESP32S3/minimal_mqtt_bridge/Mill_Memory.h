@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+ * Mill_Memory.h
+ *
+ * RAM budget of the bridge: task stacks, the heap, and whether either
+ * moves over weeks of uptime.
+ *
+ * Every firmware task is started with MILL_TASK_CREATE(), which records
+ * its handle and stack size for the report. With MILL_STATIC_ALLOC set
+ * (default) the stack and TCB are static arrays at the call site
+ * (xTaskCreateStaticPinnedToCore): they are counted in the link map's
+ * .bss, not taken from the heap, and can't fail at run time. With
+ * MILL_STATIC_ALLOC 0 the tasks are created on the heap as before.
+ *
+ * After setup() the sketch itself does not allocate: JSON goes into
+ * static buffers, MQTT payloads are parsed in one static copy. Queues,
+ * semaphores and the PubSubClient buffer are allocated once during
+ * setup() and never freed. What is left on the heap at run time is the
+ * ESP-IDF network stack (lwIP pbufs, sockets, the NetworkClient of a
+ * Modbus TCP connection) and NVS handles, so mem_setup_done() takes the
+ * free heap at the end of setup() as the baseline and diag reports
+ * free / minimum / largest block against it, plus each task's stack
+ * high-water mark. A leak shows as heap_free
+ * drifting below heap_setup, fragmentation as heap_largest shrinking
+ * while heap_free holds.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#ifndef MILL_STATIC_ALLOC
+#define MILL_STATIC_ALLOC 1
+#endif
+
+static const uint8_t MEM_TASK_MAX = 12;
+
+struct MemTaskStat {
+  const char *name;
+  uint32_t    stack_bytes;     // as created
+  uint32_t    hwm_bytes;       // least free stack seen so far
+};
+
+struct MemReport {
+  uint32_t    heap_free;       // 8-bit capable heap, bytes
+  uint32_t    heap_min;        // lowest heap_free since boot
+  uint32_t    heap_largest;    // largest free block (fragmentation)
+  uint32_t    heap_setup;      // heap_free at the end of setup()
+  uint32_t    alloc_failures;  // heap_caps allocations that failed
+  uint32_t    static_bytes;    // task stacks + TCBs taken from .bss
+  uint8_t     task_count;
+  MemTaskStat task[MEM_TASK_MAX];
+};
+
+// Records a task created outside MILL_TASK_CREATE (the Arduino loop
+// task) or by it; sets *out if given. false if h is NULL (create failed).
+bool mem_task_created(TaskHandle_t h, const char *name, uint32_t stack_bytes,
+                      bool is_static, TaskHandle_t *out);
+
+// End of setup(): heap baseline, alloc-failure hook, loop task entry
+void mem_setup_done(void);
+
+// Cheap enough for every diag publish (one pass over MEM_TASK_MAX)
+void mem_report(MemReport &r);
+
+// Same argument order as xTaskCreatePinnedToCore; stack in bytes
+#if MILL_STATIC_ALLOC
+#define MILL_TASK_CREATE(fn, name, stack, arg, prio, handle, core)                     \
+  do {                                                                                 \
+    static StackType_t  fn##_stack[(stack) / sizeof(StackType_t)];                     \
+    static StaticTask_t fn##_tcb;                                                      \
+    mem_task_created(xTaskCreateStaticPinnedToCore(fn, name, stack, arg, prio,        \
+                                                   fn##_stack, &fn##_tcb, core),      \
+                     name, stack, true, handle);                                       \
+  } while (0)
+#else
+#define MILL_TASK_CREATE(fn, name, stack, arg, prio, handle, core)                     \
+  do {                                                                                 \
+    TaskHandle_t fn##_h = NULL;                                                        \
+    xTaskCreatePinnedToCore(fn, name, stack, arg, prio, &fn##_h, core);                \
+    mem_task_created(fn##_h, name, stack, false, handle);                              \
+  } while (0)
+#endif
@@ -0,0 +1,394 @@
+#include "Mill_ModbusMap.h"
+
+#include <string.h>
+
+// -------------------------------------------------------------------
+// Image helpers
+// -------------------------------------------------------------------
+
+void mb_image_clear(MbImage &img) {
+  memset(&img, 0, sizeof(img));
+  img.reg[MB_REG_VERSION] = MB_MAP_VERSION;
+}
+
+void mb_image_set_u32(MbImage &img, uint16_t reg, uint32_t v) {
+  img.reg[reg]     = (uint16_t)(v >> 16);
+  img.reg[reg + 1] = (uint16_t)(v & 0xFFFF);
+}
+
+void mb_image_set_bit(MbImage &img, uint16_t bit, bool on) {
+  uint8_t mask = (uint8_t)(1u << (bit & 7));
+  if (on) {
+    img.discrete[bit >> 3] |= mask;
+  } else {
+    img.discrete[bit >> 3] &= (uint8_t)~mask;
+  }
+}
+
+// -------------------------------------------------------------------
+// PDU helpers
+// -------------------------------------------------------------------
+
+static inline uint16_t be16(const uint8_t *p) {
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static size_t exceptionPdu(uint8_t fc, uint8_t code, uint8_t *resp, bool *exception) {
+  resp[0] = fc | 0x80;
+  resp[1] = code;
+  if (exception) *exception = true;
+  return 2;
+}
+
+// FC03 / FC04: registers straight out of the image
+static size_t readRegisters(const MbImage &img, const uint8_t *req, size_t len,
+                            uint8_t *resp, bool *exception) {
+  uint8_t fc = req[0];
+  if (len != 5) return exceptionPdu(fc, MB_EX_ILLEGAL_VALUE, resp, exception);
+
+  uint16_t start = be16(&req[1]);
+  uint16_t count = be16(&req[3]);
+  if (count == 0 || count > 125) {
+    return exceptionPdu(fc, MB_EX_ILLEGAL_VALUE, resp, exception);
+  }
+  if ((uint32_t)start + count > MB_REG_COUNT) {
+    return exceptionPdu(fc, MB_EX_ILLEGAL_ADDRESS, resp, exception);
+  }
+
+  resp[0] = fc;
+  resp[1] = (uint8_t)(count * 2);
+  for (uint16_t i = 0; i < count; ++i) {
+    uint16_t v = img.reg[start + i];
+    resp[2 + 2 * i] = (uint8_t)(v >> 8);
+    resp[3 + 2 * i] = (uint8_t)(v & 0xFF);
+  }
+  return 2 + count * 2;
+}
+
+// FC01 / FC02: bit reads (coils always read back 0, they are pulses)
+static size_t readBits(const MbImage &img, const uint8_t *req, size_t len,
+                       uint8_t *resp, bool *exception) {
+  uint8_t fc = req[0];
+  if (len != 5) return exceptionPdu(fc, MB_EX_ILLEGAL_VALUE, resp, exception);
+
+  uint16_t start = be16(&req[1]);
+  uint16_t count = be16(&req[3]);
+  uint16_t limit = (fc == 0x01) ? (uint16_t)MB_COIL_COUNT : (uint16_t)MB_DISCRETE_COUNT;
+  if (count == 0 || count > 2000) {
+    return exceptionPdu(fc, MB_EX_ILLEGAL_VALUE, resp, exception);
+  }
+  if ((uint32_t)start + count > limit) {
+    return exceptionPdu(fc, MB_EX_ILLEGAL_ADDRESS, resp, exception);
+  }
+
+  uint8_t bytes = (uint8_t)((count + 7) / 8);
+  resp[0] = fc;
+  resp[1] = bytes;
+  memset(&resp[2], 0, bytes);
+  if (fc == 0x02) {
+    for (uint16_t i = 0; i < count; ++i) {
+      uint16_t bit = start + i;
+      if (img.discrete[bit >> 3] & (1u << (bit & 7))) {
+        resp[2 + (i >> 3)] |= (uint8_t)(1u << (i & 7));
+      }
+    }
+  }
+  return 2 + bytes;
+}
+
+// FC05: single coil pulse
+static size_t writeCoil(const uint8_t *req, size_t len, uint8_t *resp,
+                        MbCommandFn onCommand, bool *exception) {
+  uint8_t fc = req[0];
+  if (len != 5) return exceptionPdu(fc, MB_EX_ILLEGAL_VALUE, resp, exception);
+
+  uint16_t coil  = be16(&req[1]);
+  uint16_t value = be16(&req[3]);
+  if (value != 0xFF00 && value != 0x0000) {
+    return exceptionPdu(fc, MB_EX_ILLEGAL_VALUE, resp, exception);
+  }
+  if (coil >= MB_COIL_COUNT) {
+    return exceptionPdu(fc, MB_EX_ILLEGAL_ADDRESS, resp, exception);
+  }
+  if (value == 0xFF00 && onCommand && !onCommand((MbCoil)coil)) {
+    return exceptionPdu(fc, MB_EX_ILLEGAL_VALUE, resp, exception);
+  }
+
+  memcpy(resp, req, 5);   // normal response echoes the request
+  return 5;
+}
+
+// FC0F: multiple coils, only the lowest set coil is executed so a single
+// frame can never issue two conflicting commands
+static size_t writeCoils(const uint8_t *req, size_t len, uint8_t *resp,
+                         MbCommandFn onCommand, bool *exception) {
+  uint8_t fc = req[0];
+  if (len < 6) return exceptionPdu(fc, MB_EX_ILLEGAL_VALUE, resp, exception);
+
+  uint16_t start = be16(&req[1]);
+  uint16_t count = be16(&req[3]);
+  uint8_t  bytes = req[5];
+  if (count == 0 || count > 0x07B0 || bytes != (count + 7) / 8 || len != 6u + bytes) {
+    return exceptionPdu(fc, MB_EX_ILLEGAL_VALUE, resp, exception);
+  }
+  if ((uint32_t)start + count > MB_COIL_COUNT) {
+    return exceptionPdu(fc, MB_EX_ILLEGAL_ADDRESS, resp, exception);
+  }
+
+  for (uint16_t i = 0; i < count; ++i) {
+    if (req[6 + (i >> 3)] & (1u << (i & 7))) {
+      if (onCommand && !onCommand((MbCoil)(start + i))) {
+        return exceptionPdu(fc, MB_EX_ILLEGAL_VALUE, resp, exception);
+      }
+      break;
+    }
+  }
+
+  memcpy(resp, req, 5);
+  return 5;
+}
+
+// -------------------------------------------------------------------
+// Public entry points
+// -------------------------------------------------------------------
+
+size_t mb_process_pdu(const MbImage &img,
+                      const uint8_t *req, size_t len,
+                      uint8_t *resp, size_t cap,
+                      MbCommandFn onCommand,
+                      bool *exception) {
+  if (exception) *exception = false;
+  if (len < 1 || cap < 253) return 0;
+
+  switch (req[0]) {
+    case 0x01:
+    case 0x02: return readBits(img, req, len, resp, exception);
+    case 0x03:
+    case 0x04: return readRegisters(img, req, len, resp, exception);
+    case 0x05:
+    case 0x0F:
+      // No command handler: read-only server, writes are not supported
+      if (!onCommand) return exceptionPdu(req[0], MB_EX_ILLEGAL_FUNCTION, resp, exception);
+      return (req[0] == 0x05) ? writeCoil(req, len, resp, onCommand, exception)
+                              : writeCoils(req, len, resp, onCommand, exception);
+    default:   return exceptionPdu(req[0], MB_EX_ILLEGAL_FUNCTION, resp, exception);
+  }
+}
+
+// MBAP: [tid hi][tid lo][pid hi][pid lo][len hi][len lo][unit] + PDU
+size_t mb_process_tcp(const MbImage &img,
+                      const uint8_t *req, size_t len,
+                      uint8_t *resp, size_t cap,
+                      MbCommandFn onCommand,
+                      bool *exception) {
+  if (len < 8 || cap < 7 + 253) return 0;
+  if (be16(&req[2]) != 0) return 0;                 // not Modbus
+  uint16_t mbapLen = be16(&req[4]);
+  if (mbapLen < 2 || (size_t)mbapLen + 6 != len) return 0;
+
+  size_t pduLen = mb_process_pdu(img, &req[7], mbapLen - 1,
+                                 &resp[7], cap - 7, onCommand, exception);
+  if (pduLen == 0) return 0;
+
+  memcpy(resp, req, 4);                             // tid + pid
+  resp[4] = (uint8_t)((pduLen + 1) >> 8);
+  resp[5] = (uint8_t)((pduLen + 1) & 0xFF);
+  resp[6] = req[6];                                 // unit id
+  return 7 + pduLen;
+}
+
+// -------------------------------------------------------------------
+// Host simulation: the same map over POSIX sockets, for mbpoll /
+// pymodbus on Linux (Mill_ModbusTcp is the MCU transport)
+// -------------------------------------------------------------------
+#ifdef MILL_MODBUS_HOST_MAIN
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// A pretend mill: coils drive state, RUN counts the cycle down, and the
+// LN2 PV cools toward its SV
+struct SimMill {
+  uint16_t state;          // 0 IDLE, 1 RUN, 2 HOLD, 3 FAULT (register 1)
+  uint32_t cycle_current;
+  uint32_t cycle_target;
+  uint16_t cycle_index;
+  uint16_t cycle_total;
+  float    pv_c;
+  uint16_t heartbeat;
+};
+
+static SimMill  sim = { 0, 0, 300, 0, 3, 20.0f, 0 };
+static uint32_t simRequests   = 0;
+static uint16_t simExceptions = 0;
+
+static const char *const SIM_COIL_NAMES[MB_COIL_COUNT] = {
+  "START", "STOP", "HOLD", "RESUME", "RESET_FAULT"
+};
+
+static bool simCommand(MbCoil coil) {
+  printf("coil %u %s in state %u\n", (unsigned)coil, SIM_COIL_NAMES[coil], (unsigned)sim.state);
+  switch (coil) {
+    case MB_COIL_START:
+      if (sim.state == 3) return false;   // refused in FAULT, like the FSM
+      if (sim.state == 0) {
+        sim.cycle_index   = 1;
+        sim.cycle_current = 0;
+      }
+      sim.state = 1;
+      return true;
+    case MB_COIL_STOP:        sim.state = 0; sim.cycle_index = 0; return true;
+    case MB_COIL_HOLD:        if (sim.state == 1) sim.state = 2; return true;
+    case MB_COIL_RESUME:      if (sim.state == 2) sim.state = 1; return true;
+    case MB_COIL_RESET_FAULT: if (sim.state == 3) sim.state = 0; return true;
+    default:                  return false;
+  }
+}
+
+static void simRefresh(MbImage &img, uint32_t uptime_s) {
+  img.reg[MB_REG_STATE]       = sim.state;
+  img.reg[MB_REG_CYCLE_INDEX] = sim.cycle_index;
+  img.reg[MB_REG_CYCLE_TOTAL] = sim.cycle_total;
+  mb_image_set_u32(img, MB_REG_CYCLE_CURRENT, sim.cycle_current);
+  mb_image_set_u32(img, MB_REG_CYCLE_TARGET,  sim.cycle_target);
+  mb_image_set_u32(img, MB_REG_TIME_REMAIN,   sim.cycle_target - sim.cycle_current);
+  img.reg[MB_REG_INTERLOCKS]  = 0x0007;
+  mb_image_set_u32(img, MB_REG_UPTIME, uptime_s);
+  img.reg[MB_REG_MQTT_OK]     = 1;
+  img.reg[MB_REG_HEARTBEAT]   = ++sim.heartbeat;
+  mb_image_set_u32(img, MB_REG_SRV_REQUESTS, simRequests);
+  img.reg[MB_REG_SRV_EXCEPT]  = simExceptions;
+
+  uint16_t *pid = &img.reg[MB_REG_PID_BASE];
+  pid[MB_PID_COMM_OK] = 1;
+  pid[MB_PID_PV_X10]  = (uint16_t)(int16_t)(sim.pv_c * 10.0f);
+  pid[MB_PID_SV_X10]  = (uint16_t)(int16_t)-1800;
+  pid[MB_PID_OUT_X10] = (sim.state == 1) ? 1000 : 0;
+  pid[MB_PID_SCORE]   = 100;
+
+  mb_image_set_bit(img, MB_DI_ESTOP_OK, true);
+  mb_image_set_bit(img, MB_DI_LID_LOCKED, true);
+  mb_image_set_bit(img, MB_DI_DOOR_CLOSED, true);
+  for (uint16_t m = 0; m <= 3; ++m) mb_image_set_bit(img, MB_DI_STATE_IDLE + m, sim.state == m);
+  mb_image_set_bit(img, MB_DI_MQTT_OK, true);
+  mb_image_set_bit(img, MB_DI_PID_COMM_BASE, true);
+}
+
+// Once a second
+static void simTick() {
+  if (sim.state == 1) {
+    if (sim.pv_c > -180.0f) sim.pv_c -= 2.5f;
+    if (++sim.cycle_current >= sim.cycle_target) {
+      sim.cycle_current = 0;
+      if (++sim.cycle_index > sim.cycle_total) {
+        sim.state       = 0;
+        sim.cycle_index = 0;
+      }
+    }
+  } else if (sim.pv_c < 20.0f) {
+    sim.pv_c += 0.5f;
+  }
+}
+
+struct SimClient {
+  int     fd;
+  uint8_t rx[260];   // MBAP (7) + max PDU (253), as on the MCU
+  size_t  len;
+};
+
+int main(int argc, char **argv) {
+  uint16_t port = (argc > 1) ? (uint16_t)atoi(argv[1]) : 5020;
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(lfd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 4) != 0) {
+    perror("bind");
+    return 1;
+  }
+  printf("Modbus TCP simulation on port %u (map v%u); try\n"
+         "  mbpoll -m tcp -p %u -a 1 -t 3 -r 1 -c 22 127.0.0.1\n"
+         "  mbpoll -m tcp -p %u -a 1 -t 0 -r 1 127.0.0.1 1      # START\n",
+         (unsigned)port, (unsigned)MB_MAP_VERSION, (unsigned)port, (unsigned)port);
+  fflush(stdout);
+
+  static MbImage img;
+  mb_image_clear(img);
+  static const uint8_t SIM_MAX_CLIENTS = 4;
+  SimClient clients[SIM_MAX_CLIENTS];
+  for (auto &c : clients) c.fd = -1;
+
+  time_t start = time(nullptr), last = start;
+  for (;;) {
+    time_t now = time(nullptr);
+    if (now != last) {
+      last = now;
+      simTick();
+    }
+    simRefresh(img, (uint32_t)(now - start));
+
+    pollfd pfd[1 + SIM_MAX_CLIENTS];
+    pfd[0] = { lfd, POLLIN, 0 };
+    for (uint8_t i = 0; i < SIM_MAX_CLIENTS; ++i) pfd[1 + i] = { clients[i].fd, POLLIN, 0 };
+    if (poll(pfd, 1 + SIM_MAX_CLIENTS, 200) <= 0) continue;
+
+    if (pfd[0].revents & POLLIN) {
+      int fd = accept(lfd, nullptr, nullptr);
+      bool placed = false;
+      for (auto &c : clients) {
+        if (c.fd < 0 && fd >= 0) {
+          setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+          c.fd  = fd;
+          c.len = 0;
+          placed = true;
+          break;
+        }
+      }
+      if (!placed && fd >= 0) close(fd);
+    }
+
+    for (uint8_t i = 0; i < SIM_MAX_CLIENTS; ++i) {
+      SimClient &c = clients[i];
+      if (c.fd < 0 || !(pfd[1 + i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+      ssize_t n = recv(c.fd, c.rx + c.len, sizeof(c.rx) - c.len, 0);
+      if (n <= 0) {
+        close(c.fd);
+        c.fd = -1;
+        continue;
+      }
+      c.len += (size_t)n;
+
+      // Same framing as Mill_ModbusTcp: every complete ADU, pipelined
+      while (c.fd >= 0 && c.len >= 7) {
+        size_t adu = 6 + (((size_t)c.rx[4] << 8) | c.rx[5]);
+        if (adu < 8 || adu > sizeof(c.rx)) {
+          close(c.fd);
+          c.fd = -1;
+          break;
+        }
+        if (c.len < adu) break;
+        uint8_t resp[260];
+        bool    exception = false;
+        size_t  rlen = mb_process_tcp(img, c.rx, adu, resp, sizeof(resp), simCommand, &exception);
+        if (rlen) {
+          send(c.fd, resp, rlen, 0);
+          simRequests++;
+          if (exception) simExceptions++;
+        }
+        memmove(c.rx, c.rx + adu, c.len - adu);
+        c.len -= adu;
+      }
+    }
+    fflush(stdout);
+  }
+}
+#endif
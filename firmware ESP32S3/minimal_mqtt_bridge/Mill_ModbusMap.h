@@ -0,0 +1,151 @@
+#pragma once
+
+/*
+ * Mill_ModbusMap.h
+ *
+ * Modbus register map exposing mill state to a local SCADA / historian.
+ *
+ * The map is a flat, pre-built image (MbImage) refreshed by the control
+ * loop from its cached state; requests are answered straight out of the
+ * image, so every request is O(1) per register and never touches the
+ * downstream LC108 bus. Protocol handling here is plain C++ (no Arduino
+ * headers) so the same code can be built for a host simulation; the
+ * TCP transport lives in Mill_ModbusTcp.
+ *
+ * Host simulation (same map and framing over POSIX sockets, a pretend
+ * mill behind it) for testing SCADA clients on Linux:
+ *
+ *   g++ -std=c++17 -DMILL_MODBUS_HOST_MAIN Mill_ModbusMap.cpp -o mb_sim
+ *   ./mb_sim 5020
+ *   mbpoll -m tcp -p 5020 -a 1 -t 3 -r 1 -c 22 127.0.0.1
+ *
+ * Supported function codes:
+ *   0x01 Read Coils            – command coils (always read back 0)
+ *   0x02 Read Discrete Inputs  – state / interlock bits
+ *   0x03 Read Holding Regs     – same image as 0x04 (read-only)
+ *   0x04 Read Input Regs       – state, cycle counters, PIDs, server stats
+ *   0x05 Write Single Coil     – pulse a command (0xFF00 = execute)
+ *   0x0F Write Multiple Coils  – lowest set coil is executed
+ *   (0x05 / 0x0F only with MODBUS_TCP_COMMANDS, see Mill_ModbusTcp.h)
+ *
+ * Register map (input / holding, 0-based addresses):
+ *   0      map version (MB_MAP_VERSION)
+ *   1      millState        0=IDLE 1=RUN 2=HOLD 3=FAULT
+ *   2      fault_code
+ *   3      cycle_index
+ *   4      cycle_total
+ *   5..6   cycle_current    (u32, hi word first)
+ *   7..8   cycle_target     (u32)
+ *   9..10  time_remaining_s (u32)
+ *   11     interlock bits   bit0 estop_ok, bit1 lid_locked, bit2 door_closed
+ *   12..13 uptime_s         (u32)
+ *   14     mqtt_connected
+ *   15     heartbeat        (image refresh counter, wraps)
+ *   16     server requests per second (last full second)
+ *   17     server avg response latency (µs, last second)
+ *   18     server max response latency (µs, since boot)
+ *   19..20 server total requests (u32)
+ *   21     server exception responses
+ *   32 + 16*n  PID slot n (n < MB_PID_SLOTS, 0 = pid_ln2):
+ *     +0 comm_ok, +1 pv ×10 (s16), +2 sv ×10 (s16), +3 output ×10,
+ *     +4 status_raw, +5 health score, +6 rs485 error total (low word)
+ *
+ * Discrete inputs:
+ *   0 estop_ok, 1 lid_locked, 2 door_closed, 3 IDLE, 4 RUN, 5 HOLD,
+ *   6 FAULT, 7 mqtt_connected, 8 + n pid slot n comm_ok
+ *
+ * Coils (write 1 to execute):
+ *   0 START, 1 STOP, 2 HOLD, 3 RESUME, 4 RESET_FAULT
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+static const uint16_t MB_MAP_VERSION       = 1;
+
+static const uint16_t MB_REG_COUNT         = 96;
+static const uint16_t MB_DISCRETE_COUNT    = 16;
+
+static const uint16_t MB_REG_VERSION       = 0;
+static const uint16_t MB_REG_STATE         = 1;
+static const uint16_t MB_REG_FAULT_CODE    = 2;
+static const uint16_t MB_REG_CYCLE_INDEX   = 3;
+static const uint16_t MB_REG_CYCLE_TOTAL   = 4;
+static const uint16_t MB_REG_CYCLE_CURRENT = 5;
+static const uint16_t MB_REG_CYCLE_TARGET  = 7;
+static const uint16_t MB_REG_TIME_REMAIN   = 9;
+static const uint16_t MB_REG_INTERLOCKS    = 11;
+static const uint16_t MB_REG_UPTIME        = 12;
+static const uint16_t MB_REG_MQTT_OK       = 14;
+static const uint16_t MB_REG_HEARTBEAT     = 15;
+static const uint16_t MB_REG_SRV_RPS       = 16;
+static const uint16_t MB_REG_SRV_LAT_AVG   = 17;
+static const uint16_t MB_REG_SRV_LAT_MAX   = 18;
+static const uint16_t MB_REG_SRV_REQUESTS  = 19;
+static const uint16_t MB_REG_SRV_EXCEPT    = 21;
+
+static const uint16_t MB_REG_PID_BASE      = 32;
+static const uint16_t MB_REG_PID_STRIDE    = 16;
+static const uint8_t  MB_PID_SLOTS         = 4;
+
+static const uint16_t MB_PID_COMM_OK       = 0;
+static const uint16_t MB_PID_PV_X10        = 1;
+static const uint16_t MB_PID_SV_X10        = 2;
+static const uint16_t MB_PID_OUT_X10       = 3;
+static const uint16_t MB_PID_STATUS        = 4;
+static const uint16_t MB_PID_SCORE         = 5;
+static const uint16_t MB_PID_ERRORS        = 6;
+
+static const uint16_t MB_DI_ESTOP_OK       = 0;
+static const uint16_t MB_DI_LID_LOCKED     = 1;
+static const uint16_t MB_DI_DOOR_CLOSED    = 2;
+static const uint16_t MB_DI_STATE_IDLE     = 3;   // + millState
+static const uint16_t MB_DI_MQTT_OK        = 7;
+static const uint16_t MB_DI_PID_COMM_BASE  = 8;
+
+enum MbCoil : uint8_t {
+  MB_COIL_START = 0,
+  MB_COIL_STOP,
+  MB_COIL_HOLD,
+  MB_COIL_RESUME,
+  MB_COIL_RESET_FAULT,
+  MB_COIL_COUNT
+};
+
+// Modbus exception codes
+static const uint8_t MB_EX_ILLEGAL_FUNCTION = 0x01;
+static const uint8_t MB_EX_ILLEGAL_ADDRESS  = 0x02;
+static const uint8_t MB_EX_ILLEGAL_VALUE    = 0x03;
+
+struct MbImage {
+  uint16_t reg[MB_REG_COUNT];
+  uint8_t  discrete[(MB_DISCRETE_COUNT + 7) / 8];
+};
+
+// Called for a coil write with value ON; returns false if the command
+// could not be queued (answered with an exception).
+typedef bool (*MbCommandFn)(MbCoil coil);
+
+// Image helpers
+void mb_image_clear(MbImage &img);
+void mb_image_set_u32(MbImage &img, uint16_t reg, uint32_t v);
+void mb_image_set_bit(MbImage &img, uint16_t bit, bool on);
+
+// Process one request PDU (function code + data). Writes the response PDU
+// into resp (cap >= 253) and returns its length; exceptions are encoded
+// as (fc | 0x80, code). `exception` is set when an exception was returned.
+// onCommand == nullptr makes the server read-only (0x05 / 0x0F answer
+// ILLEGAL_FUNCTION).
+size_t mb_process_pdu(const MbImage &img,
+                      const uint8_t *req, size_t len,
+                      uint8_t *resp, size_t cap,
+                      MbCommandFn onCommand,
+                      bool *exception);
+
+// Process one complete Modbus TCP ADU (MBAP header + PDU). Returns the
+// response ADU length, or 0 if the frame must be dropped (bad protocol id).
+size_t mb_process_tcp(const MbImage &img,
+                      const uint8_t *req, size_t len,
+                      uint8_t *resp, size_t cap,
+                      MbCommandFn onCommand,
+                      bool *exception);
@@ -0,0 +1,166 @@
+#include "Mill_ModbusTcp.h"
+
+#if MODBUS_TCP_ENABLE
+
+// MBAP (7) + max PDU (253)
+static const size_t MB_TCP_ADU_MAX = 260;
+
+struct MbTcpClient {
+  NetworkClient sock;
+  bool          active;
+  uint8_t       rx[MB_TCP_ADU_MAX];
+  size_t        rxLen;
+  unsigned long lastRxMs;
+};
+
+static NetworkServer mbServer(MODBUS_TCP_PORT);
+static MbTcpClient   mbClients[MODBUS_TCP_MAX_CLIENTS];
+static MbServerStats mbStats;
+
+// Per-second accounting
+static unsigned long mbWindowStartMs = 0;
+static uint32_t      mbWindowCount   = 0;
+static uint32_t      mbWindowLatUs   = 0;
+
+void modbusTcp_begin(void) {
+  memset(&mbStats, 0, sizeof(mbStats));
+  for (uint8_t i = 0; i < MODBUS_TCP_MAX_CLIENTS; ++i) {
+    mbClients[i].active = false;
+    mbClients[i].rxLen  = 0;
+  }
+  mbServer.begin();
+  mbServer.setNoDelay(true);
+  mbWindowStartMs = millis();
+
+  Serial.print("[MODBUS] TCP server listening on port ");
+  Serial.println(MODBUS_TCP_PORT);
+}
+
+const MbServerStats &modbusTcp_stats(void) {
+  return mbStats;
+}
+
+static void noteLatency(uint32_t us) {
+  mbStats.requests++;
+  mbWindowCount++;
+  mbWindowLatUs += us;
+  if (us > mbStats.lat_max_us) {
+    mbStats.lat_max_us = (us > 0xFFFF) ? 0xFFFF : (uint16_t)us;
+  }
+}
+
+static void closeClient(MbTcpClient &c) {
+  c.sock.stop();
+  c.active = false;
+  c.rxLen  = 0;
+}
+
+static void acceptClients(unsigned long now) {
+  NetworkClient incoming = mbServer.accept();
+  if (!incoming) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < MODBUS_TCP_MAX_CLIENTS; ++i) {
+    if (!mbClients[i].active) {
+      mbClients[i].sock     = incoming;
+      mbClients[i].active   = true;
+      mbClients[i].rxLen    = 0;
+      mbClients[i].lastRxMs = now;
+      Serial.print("[MODBUS] client connected, slot ");
+      Serial.println(i);
+      return;
+    }
+  }
+
+  // All slots busy: refuse rather than evict a live poller
+  mbStats.dropped++;
+  incoming.stop();
+}
+
+static void serviceClient(MbTcpClient &c, const MbImage &img,
+                          MbCommandFn onCommand, unsigned long now) {
+  if (!c.sock.connected()) {
+    closeClient(c);
+    return;
+  }
+
+  int avail = c.sock.available();
+  if (avail > 0) {
+    size_t room = MB_TCP_ADU_MAX - c.rxLen;
+    int n = c.sock.read(&c.rx[c.rxLen], (size_t)avail < room ? (size_t)avail : room);
+    if (n > 0) {
+      c.rxLen    += (size_t)n;
+      c.lastRxMs  = now;
+    }
+  } else if (now - c.lastRxMs > MODBUS_TCP_IDLE_MS) {
+    Serial.println("[MODBUS] idle client dropped");
+    closeClient(c);
+    return;
+  }
+
+  // Handle every complete ADU in the buffer (clients may pipeline)
+  while (c.rxLen >= 7) {
+    size_t aduLen = 6 + (((size_t)c.rx[4] << 8) | c.rx[5]);
+    if (aduLen < 8 || aduLen > MB_TCP_ADU_MAX) {
+      mbStats.dropped++;
+      closeClient(c);
+      return;
+    }
+    if (c.rxLen < aduLen) {
+      break;   // wait for the rest
+    }
+
+    uint32_t t0 = micros();
+    uint8_t  resp[MB_TCP_ADU_MAX];
+    bool     exception = false;
+    size_t   respLen = mb_process_tcp(img, c.rx, aduLen, resp, sizeof(resp),
+                                      onCommand, &exception);
+    if (respLen > 0) {
+      c.sock.write(resp, respLen);
+      if (exception) mbStats.exceptions++;
+      noteLatency(micros() - t0);
+    } else {
+      mbStats.dropped++;
+    }
+
+    memmove(c.rx, &c.rx[aduLen], c.rxLen - aduLen);
+    c.rxLen -= aduLen;
+  }
+}
+
+void modbusTcp_loop(const MbImage &img, MbCommandFn onCommand) {
+#if !MODBUS_TCP_COMMANDS
+  onCommand = nullptr;                 // read-only unless opted in
+#endif
+  unsigned long now = millis();
+
+  acceptClients(now);
+
+  uint8_t active = 0;
+  for (uint8_t i = 0; i < MODBUS_TCP_MAX_CLIENTS; ++i) {
+    if (mbClients[i].active) {
+      serviceClient(mbClients[i], img, onCommand, now);
+      if (mbClients[i].active) active++;
+    }
+  }
+  mbStats.clients = active;
+
+  if (now - mbWindowStartMs >= 1000) {
+    mbStats.rps        = (mbWindowCount > 0xFFFF) ? 0xFFFF : (uint16_t)mbWindowCount;
+    mbStats.lat_avg_us = mbWindowCount ? (uint16_t)(mbWindowLatUs / mbWindowCount) : 0;
+    mbWindowStartMs    = now;
+    mbWindowCount      = 0;
+    mbWindowLatUs      = 0;
+  }
+}
+
+#else  // !MODBUS_TCP_ENABLE
+
+static MbServerStats mbStats;
+
+void modbusTcp_begin(void) {}
+void modbusTcp_loop(const MbImage &, MbCommandFn) {}
+const MbServerStats &modbusTcp_stats(void) { return mbStats; }
+
+#endif
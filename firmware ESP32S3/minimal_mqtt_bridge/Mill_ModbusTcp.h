@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+ * Mill_ModbusTcp.h
+ *
+ * Modbus TCP server (port 502) on the W5500 link, serving the MbImage
+ * register map from Mill_ModbusMap. Serviced from loop(); it never blocks
+ * and never touches the RS-485 bus.
+ */
+
+#include <Arduino.h>
+#include <ETH.h>
+
+#include "Mill_ModbusMap.h"
+
+// Off by default: the server has no authentication. Set to 1 (or pass
+// -DMODBUS_TCP_ENABLE=1) for a read-only historian feed on port 502.
+#ifndef MODBUS_TCP_ENABLE
+#define MODBUS_TCP_ENABLE 0
+#endif
+
+// Separate opt-in for the command coils (START / STOP / HOLD / RESUME /
+// RESET_FAULT from any host that reaches port 502). Without it coil
+// writes answer ILLEGAL_FUNCTION.
+#ifndef MODBUS_TCP_COMMANDS
+#define MODBUS_TCP_COMMANDS 0
+#endif
+
+static const uint16_t MODBUS_TCP_PORT        = 502;
+static const uint8_t  MODBUS_TCP_MAX_CLIENTS = 2;
+static const uint32_t MODBUS_TCP_IDLE_MS     = 60000;  // drop silent clients
+
+struct MbServerStats {
+  uint32_t requests;       // since boot
+  uint32_t exceptions;     // exception responses since boot
+  uint32_t dropped;        // malformed frames / evicted clients
+  uint16_t rps;            // requests in the last full second
+  uint16_t lat_avg_us;     // mean request→response latency, last second
+  uint16_t lat_max_us;     // worst latency since boot (saturates)
+  uint8_t  clients;        // currently connected
+};
+
+void modbusTcp_begin(void);
+void modbusTcp_loop(const MbImage &img, MbCommandFn onCommand);
+const MbServerStats &modbusTcp_stats(void);
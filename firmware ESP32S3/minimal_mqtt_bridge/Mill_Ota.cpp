@@ -0,0 +1,632 @@
+#include "Mill_Ota.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// -------------------------------------------------------------------
+// SHA-256
+// -------------------------------------------------------------------
+
+static const uint32_t SHA_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, uint8_t n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static void shaBlock(OtaSha256 &s, const uint8_t *p) {
+  uint32_t w[64];
+  for (uint8_t i = 0; i < 16; ++i) {
+    w[i] = ((uint32_t)p[4 * i] << 24) | ((uint32_t)p[4 * i + 1] << 16) |
+           ((uint32_t)p[4 * i + 2] << 8) | (uint32_t)p[4 * i + 3];
+  }
+  for (uint8_t i = 16; i < 64; ++i) {
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = s.h[0], b = s.h[1], c = s.h[2], d = s.h[3];
+  uint32_t e = s.h[4], f = s.h[5], g = s.h[6], h = s.h[7];
+  for (uint8_t i = 0; i < 64; ++i) {
+    uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA_K[i] + w[i];
+    uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  s.h[0] += a; s.h[1] += b; s.h[2] += c; s.h[3] += d;
+  s.h[4] += e; s.h[5] += f; s.h[6] += g; s.h[7] += h;
+}
+
+void ota_sha256_init(OtaSha256 &s) {
+  static const uint32_t H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  memcpy(s.h, H0, sizeof(H0));
+  s.bytes = 0;
+  s.fill  = 0;
+}
+
+void ota_sha256_update(OtaSha256 &s, const uint8_t *data, size_t len) {
+  s.bytes += len;
+  if (s.fill) {
+    size_t n = 64 - s.fill;
+    if (n > len) n = len;
+    memcpy(s.block + s.fill, data, n);
+    s.fill += (uint8_t)n;
+    data += n;
+    len  -= n;
+    if (s.fill < 64) return;
+    shaBlock(s, s.block);
+    s.fill = 0;
+  }
+  // Whole blocks straight from the caller's buffer
+  while (len >= 64) {
+    shaBlock(s, data);
+    data += 64;
+    len  -= 64;
+  }
+  memcpy(s.block, data, len);
+  s.fill = (uint8_t)len;
+}
+
+void ota_sha256_final(OtaSha256 &s, uint8_t out[32]) {
+  uint64_t bits = s.bytes * 8;
+  s.block[s.fill++] = 0x80;
+  if (s.fill > 56) {
+    memset(s.block + s.fill, 0, 64 - s.fill);
+    shaBlock(s, s.block);
+    s.fill = 0;
+  }
+  memset(s.block + s.fill, 0, 56 - s.fill);
+  for (uint8_t i = 0; i < 8; ++i) s.block[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+  shaBlock(s, s.block);
+  for (uint8_t i = 0; i < 8; ++i) {
+    out[4 * i]     = (uint8_t)(s.h[i] >> 24);
+    out[4 * i + 1] = (uint8_t)(s.h[i] >> 16);
+    out[4 * i + 2] = (uint8_t)(s.h[i] >> 8);
+    out[4 * i + 3] = (uint8_t)s.h[i];
+  }
+}
+
+static int hexVal(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool ota_sha256_from_hex(const char *hex, uint8_t out[32]) {
+  if (!hex || strlen(hex) != 64) return false;
+  for (uint8_t i = 0; i < 32; ++i) {
+    int hi = hexVal(hex[2 * i]), lo = hexVal(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    out[i] = (uint8_t)(hi << 4 | lo);
+  }
+  return true;
+}
+
+void ota_sha256_to_hex(const uint8_t in[32], char out[65]) {
+  static const char digits[] = "0123456789abcdef";
+  for (uint8_t i = 0; i < 32; ++i) {
+    out[2 * i]     = digits[in[i] >> 4];
+    out[2 * i + 1] = digits[in[i] & 0x0F];
+  }
+  out[64] = '\0';
+}
+
+// -------------------------------------------------------------------
+// HTTP
+// -------------------------------------------------------------------
+
+bool ota_url_parse(const char *url, char host[OTA_HOST_MAX], uint16_t &port,
+                   char path[OTA_PATH_MAX]) {
+  static const char scheme[] = "http://";
+  if (!url || strncmp(url, scheme, sizeof(scheme) - 1) != 0) return false;
+  const char *h     = url + sizeof(scheme) - 1;
+  const char *slash = strchr(h, '/');
+  const char *end   = slash ? slash : h + strlen(h);
+  const char *colon = (const char *)memchr(h, ':', (size_t)(end - h));
+
+  size_t hostLen = (size_t)((colon ? colon : end) - h);
+  if (hostLen == 0 || hostLen >= OTA_HOST_MAX) return false;
+  memcpy(host, h, hostLen);
+  host[hostLen] = '\0';
+
+  port = 80;
+  if (colon) {
+    char *pend = nullptr;
+    unsigned long p = strtoul(colon + 1, &pend, 10);
+    if (pend != end || p == 0 || p > 65535) return false;
+    port = (uint16_t)p;
+  }
+
+  const char *pth = slash ? slash : "/";
+  if (strlen(pth) >= OTA_PATH_MAX) return false;
+  strcpy(path, pth);
+  return true;
+}
+
+size_t ota_http_request(const char *host, const char *path, char *buf, size_t cap) {
+  // 1.0: the server closes after the body and never sends chunks
+  int n = snprintf(buf, cap, "GET %s HTTP/1.0\r\nHost: %s\r\nConnection: close\r\n\r\n", path, host);
+  return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+// Case-insensitive "Name:" prefix; returns the value (spaces skipped)
+static const char *headerValue(const char *line, const char *name) {
+  size_t n = strlen(name);
+  for (size_t i = 0; i < n; ++i) {
+    char c = line[i];
+    if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    if (c != name[i]) return nullptr;
+  }
+  if (line[n] != ':') return nullptr;
+  const char *v = line + n + 1;
+  while (*v == ' ' || *v == '\t') v++;
+  return v;
+}
+
+// -------------------------------------------------------------------
+// Session
+// -------------------------------------------------------------------
+
+static const uint16_t OTA_HEAD_MAX = 4096;   // response head, bytes
+
+static void closeSink(OtaSession &s) {
+  if (s.sink_open && s.sink.abort) s.sink.abort(s.sink.ctx);
+  s.sink_open = false;
+}
+
+void ota_fail(OtaSession &s, OtaError why, uint32_t now_ms) {
+  if (!ota_active(s)) return;
+  closeSink(s);
+  s.state    = OTA_FAILED;
+  s.error    = why;
+  s.t_end_ms = now_ms;
+}
+
+bool ota_start(OtaSession &s, const OtaSink &sink, const char *sha_hex, uint32_t size,
+               uint32_t now_ms) {
+  memset(&s, 0, sizeof(s));
+  s.sink           = sink;
+  s.size           = size;
+  s.content_length = -1;
+  s.t_start_ms     = now_ms;
+  s.t_last_rx_ms   = now_ms;
+  s.heap_min       = UINT32_MAX;
+  ota_sha256_init(s.sha);
+  if (!ota_sha256_from_hex(sha_hex, s.expect_sha) || !sink.begin || !sink.write || !sink.finish) {
+    s.state    = OTA_FAILED;
+    s.error    = OTA_ERR_BAD_REQUEST;
+    s.t_end_ms = now_ms;
+    return false;
+  }
+  s.state = OTA_HEAD;
+  return true;
+}
+
+// Last byte in: check the hash, then let the sink switch partitions
+static bool complete(OtaSession &s, uint32_t now_ms) {
+  uint8_t got[32];
+  ota_sha256_final(s.sha, got);
+  if (memcmp(got, s.expect_sha, sizeof(got)) != 0) {
+    ota_fail(s, OTA_ERR_SHA, now_ms);
+    return false;
+  }
+  s.sink_open = false;
+  if (!s.sink.finish(s.sink.ctx)) {
+    if (s.sink.abort) s.sink.abort(s.sink.ctx);
+    s.state    = OTA_FAILED;
+    s.error    = OTA_ERR_SINK;
+    s.t_end_ms = now_ms;
+    return false;
+  }
+  s.state    = OTA_DONE;
+  s.t_end_ms = now_ms;
+  return true;
+}
+
+// One complete head line (CR stripped, maybe truncated)
+static bool headLine(OtaSession &s, uint32_t now_ms) {
+  s.line[s.line_len] = '\0';
+  s.line_len = 0;
+
+  if (!s.head_status_seen) {
+    s.head_status_seen = true;
+    int major = 0, minor = 0, status = 0;
+    if (sscanf(s.line, "HTTP/%d.%d %d", &major, &minor, &status) != 3) {
+      ota_fail(s, OTA_ERR_HTTP, now_ms);
+      return false;
+    }
+    s.http_status = status;
+    return true;
+  }
+
+  if (s.line[0] != '\0') {
+    const char *v;
+    if ((v = headerValue(s.line, "content-length")) != nullptr) {
+      s.content_length = strtoll(v, nullptr, 10);
+    } else if ((v = headerValue(s.line, "transfer-encoding")) != nullptr) {
+      s.chunked = strstr(v, "chunked") != nullptr;
+    }
+    return true;
+  }
+
+  // Blank line: head complete
+  if (s.http_status != 200 || s.chunked || s.content_length <= 0) {
+    ota_fail(s, OTA_ERR_HTTP, now_ms);
+    return false;
+  }
+  if (s.size == 0) {
+    if (s.content_length > (int64_t)UINT32_MAX) {
+      ota_fail(s, OTA_ERR_SIZE, now_ms);
+      return false;
+    }
+    s.size = (uint32_t)s.content_length;
+  } else if (s.content_length != (int64_t)s.size) {
+    ota_fail(s, OTA_ERR_SIZE, now_ms);
+    return false;
+  }
+  if (!s.sink.begin(s.sink.ctx, s.size)) {
+    ota_fail(s, OTA_ERR_SINK, now_ms);
+    return false;
+  }
+  s.sink_open = true;
+  s.state     = OTA_BODY;
+  return true;
+}
+
+bool ota_feed(OtaSession &s, const uint8_t *data, size_t len, uint32_t now_ms) {
+  if (!ota_active(s)) return false;
+  if (len) s.t_last_rx_ms = now_ms;
+
+  // Head: byte by byte into the line buffer (it is a few hundred bytes)
+  static_assert(sizeof(((OtaSession *)0)->line) < 256, "line_len is a uint8_t");
+  while (len && s.state == OTA_HEAD) {
+    char c = (char)*data++;
+    len--;
+    if (++s.head_bytes > OTA_HEAD_MAX) {
+      ota_fail(s, OTA_ERR_HTTP, now_ms);
+      return false;
+    }
+    if (c == '\n') {
+      if (!headLine(s, now_ms)) return false;
+    } else if (c != '\r' && (size_t)s.line_len + 1 < sizeof(s.line)) {
+      s.line[s.line_len++] = c;
+    }
+  }
+  if (len == 0 || s.state != OTA_BODY) return ota_active(s) || s.state == OTA_DONE;
+
+  // Body: hash and write in place
+  if (len > s.size - s.written) {
+    ota_fail(s, OTA_ERR_SIZE, now_ms);
+    return false;
+  }
+  ota_sha256_update(s.sha, data, len);
+  if (!s.sink.write(s.sink.ctx, data, len)) {
+    ota_fail(s, OTA_ERR_SINK, now_ms);
+    return false;
+  }
+  s.written += (uint32_t)len;
+  if (s.written == s.size) return complete(s, now_ms);
+  return true;
+}
+
+bool ota_end_of_stream(OtaSession &s, uint32_t now_ms) {
+  if (s.state == OTA_DONE) return true;
+  if (!ota_active(s)) return false;
+  // Closed early: in the head, or short of the announced size
+  ota_fail(s, s.state == OTA_HEAD ? OTA_ERR_HTTP : OTA_ERR_SIZE, now_ms);
+  return false;
+}
+
+bool ota_stalled(const OtaSession &s, uint32_t now_ms) {
+  return ota_active(s) && now_ms - s.t_last_rx_ms >= OTA_STALL_MS;
+}
+
+bool ota_active(const OtaSession &s) {
+  return s.state == OTA_HEAD || s.state == OTA_BODY;
+}
+
+uint8_t ota_progress_pct(const OtaSession &s) {
+  if (s.state == OTA_DONE) return 100;
+  if (s.size == 0) return 0;
+  return (uint8_t)((uint64_t)s.written * 100 / s.size);
+}
+
+const char *ota_state_str(OtaState st) {
+  switch (st) {
+    case OTA_IDLE:   return "IDLE";
+    case OTA_HEAD:   return "CONNECTING";
+    case OTA_BODY:   return "TRANSFER";
+    case OTA_DONE:   return "DONE";
+    case OTA_FAILED: return "FAILED";
+  }
+  return "?";
+}
+
+const char *ota_error_str(OtaError e) {
+  switch (e) {
+    case OTA_OK:              return "OK";
+    case OTA_ERR_BAD_REQUEST: return "BAD_REQUEST";
+    case OTA_ERR_CONNECT:     return "CONNECT";
+    case OTA_ERR_HTTP:        return "HTTP";
+    case OTA_ERR_SIZE:        return "SIZE";
+    case OTA_ERR_SINK:        return "FLASH";
+    case OTA_ERR_SHA:         return "SHA256";
+    case OTA_ERR_STALLED:     return "STALLED";
+    case OTA_ERR_ABORTED:     return "ABORTED";
+  }
+  return "?";
+}
+
+size_t ota_json(const OtaSession &s, uint32_t now_ms, char *buf, size_t cap) {
+  uint32_t end = ota_active(s) ? now_ms : s.t_end_ms;
+  uint32_t ms  = (s.state == OTA_IDLE) ? 0 : end - s.t_start_ms;
+  double   kBs = ms ? (double)s.written / (double)ms : 0.0;   // B/ms == kB/s
+  int n = snprintf(buf, cap,
+                   "{\"state\":\"%s\",\"error\":\"%s\",\"bytes\":%lu,\"size\":%lu,\"pct\":%u,"
+                   "\"ms\":%lu,\"kB_s\":%.1f,\"flash_ms\":%lu,\"heap_min\":%lu}",
+                   ota_state_str(s.state), ota_error_str(s.error), (unsigned long)s.written,
+                   (unsigned long)s.size, (unsigned)ota_progress_pct(s), (unsigned long)ms, kBs,
+                   (unsigned long)s.flash_ms,
+                   (unsigned long)(s.heap_min == UINT32_MAX ? 0 : s.heap_min));
+  return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+// -------------------------------------------------------------------
+// Host demo: self-test, or pull a real image from an HTTP server
+// -------------------------------------------------------------------
+#ifdef MILL_OTA_DEMO_MAIN
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint32_t nowMs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// Sink into memory (self-test) or a file (pull)
+struct DemoSink {
+  FILE    *f;
+  uint8_t *mem;
+  size_t   cap;
+  size_t   len;
+  bool     finished;
+  bool     aborted;
+};
+
+static bool demoBegin(void *ctx, uint32_t size) {
+  DemoSink &d = *(DemoSink *)ctx;
+  d.len = 0;
+  return d.f || size <= d.cap;
+}
+
+static bool demoWrite(void *ctx, const uint8_t *data, size_t len) {
+  DemoSink &d = *(DemoSink *)ctx;
+  if (d.f) return fwrite(data, 1, len, d.f) == len;
+  if (d.len + len > d.cap) return false;
+  memcpy(d.mem + d.len, data, len);
+  d.len += len;
+  return true;
+}
+
+static bool demoFinish(void *ctx) {
+  ((DemoSink *)ctx)->finished = true;
+  return true;
+}
+
+static void demoAbort(void *ctx) {
+  ((DemoSink *)ctx)->aborted = true;
+}
+
+static OtaSink demoSink(DemoSink &d) {
+  OtaSink s = { demoBegin, demoWrite, demoFinish, demoAbort, &d };
+  return s;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  printf("  %-58s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok) failures++;
+}
+
+static void hashHex(const void *data, size_t len, char hex[65]) {
+  OtaSha256 s;
+  uint8_t   d[32];
+  ota_sha256_init(s);
+  ota_sha256_update(s, (const uint8_t *)data, len);
+  ota_sha256_final(s, d);
+  ota_sha256_to_hex(d, hex);
+}
+
+// Feeds `resp` in slices of `step` bytes (0 = one byte at a time, then
+// every split point of the head is exercised), then closes
+static OtaSession runCanned(const char *resp, size_t respLen, const char *sha, uint32_t size,
+                            size_t step, DemoSink &d) {
+  static uint8_t mem[8192];
+  d = DemoSink{ nullptr, mem, sizeof(mem), 0, false, false };
+  OtaSession s;
+  ota_start(s, demoSink(d), sha, size, 0);
+  size_t i = 0;
+  while (i < respLen && ota_active(s)) {
+    size_t n = step ? step : 1;
+    if (n > respLen - i) n = respLen - i;
+    ota_feed(s, (const uint8_t *)resp + i, n, 1);
+    i += n;
+  }
+  ota_end_of_stream(s, 2);
+  return s;
+}
+
+static int selfTest() {
+  char hex[65];
+  printf("SHA-256 vectors\n");
+  hashHex("", 0, hex);
+  check(strcmp(hex, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855") == 0, "\"\"");
+  hashHex("abc", 3, hex);
+  check(strcmp(hex, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") == 0, "\"abc\"");
+  const char *two = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  hashHex(two, strlen(two), hex);
+  check(strcmp(hex, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1") == 0, "448-bit message");
+  static uint8_t million[1000000];
+  memset(million, 'a', sizeof(million));
+  OtaSha256 s;
+  uint8_t   dg[32];
+  ota_sha256_init(s);
+  for (size_t i = 0; i < sizeof(million); i += 997) {   // odd slices cross block edges
+    size_t n = sizeof(million) - i < 997 ? sizeof(million) - i : 997;
+    ota_sha256_update(s, million + i, n);
+  }
+  ota_sha256_final(s, dg);
+  ota_sha256_to_hex(dg, hex);
+  check(strcmp(hex, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0") == 0, "one million 'a', 997-byte slices");
+
+  printf("Transfer\n");
+  static char   body[5000];
+  for (size_t i = 0; i < sizeof(body); ++i) body[i] = (char)(i * 31 + 7);
+  char sha[65];
+  hashHex(body, sizeof(body), sha);
+  static char resp[6000];
+  int head = snprintf(resp, sizeof(resp),
+                      "HTTP/1.0 200 OK\r\nServer: SimpleHTTP/0.6 Python/3.11\r\n"
+                      "content-length: %u\r\nContent-Type: application/octet-stream\r\n\r\n",
+                      (unsigned)sizeof(body));
+  memcpy(resp + head, body, sizeof(body));
+  size_t respLen = (size_t)head + sizeof(body);
+
+  DemoSink d;
+  OtaSession r = runCanned(resp, respLen, sha, sizeof(body), 0, d);
+  check(r.state == OTA_DONE && d.finished && d.len == sizeof(body) &&
+        memcmp(d.mem, body, sizeof(body)) == 0, "byte-at-a-time, image identical");
+  bool allSplits = true;
+  for (size_t step = 2; step < 200; ++step) {
+    r = runCanned(resp, respLen, sha, 0, step, d);
+    allSplits = allSplits && r.state == OTA_DONE && d.finished;
+  }
+  check(allSplits, "slices of 2..199 bytes, size from Content-Length");
+
+  char badSha[65];
+  memcpy(badSha, sha, sizeof(badSha));
+  badSha[10] = badSha[10] == '0' ? '1' : '0';
+  r = runCanned(resp, respLen, badSha, sizeof(body), 512, d);
+  check(r.state == OTA_FAILED && r.error == OTA_ERR_SHA && d.aborted && !d.finished, "wrong hash -> SHA256, aborted");
+
+  r = runCanned(resp, respLen - 100, sha, sizeof(body), 512, d);
+  check(r.state == OTA_FAILED && r.error == OTA_ERR_SIZE && d.aborted, "connection closed 100 B early -> SIZE");
+
+  r = runCanned(resp, respLen, sha, sizeof(body) + 1, 512, d);
+  check(r.state == OTA_FAILED && r.error == OTA_ERR_SIZE && !d.finished, "announced size != Content-Length -> SIZE");
+
+  const char *notFound = "HTTP/1.0 404 File not found\r\nContent-Length: 9\r\n\r\nnot found";
+  r = runCanned(notFound, strlen(notFound), sha, 0, 64, d);
+  check(r.state == OTA_FAILED && r.error == OTA_ERR_HTTP, "404 -> HTTP");
+
+  const char *chunked = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n";
+  r = runCanned(chunked, strlen(chunked), sha, 0, 64, d);
+  check(r.state == OTA_FAILED && r.error == OTA_ERR_HTTP, "chunked -> HTTP");
+
+  check(!ota_start(r, demoSink(d), "abc", 0, 0) && r.error == OTA_ERR_BAD_REQUEST, "short sha256 -> BAD_REQUEST");
+
+  char host[OTA_HOST_MAX], path[OTA_PATH_MAX];
+  uint16_t port = 0;
+  check(ota_url_parse("http://192.168.50.2:8000/fw/mill.bin", host, port, path) &&
+        strcmp(host, "192.168.50.2") == 0 && port == 8000 && strcmp(path, "/fw/mill.bin") == 0, "url with port");
+  check(ota_url_parse("http://pi", host, port, path) && port == 80 && strcmp(path, "/") == 0, "url without port / path");
+  check(!ota_url_parse("https://pi/fw.bin", host, port, path), "https refused (no TLS on the link)");
+
+  printf("\nsession %u B + caller's receive slice; %s\n", (unsigned)sizeof(OtaSession),
+         failures ? "FAIL" : "OK");
+  return failures ? 1 : 0;
+}
+
+// Same sequence the sketch runs, over POSIX sockets
+static int pull(const char *url, const char *sha, const char *outPath) {
+  char host[OTA_HOST_MAX], path[OTA_PATH_MAX];
+  uint16_t port;
+  if (!ota_url_parse(url, host, port, path)) {
+    fprintf(stderr, "bad url\n");
+    return 2;
+  }
+  DemoSink d = { fopen(outPath, "wb"), nullptr, 0, 0, false, false };
+  if (!d.f) {
+    perror(outPath);
+    return 2;
+  }
+  OtaSession s;
+  uint32_t t0 = nowMs();
+  if (!ota_start(s, demoSink(d), sha, 0, t0)) {
+    fprintf(stderr, "bad sha256\n");
+    return 2;
+  }
+
+  char portStr[8];
+  snprintf(portStr, sizeof(portStr), "%u", port);
+  addrinfo hints = {}, *ai = nullptr;
+  hints.ai_socktype = SOCK_STREAM;
+  int fd = -1;
+  if (getaddrinfo(host, portStr, &hints, &ai) == 0) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+      close(fd);
+      fd = -1;
+    }
+    freeaddrinfo(ai);
+  }
+  if (fd < 0) {
+    ota_fail(s, OTA_ERR_CONNECT, nowMs());
+  } else {
+    char req[256];
+    size_t n = ota_http_request(host, path, req, sizeof(req));
+    if (send(fd, req, n, 0) != (ssize_t)n) ota_fail(s, OTA_ERR_CONNECT, nowMs());
+
+    static uint8_t slice[1024];   // same receive slice as the sketch
+    while (ota_active(s)) {
+      ssize_t got = recv(fd, slice, sizeof(slice), 0);
+      if (got <= 0) {
+        ota_end_of_stream(s, nowMs());
+        break;
+      }
+      uint32_t w0 = nowMs();
+      ota_feed(s, slice, (size_t)got, w0);
+      s.flash_ms += nowMs() - w0;
+    }
+    close(fd);
+  }
+  fclose(d.f);
+
+  char json[256];
+  ota_json(s, nowMs(), json, sizeof(json));
+  rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  printf("%s\n", json);
+  printf("transfer buffers: session %u B + slice 1024 B; process max RSS %ld kB\n",
+         (unsigned)sizeof(OtaSession), ru.ru_maxrss);
+  return s.state == OTA_DONE ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 4) return pull(argv[1], argv[2], argv[3]);
+  if (argc != 1) {
+    fprintf(stderr, "usage: %s [http://host:port/fw.bin <sha256> <out file>]\n", argv[0]);
+    return 2;
+  }
+  return selfTest();
+}
+#endif
@@ -0,0 +1,160 @@
+#pragma once
+
+/*
+ * Mill_Ota.h
+ *
+ * Firmware update pulled over HTTP from the Pi. The transfer logic lives
+ * here; the caller owns the socket and the flash:
+ *
+ *   ota_url_parse()  ->  caller connects  ->  ota_http_request() sent
+ *   every received slice  ->  ota_feed()
+ *   connection closed     ->  ota_end_of_stream()
+ *
+ * The response head (HTTP/1.0: status line, Content-Length, no chunked
+ * encoding) is parsed incrementally; body bytes go straight to the sink
+ * and through an incremental SHA-256, so nothing is buffered beyond the
+ * caller's receive slice. The image is only handed to sink.finish()
+ * (on the MCU: esp_ota_end + set boot partition) once its length and
+ * SHA-256 match what the command announced; any mismatch calls
+ * sink.abort() and the running image stays the boot image.
+ *
+ * Plain C++. Host demo: self-test (SHA-256 vectors, head split at every
+ * byte, bad hash / short body / wrong size), or a real pull from any
+ * HTTP server into a file, with timing and peak memory:
+ *
+ *   g++ -std=c++17 -O2 -DMILL_OTA_DEMO_MAIN Mill_Ota.cpp -o ota_demo
+ *   ./ota_demo
+ *   python3 -m http.server 8000 &     # in the directory holding fw.bin
+ *   ./ota_demo http://127.0.0.1:8000/fw.bin $(sha256sum fw.bin | cut -c1-64) /tmp/fw.out
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const size_t   OTA_URL_MAX      = 160;
+static const size_t   OTA_HOST_MAX     = 64;
+static const size_t   OTA_PATH_MAX     = 128;
+static const uint32_t OTA_STALL_MS     = 15000;   // no body bytes for this long: fail
+
+// -------------------------------------------------------------------
+// SHA-256 (FIPS 180-4), streaming
+// -------------------------------------------------------------------
+
+struct OtaSha256 {
+  uint32_t h[8];
+  uint64_t bytes;
+  uint8_t  block[64];
+  uint8_t  fill;
+};
+
+void ota_sha256_init(OtaSha256 &s);
+void ota_sha256_update(OtaSha256 &s, const uint8_t *data, size_t len);
+void ota_sha256_final(OtaSha256 &s, uint8_t out[32]);
+
+// 64 hex digits (either case) -> 32 bytes
+bool ota_sha256_from_hex(const char *hex, uint8_t out[32]);
+void ota_sha256_to_hex(const uint8_t in[32], char out[65]);
+
+// -------------------------------------------------------------------
+// HTTP
+// -------------------------------------------------------------------
+
+// "http://host[:port]/path" only (private link, no TLS)
+bool ota_url_parse(const char *url, char host[OTA_HOST_MAX], uint16_t &port,
+                   char path[OTA_PATH_MAX]);
+
+// "GET <path> HTTP/1.0" + Host; 0 if cap is too small
+size_t ota_http_request(const char *host, const char *path, char *buf, size_t cap);
+
+// -------------------------------------------------------------------
+// Session
+// -------------------------------------------------------------------
+
+// Where the image goes: esp_ota_* on the MCU, a file on a host. Every
+// call returns false on failure; abort() may follow begin() at any point.
+struct OtaSink {
+  bool (*begin)(void *ctx, uint32_t size);
+  bool (*write)(void *ctx, const uint8_t *data, size_t len);
+  bool (*finish)(void *ctx);     // length + hash verified: make it bootable
+  void (*abort)(void *ctx);
+  void *ctx;
+};
+
+enum OtaState : uint8_t {
+  OTA_IDLE = 0,
+  OTA_HEAD,            // request sent, reading the response head
+  OTA_BODY,            // streaming the image
+  OTA_DONE,            // verified and handed to sink.finish()
+  OTA_FAILED
+};
+
+enum OtaError : uint8_t {
+  OTA_OK = 0,
+  OTA_ERR_BAD_REQUEST,   // url / sha256 / size in the command
+  OTA_ERR_CONNECT,
+  OTA_ERR_HTTP,          // not 200, no Content-Length, chunked, head too long
+  OTA_ERR_SIZE,          // Content-Length or body length != announced size
+  OTA_ERR_SINK,          // flash begin / write / finish failed
+  OTA_ERR_SHA,
+  OTA_ERR_STALLED,
+  OTA_ERR_ABORTED        // OTA_ABORT, or the mill left IDLE
+};
+
+struct OtaSession {
+  OtaState  state;
+  OtaError  error;
+  OtaSink   sink;
+  bool      sink_open;
+
+  // response head
+  char      line[96];
+  uint8_t   line_len;
+  uint16_t  head_bytes;        // capped, a server that never ends the head fails
+  bool      head_status_seen;
+  int       http_status;
+  int64_t   content_length;    // -1 until seen
+  bool      chunked;
+
+  // body
+  OtaSha256 sha;
+  uint8_t   expect_sha[32];
+  uint32_t  size;              // announced by the command, 0 = take Content-Length
+  uint32_t  written;
+
+  uint32_t  t_start_ms;
+  uint32_t  t_last_rx_ms;
+  uint32_t  t_end_ms;
+
+  // Filled in by the caller / sink, reported as is by ota_json()
+  uint32_t  flash_ms;          // time spent inside sink.write()
+  uint32_t  heap_min;          // lowest free heap seen during the transfer
+};
+
+// IDLE -> HEAD. false (session FAILED, OTA_ERR_BAD_REQUEST) if the hash is
+// not 64 hex digits. size 0 = trust Content-Length.
+bool ota_start(OtaSession &s, const OtaSink &sink, const char *sha_hex, uint32_t size,
+               uint32_t now_ms);
+
+// Response bytes as received (head and body in any split). false once
+// the session has failed.
+bool ota_feed(OtaSession &s, const uint8_t *data, size_t len, uint32_t now_ms);
+
+// Peer closed the connection: complete iff every byte arrived and the
+// hash matches. Returns the final state's success.
+bool ota_end_of_stream(OtaSession &s, uint32_t now_ms);
+
+// Caller-side failure (connect, OTA_ABORT, state change); no-op when not
+// active
+void ota_fail(OtaSession &s, OtaError why, uint32_t now_ms);
+
+// true if active and no body byte for OTA_STALL_MS (then ota_fail it)
+bool ota_stalled(const OtaSession &s, uint32_t now_ms);
+
+bool        ota_active(const OtaSession &s);
+uint8_t     ota_progress_pct(const OtaSession &s);
+const char *ota_state_str(OtaState st);
+const char *ota_error_str(OtaError e);
+
+// {"state":"TRANSFER","error":"OK","bytes":..,"size":..,"pct":..,"ms":..,
+//  "kB_s":..,"flash_ms":..,"heap_min":..}; 0 if cap is too small
+size_t ota_json(const OtaSession &s, uint32_t now_ms, char *buf, size_t cap);
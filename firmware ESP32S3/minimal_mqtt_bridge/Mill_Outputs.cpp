@@ -0,0 +1,149 @@
+#include "Mill_Outputs.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ROLE_BIT(r) ((uint8_t)(1u << (r)))
+
+// Which roles each state energizes (was the four update*RelayFromState())
+static const uint8_t kWanted[MILL_STATE_COUNT] = {
+  0,                                                                  // IDLE
+  ROLE_BIT(IO_RELAY_MOTOR) | ROLE_BIT(IO_RELAY_LN2) | ROLE_BIT(IO_RELAY_FAN),  // RUN
+  ROLE_BIT(IO_RELAY_LN2)   | ROLE_BIT(IO_RELAY_FAN),                  // HOLD
+  ROLE_BIT(IO_RELAY_FAULT) | ROLE_BIT(IO_RELAY_FAN),                  // FAULT
+};
+
+// Switch-on order per state; roles not wanted in that state are skipped
+static const IoRelayRole kOnOrder[MILL_STATE_COUNT][IO_RELAY_COUNT] = {
+  { IO_RELAY_FAN,   IO_RELAY_LN2, IO_RELAY_MOTOR, IO_RELAY_FAULT },   // IDLE
+  { IO_RELAY_FAN,   IO_RELAY_LN2, IO_RELAY_MOTOR, IO_RELAY_FAULT },   // RUN
+  { IO_RELAY_FAN,   IO_RELAY_LN2, IO_RELAY_MOTOR, IO_RELAY_FAULT },   // HOLD
+  { IO_RELAY_FAULT, IO_RELAY_FAN, IO_RELAY_LN2,   IO_RELAY_MOTOR },   // FAULT: lamp first
+};
+
+static const char *const kRoleLabel[IO_RELAY_COUNT] = {
+  "MOTOR", "FAULT", "LN2", "FAN"
+};
+
+static OutConfig  outCfg;
+static OutWriteFn outWrite = nullptr;
+static OutLogFn   outLog   = nullptr;
+
+static bool     roleOn[IO_RELAY_COUNT];
+static bool     roleTimed[IO_RELAY_COUNT];      // changedMs is meaningful
+static uint32_t roleChangedMs[IO_RELAY_COUNT];
+static bool     everEnergized = false;
+static uint32_t lastEnergizeMs = 0;
+
+static void logSwitch(IoRelayRole r, uint8_t ch, bool on, bool ok) {
+  if (!outLog) return;
+  char line[48];
+  if (ok) {
+    snprintf(line, sizeof(line), "[RELAY] %s CH%u %s", kRoleLabel[r], ch,
+             on ? "→ ON" : "→ OFF");
+  } else {
+    snprintf(line, sizeof(line), "[RELAY] Failed to set %s relay", kRoleLabel[r]);
+  }
+  outLog(line);
+}
+
+static bool switchRole(IoRelayRole r, uint8_t ch, bool on, uint32_t now_ms) {
+  bool ok = outWrite ? outWrite(ch, on) : true;
+  logSwitch(r, ch, on, ok);
+  if (!ok) return false;          // retried next pass
+  roleOn[r]        = on;
+  roleTimed[r]     = true;
+  roleChangedMs[r] = now_ms;
+  return true;
+}
+
+// -------------------------------------------------------------------
+// Public API
+// -------------------------------------------------------------------
+
+void outputs_begin(OutWriteFn write, OutLogFn log) {
+  outWrite = write;
+  outLog   = log;
+
+  memset(&outCfg, 0, sizeof(outCfg));
+  outCfg.role[IO_RELAY_MOTOR] = {    0, 3000 };   // contactor restart guard
+  outCfg.role[IO_RELAY_FAULT] = {    0,    0 };
+  outCfg.role[IO_RELAY_LN2]   = { 2000, 2000 };   // solenoid anti-chatter
+  outCfg.role[IO_RELAY_FAN]   = { 5000,    0 };
+  outCfg.stagger_ms = 300;
+
+  memset(roleOn, 0, sizeof(roleOn));
+  memset(roleTimed, 0, sizeof(roleTimed));
+  memset(roleChangedMs, 0, sizeof(roleChangedMs));
+  everEnergized = false;
+}
+
+OutConfig &outputs_config(void) {
+  return outCfg;
+}
+
+void outputs_reset(uint32_t now_ms) {
+  for (uint8_t r = 0; r < IO_RELAY_COUNT; ++r) {
+    roleOn[r]        = false;
+    roleTimed[r]     = true;
+    roleChangedMs[r] = now_ms;
+  }
+}
+
+void outputs_update(const IoMapCompiled &io, MillState state, bool safety,
+                    uint32_t now_ms, uint8_t inhibit) {
+  if (state >= MILL_STATE_COUNT) state = MILL_FAULT;
+  uint8_t want = safety ? (kWanted[state] & kWanted[MILL_FAULT]) : kWanted[state];
+  want &= (uint8_t)~inhibit;
+
+  // 1) Switch-offs: all in this pass, never staggered
+  for (uint8_t r = 0; r < IO_RELAY_COUNT; ++r) {
+    if (!roleOn[r] || (want & ROLE_BIT(r))) continue;
+    uint8_t ch = io_relay_channel(io, (IoRelayRole)r);
+    if (ch == 0) { roleOn[r] = false; continue; }
+
+    if (!safety && roleTimed[r] &&
+        now_ms - roleChangedMs[r] < outCfg.role[r].min_on_ms) {
+      continue;                   // anti-chatter hold, not a safety cut
+    }
+    switchRole((IoRelayRole)r, ch, false, now_ms);
+  }
+
+  // 2) Switch-ons: in order, one per stagger window
+  if (everEnergized && now_ms - lastEnergizeMs < outCfg.stagger_ms) {
+    return;
+  }
+  const IoRelayRole *order = kOnOrder[state];
+  for (uint8_t i = 0; i < IO_RELAY_COUNT; ++i) {
+    IoRelayRole r = order[i];
+    if (!(want & ROLE_BIT(r)) || roleOn[r]) continue;
+
+    uint8_t ch = io_relay_channel(io, r);
+    if (ch == 0) continue;        // role not wired on this machine
+
+    if (roleTimed[r] && now_ms - roleChangedMs[r] < outCfg.role[r].min_off_ms) {
+      return;                     // later roles wait for this one
+    }
+    if (switchRole(r, ch, true, now_ms)) {
+      everEnergized  = true;
+      lastEnergizeMs = now_ms;
+    }
+    return;
+  }
+}
+
+bool outputs_role_on(IoRelayRole r) {
+  return (r < IO_RELAY_COUNT) ? roleOn[r] : false;
+}
+
+uint8_t outputs_mask(void) {
+  uint8_t m = 0;
+  for (uint8_t r = 0; r < IO_RELAY_COUNT; ++r) {
+    if (roleOn[r]) m |= ROLE_BIT(r);
+  }
+  return m;
+}
+
+uint8_t outputs_wanted_mask(MillState s) {
+  return (s < MILL_STATE_COUNT) ? kWanted[s] : 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * Mill_Outputs.h
+ *
+ * Relay output scheduler. The mill state selects which relay roles should
+ * be energized; this module decides *when* each channel actually switches:
+ *
+ *  - Energizing follows a per-state order (RUN: fan → LN2 → motor) with at
+ *    most one channel switched on per stagger window, so contactor and
+ *    solenoid inrush do not land on the 24 V supply in the same tick.
+ *    A role waits for the ones before it in the order.
+ *  - Each role has a minimum on and minimum off time (valve / contactor
+ *    anti-chatter). A minimum off time only ever delays switching ON.
+ *  - A caller-supplied inhibit mask can withhold roles the state would
+ *    otherwise energize (closed-loop LN2 valve control); an inhibited role
+ *    switches off like any other, i.e. after its minimum on time.
+ *  - Switching OFF is never staggered. With `safety` set (FAULT, or an
+ *    interlock open) it also ignores minimum on times, so cut-off happens
+ *    in the same loop pass as before.
+ *
+ * Plain C++; the relay write and log sinks are callbacks.
+ */
+
+#include <stdint.h>
+
+#include "Mill_Snapshot.h"
+#include "Mill_IoMap.h"
+
+struct OutRoleTiming {
+  uint16_t min_on_ms;
+  uint16_t min_off_ms;
+};
+
+struct OutConfig {
+  OutRoleTiming role[IO_RELAY_COUNT];
+  uint16_t      stagger_ms;          // between successive switch-ons
+};
+
+typedef bool (*OutWriteFn)(uint8_t ch, bool on);
+typedef void (*OutLogFn)(const char *line);
+
+void outputs_begin(OutWriteFn write, OutLogFn log);
+
+// Timing knobs (defaults set by outputs_begin)
+OutConfig &outputs_config(void);
+
+// Forget every role's state (after all relays were forced off, e.g. an
+// I/O remap); minimum off times restart from now_ms.
+void outputs_reset(uint32_t now_ms);
+
+// Call every loop pass after the state machine has run. Bits set in
+// `inhibit` (bit r = role r) are removed from the state's wanted set.
+void outputs_update(const IoMapCompiled &io, MillState state, bool safety,
+                    uint32_t now_ms, uint8_t inhibit = 0);
+
+bool    outputs_role_on(IoRelayRole r);
+uint8_t outputs_mask(void);                 // bit r = role r energized
+uint8_t outputs_wanted_mask(MillState s);   // bit r = role r wanted in s
@@ -0,0 +1,42 @@
+#include "Mill_Retain.h"
+
+void retain_init(RetainSlot &s, uint32_t min_gap_ms, uint32_t refresh_ms) {
+  s.min_gap_ms = min_gap_ms;
+  s.refresh_ms = refresh_ms;
+  s.writes     = 0;
+  s.held       = 0;
+  retain_reset(s);
+}
+
+void retain_reset(RetainSlot &s) {
+  s.sent    = false;
+  s.key     = 0;
+  s.last_ms = 0;
+}
+
+bool retain_due(RetainSlot &s, uint32_t key, uint32_t now_ms) {
+  if (!s.sent) return true;
+  uint32_t age = now_ms - s.last_ms;
+  if (key != s.key) {
+    if (age >= s.min_gap_ms) return true;
+    s.held++;
+    return false;
+  }
+  return s.refresh_ms != 0 && age >= s.refresh_ms;
+}
+
+void retain_sent(RetainSlot &s, uint32_t key, uint32_t now_ms) {
+  s.sent    = true;
+  s.key     = key;
+  s.last_ms = now_ms;
+  s.writes++;
+}
+
+uint32_t retain_hash(const void *p, size_t len, uint32_t h) {
+  const uint8_t *b = (const uint8_t *)p;
+  for (size_t i = 0; i < len; ++i) {
+    h ^= b[i];
+    h *= 16777619u;
+  }
+  return h;
+}
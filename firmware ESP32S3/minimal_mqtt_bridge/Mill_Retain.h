@@ -0,0 +1,42 @@
+#pragma once
+
+/*
+ * Mill_Retain.h
+ *
+ * Rate limit for retained publishes. Every retained message is a write
+ * to the broker's persistence, so a slot publishes only when
+ *
+ *  - nothing has been sent since (re)connect,
+ *  - its key changed and min_gap_ms has passed since the last write
+ *    (a change inside the gap is held, not lost: the key still differs
+ *    when the gap ends), or
+ *  - refresh_ms passed (0 = never), for values that drift without the
+ *    key changing (PV in the last-state snapshot).
+ *
+ * The key is whatever the caller hashes: the significant fields for the
+ * state snapshot, the whole payload for the config echo.
+ *
+ * Plain C++.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct RetainSlot {
+  uint32_t min_gap_ms;
+  uint32_t refresh_ms;
+
+  bool     sent;             // since the last retain_reset()
+  uint32_t key;
+  uint32_t last_ms;
+
+  uint32_t writes;           // since boot
+  uint32_t held;             // evaluations that found a change inside the gap
+};
+
+void     retain_init(RetainSlot &s, uint32_t min_gap_ms, uint32_t refresh_ms);
+void     retain_reset(RetainSlot &s);          // after a (re)connect
+bool     retain_due(RetainSlot &s, uint32_t key, uint32_t now_ms);
+void     retain_sent(RetainSlot &s, uint32_t key, uint32_t now_ms);
+
+uint32_t retain_hash(const void *p, size_t len, uint32_t h = 2166136261u);   // FNV-1a
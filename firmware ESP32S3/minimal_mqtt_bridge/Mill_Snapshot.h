@@ -0,0 +1,193 @@
+#pragma once
+
+/*
+ * Mill_Snapshot.h
+ *
+ * Shared mill state as a single POD snapshot.
+ *
+ * The control loop owns the working state and commits a complete
+ * MillSnapshot after every update pass. Readers (status / diag publisher,
+ * Modbus image, other tasks) take a consistent copy through a
+ * double-buffered sequence latch: no mutex, the writer never waits, and a
+ * reader only retries if the writer committed again while it was copying.
+ * Because the writer always leaves one of the two copies untouched, a
+ * reader that preempts the writer mid-commit on the same core reads the
+ * stable copy instead of spinning.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// -------------------------------------------------------------------
+// Mill state machine
+// -------------------------------------------------------------------
+
+enum MillState : uint8_t {
+  MILL_IDLE = 0,
+  MILL_RUN,
+  MILL_HOLD,
+  MILL_FAULT
+};
+
+static const uint8_t MILL_STATE_COUNT = 4;
+
+// Substates as published in mill/<id>/status/state (protocol.md §5.2.1)
+enum MillSubstate : uint8_t {
+  SUB_IDLE_READY = 0,
+  SUB_RUN_ACTIVE,
+  SUB_RUN_COOLING,
+  SUB_HOLD_USER,
+  SUB_HOLD_INTERLOCK,
+  SUB_FAULT_INTERLOCK,
+  SUB_FAULT_DEVICE,
+  SUB_FAULT_INTERNAL,
+  SUB_COUNT,
+  SUB_KEEP = 0xFF          // transition target: stay in the current substate
+};
+
+// Fault reason; the numeric value is the published fault_code.
+enum FaultReason : uint8_t {
+  FAULT_NONE           = 0,
+  FAULT_ESTOP_OPEN     = 1,
+  FAULT_LID_OPEN       = 2,
+  FAULT_DOOR_OPEN      = 3,
+  FAULT_INTERLOCK_OPEN = 10,
+  FAULT_PID_ANOMALY    = 20
+};
+
+static inline const char *millStateStr(MillState s) {
+  switch (s) {
+    case MILL_IDLE:  return "IDLE";
+    case MILL_RUN:   return "RUN";
+    case MILL_HOLD:  return "HOLD";
+    case MILL_FAULT: return "FAULT";
+  }
+  return "IDLE";
+}
+
+static inline const char *faultReasonStr(FaultReason f) {
+  switch (f) {
+    case FAULT_NONE:           return "";
+    case FAULT_ESTOP_OPEN:     return "ESTOP_OPEN";
+    case FAULT_LID_OPEN:       return "LID_OPEN";
+    case FAULT_DOOR_OPEN:      return "DOOR_OPEN";
+    case FAULT_INTERLOCK_OPEN: return "INTERLOCK_OPEN";
+    case FAULT_PID_ANOMALY:    return "PID_ANOMALY";
+  }
+  return "UNKNOWN";
+}
+
+// -------------------------------------------------------------------
+// PID snapshot (one per LC108)
+// -------------------------------------------------------------------
+
+struct PidSnapshot {
+  bool     comm_ok;      // slave health (hysteresis), not just the last poll
+  float    pv_c;         // process variable (°C)
+  float    sv_c;         // setpoint (°C)
+  float    output_pct;   // controller MV1 output (%)
+  uint16_t status_raw;   // raw STATUS register
+  bool     run;
+  bool     man;
+  bool     prg;
+  bool     op1;
+  bool     op2;
+  bool     au1;
+  bool     au2;
+  bool     atu;
+};
+
+// -------------------------------------------------------------------
+// Recipe ETA (Mill_Eta)
+// -------------------------------------------------------------------
+
+struct EtaSnapshot {
+  bool     valid;          // a recipe is in progress
+  uint32_t recipe_s;       // estimated wall-clock seconds to recipe end
+  float    cycle_ratio;    // observed cycle wall time / cycle_target
+  uint32_t last_cycle_s;   // wall time of the last completed cycle
+  uint32_t stall_s;        // HOLD + FAULT time in this recipe
+  float    cool_rate_cpm;  // PV trend (°C/min, < 0 while cooling)
+  int32_t  time_to_sv_s;   // -1 = unknown / not cooling
+  int32_t  ln2_open_s;     // expected LN2 valve-open s remaining, -1 = unknown
+};
+
+// -------------------------------------------------------------------
+// Complete mill snapshot
+// -------------------------------------------------------------------
+
+struct MillSnapshot {
+  uint32_t    seq;                 // commit number (set by the latch)
+  uint32_t    commit_ms;           // millis() at commit
+  int64_t     utc_ms;              // UTC at commit (Mill_TimeSync), 0 = unknown
+
+  MillState   state;
+  MillSubstate substate;
+  MillState   state_before_fault;
+  FaultReason fault;
+
+  uint32_t    cycle_current;       // seconds elapsed in current cycle
+  uint32_t    cycle_target;        // seconds per cycle
+  uint32_t    time_remaining_s;
+  uint32_t    cycle_total;
+  uint32_t    cycle_index;
+
+  bool        estop_ok;
+  bool        lid_locked;
+  bool        door_closed;
+
+  PidSnapshot pid_ln2;
+  EtaSnapshot eta;
+};
+
+// -------------------------------------------------------------------
+// Double-buffered sequence latch (single writer, many readers)
+// -------------------------------------------------------------------
+
+template <typename T>
+class SnapshotLatch {
+ public:
+  SnapshotLatch() : seq_(0) {
+    memset((void *)buf_, 0, sizeof(buf_));
+  }
+
+  // Single writer only. Readers follow seq parity: odd → copy 1, even →
+  // copy 0, so the copy being written is never the one being read.
+  uint32_t commit(const T &v) {
+    uint32_t s = seq_.load(std::memory_order_relaxed);
+
+    seq_.store(s + 1, std::memory_order_release);        // readers → buf_[1]
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy((void *)&buf_[0], &v, sizeof(T));
+
+    seq_.store(s + 2, std::memory_order_release);        // readers → buf_[0]
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy((void *)&buf_[1], &v, sizeof(T));
+
+    return s + 2;
+  }
+
+  // Returns the sequence number of the copy taken.
+  uint32_t read(T &out) const {
+    for (;;) {
+      uint32_t s = seq_.load(std::memory_order_acquire);
+      memcpy(&out, (const void *)&buf_[s & 1], sizeof(T));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == s) {
+        return s;
+      }
+    }
+  }
+
+  uint32_t sequence() const {
+    return seq_.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::atomic<uint32_t> seq_;
+  volatile T            buf_[2];
+};
+
+// The one shared instance (defined in the sketch)
+extern SnapshotLatch<MillSnapshot> millSnapshot;
@@ -0,0 +1,643 @@
+#include "Mill_StateMachine.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static MillLogFn millLog = nullptr;
+
+static void logLine(const char *line) {
+  if (millLog) millLog(line);
+}
+
+// -------------------------------------------------------------------
+// Guards
+// -------------------------------------------------------------------
+
+static bool interlocksOk(const MillContext &ctx) {
+  return ctx.interlocks_ok;
+}
+
+static bool canStart(const MillContext &ctx) {
+  return interlocksOk(ctx) && ctx.cycle_target > 0 && ctx.cycle_total > 0;
+}
+
+// HOLD entered during a cooling phase resumes into it (same test as
+// resumeOrRestart, which otherwise restarts the cycle)
+static bool inCoolPhase(const MillContext &ctx) {
+  return ctx.cool_phase && ctx.cycle_index > 0 && ctx.cycle_current < ctx.cool_target;
+}
+
+// Lid / door opened while the operator had the mill in HOLD: a soft access
+// event, so RESET_FAULT goes back to HOLD instead of dropping the recipe.
+static bool softAccessHold(const MillContext &ctx) {
+  return (ctx.fault == FAULT_LID_OPEN || ctx.fault == FAULT_DOOR_OPEN) &&
+         ctx.state_before_fault == MILL_HOLD &&
+         ctx.cycle_total > 0;
+}
+
+// -------------------------------------------------------------------
+// Actions (run before the state changes; ctx.state is still the source)
+// -------------------------------------------------------------------
+
+static void freshStart(MillContext &ctx) {
+  ctx.cool_phase         = false;
+  ctx.cycle_current      = 0;
+  ctx.time_remaining_s   = ctx.cycle_target;
+  if (ctx.cycle_index == 0) ctx.cycle_index = 1;
+  ctx.last_cycle_tick_ms = ctx.now_ms;
+}
+
+// Continue the interrupted cycle if there is one, otherwise start fresh.
+static void resumeOrRestart(MillContext &ctx) {
+  uint32_t phase = ctx.cool_phase ? ctx.cool_target : ctx.cycle_target;
+  if (ctx.cycle_index > 0 && ctx.cycle_current < phase) {
+    ctx.last_cycle_tick_ms = ctx.now_ms;
+  } else {
+    freshStart(ctx);
+  }
+}
+
+static void startCooling(MillContext &ctx) {
+  ctx.cool_phase       = true;
+  ctx.cycle_current    = 0;
+  ctx.time_remaining_s = ctx.cool_target;
+}
+
+static void nextCycle(MillContext &ctx) {
+  ctx.cool_phase = false;
+  ctx.cycle_index++;
+  ctx.cycle_current    = 0;
+  ctx.time_remaining_s = ctx.cycle_target;
+
+  char line[64];
+  snprintf(line, sizeof(line), "[CYCLE] Starting next cycle %lu / %lu",
+           (unsigned long)ctx.cycle_index, (unsigned long)ctx.cycle_total);
+  logLine(line);
+}
+
+static void enterFault(MillContext &ctx) {
+  // Keep a 1-based index so a later HOLD restore has a cycle to resume
+  if ((ctx.state == MILL_RUN || ctx.state == MILL_HOLD) &&
+      ctx.cycle_total > 0 && ctx.cycle_index == 0) {
+    ctx.cycle_index = 1;
+  }
+}
+
+// Only PID plausibility faults exist so far (Mill_Anomaly)
+static void deviceFault(MillContext &ctx) {
+  ctx.fault = FAULT_PID_ANOMALY;
+  enterFault(ctx);
+}
+
+static void clearFault(MillContext &ctx) {
+  ctx.fault = FAULT_NONE;
+}
+
+// -------------------------------------------------------------------
+// Transition table
+// -------------------------------------------------------------------
+
+struct MillRow {
+  MillState      from;
+  MillEvent      ev;
+  MillTransition t;
+};
+
+#define GUARD(fn)   fn, #fn
+#define ACTION(fn)  fn, #fn
+#define NO_GUARD    nullptr, "-"
+#define NO_ACTION   nullptr, "-"
+#define NO_ALT      nullptr, nullptr, SUB_KEEP
+
+static constexpr MillRow kRows[] = {
+  // IDLE
+  { MILL_IDLE,  EV_START,          { true, GUARD(canStart),     ACTION(freshStart),      SUB_RUN_ACTIVE,      NO_ALT } },
+  { MILL_IDLE,  EV_INTERLOCK_TRIP, { true, NO_GUARD,            ACTION(enterFault),      SUB_FAULT_INTERLOCK, NO_ALT } },
+
+  // RUN
+  { MILL_RUN,   EV_START,          { true, GUARD(canStart),     ACTION(freshStart),      SUB_RUN_ACTIVE,      NO_ALT } },
+  { MILL_RUN,   EV_HOLD,           { true, NO_GUARD,            NO_ACTION,               SUB_HOLD_USER,       NO_ALT } },
+  { MILL_RUN,   EV_STOP,           { true, NO_GUARD,            NO_ACTION,               SUB_IDLE_READY,      NO_ALT } },
+  { MILL_RUN,   EV_INTERLOCK_TRIP, { true, NO_GUARD,            ACTION(enterFault),      SUB_FAULT_INTERLOCK, NO_ALT } },
+  { MILL_RUN,   EV_CYCLE_COOL,     { true, NO_GUARD,            ACTION(startCooling),    SUB_RUN_COOLING,     NO_ALT } },
+  { MILL_RUN,   EV_CYCLE_NEXT,     { true, NO_GUARD,            ACTION(nextCycle),       SUB_RUN_ACTIVE,      NO_ALT } },
+  { MILL_RUN,   EV_RECIPE_DONE,    { true, NO_GUARD,            NO_ACTION,               SUB_IDLE_READY,      NO_ALT } },
+  { MILL_RUN,   EV_DEVICE_FAULT,   { true, NO_GUARD,            ACTION(deviceFault),     SUB_FAULT_DEVICE,    NO_ALT } },
+
+  // HOLD
+  { MILL_HOLD,  EV_START,          { true, GUARD(canStart),     ACTION(resumeOrRestart), SUB_RUN_ACTIVE,
+                                     inCoolPhase, "inCoolPhase", SUB_RUN_COOLING } },
+  { MILL_HOLD,  EV_RESUME,         { true, GUARD(canStart),     ACTION(resumeOrRestart), SUB_RUN_ACTIVE,
+                                     inCoolPhase, "inCoolPhase", SUB_RUN_COOLING } },
+  { MILL_HOLD,  EV_STOP,           { true, NO_GUARD,            NO_ACTION,               SUB_IDLE_READY,      NO_ALT } },
+  { MILL_HOLD,  EV_INTERLOCK_TRIP, { true, NO_GUARD,            ACTION(enterFault),      SUB_FAULT_INTERLOCK, NO_ALT } },
+  { MILL_HOLD,  EV_DEVICE_FAULT,   { true, NO_GUARD,            ACTION(deviceFault),     SUB_FAULT_DEVICE,    NO_ALT } },
+
+  // FAULT (latched; only RESET_FAULT with closed interlocks leaves it)
+  { MILL_FAULT, EV_RESET_FAULT,    { true, GUARD(interlocksOk), ACTION(clearFault),      SUB_IDLE_READY,
+                                     softAccessHold, "softAccessHold", SUB_HOLD_USER } },
+};
+
+#undef GUARD
+#undef ACTION
+#undef NO_GUARD
+#undef NO_ACTION
+#undef NO_ALT
+
+static constexpr size_t kRowCount = sizeof(kRows) / sizeof(kRows[0]);
+
+struct MillTable {
+  MillTransition cell[MILL_STATE_COUNT][EV_COUNT];
+};
+
+static constexpr MillTable buildTable() {
+  MillTable tbl{};
+  for (size_t i = 0; i < kRowCount; ++i) {
+    tbl.cell[kRows[i].from][kRows[i].ev] = kRows[i].t;
+  }
+  return tbl;
+}
+
+static constexpr bool rowsUnique() {
+  for (size_t i = 0; i < kRowCount; ++i) {
+    for (size_t j = i + 1; j < kRowCount; ++j) {
+      if (kRows[i].from == kRows[j].from && kRows[i].ev == kRows[j].ev) return false;
+    }
+  }
+  return true;
+}
+
+static constexpr bool tripsEverywhere() {
+  for (uint8_t s = 0; s < MILL_STATE_COUNT; ++s) {
+    if (s == MILL_FAULT) continue;
+    bool found = false;
+    for (size_t i = 0; i < kRowCount; ++i) {
+      if (kRows[i].from == s && kRows[i].ev == EV_INTERLOCK_TRIP &&
+          kRows[i].t.guard == nullptr) {
+        found = true;
+      }
+    }
+    if (!found) return false;
+  }
+  return true;
+}
+
+static_assert(rowsUnique(), "duplicate (state, event) row in mill transition table");
+static_assert(tripsEverywhere(), "every non-FAULT state needs an unguarded EV_INTERLOCK_TRIP row");
+
+static constexpr MillTable kTable = buildTable();
+
+// -------------------------------------------------------------------
+// Names
+// -------------------------------------------------------------------
+
+MillState millStateOf(MillSubstate sub) {
+  switch (sub) {
+    case SUB_IDLE_READY:      return MILL_IDLE;
+    case SUB_RUN_ACTIVE:
+    case SUB_RUN_COOLING:     return MILL_RUN;
+    case SUB_HOLD_USER:
+    case SUB_HOLD_INTERLOCK:  return MILL_HOLD;
+    case SUB_FAULT_INTERLOCK:
+    case SUB_FAULT_DEVICE:
+    case SUB_FAULT_INTERNAL:  return MILL_FAULT;
+    default:                  return MILL_IDLE;
+  }
+}
+
+const char *millSubstateStr(MillSubstate sub) {
+  switch (sub) {
+    case SUB_IDLE_READY:      return "IDLE_READY";
+    case SUB_RUN_ACTIVE:      return "RUN_ACTIVE";
+    case SUB_RUN_COOLING:     return "RUN_COOLING";
+    case SUB_HOLD_USER:       return "HOLD_USER";
+    case SUB_HOLD_INTERLOCK:  return "HOLD_INTERLOCK";
+    case SUB_FAULT_INTERLOCK: return "FAULT_INTERLOCK";
+    case SUB_FAULT_DEVICE:    return "FAULT_DEVICE";
+    case SUB_FAULT_INTERNAL:  return "FAULT_INTERNAL";
+    default:                  return "KEEP";
+  }
+}
+
+const char *millEventStr(MillEvent ev) {
+  switch (ev) {
+    case EV_START:          return "START";
+    case EV_STOP:           return "STOP";
+    case EV_HOLD:           return "HOLD";
+    case EV_RESUME:         return "RESUME";
+    case EV_RESET_FAULT:    return "RESET_FAULT";
+    case EV_INTERLOCK_TRIP: return "INTERLOCK_TRIP";
+    case EV_CYCLE_NEXT:     return "CYCLE_NEXT";
+    case EV_CYCLE_COOL:     return "CYCLE_COOL";
+    case EV_RECIPE_DONE:    return "RECIPE_DONE";
+    case EV_DEVICE_FAULT:   return "DEVICE_FAULT";
+    default:                return "?";
+  }
+}
+
+// Only operator commands; timer / interlock events are internal.
+bool millEventFromCommand(const char *cmd, MillEvent &out) {
+  if (cmd == nullptr) return false;
+  switch (cmd[0]) {
+    case 'S':
+      if (strcmp(cmd, "START") == 0) { out = EV_START; return true; }
+      if (strcmp(cmd, "STOP") == 0)  { out = EV_STOP;  return true; }
+      return false;
+    case 'H':
+      if (strcmp(cmd, "HOLD") == 0) { out = EV_HOLD; return true; }
+      return false;
+    case 'R':
+      if (strcmp(cmd, "RESUME") == 0)      { out = EV_RESUME;      return true; }
+      if (strcmp(cmd, "RESET_FAULT") == 0) { out = EV_RESET_FAULT; return true; }
+      return false;
+    default:
+      return false;
+  }
+}
+
+// -------------------------------------------------------------------
+// Public API
+// -------------------------------------------------------------------
+
+void millSetLog(MillLogFn fn) {
+  millLog = fn;
+}
+
+void millInit(MillContext &ctx, uint32_t now_ms) {
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.state              = MILL_IDLE;
+  ctx.substate           = SUB_IDLE_READY;
+  ctx.state_before_fault = MILL_IDLE;
+  ctx.fault              = FAULT_NONE;
+  ctx.now_ms             = now_ms;
+  ctx.last_cycle_tick_ms = now_ms;
+}
+
+bool millInterlocksOk(const MillContext &ctx) {
+  return interlocksOk(ctx);
+}
+
+FaultReason millInterlockFault(const MillContext &ctx) {
+  if (!ctx.estop_ok)    return FAULT_ESTOP_OPEN;
+  if (!ctx.lid_locked)  return FAULT_LID_OPEN;
+  if (!ctx.door_closed) return FAULT_DOOR_OPEN;
+  if (!ctx.interlocks_ok) return FAULT_INTERLOCK_OPEN;   // overtemp / aux
+  return FAULT_NONE;
+}
+
+const MillTransition &millTransition(MillState s, MillEvent ev) {
+  return kTable.cell[s][ev];
+}
+
+// Entry actions, run only when the coarse state changes
+static void enterState(MillContext &ctx, MillState from) {
+  switch (ctx.state) {
+    case MILL_IDLE:
+      ctx.cycle_index      = 0;
+      ctx.cool_phase       = false;
+      ctx.cycle_current    = 0;
+      ctx.time_remaining_s = 0;
+      break;
+    case MILL_FAULT:
+      ctx.state_before_fault = from;
+      break;
+    default:
+      break;
+  }
+}
+
+MillDispatchResult millDispatch(MillContext &ctx, MillEvent ev, uint32_t now_ms) {
+  if (ctx.state >= MILL_STATE_COUNT || ev >= EV_COUNT) {
+    return MILL_DISPATCH_IGNORED;
+  }
+
+  const MillTransition &t = kTable.cell[ctx.state][ev];
+  if (!t.defined) {
+    return MILL_DISPATCH_IGNORED;
+  }
+
+  ctx.now_ms = now_ms;
+  if (t.guard && !t.guard(ctx)) {
+    char line[96];
+    snprintf(line, sizeof(line), "[FSM] %s/%s --%s--> blocked by %s",
+             millStateStr(ctx.state), millSubstateStr(ctx.substate),
+             millEventStr(ev), t.guard_name);
+    logLine(line);
+    return MILL_DISPATCH_BLOCKED;
+  }
+
+  // Choice is decided on the pre-action context (the action may clear
+  // the very field the choice looks at).
+  MillSubstate target = (t.alt_when && t.alt_when(ctx)) ? t.alt_next : t.next;
+
+  MillState    fromState = ctx.state;
+  MillSubstate fromSub   = ctx.substate;
+
+  if (t.action) t.action(ctx);
+
+  if (target != SUB_KEEP) {
+    ctx.substate = target;
+    ctx.state    = millStateOf(target);
+    if (ctx.state != fromState) {
+      enterState(ctx, fromState);
+    }
+  }
+
+  if (ctx.substate != fromSub) {
+    char line[96];
+    snprintf(line, sizeof(line), "[FSM] %s/%s --%s--> %s/%s",
+             millStateStr(fromState), millSubstateStr(fromSub),
+             millEventStr(ev),
+             millStateStr(ctx.state), millSubstateStr(ctx.substate));
+    logLine(line);
+  }
+  return MILL_DISPATCH_DONE;
+}
+
+void millCycleTick(MillContext &ctx, uint32_t now_ms) {
+  if (ctx.state != MILL_RUN || ctx.cycle_target == 0 ||
+      ctx.cycle_total == 0 || ctx.cycle_index == 0) {
+    ctx.last_cycle_tick_ms = now_ms;
+    return;
+  }
+
+  uint32_t dt = now_ms - ctx.last_cycle_tick_ms;
+  if (dt < 1000) {
+    return;
+  }
+
+  uint32_t inc = dt / 1000;
+  ctx.last_cycle_tick_ms += inc * 1000;
+  ctx.cycle_current      += inc;
+
+  uint32_t phase = ctx.cool_phase ? ctx.cool_target : ctx.cycle_target;
+  if (ctx.cycle_current < phase) {
+    ctx.time_remaining_s = phase - ctx.cycle_current;
+    return;
+  }
+
+  ctx.cycle_current    = phase;
+  ctx.time_remaining_s = 0;
+  MillEvent ev = EV_RECIPE_DONE;
+  if (ctx.cycle_index < ctx.cycle_total) {
+    ev = (!ctx.cool_phase && ctx.cool_target > 0) ? EV_CYCLE_COOL : EV_CYCLE_NEXT;
+  }
+  millDispatch(ctx, ev, now_ms);
+}
+
+// -------------------------------------------------------------------
+// Table dumps (Graphviz / JSON)
+// -------------------------------------------------------------------
+
+void millFsmDumpDot(MillEmitFn emit) {
+  char line[192];
+
+  emit("digraph mill_fsm {\n  rankdir=LR;\n  node [shape=box, style=rounded];\n");
+  for (uint8_t s = 0; s < MILL_STATE_COUNT; ++s) {
+    for (uint8_t e = 0; e < EV_COUNT; ++e) {
+      const MillTransition &t = kTable.cell[s][e];
+      if (!t.defined) continue;
+
+      MillState    from = (MillState)s;
+      MillSubstate next = t.next;
+      const char  *to   = (next == SUB_KEEP) ? millStateStr(from)
+                                             : millStateStr(millStateOf(next));
+      snprintf(line, sizeof(line),
+               "  %s -> %s [label=\"%s [%s] / %s\\n→ %s\"];\n",
+               millStateStr(from), to, millEventStr((MillEvent)e),
+               t.guard_name, t.action_name, millSubstateStr(next));
+      emit(line);
+
+      if (t.alt_when) {
+        snprintf(line, sizeof(line),
+                 "  %s -> %s [style=dashed, label=\"%s [%s]\\n→ %s\"];\n",
+                 millStateStr(from), millStateStr(millStateOf(t.alt_next)),
+                 millEventStr((MillEvent)e), t.alt_name,
+                 millSubstateStr(t.alt_next));
+        emit(line);
+      }
+    }
+  }
+  emit("}\n");
+}
+
+void millFsmDumpJson(MillEmitFn emit) {
+  char line[256];
+  bool first = true;
+
+  emit("[\n");
+  for (uint8_t s = 0; s < MILL_STATE_COUNT; ++s) {
+    for (uint8_t e = 0; e < EV_COUNT; ++e) {
+      const MillTransition &t = kTable.cell[s][e];
+      if (!t.defined) continue;
+
+      snprintf(line, sizeof(line),
+               "%s  {\"from\":\"%s\",\"event\":\"%s\",\"guard\":\"%s\","
+               "\"action\":\"%s\",\"next\":\"%s\"",
+               first ? "" : ",\n",
+               millStateStr((MillState)s), millEventStr((MillEvent)e),
+               t.guard_name, t.action_name, millSubstateStr(t.next));
+      emit(line);
+      if (t.alt_when) {
+        snprintf(line, sizeof(line), ",\"alt_when\":\"%s\",\"alt_next\":\"%s\"",
+                 t.alt_name, millSubstateStr(t.alt_next));
+        emit(line);
+      }
+      emit("}");
+      first = false;
+    }
+  }
+  emit("\n]\n");
+}
+
+#ifdef MILL_FSM_DUMP_MAIN
+static void emitStdout(const char *text) {
+  fputs(text, stdout);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "json") == 0) {
+    millFsmDumpJson(emitStdout);
+  } else {
+    millFsmDumpDot(emitStdout);
+  }
+  return 0;
+}
+#endif
+
+// -------------------------------------------------------------------
+// Host test: every (state, event) pair against an expectation written
+// out independently of kRows, plus the multi-step paths through FAULT
+// -------------------------------------------------------------------
+#ifdef MILL_FSM_TEST_MAIN
+static int testFailures = 0;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    printf("  FAIL %s\n", what);
+    testFailures++;
+  }
+}
+
+static const MillSubstate IGN = SUB_KEEP;   // expected: no row, ignored
+
+// With guards satisfied (interlocks closed, cycle config set); the FAULT
+// context is an ESTOP fault raised in IDLE
+static const MillSubstate kExpect[MILL_STATE_COUNT][EV_COUNT] = {
+  //            START           STOP            HOLD           RESUME          RESET_FAULT     INTERLOCK_TRIP       CYCLE_NEXT      CYCLE_COOL       RECIPE_DONE     DEVICE_FAULT
+  /* IDLE  */ { SUB_RUN_ACTIVE, IGN,            IGN,           IGN,            IGN,            SUB_FAULT_INTERLOCK, IGN,            IGN,             IGN,            IGN              },
+  /* RUN   */ { SUB_RUN_ACTIVE, SUB_IDLE_READY, SUB_HOLD_USER, IGN,            IGN,            SUB_FAULT_INTERLOCK, SUB_RUN_ACTIVE, SUB_RUN_COOLING, SUB_IDLE_READY, SUB_FAULT_DEVICE },
+  /* HOLD  */ { SUB_RUN_ACTIVE, SUB_IDLE_READY, IGN,           SUB_RUN_ACTIVE, IGN,            SUB_FAULT_INTERLOCK, IGN,            IGN,             IGN,            SUB_FAULT_DEVICE },
+  /* FAULT */ { IGN,            IGN,            IGN,           IGN,            SUB_IDLE_READY, IGN,                 IGN,            IGN,             IGN,            IGN              },
+};
+
+// Rows with a guard: with interlocks open and no cycle config they are
+// BLOCKED instead
+static bool guarded(MillState s, MillEvent ev) {
+  switch (s) {
+    case MILL_IDLE:
+    case MILL_RUN:   return ev == EV_START;
+    case MILL_HOLD:  return ev == EV_START || ev == EV_RESUME;
+    case MILL_FAULT: return ev == EV_RESET_FAULT;
+  }
+  return false;
+}
+
+static const MillSubstate kPrimary[MILL_STATE_COUNT] = {
+  SUB_IDLE_READY, SUB_RUN_ACTIVE, SUB_HOLD_USER, SUB_FAULT_INTERLOCK
+};
+
+static void setInterlocks(MillContext &ctx, bool estop, bool lid, bool door) {
+  ctx.estop_ok      = estop;
+  ctx.lid_locked    = lid;
+  ctx.door_closed   = door;
+  ctx.interlocks_ok = estop && lid && door;
+}
+
+static MillContext contextIn(MillState s, bool ready) {
+  MillContext ctx;
+  millInit(ctx, 0);
+  ctx.state        = s;
+  ctx.substate     = kPrimary[s];
+  ctx.cycle_target = ready ? 60 : 0;
+  ctx.cycle_total  = ready ? 3 : 0;
+  ctx.cycle_index  = (s == MILL_RUN || s == MILL_HOLD) ? 1 : 0;
+  setInterlocks(ctx, ready, ready, ready);
+  if (s == MILL_FAULT) ctx.fault = FAULT_ESTOP_OPEN;
+  return ctx;
+}
+
+static void pairs(bool ready) {
+  char what[96];
+  for (uint8_t s = 0; s < MILL_STATE_COUNT; ++s) {
+    for (uint8_t e = 0; e < EV_COUNT; ++e) {
+      MillContext ctx    = contextIn((MillState)s, ready);
+      MillContext before = ctx;
+      MillDispatchResult r = millDispatch(ctx, (MillEvent)e, 0);
+
+      MillSubstate want = kExpect[s][e];
+      MillDispatchResult wantR = (want == IGN) ? MILL_DISPATCH_IGNORED
+                               : (!ready && guarded((MillState)s, (MillEvent)e)) ? MILL_DISPATCH_BLOCKED
+                               : MILL_DISPATCH_DONE;
+      snprintf(what, sizeof(what), "%s x %s (%s): result %u, want %u", millStateStr((MillState)s),
+               millEventStr((MillEvent)e), ready ? "ready" : "not ready", (unsigned)r, (unsigned)wantR);
+      expect(r == wantR, what);
+      if (wantR == MILL_DISPATCH_DONE) {
+        snprintf(what, sizeof(what), "%s x %s: to %s, want %s", millStateStr((MillState)s),
+                 millEventStr((MillEvent)e), millSubstateStr(ctx.substate), millSubstateStr(want));
+        expect(ctx.substate == want && ctx.state == millStateOf(want), what);
+      } else {
+        snprintf(what, sizeof(what), "%s x %s: context changed though not taken",
+                 millStateStr((MillState)s), millEventStr((MillEvent)e));
+        expect(memcmp(&ctx, &before, sizeof(ctx)) == 0, what);
+      }
+    }
+  }
+}
+
+// As the sketch does it: classify, then trip
+static MillDispatchResult trip(MillContext &ctx, bool estop, bool lid, bool door, uint32_t now) {
+  setInterlocks(ctx, estop, lid, door);
+  ctx.fault = millInterlockFault(ctx);
+  return millDispatch(ctx, EV_INTERLOCK_TRIP, now);
+}
+
+static MillContext runningMill(uint32_t cool_s) {
+  MillContext ctx;
+  millInit(ctx, 0);
+  ctx.cycle_target = 60;
+  ctx.cool_target  = cool_s;
+  ctx.cycle_total  = 2;
+  setInterlocks(ctx, true, true, true);
+  millDispatch(ctx, EV_START, 0);
+  return ctx;
+}
+
+static void paths() {
+  // Lid opened while held: RESET_FAULT restores HOLD with the cycle kept
+  MillContext ctx = runningMill(0);
+  millCycleTick(ctx, 10000);
+  millDispatch(ctx, EV_HOLD, 10000);
+  expect(trip(ctx, true, false, true, 11000) == MILL_DISPATCH_DONE &&
+         ctx.substate == SUB_FAULT_INTERLOCK && ctx.fault == FAULT_LID_OPEN, "HOLD + lid open -> FAULT_INTERLOCK (LID)");
+  expect(millDispatch(ctx, EV_START, 12000) == MILL_DISPATCH_IGNORED && ctx.state == MILL_FAULT, "START ignored in FAULT");
+  expect(millDispatch(ctx, EV_RESET_FAULT, 12000) == MILL_DISPATCH_BLOCKED, "RESET_FAULT blocked while the lid is open");
+  setInterlocks(ctx, true, true, true);
+  expect(millDispatch(ctx, EV_RESET_FAULT, 13000) == MILL_DISPATCH_DONE && ctx.substate == SUB_HOLD_USER &&
+         ctx.fault == FAULT_NONE, "lid closed, RESET_FAULT -> HOLD_USER");
+  expect(ctx.cycle_index == 1 && ctx.cycle_current == 10, "HOLD restore keeps cycle 1 at 10 s");
+  expect(millDispatch(ctx, EV_RESUME, 14000) == MILL_DISPATCH_DONE && ctx.substate == SUB_RUN_ACTIVE &&
+         ctx.cycle_current == 10, "RESUME continues the cycle at 10 s");
+
+  // Same for the door
+  ctx = runningMill(0);
+  millDispatch(ctx, EV_HOLD, 0);
+  trip(ctx, true, true, false, 1000);
+  setInterlocks(ctx, true, true, true);
+  expect(millDispatch(ctx, EV_RESET_FAULT, 2000) == MILL_DISPATCH_DONE && ctx.substate == SUB_HOLD_USER,
+         "HOLD + door open, RESET_FAULT -> HOLD_USER");
+
+  // Not soft: lid opened while running, ESTOP while held
+  ctx = runningMill(0);
+  trip(ctx, true, false, true, 1000);
+  setInterlocks(ctx, true, true, true);
+  expect(millDispatch(ctx, EV_RESET_FAULT, 2000) == MILL_DISPATCH_DONE && ctx.substate == SUB_IDLE_READY &&
+         ctx.cycle_index == 0, "RUN + lid open, RESET_FAULT -> IDLE_READY");
+  ctx = runningMill(0);
+  millDispatch(ctx, EV_HOLD, 0);
+  trip(ctx, false, true, true, 1000);
+  expect(ctx.fault == FAULT_ESTOP_OPEN, "ESTOP classified first");
+  setInterlocks(ctx, true, true, true);
+  expect(millDispatch(ctx, EV_RESET_FAULT, 2000) == MILL_DISPATCH_DONE && ctx.substate == SUB_IDLE_READY,
+         "HOLD + ESTOP, RESET_FAULT -> IDLE_READY");
+
+  // Device fault while held is not a soft access fault either
+  ctx = runningMill(0);
+  millDispatch(ctx, EV_HOLD, 0);
+  millDispatch(ctx, EV_DEVICE_FAULT, 1000);
+  expect(ctx.substate == SUB_FAULT_DEVICE && ctx.fault == FAULT_PID_ANOMALY, "HOLD + device fault -> FAULT_DEVICE");
+  expect(millDispatch(ctx, EV_RESET_FAULT, 2000) == MILL_DISPATCH_DONE && ctx.substate == SUB_IDLE_READY,
+         "FAULT_DEVICE, RESET_FAULT -> IDLE_READY");
+
+  // Timer path with cooling, and HOLD during cooling resumes cooling
+  ctx = runningMill(20);
+  millCycleTick(ctx, 60000);
+  expect(ctx.substate == SUB_RUN_COOLING && ctx.cycle_index == 1, "run time over -> RUN_COOLING");
+  millDispatch(ctx, EV_HOLD, 65000);
+  expect(millDispatch(ctx, EV_RESUME, 70000) == MILL_DISPATCH_DONE && ctx.substate == SUB_RUN_COOLING,
+         "HOLD while cooling, RESUME -> RUN_COOLING");
+  millCycleTick(ctx, 70000 + 20000);
+  expect(ctx.substate == SUB_RUN_ACTIVE && ctx.cycle_index == 2, "cool time over -> cycle 2");
+  millCycleTick(ctx, 90000 + 60000);
+  expect(ctx.substate == SUB_IDLE_READY && ctx.cycle_index == 0, "last cycle over -> IDLE_READY");
+}
+
+int main() {
+  pairs(true);
+  pairs(false);
+  paths();
+  printf("%u states x %u events, twice (guards open / closed), + FAULT paths: %s (%d failures)\n",
+         (unsigned)MILL_STATE_COUNT, (unsigned)EV_COUNT, testFailures ? "FAIL" : "OK", testFailures);
+  return testFailures ? 1 : 0;
+}
+#endif
@@ -0,0 +1,121 @@
+#pragma once
+
+/*
+ * Mill_StateMachine.h
+ *
+ * IDLE / RUN / HOLD / FAULT machine with substates, driven by a
+ * compile-time transition table indexed [state][event]:
+ *
+ *   (state, event) → (guard, action, next [, alt_when → alt_next])
+ *
+ * Dispatch is one array lookup. `alt_when` is a choice pseudo-state used
+ * where one event has two legal targets (RESET_FAULT restoring HOLD after
+ * a soft access fault). Entering a coarse state runs its entry action
+ * (IDLE clears cycle timing; FAULT remembers the state it came from).
+ *
+ * The module is plain C++ on a MillContext (no Arduino headers), so the
+ * same table can be built on a host and dumped as Graphviz / JSON with
+ * millFsmDumpDot() / millFsmDumpJson(), e.g.
+ *
+ *   g++ -std=c++17 -DMILL_FSM_DUMP_MAIN Mill_StateMachine.cpp -o fsm_dump
+ *   ./fsm_dump dot | dot -Tsvg > mill_fsm.svg
+ *
+ * Host test: every state x event pair with guards met and not met, the
+ * soft-access HOLD restore and the other FAULT / cooling paths; exits
+ * non-zero on a mismatch:
+ *
+ *   g++ -std=c++17 -DMILL_FSM_TEST_MAIN Mill_StateMachine.cpp -o fsm_test && ./fsm_test
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Mill_Snapshot.h"
+
+enum MillEvent : uint8_t {
+  EV_START = 0,
+  EV_STOP,
+  EV_HOLD,
+  EV_RESUME,
+  EV_RESET_FAULT,
+  EV_INTERLOCK_TRIP,       // an interlock input is open
+  EV_CYCLE_NEXT,           // timer: cycle finished, more to go
+  EV_CYCLE_COOL,           // timer: run phase over, cool before the next cycle
+  EV_RECIPE_DONE,          // timer: last cycle finished
+  EV_DEVICE_FAULT,         // a field device failed a plausibility check
+  EV_COUNT
+};
+
+// Working state owned by the control loop
+struct MillContext {
+  MillState    state;
+  MillSubstate substate;
+  MillState    state_before_fault;   // for the soft-fault HOLD restore
+  FaultReason  fault;
+
+  uint32_t     cycle_current;        // seconds elapsed in the current phase
+  uint32_t     cycle_target;         // seconds of run (motor on) per cycle
+  uint32_t     cool_target;          // seconds of RUN_COOLING between cycles, 0 = none
+  bool         cool_phase;           // current cycle is in its cooling phase (kept over HOLD)
+  uint32_t     time_remaining_s;     // in the current phase
+  uint32_t     cycle_total;          // requested cycles in recipe
+  uint32_t     cycle_index;          // 0 when idle, 1..cycle_total when running
+
+  bool         interlocks_ok;        // every mapped interlock signal OK
+  bool         estop_ok;             // named signals, for fault reasons / UI
+  bool         lid_locked;
+  bool         door_closed;
+
+  uint32_t     last_cycle_tick_ms;
+  uint32_t     now_ms;               // set by millDispatch / millCycleTick
+};
+
+typedef bool (*MillGuard)(const MillContext &ctx);
+typedef void (*MillAction)(MillContext &ctx);
+
+struct MillTransition {
+  bool         defined;
+  MillGuard    guard;        // nullptr = always allowed
+  const char  *guard_name;
+  MillAction   action;       // nullptr = none
+  const char  *action_name;
+  MillSubstate next;
+  MillGuard    alt_when;     // optional choice: if true → alt_next
+  const char  *alt_name;
+  MillSubstate alt_next;
+};
+
+enum MillDispatchResult : uint8_t {
+  MILL_DISPATCH_IGNORED = 0,   // no row for (state, event)
+  MILL_DISPATCH_BLOCKED,       // row exists, guard said no
+  MILL_DISPATCH_DONE
+};
+
+typedef void (*MillLogFn)(const char *line);
+typedef void (*MillEmitFn)(const char *text);
+
+void millInit(MillContext &ctx, uint32_t now_ms);
+void millSetLog(MillLogFn fn);
+
+MillDispatchResult millDispatch(MillContext &ctx, MillEvent ev, uint32_t now_ms);
+
+// Advance RUN timing; dispatches EV_CYCLE_COOL / EV_CYCLE_NEXT /
+// EV_RECIPE_DONE. A cycle is cycle_target s of RUN_ACTIVE followed, if
+// another cycle comes and cool_target > 0, by cool_target s of
+// RUN_COOLING (motor off, LN2 stays on).
+void millCycleTick(MillContext &ctx, uint32_t now_ms);
+
+// Classify open interlocks into a FaultReason (FAULT_NONE if all OK).
+FaultReason millInterlockFault(const MillContext &ctx);
+bool millInterlocksOk(const MillContext &ctx);
+
+const MillTransition &millTransition(MillState s, MillEvent ev);
+MillState    millStateOf(MillSubstate sub);
+const char  *millSubstateStr(MillSubstate sub);
+const char  *millEventStr(MillEvent ev);
+
+// Command name ("START", "RESET_FAULT", …) → event; false if unknown.
+bool millEventFromCommand(const char *cmd, MillEvent &out);
+
+void millFsmDumpDot(MillEmitFn emit);
+void millFsmDumpJson(MillEmitFn emit);
@@ -0,0 +1,165 @@
+#include "Mill_StatusJson.h"
+
+#include "Mill_Retain.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// -------------------------------------------------------------------
+// Appender
+// -------------------------------------------------------------------
+
+void json_put(JsonOut &o, const char *fmt, ...) {
+  if (o.overflow) return;
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(o.buf + o.len, o.cap - o.len, fmt, ap);
+  va_end(ap);
+  if (n < 0 || (size_t)n >= o.cap - o.len) {
+    o.overflow = true;
+    return;
+  }
+  o.len += (size_t)n;
+}
+
+static const char *tf(bool b) {
+  return b ? "true" : "false";
+}
+
+// -------------------------------------------------------------------
+// Status
+// -------------------------------------------------------------------
+
+size_t mill_status_json(const MillSnapshot &snap, char *buf, size_t cap) {
+  if (!buf || cap == 0) return 0;
+  JsonOut o = { buf, cap, 0, false };
+
+  // ts (Unix s, per protocol) + ms resolution; 0 until time is known
+  json_put(o, "{\"ts\":%lld,\"ts_ms\":%lld,",
+      (long long)(snap.utc_ms / 1000), (long long)snap.utc_ms);
+
+  json_put(o, "\"state\":\"%s\",\"substate\":\"%s\",",
+      millStateStr(snap.state), millSubstateStr(snap.substate));
+
+  json_put(o, "\"cycle_current\":%lu,\"cycle_target\":%lu,\"time_remaining_s\":%lu,"
+              "\"cycle_total\":%lu,\"cycle_index\":%lu,",
+      (unsigned long)snap.cycle_current, (unsigned long)snap.cycle_target,
+      (unsigned long)snap.time_remaining_s, (unsigned long)snap.cycle_total,
+      (unsigned long)snap.cycle_index);
+
+  json_put(o, "\"fault_code\":%u,\"fault_reason\":\"%s\",",
+      (unsigned)snap.fault, faultReasonStr(snap.fault));
+
+  // legacy pid block (for existing UI) – LN2 PV only
+  const PidSnapshot &p = snap.pid_ln2;
+  json_put(o, "\"pid\":{\"pv_c\":%.1f},", (double)p.pv_c);
+
+  json_put(o, "\"pid_ln2\":{\"pv_c\":%.1f,\"sv_c\":%.1f,\"output_pct\":%.1f,"
+              "\"comm_ok\":%s,\"status_raw\":%u,",
+      (double)p.pv_c, (double)p.sv_c, (double)p.output_pct,
+      tf(p.comm_ok), (unsigned)p.status_raw);
+  json_put(o, "\"run\":%s,\"man\":%s,\"prg\":%s,\"op1\":%s,\"op2\":%s,"
+              "\"au1\":%s,\"au2\":%s,\"atu\":%s},",
+      tf(p.run), tf(p.man), tf(p.prg), tf(p.op1), tf(p.op2),
+      tf(p.au1), tf(p.au2), tf(p.atu));
+
+  json_put(o, "\"interlocks\":{\"door_closed\":%s,\"estop_ok\":%s,\"lid_locked\":%s},",
+      tf(snap.door_closed), tf(snap.estop_ok), tf(snap.lid_locked));
+
+  // recipe ETA
+  const EtaSnapshot &e = snap.eta;
+  json_put(o, "\"eta\":{\"valid\":%s,\"recipe_s\":%lu,\"cycle_ratio\":%.2f,"
+              "\"last_cycle_s\":%lu,\"stall_s\":%lu,\"cool_rate_cpm\":%.2f,"
+              "\"time_to_sv_s\":%ld,\"ln2_open_s\":%ld}",
+      tf(e.valid), (unsigned long)e.recipe_s, (double)e.cycle_ratio,
+      (unsigned long)e.last_cycle_s, (unsigned long)e.stall_s, (double)e.cool_rate_cpm,
+      (long)e.time_to_sv_s, (long)e.ln2_open_s);
+
+  json_put(o, "}");
+  return o.overflow ? 0 : o.len;
+}
+
+// -------------------------------------------------------------------
+// Retained last state
+// -------------------------------------------------------------------
+
+size_t mill_last_json(const MillSnapshot &snap, char *buf, size_t cap) {
+  if (!buf || cap == 0) return 0;
+  JsonOut o = { buf, cap, 0, false };
+  json_put(o, "{\"ts_ms\":%lld,\"state\":\"%s\",\"substate\":\"%s\",\"fault_code\":%u,",
+      (long long)snap.utc_ms, millStateStr(snap.state), millSubstateStr(snap.substate),
+      (unsigned)snap.fault);
+  json_put(o, "\"cycle_index\":%lu,\"cycle_total\":%lu,\"cycle_target\":%lu,\"time_remaining_s\":%lu,",
+      (unsigned long)snap.cycle_index, (unsigned long)snap.cycle_total,
+      (unsigned long)snap.cycle_target, (unsigned long)snap.time_remaining_s);
+  json_put(o, "\"pv_c\":%.1f,\"sv_c\":%.1f,\"comm_ok\":%s,",
+      (double)snap.pid_ln2.pv_c, (double)snap.pid_ln2.sv_c, tf(snap.pid_ln2.comm_ok));
+  json_put(o, "\"door_closed\":%s,\"estop_ok\":%s,\"lid_locked\":%s}",
+      tf(snap.door_closed), tf(snap.estop_ok), tf(snap.lid_locked));
+  return o.overflow ? 0 : o.len;
+}
+
+uint32_t mill_last_key(const MillSnapshot &snap) {
+  uint32_t k[4] = {
+    (uint32_t)snap.state | ((uint32_t)snap.substate << 8) | ((uint32_t)snap.fault << 16) |
+      ((uint32_t)snap.pid_ln2.comm_ok << 24) | ((uint32_t)snap.door_closed << 25) |
+      ((uint32_t)snap.estop_ok << 26) | ((uint32_t)snap.lid_locked << 27),
+    snap.cycle_index,
+    snap.cycle_total,
+    snap.cycle_target
+  };
+  return retain_hash(k, sizeof(k));
+}
+
+// -------------------------------------------------------------------
+// Command ack
+// -------------------------------------------------------------------
+
+const char *millAckResultStr(MillAckResult r) {
+  switch (r) {
+    case MILL_ACK_DONE:      return "DONE";
+    case MILL_ACK_IGNORED:   return "IGNORED";
+    case MILL_ACK_BLOCKED:   return "BLOCKED";
+    case MILL_ACK_REJECTED:  return "REJECTED";
+    case MILL_ACK_DUPLICATE: return "DUPLICATE";
+    case MILL_ACK_STALE:     return "STALE";
+  }
+  return "REJECTED";
+}
+
+MillAckResult millAckFromDispatch(MillDispatchResult r) {
+  switch (r) {
+    case MILL_DISPATCH_DONE:    return MILL_ACK_DONE;
+    case MILL_DISPATCH_BLOCKED: return MILL_ACK_BLOCKED;
+    case MILL_DISPATCH_IGNORED: return MILL_ACK_IGNORED;
+  }
+  return MILL_ACK_REJECTED;
+}
+
+// Strings off the wire: keep them printable and short
+static void sanitize(const char *in, char *out, size_t cap) {
+  size_t n = 0;
+  for (const char *c = in ? in : ""; *c && n + 1 < cap; ++c) {
+    out[n++] = (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) ? '?' : *c;
+  }
+  out[n] = '\0';
+}
+
+size_t mill_ack_json(const char *id, uint32_t seq, const char *cmd, MillAckResult result,
+                     MillState state, MillSubstate substate, char *buf, size_t cap,
+                     const char *detail) {
+  if (!buf || cap == 0) return 0;
+  JsonOut o = { buf, cap, 0, false };
+  char safe[24];
+  sanitize(cmd, safe, sizeof(safe));
+  json_put(o, "{\"id\":\"%s\",\"seq\":%lu,\"cmd\":\"%s\",\"result\":\"%s\",\"state\":\"%s\",\"substate\":\"%s\"",
+      id ? id : "", (unsigned long)seq, safe, millAckResultStr(result),
+      millStateStr(state), millSubstateStr(substate));
+  if (detail && *detail) {
+    char why[48];
+    sanitize(detail, why, sizeof(why));
+    json_put(o, ",\"detail\":\"%s\"", why);
+  }
+  json_put(o, "}");
+  return o.overflow ? 0 : o.len;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ * Mill_StatusJson.h
+ *
+ * mill/<id>/status/state, the retained last-state snapshot and
+ * command-ack payloads (protocol.md §3.3, §5) written straight into a
+ * caller buffer: no heap, one pass, same bytes on the MCU and on a host.
+ *
+ * The Pi-side fleet load generator (pi_ingest/mill_fleet.cpp) builds
+ * this file together with Mill_StateMachine.cpp, so a virtual mill
+ * publishes exactly what a real one does.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Mill_Snapshot.h"
+#include "Mill_StateMachine.h"
+
+static const size_t MILL_STATUS_JSON_MAX = 768;   // worst case is ~700 B
+static const size_t MILL_ACK_JSON_MAX    = 224;
+static const size_t MILL_LAST_JSON_MAX   = 320;
+
+// printf-style appender into a fixed buffer; after the first overflow
+// every further json_put() is a no-op. Also used for the sketch's diag.
+struct JsonOut {
+  char  *buf;
+  size_t cap;
+  size_t len;
+  bool   overflow;
+};
+
+void json_put(JsonOut &o, const char *fmt, ...);
+
+// Length written (without NUL), 0 if `cap` was too small.
+size_t mill_status_json(const MillSnapshot &snap, char *buf, size_t cap);
+
+// Compact retained snapshot (mill/<id>/status/last): what an HMI needs
+// to draw the mill before the first full frame arrives.
+size_t mill_last_json(const MillSnapshot &snap, char *buf, size_t cap);
+
+// Hash of the fields whose change should refresh the retained snapshot
+// at once (state, fault, cycle position, comm / interlocks), not PV or
+// countdowns.
+uint32_t mill_last_key(const MillSnapshot &snap);
+
+// Outcome of one command, echoed on the ack topic
+enum MillAckResult : uint8_t {
+  MILL_ACK_DONE = 0,       // transition taken / setting applied
+  MILL_ACK_IGNORED,        // no transition for this state
+  MILL_ACK_BLOCKED,        // guard refused (interlocks, no cycle config)
+  MILL_ACK_REJECTED,       // unknown command
+  MILL_ACK_DUPLICATE,      // seq already handled (QoS 1 redelivery / resend), not run again
+  MILL_ACK_STALE           // "ts" too old (queued while offline), not run
+};
+
+const char   *millAckResultStr(MillAckResult r);
+MillAckResult millAckFromDispatch(MillDispatchResult r);
+
+// {"id":"..","seq":..,"cmd":"..","result":"..","state":"..","substate":".."[,"detail":".."]}
+// id: the device id (Mill_Topics), so broadcast acks can be told apart;
+// detail: why a command was refused (e.g. "ln2_kp OUT_OF_RANGE"), optional
+size_t mill_ack_json(const char *id, uint32_t seq, const char *cmd, MillAckResult result,
+                     MillState state, MillSubstate substate, char *buf, size_t cap,
+                     const char *detail = nullptr);
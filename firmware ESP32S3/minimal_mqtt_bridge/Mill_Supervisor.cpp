@@ -0,0 +1,259 @@
+#include "Mill_Supervisor.h"
+
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+
+#include "Mill_Memory.h"
+#include "WS_Relay.h"
+
+volatile uint32_t     supCheckinTick[SUP_TASK_COUNT] = {0};
+volatile SupLoopPhase supLoopPhase = SUP_PHASE_BOOT;
+
+// Per-task deadlines: a few periods of the task's own loop, except the
+// control loop which can legitimately sit in an MQTT connect attempt
+// (bounded by the socket timeouts set in setup()).
+static const uint32_t supDeadlineMs[SUP_TASK_COUNT] = {
+  6000,   // SUP_TASK_LOOP
+  1000,   // SUP_TASK_DIN
+  1000,   // SUP_TASK_RELAY_FAIL
+  1000,   // SUP_TASK_ETH
+  1000,   // SUP_TASK_I2C (one request incl. a bus recovery)
+};
+
+// -------------------------------------------------------------------
+// Record kept across resets (RTC no-init RAM)
+// -------------------------------------------------------------------
+
+static const uint32_t SUP_PERSIST_MAGIC = 0x53555056;   // "SUPV"
+
+struct SupPersist {
+  uint32_t magic;
+  uint32_t boot_count;
+  uint8_t  stalled_task;
+  uint8_t  stalled_phase;
+  uint32_t stalled_late_ms;
+  uint32_t uptime_s;
+  uint32_t loop_avg_us;
+  uint32_t loop_max_us;
+};
+
+RTC_NOINIT_ATTR static SupPersist supPersist;
+
+static SupBootInfo  supBoot;
+static TaskHandle_t supTaskHandle = nullptr;
+static bool         supTripped    = false;
+static volatile uint32_t supOkTick = 0;     // last all-on-time pass (0 = none yet)
+
+// -------------------------------------------------------------------
+// Safe outputs
+// -------------------------------------------------------------------
+
+// One TCA9554 write for all eight channels, normally through the I2C
+// manager. When I2CTask is the stalled task, or the queued write fails,
+// it goes straight to the bus instead: the expander keeps its outputs
+// across the watchdog reset, so this write must not depend on the queue.
+void supervisor_safe_outputs(void) {
+  bool i2cStalled = supTripped && supPersist.stalled_task == SUP_TASK_I2C;
+  if (!i2cStalled && Relay_CHxs_PinState(0x00)) return;
+  Set_EXIOS_Emergency(0x00);
+}
+
+// -------------------------------------------------------------------
+// Supervisor task
+// -------------------------------------------------------------------
+
+static void supervisorTask(void *parameter) {
+  (void)parameter;
+  esp_task_wdt_add(nullptr);
+
+  while (1) {
+    TickType_t now = xTaskGetTickCount();
+
+    SupTaskId late     = SUP_TASK_NONE;
+    uint32_t  lateByMs = 0;
+    for (uint8_t i = 0; i < SUP_TASK_COUNT; ++i) {
+      uint32_t last = supCheckinTick[i];
+      if (last == 0) continue;                       // not armed yet
+      uint32_t age = (uint32_t)(now - last) * portTICK_PERIOD_MS;
+      if (age > supDeadlineMs[i]) {
+        late     = (SupTaskId)i;
+        lateByMs = age - supDeadlineMs[i];
+        break;
+      }
+    }
+
+    supPersist.uptime_s = millis() / 1000;
+
+    if (late == SUP_TASK_NONE) {
+      esp_task_wdt_reset();
+      supOkTick = now | 1u;
+    } else if (!supTripped) {
+      // Record first, then try the outputs (the I2C bus may be the culprit)
+      supTripped = true;
+      supPersist.stalled_task    = late;
+      supPersist.stalled_phase   = (late == SUP_TASK_LOOP) ? supLoopPhase : SUP_PHASE_BOOT;
+      supPersist.stalled_late_ms = lateByMs;
+
+      Serial.print("[SUP] ");
+      Serial.print(supervisor_task_str(late));
+      Serial.print(" missed its deadline by ");
+      Serial.print(lateByMs);
+      Serial.print(" ms");
+      if (late == SUP_TASK_LOOP) {
+        Serial.print(" (phase ");
+        Serial.print(supervisor_phase_str(supLoopPhase));
+        Serial.print(")");
+      }
+      Serial.println(" → relays OFF, waiting for watchdog reset");
+
+      supervisor_safe_outputs();
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(SUP_PERIOD_MS));
+  }
+  vTaskDelete(NULL);
+}
+
+// -------------------------------------------------------------------
+// Public API
+// -------------------------------------------------------------------
+
+void supervisor_begin(void) {
+  esp_reset_reason_t reason = esp_reset_reason();
+
+  memset(&supBoot, 0, sizeof(supBoot));
+  supBoot.reset_reason  = (uint32_t)reason;
+  supBoot.stalled_task  = SUP_TASK_NONE;
+  supBoot.stalled_phase = SUP_PHASE_BOOT;
+
+  // RTC RAM is garbage after power-on / brownout
+  bool survived = (supPersist.magic == SUP_PERSIST_MAGIC) &&
+                  reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT;
+  if (survived) {
+    supBoot.valid           = true;
+    supBoot.stalled_task    = (SupTaskId)supPersist.stalled_task;
+    supBoot.stalled_phase   = (SupLoopPhase)supPersist.stalled_phase;
+    supBoot.stalled_late_ms = supPersist.stalled_late_ms;
+    supBoot.uptime_s        = supPersist.uptime_s;
+    supBoot.loop_avg_us     = supPersist.loop_avg_us;
+    supBoot.loop_max_us     = supPersist.loop_max_us;
+    supBoot.boot_count      = supPersist.boot_count + 1;
+  } else {
+    supBoot.boot_count      = 1;
+  }
+
+  memset(&supPersist, 0, sizeof(supPersist));
+  supPersist.magic         = SUP_PERSIST_MAGIC;
+  supPersist.boot_count    = supBoot.boot_count;
+  supPersist.stalled_task  = SUP_TASK_NONE;
+
+  Serial.print("[SUP] reset reason ");
+  Serial.print(supervisor_reset_reason_str(supBoot.reset_reason));
+  Serial.print(", boot #");
+  Serial.println(supBoot.boot_count);
+  if (supBoot.valid && supBoot.stalled_task != SUP_TASK_NONE) {
+    Serial.print("[SUP] previous boot: ");
+    Serial.print(supervisor_task_str(supBoot.stalled_task));
+    Serial.print(" stalled in ");
+    Serial.print(supervisor_phase_str(supBoot.stalled_phase));
+    Serial.print(", loop avg/max ");
+    Serial.print(supBoot.loop_avg_us);
+    Serial.print("/");
+    Serial.print(supBoot.loop_max_us);
+    Serial.println(" us");
+  }
+
+  esp_register_shutdown_handler(supervisor_safe_outputs);
+
+  esp_task_wdt_config_t cfg = {
+    SUP_WDT_TIMEOUT_MS,
+    (1u << 0),        // keep watching the core 0 idle task
+    true              // panic → reset
+  };
+  esp_task_wdt_reconfigure(&cfg);
+
+  // Core 0 so a wedged loop() on core 1 cannot starve the supervisor
+  MILL_TASK_CREATE(
+    supervisorTask,
+    "SupervisorTask",
+    3072,
+    NULL,
+    5,
+    &supTaskHandle,
+    0
+  );
+}
+
+// EWMA (1/16) average plus running max; a few integer ops per loop
+void supervisor_loop_done(uint32_t loop_us) {
+  uint32_t avg = supPersist.loop_avg_us;
+  supPersist.loop_avg_us = (avg == 0) ? loop_us : avg - (avg >> 4) + (loop_us >> 4);
+  if (loop_us > supPersist.loop_max_us) {
+    supPersist.loop_max_us = loop_us;
+  }
+}
+
+bool supervisor_healthy(void) {
+  uint32_t ok = supOkTick;
+  if (supTripped || ok == 0 || supCheckinTick[SUP_TASK_LOOP] == 0) return false;
+  uint32_t age = (uint32_t)(xTaskGetTickCount() - ok) * portTICK_PERIOD_MS;
+  return age <= 4 * SUP_PERIOD_MS;   // the supervisor task itself is running
+}
+
+const SupBootInfo &supervisor_boot_info(void) {
+  return supBoot;
+}
+
+uint32_t supervisor_loop_avg_us(void) {
+  return supPersist.loop_avg_us;
+}
+
+uint32_t supervisor_loop_max_us(void) {
+  return supPersist.loop_max_us;
+}
+
+// -------------------------------------------------------------------
+// Names
+// -------------------------------------------------------------------
+
+const char *supervisor_task_str(SupTaskId id) {
+  switch (id) {
+    case SUP_TASK_LOOP:       return "LOOP";
+    case SUP_TASK_DIN:        return "DINTask";
+    case SUP_TASK_RELAY_FAIL: return "RelayFailTask";
+    case SUP_TASK_ETH:        return "EthernetTask";
+    case SUP_TASK_I2C:        return "I2CTask";
+    default:                  return "NONE";
+  }
+}
+
+const char *supervisor_phase_str(SupLoopPhase phase) {
+  switch (phase) {
+    case SUP_PHASE_BOOT:       return "BOOT";
+    case SUP_PHASE_MQTT:       return "MQTT";
+    case SUP_PHASE_CYCLE:      return "CYCLE";
+    case SUP_PHASE_INTERLOCKS: return "INTERLOCKS";
+    case SUP_PHASE_PID:        return "PID";
+    case SUP_PHASE_RELAYS:     return "RELAYS";
+    case SUP_PHASE_MODBUS:     return "MODBUS";
+    case SUP_PHASE_PUBLISH:    return "PUBLISH";
+    case SUP_PHASE_IDLE:       return "IDLE";
+    case SUP_PHASE_OTA:        return "OTA";
+  }
+  return "?";
+}
+
+const char *supervisor_reset_reason_str(uint32_t reason) {
+  switch ((esp_reset_reason_t)reason) {
+    case ESP_RST_POWERON:  return "POWERON";
+    case ESP_RST_EXT:      return "EXT";
+    case ESP_RST_SW:       return "SW";
+    case ESP_RST_PANIC:    return "PANIC";
+    case ESP_RST_INT_WDT:  return "INT_WDT";
+    case ESP_RST_TASK_WDT: return "TASK_WDT";
+    case ESP_RST_WDT:      return "WDT";
+    case ESP_RST_BROWNOUT: return "BROWNOUT";
+    default:               return "UNKNOWN";
+  }
+}
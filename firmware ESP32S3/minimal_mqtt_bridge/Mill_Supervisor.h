@@ -0,0 +1,111 @@
+#pragma once
+
+/*
+ * Mill_Supervisor.h
+ *
+ * Task-liveness supervisor in front of the ESP32 task watchdog (TWDT).
+ *
+ * Every supervised task checks in with supervisor_checkin() once per
+ * iteration (one tick-count store, no locks). A dedicated supervisor task
+ * compares each slot against its deadline every SUP_PERIOD_MS and feeds
+ * the TWDT only while all armed slots are on time. When one is late it
+ * forces every relay off, records which task (and, for the control loop,
+ * which phase) stalled, and stops feeding so the TWDT resets the board.
+ *
+ * The record lives in RTC no-init RAM together with the control loop
+ * timings, so the next boot can publish the reset cause and the last
+ * good loop timings on mill/status/diag.
+ *
+ * Note: the TCA9554 keeps its outputs across an ESP reset, which is why
+ * the relays are forced off here first; Relay_Init() clears them again
+ * on the way back up.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Supervised tasks. The MQTT client and the Modbus TCP server are serviced
+// from loop(), so a hang there shows up as a SUP_TASK_LOOP stall with the
+// loop phase recorded.
+enum SupTaskId : uint8_t {
+  SUP_TASK_LOOP = 0,     // Arduino loop() – control, MQTT, Modbus TCP
+  SUP_TASK_DIN,          // DINTask
+  SUP_TASK_RELAY_FAIL,   // RelayFailTask
+  SUP_TASK_ETH,          // EthernetTask
+  SUP_TASK_I2C,          // I2CTask (bus manager)
+  SUP_TASK_COUNT,
+  SUP_TASK_NONE = 0xFF
+};
+
+// Where loop() was when it last marked progress
+enum SupLoopPhase : uint8_t {
+  SUP_PHASE_BOOT = 0,
+  SUP_PHASE_MQTT,
+  SUP_PHASE_CYCLE,
+  SUP_PHASE_INTERLOCKS,
+  SUP_PHASE_PID,
+  SUP_PHASE_RELAYS,
+  SUP_PHASE_MODBUS,
+  SUP_PHASE_PUBLISH,
+  SUP_PHASE_IDLE,
+  SUP_PHASE_OTA         // firmware transfer slice (appended: value persists)
+};
+
+static const uint32_t SUP_PERIOD_MS      = 250;    // supervisor check rate
+static const uint32_t SUP_WDT_TIMEOUT_MS = 8000;   // TWDT, > every deadline
+
+// What the previous boot left behind (valid = record survived the reset)
+struct SupBootInfo {
+  bool         valid;
+  uint32_t     reset_reason;     // esp_reset_reason_t of this boot
+  SupTaskId    stalled_task;     // SUP_TASK_NONE if no stall was seen
+  SupLoopPhase stalled_phase;
+  uint32_t     stalled_late_ms;  // how far past its deadline it was
+  uint32_t     uptime_s;         // uptime of the previous boot
+  uint32_t     loop_avg_us;      // control loop timings of the previous boot
+  uint32_t     loop_max_us;
+  uint32_t     boot_count;
+};
+
+// Hot path: written by the owning task, read by the supervisor
+extern volatile uint32_t     supCheckinTick[SUP_TASK_COUNT];
+extern volatile SupLoopPhase supLoopPhase;
+
+// Tick 0 is reserved for "never checked in" (slot not armed yet)
+static inline void supervisor_checkin(SupTaskId id) {
+  supCheckinTick[id] = xTaskGetTickCount() | 1u;
+}
+
+// For event-driven tasks: disarm the slot before blocking indefinitely on
+// an event, check in again on wake. A parked task costs no wakeups.
+static inline void supervisor_park(SupTaskId id) {
+  supCheckinTick[id] = 0;
+}
+
+static inline void supervisor_phase(SupLoopPhase phase) {
+  supLoopPhase = phase;
+}
+
+// Reads the previous boot's record, reconfigures the TWDT and starts the
+// supervisor task. Call early in setup().
+void supervisor_begin(void);
+
+// Control loop duration (µs, excluding the trailing delay()).
+void supervisor_loop_done(uint32_t loop_us);
+
+// Drive every relay off (also runs from the esp_restart() shutdown hook).
+void supervisor_safe_outputs(void);
+
+// True while the supervisor task runs, the control loop has checked in,
+// every armed task met its deadline on the last pass and nothing has
+// tripped since boot. Independent of the network.
+bool supervisor_healthy(void);
+
+const SupBootInfo &supervisor_boot_info(void);
+uint32_t supervisor_loop_avg_us(void);
+uint32_t supervisor_loop_max_us(void);
+
+const char *supervisor_task_str(SupTaskId id);
+const char *supervisor_phase_str(SupLoopPhase phase);
+const char *supervisor_reset_reason_str(uint32_t reason);
@@ -0,0 +1,159 @@
+#include "Mill_TimeSync.h"
+
+#include <string.h>
+
+void timesync_default_config(TimeSyncConfig &cfg) {
+  cfg.max_rtt_ms = 500;
+  cfg.step_ms    = 1000;
+  cfg.slew_ppm   = 500;    // 0.5 ms per s
+}
+
+void timesync_init(TimeSync &ts, const TimeSyncConfig &cfg) {
+  memset(&ts, 0, sizeof(ts));
+  ts.cfg = cfg;
+}
+
+void timesync_seed(TimeSync &ts, int64_t utc_ms, uint64_t mono_ms) {
+  if (ts.src == TIME_SRC_SYNC) return;
+  ts.offset_ms     = utc_ms - (int64_t)mono_ms;
+  ts.slew_left_ms  = 0;
+  ts.slew_ref_mono = mono_ms;
+  ts.src           = TIME_SRC_RTC;
+}
+
+uint32_t timesync_request(TimeSync &ts, uint64_t mono_ms) {
+  ts.req_id++;
+  ts.req_mono    = mono_ms;
+  ts.req_pending = true;
+  return ts.req_id;
+}
+
+// Move at most slew_ppm of the elapsed time from slew_left into offset.
+// slew_ref only advances by the time actually "spent", so no fraction is
+// lost between calls.
+static void applySlew(TimeSync &ts, uint64_t mono_ms) {
+  if (ts.slew_left_ms == 0 || ts.cfg.slew_ppm == 0) {
+    ts.slew_ref_mono = mono_ms;
+    return;
+  }
+  if (mono_ms <= ts.slew_ref_mono) return;
+
+  uint64_t elapsed = mono_ms - ts.slew_ref_mono;
+  int64_t  allowed = (int64_t)(elapsed * ts.cfg.slew_ppm / 1000000ULL);
+  if (allowed == 0) return;
+
+  int64_t left = ts.slew_left_ms;
+  int64_t step = (left > 0) ? (left < allowed ? left : allowed)
+                            : (-left < allowed ? left : -allowed);
+  int64_t mag  = step < 0 ? -step : step;
+
+  ts.offset_ms       += step;
+  ts.slew_left_ms    -= step;
+  ts.slew_ref_mono   += (uint64_t)mag * 1000000ULL / ts.cfg.slew_ppm;
+  if (ts.slew_left_ms == 0) ts.slew_ref_mono = mono_ms;
+}
+
+bool timesync_response(TimeSync &ts, uint32_t id, uint64_t t0, int64_t t1,
+                       int64_t t2, uint64_t t3) {
+  if (!ts.req_pending || id != ts.req_id || t0 != ts.req_mono || t3 < t0) {
+    ts.rejects++;
+    return false;
+  }
+  ts.req_pending = false;
+
+  int64_t rtt = (int64_t)(t3 - t0) - (t2 - t1);
+  if (rtt < 0) rtt = 0;
+
+  // Queueing only ever adds delay: trust the fastest round trips
+  bool haveBest = ts.samples > 0;
+  if (rtt > (int64_t)ts.cfg.max_rtt_ms ||
+      (haveBest && rtt > 2 * (int64_t)ts.rtt_best_ms + 10)) {
+    ts.rejects++;
+    if (haveBest) ts.rtt_best_ms++;
+    return false;
+  }
+  ts.rtt_ms      = (uint32_t)rtt;
+  ts.rtt_best_ms = (!haveBest || ts.rtt_ms < ts.rtt_best_ms) ? ts.rtt_ms
+                                                             : ts.rtt_best_ms + 1;
+
+  applySlew(ts, t3);
+  int64_t measured = ((t1 - (int64_t)t0) + (t2 - (int64_t)t3)) / 2;
+  int64_t target   = ts.offset_ms + ts.slew_left_ms;
+  int64_t err      = measured - target;
+  ts.err_ms = (err > INT32_MAX) ? INT32_MAX : (err < INT32_MIN) ? INT32_MIN : (int32_t)err;
+
+  int64_t nowErr = measured - ts.offset_ms;
+  if (ts.src != TIME_SRC_SYNC || nowErr > ts.cfg.step_ms || nowErr < -ts.cfg.step_ms) {
+    ts.offset_ms    = measured;
+    ts.slew_left_ms = 0;
+    ts.steps++;
+  } else {
+    ts.slew_left_ms = nowErr;
+  }
+  ts.slew_ref_mono  = t3;
+  ts.src            = TIME_SRC_SYNC;
+  ts.last_sync_mono = t3;
+  ts.samples++;
+  return true;
+}
+
+int64_t timesync_utc_ms(TimeSync &ts, uint64_t mono_ms) {
+  if (ts.src == TIME_SRC_NONE) return 0;
+  applySlew(ts, mono_ms);
+  return (int64_t)mono_ms + ts.offset_ms;
+}
+
+// -------------------------------------------------------------------
+// Civil calendar (proleptic Gregorian, days since 1970-01-01)
+// -------------------------------------------------------------------
+
+static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int64_t  era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = (unsigned)(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468;
+}
+
+void timesync_to_civil(int64_t utc_ms, TsCivil &out) {
+  int64_t secs = utc_ms / 1000;
+  int64_t ms   = utc_ms % 1000;
+  if (ms < 0) { ms += 1000; secs--; }
+  int64_t days = secs / 86400;
+  int64_t sod  = secs % 86400;
+  if (sod < 0) { sod += 86400; days--; }
+
+  int64_t z   = days + 719468;
+  int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  unsigned doe = (unsigned)(z - era * 146097);
+  unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  unsigned mp  = (5 * doy + 2) / 153;
+  unsigned d   = doy - (153 * mp + 2) / 5 + 1;
+  unsigned m   = mp < 10 ? mp + 3 : mp - 9;
+  int64_t  y   = (int64_t)yoe + era * 400 + (m <= 2);
+
+  out.year   = (uint16_t)y;
+  out.month  = (uint8_t)m;
+  out.day    = (uint8_t)d;
+  out.dotw   = (uint8_t)((days % 7 + 11) % 7);   // 1970-01-01 was a Thursday
+  out.hour   = (uint8_t)(sod / 3600);
+  out.minute = (uint8_t)(sod / 60 % 60);
+  out.second = (uint8_t)(sod % 60);
+  out.ms     = (uint16_t)ms;
+}
+
+int64_t timesync_from_civil(const TsCivil &c) {
+  int64_t days = daysFromCivil(c.year, c.month, c.day);
+  return ((days * 86400) + c.hour * 3600 + c.minute * 60 + c.second) * 1000 + c.ms;
+}
+
+const char *timesync_source_str(TimeSource s) {
+  switch (s) {
+    case TIME_SRC_NONE: return "NONE";
+    case TIME_SRC_RTC:  return "RTC";
+    case TIME_SRC_SYNC: return "SYNC";
+  }
+  return "?";
+}
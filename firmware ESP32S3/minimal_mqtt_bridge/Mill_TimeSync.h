@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+ * Mill_TimeSync.h
+ *
+ * UTC for a network without NTP: the MCU keeps an offset from its
+ * monotonic millisecond clock to UTC and disciplines it against the Pi
+ * over MQTT.
+ *
+ *   MCU → Pi   mill/<id>/time/req   {"id":n,"t0":<mono ms>}
+ *   Pi  → MCU  mill/<id>/time/resp  {"id":n,"t0":<echo>,"t1":<UTC ms rx>,"t2":<UTC ms tx>}
+ *
+ * With t3 = mono ms at reception (NTP on-wire arithmetic):
+ *
+ *   rtt    = (t3 - t0) - (t2 - t1)
+ *   offset = ((t1 - t0) + (t2 - t3)) / 2
+ *
+ * Samples with a round trip above max_rtt_ms, or well above the best
+ * recent one, are dropped. The first good sample (or one off by more
+ * than step_ms) steps the offset; smaller errors are slewed in at no
+ * more than slew_ppm, so published time never runs backwards in normal
+ * operation. Until the Pi answers, the PCF85063 can seed the offset at
+ * 1 s resolution.
+ *
+ * Plain C++, no Arduino headers; the caller supplies the clocks.
+ */
+
+#include <stdint.h>
+
+enum TimeSource : uint8_t {
+  TIME_SRC_NONE = 0,
+  TIME_SRC_RTC,          // seeded from the PCF85063 (1 s)
+  TIME_SRC_SYNC          // disciplined against the Pi
+};
+
+struct TimeSyncConfig {
+  uint32_t max_rtt_ms;
+  int32_t  step_ms;      // |error| above this steps instead of slewing
+  uint32_t slew_ppm;     // max correction rate while slewing
+};
+
+struct TimeSync {
+  TimeSyncConfig cfg;
+  TimeSource src;
+
+  int64_t  offset_ms;        // UTC = mono + offset (applied so far)
+  int64_t  slew_left_ms;     // correction still to apply
+  uint64_t slew_ref_mono;
+
+  uint32_t req_id;
+  uint64_t req_mono;
+  bool     req_pending;
+
+  uint32_t rtt_ms;           // last accepted sample
+  uint32_t rtt_best_ms;      // ages by 1 ms per sample
+  int32_t  err_ms;           // measured offset - target before the sample
+  uint64_t last_sync_mono;
+  uint32_t samples;
+  uint32_t rejects;
+  uint32_t steps;
+};
+
+// Broken-down UTC; dotw 0 = Sunday (PCF85063 convention)
+struct TsCivil {
+  uint16_t year;
+  uint8_t  month;
+  uint8_t  day;
+  uint8_t  dotw;
+  uint8_t  hour;
+  uint8_t  minute;
+  uint8_t  second;
+  uint16_t ms;
+};
+
+void timesync_default_config(TimeSyncConfig &cfg);
+void timesync_init(TimeSync &ts, const TimeSyncConfig &cfg);
+
+// Coarse seed (RTC) unless already disciplined.
+void timesync_seed(TimeSync &ts, int64_t utc_ms, uint64_t mono_ms);
+
+// Start a request; returns its id (t0 = mono_ms).
+uint32_t timesync_request(TimeSync &ts, uint64_t mono_ms);
+
+// Feed a response; false if stale / rejected.
+bool timesync_response(TimeSync &ts, uint32_t id, uint64_t t0, int64_t t1,
+                       int64_t t2, uint64_t t3);
+
+// UTC ms for a monotonic time (advances the slew); 0 = unknown.
+int64_t timesync_utc_ms(TimeSync &ts, uint64_t mono_ms);
+
+void    timesync_to_civil(int64_t utc_ms, TsCivil &out);
+int64_t timesync_from_civil(const TsCivil &c);   // UTC ms
+
+const char *timesync_source_str(TimeSource s);
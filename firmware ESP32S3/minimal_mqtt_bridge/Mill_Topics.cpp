@@ -0,0 +1,51 @@
+#include "Mill_Topics.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const char MILL_TOPIC_CMD_BROADCAST[] = "mill/all/cmd/control";
+
+bool mill_id_valid(const char *id) {
+  if (!id) return false;
+  size_t n = strlen(id);
+  if (n == 0 || n >= MILL_ID_MAX) return false;
+  if (strcmp(id, "all") == 0) return false;
+  for (size_t i = 0; i < n; ++i) {
+    char c = id[i];
+    bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+              (c >= '0' && c <= '9') || c == '_' || c == '-';
+    if (!ok) return false;
+  }
+  return true;
+}
+
+void mill_id_from_mac(const uint8_t mac[6], char out[MILL_ID_MAX]) {
+  snprintf(out, MILL_ID_MAX, "%02x%02x%02x", mac[3], mac[4], mac[5]);
+}
+
+bool mill_topics_build(MillTopics &t, const char *id) {
+  if (!mill_id_valid(id)) return false;
+  snprintf(t.id, sizeof(t.id), "%s", id);
+  snprintf(t.client_id, sizeof(t.client_id), "nu-cryo-%s", id);
+  snprintf(t.status,    sizeof(t.status),    "mill/%s/status/state", id);
+  snprintf(t.diag,      sizeof(t.diag),      "mill/%s/status/diag", id);
+  snprintf(t.schedule,  sizeof(t.schedule),  "mill/%s/status/schedule", id);
+  snprintf(t.ack,       sizeof(t.ack),       "mill/%s/status/ack", id);
+  snprintf(t.ota,       sizeof(t.ota),       "mill/%s/status/ota", id);
+  snprintf(t.online,    sizeof(t.online),    "mill/%s/status/online", id);
+  snprintf(t.last,      sizeof(t.last),      "mill/%s/status/last", id);
+  snprintf(t.config,    sizeof(t.config),    "mill/%s/status/config", id);
+  snprintf(t.cmd,       sizeof(t.cmd),       "mill/%s/cmd/control", id);
+  snprintf(t.cmd_config, sizeof(t.cmd_config), "mill/%s/cmd/config", id);
+  snprintf(t.time_req,  sizeof(t.time_req),  "mill/%s/time/req", id);
+  snprintf(t.time_resp, sizeof(t.time_resp), "mill/%s/time/resp", id);
+  return true;
+}
+
+MillTopicKind mill_topic_kind(const MillTopics &t, const char *topic) {
+  if (strcmp(topic, t.cmd) == 0)                  return MILL_TOPIC_CMD;
+  if (strcmp(topic, MILL_TOPIC_CMD_BROADCAST) == 0) return MILL_TOPIC_CMD_ALL;
+  if (strcmp(topic, t.cmd_config) == 0)           return MILL_TOPIC_CONFIG;
+  if (strcmp(topic, t.time_resp) == 0)            return MILL_TOPIC_TIME_RESP;
+  return MILL_TOPIC_OTHER;
+}
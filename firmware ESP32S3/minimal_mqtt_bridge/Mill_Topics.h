@@ -0,0 +1,67 @@
+#pragma once
+
+/*
+ * Mill_Topics.h
+ *
+ * Device-scoped MQTT topics, so several mills can share one broker:
+ *
+ *   mill/<id>/status/state | diag | schedule | ack | ota
+ *   mill/<id>/status/online | last | config   retained (birth / LWT,
+ *                                             snapshot, config echo)
+ *   mill/<id>/cmd/control                     this mill only
+ *   mill/<id>/cmd/config                      config schema v1 (Mill_Config)
+ *   mill/all/cmd/control                      every mill (broadcast)
+ *   mill/<id>/time/req → mill/<id>/time/resp
+ *
+ * <id> is the stored device id (SET_DEVICE_ID) or, by default, the last
+ * three bytes of the factory MAC in hex ("3c8a1f"). All strings are
+ * built once into fixed buffers at boot; publishing never concatenates.
+ *
+ * Plain C++: the Pi tools build the same topics on a host.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const size_t MILL_ID_MAX    = 17;   // 16 chars + NUL
+static const size_t MILL_TOPIC_MAX = 48;   // "mill/" + id + "/status/schedule"
+
+enum MillTopicKind : uint8_t {
+  MILL_TOPIC_OTHER = 0,
+  MILL_TOPIC_CMD,            // mill/<id>/cmd/control
+  MILL_TOPIC_CMD_ALL,        // mill/all/cmd/control
+  MILL_TOPIC_CONFIG,         // mill/<id>/cmd/config
+  MILL_TOPIC_TIME_RESP
+};
+
+struct MillTopics {
+  char id[MILL_ID_MAX];
+  char client_id[MILL_ID_MAX + 8];        // "nu-cryo-<id>"
+
+  char status[MILL_TOPIC_MAX];
+  char diag[MILL_TOPIC_MAX];
+  char schedule[MILL_TOPIC_MAX];
+  char ack[MILL_TOPIC_MAX];
+  char ota[MILL_TOPIC_MAX];
+  char online[MILL_TOPIC_MAX];
+  char last[MILL_TOPIC_MAX];
+  char config[MILL_TOPIC_MAX];
+  char cmd[MILL_TOPIC_MAX];
+  char cmd_config[MILL_TOPIC_MAX];
+  char time_req[MILL_TOPIC_MAX];
+  char time_resp[MILL_TOPIC_MAX];
+};
+
+extern const char MILL_TOPIC_CMD_BROADCAST[];   // "mill/all/cmd/control"
+
+// 1..16 of [A-Za-z0-9_-], and not the reserved "all"
+bool mill_id_valid(const char *id);
+
+// Last three MAC bytes as six lower-case hex digits
+void mill_id_from_mac(const uint8_t mac[6], char out[MILL_ID_MAX]);
+
+// false (and t untouched) if the id is not valid
+bool mill_topics_build(MillTopics &t, const char *id);
+
+// Which subscription an incoming topic belongs to (one strcmp each)
+MillTopicKind mill_topic_kind(const MillTopics &t, const char *topic);
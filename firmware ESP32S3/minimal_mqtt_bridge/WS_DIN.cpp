@@ -1,4 +1,6 @@
 #include "WS_DIN.h"
+#include "Mill_Supervisor.h"
+#include "Mill_Memory.h"
 
 bool DIN_Flag[8] = {0};                   // DIN current status flag
 uint8_t DIN_Data = 0;
@@ -105,19 +107,98 @@ uint8_t DIN_Read_CHxs(){
 }
 
 static uint8_t DIN_Data_Old = 0;
+
+/*******************************************************  Debounced input word  *******************************************************/
+static volatile uint8_t DIN_Word = 0;                     // published, debounced
+static volatile uint32_t DIN_Changes = 0;
+static TaskHandle_t DIN_Task_Handle = NULL;
+static TaskHandle_t DIN_Subscriber[DIN_Max_Subscribers] = {NULL};
+static portMUX_TYPE DIN_Mux = portMUX_INITIALIZER_UNLOCKED;
+
+uint8_t DIN_Get_Word(void){
+  return DIN_Word;
+}
+uint32_t DIN_Get_Changes(void){
+  return DIN_Changes;
+}
+bool DIN_Subscribe(TaskHandle_t task){
+  bool ok = false;
+  portENTER_CRITICAL(&DIN_Mux);
+  for (int i = 0; i < DIN_Max_Subscribers; i++) {
+    if (DIN_Subscriber[i] == NULL || DIN_Subscriber[i] == task) {
+      DIN_Subscriber[i] = task;
+      ok = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&DIN_Mux);
+  return ok;
+}
+
+// Any edge on any channel just wakes DINTask; it does the reading.
+static void IRAM_ATTR DIN_ISR(void){
+  BaseType_t woken = pdFALSE;
+  if (DIN_Task_Handle != NULL)
+    vTaskNotifyGiveFromISR(DIN_Task_Handle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+// Sample until the word has been stable for DIN_Debounce_MS. Edges seen
+// while sampling are drained first, so an edge after the last sample
+// leaves a pending notification and DINTask runs again straight away.
+static uint8_t DIN_Debounce(void){
+  uint8_t last = DIN_Read_CHxs();
+  uint32_t stable = 0;
+  uint32_t spent = 0;
+  while (stable < DIN_Debounce_MS && spent < DIN_Debounce_MAX_MS) {
+    vTaskDelay(pdMS_TO_TICKS(DIN_Sample_MS));
+    spent += DIN_Sample_MS;
+    supervisor_checkin(SUP_TASK_DIN);
+    ulTaskNotifyTake(pdTRUE, 0);
+    uint8_t now = DIN_Read_CHxs();
+    if (now == last) {
+      stable += DIN_Sample_MS;
+    } else {
+      last = now;
+      stable = 0;
+    }
+  }
+  return last;
+}
+
+static void DIN_Publish(uint8_t word){
+  uint8_t changed = word ^ DIN_Word;
+  if (changed) {
+    DIN_Word = word;
+    DIN_Changes++;
+
+    TaskHandle_t subs[DIN_Max_Subscribers];
+    portENTER_CRITICAL(&DIN_Mux);
+    memcpy(subs, DIN_Subscriber, sizeof(subs));
+    portEXIT_CRITICAL(&DIN_Mux);
+    for (int i = 0; i < DIN_Max_Subscribers; i++) {
+      if (subs[i] != NULL)
+        xTaskNotify(subs[i], changed, eSetBits);
+    }
+  }
+
+  // Waveshare stock behaviour: inputs drive the relays directly
+  if(Relay_Immediate_Enable && DIN_Data_Old != word){
+    if(DIN_Inverse_Enable)
+      Relay_Immediate_CHxs(~word , DIN_Mode);
+    else
+      Relay_Immediate_CHxs(word , DIN_Mode);
+    DIN_Data_Old = word;
+  }
+}
+
+// Blocks until an input edge; no periodic wakeups while inputs are quiet.
 void DINTask(void *parameter) {
   while(1){
-    if(Relay_Immediate_Enable){
-      DIN_Read_CHxs();
-      if(DIN_Data_Old != DIN_Data){
-        if(DIN_Inverse_Enable)
-          Relay_Immediate_CHxs(~DIN_Data , DIN_Mode);
-        else
-          Relay_Immediate_CHxs(DIN_Data , DIN_Mode);
-        DIN_Data_Old = DIN_Data;
-      }
-    }
-    vTaskDelay(pdMS_TO_TICKS(20));
+    supervisor_park(SUP_TASK_DIN);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    supervisor_checkin(SUP_TASK_DIN);
+    DIN_Publish(DIN_Debounce());
   }
   vTaskDelete(NULL);
 }
@@ -133,18 +214,26 @@ void DIN_Init(void)
   pinMode(DIN_PIN_CH7, INPUT_PULLUP);
   pinMode(DIN_PIN_CH8, INPUT_PULLUP);
 
-  DIN_Read_CHxs();
+  DIN_Word = DIN_Read_CHxs();
   if(DIN_Inverse_Enable)
     DIN_Data_Old = 0xFF;
   else
     DIN_Data_Old = 0x00;
-  xTaskCreatePinnedToCore(
+  MILL_TASK_CREATE(
     DINTask,    
     "DINTask",   
     4096,                
     NULL,                 
     4,                   
-    NULL,                 
+    &DIN_Task_Handle,                 
     0                   
   );
+
+  const uint8_t pins[8] = {DIN_PIN_CH1, DIN_PIN_CH2, DIN_PIN_CH3, DIN_PIN_CH4,
+                           DIN_PIN_CH5, DIN_PIN_CH6, DIN_PIN_CH7, DIN_PIN_CH8};
+  for (int i = 0; i < 8; i++)
+    attachInterrupt(digitalPinToInterrupt(pins[i]), DIN_ISR, CHANGE);
+
+  // Catch an edge between the initial read and the interrupts going live
+  xTaskNotifyGive(DIN_Task_Handle);
 }
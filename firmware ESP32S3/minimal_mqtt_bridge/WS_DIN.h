@@ -15,6 +15,18 @@
 #define Relay_Immediate_Default   1       // Enable the input control relay
 #define DIN_Inverse_Enable        1       // Input is reversed from control
 
+/*******************************************************  Debounced input word  *******************************************************/
+// DINTask is the only reader of the DIN pins: it sleeps until a pin edge
+// interrupt, debounces all eight channels and publishes one 8-bit word
+// (bit n = CH(n+1) level, 1 = HIGH / open). Consumers read the word with
+// DIN_Get_Word() (no GPIO access) or subscribe for a task notification
+// carrying the mask of channels that changed (eSetBits).
+#define DIN_BIT(ch)               (1u << ((ch) - 1))
+#define DIN_Sample_MS             2       // sampling interval while debouncing
+#define DIN_Debounce_MS           10      // input must be stable this long
+#define DIN_Debounce_MAX_MS       200     // accept a chattering input after this
+#define DIN_Max_Subscribers       4
+
 void DIN_Init(void);
 
 bool DIN_Read_CH1(void);
@@ -25,3 +37,8 @@ bool DIN_Read_CH5(void);
 bool DIN_Read_CH6(void);
 bool DIN_Read_CH7(void);
 bool DIN_Read_CH8(void);
+uint8_t DIN_Read_CHxs(void);
+
+uint8_t DIN_Get_Word(void);               // last debounced word
+uint32_t DIN_Get_Changes(void);           // number of published changes
+bool DIN_Subscribe(TaskHandle_t task);    // notify task on every change
@@ -1,9 +1,11 @@
 #include "WS_ETH.h"
+#include "Mill_Supervisor.h"
+#include "Mill_Memory.h"
 
 #include <NTPClient.h>
 #include <WiFiUdp.h>
 
-static bool eth_connected = false;
+static volatile bool eth_connected = false;   // written by the network event task
 static bool eth_connected_Old = false;
 IPAddress ETH_ip;
 // NTP setup
@@ -70,7 +72,7 @@ void ETH_Init(void) {
 #if USE_TWO_ETH_PORTS
   ETH1.begin(ETH1_PHY_TYPE, ETH1_PHY_ADDR, ETH1_PHY_CS, ETH1_PHY_IRQ, ETH1_PHY_RST, SPI);
 #endif
-  xTaskCreatePinnedToCore(
+  MILL_TASK_CREATE(
     EthernetTask,    
     "EthernetTask",   
     4096,                
@@ -80,8 +82,12 @@ void ETH_Init(void) {
     0                   
   );
 }
+bool ETH_Connected(void) {
+  return eth_connected;
+}
 void EthernetTask(void *parameter) {
   while(1){
+    supervisor_checkin(SUP_TASK_ETH);
     if (eth_connected && !eth_connected_Old) {
       eth_connected_Old = eth_connected;
       RGB_Open_Time(0, 60, 0,1000, 0); 
@@ -37,6 +37,7 @@
 #define timezone 8        // china 
 
 void ETH_Init(void);
+bool ETH_Connected(void);                // link up with an IP (GOT_IP seen, not lost since)
 void ETH_Loop(void);
 void EthernetTask(void *parameter);
 
@@ -1,4 +1,11 @@
 #include "WS_GPIO.h"
+#include "Mill_Memory.h"
+
+static IndChannel   RGB_Channel;
+static IndChannel   Buzzer_Channel;
+static portMUX_TYPE Indicator_Mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t Indicator_Task_Handle = NULL;
+static IndPattern Indicator_From_Time(uint8_t red_val, uint8_t green_val, uint8_t blue_val, uint16_t Time, uint16_t flicker_time);
 
 /*************************************************************  I/O Init  *************************************************************/
 void GPIO_Init() {
@@ -8,22 +15,16 @@ void GPIO_Init() {
   ledcAttach(GPIO_PIN_Buzzer, Frequency, Resolution);   
   Set_Dutyfactor(0);                //0~100  
 
-  xTaskCreatePinnedToCore(
-    RGBTask,    
-    "RelayFailTask",   
-    4096,                
-    NULL,                 
-    2,                   
-    NULL,                 
-    0                   
-  );
-  xTaskCreatePinnedToCore(
-    BuzzerTask,    
-    "RelayFailTask",   
-    4096,                
+  ind_init(RGB_Channel);
+  ind_init(Buzzer_Channel);
+
+  MILL_TASK_CREATE(
+    IndicatorTask,    
+    "IndicatorTask",   
+    Indicator_Stack,                
     NULL,                 
     2,                   
-    NULL,                 
+    &Indicator_Task_Handle,                 
     0                   
   );
 }
@@ -32,65 +33,9 @@ void GPIO_Init() {
 void RGB_Light(uint8_t red_val, uint8_t green_val, uint8_t blue_val) {
   neopixelWrite(GPIO_PIN_RGB, green_val, red_val, blue_val);  // RGB color adjustment
 }
-RGB_Indicate RGB_indicate[RGB_Indicate_Number];
-static uint8_t RGB_indicate_Num = 0;
 void RGB_Open_Time(uint8_t red_val, uint8_t green_val, uint8_t blue_val, uint16_t Time, uint16_t flicker_time) {
-
-  if(RGB_indicate_Num + 1 >= RGB_Indicate_Number)
-  {
+  if(!Indicator_RGB(Indicator_From_Time(red_val, green_val, blue_val, Time, flicker_time), IND_PRIO_NORMAL))
     printf("Note : The RGB indicates that the cache is full and has been ignored\r\n");
-  }
-  else{
-    RGB_indicate[RGB_indicate_Num].Red = red_val;
-    RGB_indicate[RGB_indicate_Num].Green = green_val;
-    RGB_indicate[RGB_indicate_Num].Blue = blue_val;
-    RGB_indicate[RGB_indicate_Num].RGB_Time = Time;
-    if(flicker_time<51)
-      flicker_time = 0;                                         // If the blinking interval is less than 50ms, the blinking is ignored
-    RGB_indicate[RGB_indicate_Num].RGB_Flicker = flicker_time;
-    RGB_indicate_Num ++;
-  }
-}
-void RGBTask(void *parameter) {
-  bool RGB_Flag = 0;
-  while(1){
-    if(RGB_indicate[0].RGB_Time)
-    {
-      RGB_Flag = 1;
-      RGB_Light(RGB_indicate[0].Red, RGB_indicate[0].Green, RGB_indicate[0].Blue); 
-      if(RGB_indicate[0].RGB_Flicker){
-        vTaskDelay(pdMS_TO_TICKS(RGB_indicate[0].RGB_Flicker));
-        RGB_Light(0, 0, 0);  
-        vTaskDelay(pdMS_TO_TICKS(RGB_indicate[0].RGB_Flicker));
-      }
-      if(RGB_indicate[0].RGB_Time > (RGB_indicate[0].RGB_Flicker * 2 +50))
-        RGB_indicate[0].RGB_Time = RGB_indicate[0].RGB_Time -(RGB_indicate[0].RGB_Flicker * 2 +50);
-      else
-        RGB_indicate[0].RGB_Time = 0;
-    }
-    else if(RGB_Flag && !RGB_indicate[0].RGB_Time){
-      RGB_Light(0, 0, 0);  
-      RGB_Flag = 0;
-      RGB_indicate[0].Red = 0;
-      RGB_indicate[0].Green = 0;
-      RGB_indicate[0].Blue = 0;
-      RGB_indicate[0].RGB_Time = 0;
-      RGB_indicate[0].RGB_Flicker = 0;
-      if(RGB_indicate_Num > 0){
-        for (int i = 1; i < RGB_Indicate_Number; i++) {
-          RGB_indicate[i-1] = RGB_indicate[i];  
-        }
-        RGB_indicate[RGB_Indicate_Number -1].Red = 0;
-        RGB_indicate[RGB_Indicate_Number -1].Green = 0;
-        RGB_indicate[RGB_Indicate_Number -1].Blue = 0;
-        RGB_indicate[RGB_Indicate_Number -1].RGB_Time = 0;
-        RGB_indicate[RGB_Indicate_Number -1].RGB_Flicker = 0;
-        RGB_indicate_Num --;
-      }
-    }
-    vTaskDelay(pdMS_TO_TICKS(50));
-  }
-  vTaskDelete(NULL);
 }
 
 
@@ -111,54 +56,90 @@ void Buzzer_Closs(void)
 {
   Set_Dutyfactor(0);
 }
-Buzzer_Indicate Buzzer_indicate[Buzzer_Indicate_Number];
-static uint8_t Buzzer_indicate_Num = 0;
 void Buzzer_Open_Time(uint16_t Time, uint16_t flicker_time) 
 {
-  if(Buzzer_indicate_Num + 1 >= Buzzer_Indicate_Number)
-  {
+  if(!Indicator_Buzzer(Indicator_From_Time(1, 0, 0, Time, flicker_time), IND_PRIO_NORMAL))
     printf("Note : The buzzer indicates that the cache is full and has been ignored\r\n");
-  }
-  else{
-    Buzzer_indicate[Buzzer_indicate_Num].Buzzer_Time = Time;
-    if(flicker_time<51)
-      flicker_time = 0;                                         // If the blinking interval is less than 50ms, the blinking is ignored
-    Buzzer_indicate[Buzzer_indicate_Num].Buzzer_Flicker = flicker_time;
-    Buzzer_indicate_Num ++;
-  }
 }
-void BuzzerTask(void *parameter) {
-  bool Buzzer_Flag = 0;
+
+/*************************************************************  Indicators  *************************************************************/
+// Old (Time, flicker) requests: flicker on / flicker off for Time ms, or
+// steady for Time ms when flicker is 50 ms or less
+static IndPattern Indicator_From_Time(uint8_t red_val, uint8_t green_val, uint8_t blue_val, uint16_t Time, uint16_t flicker_time)
+{
+  if(flicker_time < 51)
+    return ind_steady(red_val, green_val, blue_val, Time);
+  uint32_t blinks = Time / (2 * (uint32_t)flicker_time);
+  if(blinks < 1)   blinks = 1;
+  if(blinks > 255) blinks = 255;
+  return ind_blink(red_val, green_val, blue_val, flicker_time, flicker_time, (uint8_t)blinks, flicker_time, 1);
+}
+static void Indicator_Wake(void)
+{
+  if(Indicator_Task_Handle != NULL)
+    xTaskNotifyGive(Indicator_Task_Handle);
+}
+bool Indicator_RGB(const IndPattern &Pattern, IndPrio Prio)
+{
+  portENTER_CRITICAL(&Indicator_Mux);
+  bool ok = ind_push(RGB_Channel, Pattern, Prio);
+  portEXIT_CRITICAL(&Indicator_Mux);
+  Indicator_Wake();
+  return ok;
+}
+bool Indicator_Buzzer(const IndPattern &Pattern, IndPrio Prio)
+{
+  portENTER_CRITICAL(&Indicator_Mux);
+  bool ok = ind_push(Buzzer_Channel, Pattern, Prio);
+  portEXIT_CRITICAL(&Indicator_Mux);
+  Indicator_Wake();
+  return ok;
+}
+void Indicator_RGB_Background(const IndPattern *Pattern)
+{
+  portENTER_CRITICAL(&Indicator_Mux);
+  ind_set_background(RGB_Channel, Pattern);
+  portEXIT_CRITICAL(&Indicator_Mux);
+  Indicator_Wake();
+}
+void Indicator_Buzzer_Background(const IndPattern *Pattern)
+{
+  portENTER_CRITICAL(&Indicator_Mux);
+  ind_set_background(Buzzer_Channel, Pattern);
+  portEXIT_CRITICAL(&Indicator_Mux);
+  Indicator_Wake();
+}
+void IndicatorTask(void *parameter) {
+  IndLevel RGB_Now = {0, 0, 0};
+  bool Buzzer_Now = false;
   while(1){
-    if(Buzzer_indicate[0].Buzzer_Time)
-    {
-      Buzzer_Flag = 1;
-      Buzzer_Open(); 
-      if(Buzzer_indicate[0].Buzzer_Flicker){
-        vTaskDelay(pdMS_TO_TICKS(Buzzer_indicate[0].Buzzer_Flicker));
-        Buzzer_Closs();  
-        vTaskDelay(pdMS_TO_TICKS(Buzzer_indicate[0].Buzzer_Flicker));
-      }
-      if(Buzzer_indicate[0].Buzzer_Time > (Buzzer_indicate[0].Buzzer_Flicker * 2 +50))
-        Buzzer_indicate[0].Buzzer_Time = Buzzer_indicate[0].Buzzer_Time -(Buzzer_indicate[0].Buzzer_Flicker * 2 +50);
-      else
-        Buzzer_indicate[0].Buzzer_Time = 0;
+    IndLevel RGB_Level, Buzzer_Level;
+    uint32_t now = millis();
+    portENTER_CRITICAL(&Indicator_Mux);
+    uint32_t Wait        = ind_step(RGB_Channel, now, RGB_Level);
+    uint32_t Wait_Buzzer = ind_step(Buzzer_Channel, now, Buzzer_Level);
+    portEXIT_CRITICAL(&Indicator_Mux);
+
+    // Hardware is only touched on an edge
+    if(RGB_Level.r != RGB_Now.r || RGB_Level.g != RGB_Now.g || RGB_Level.b != RGB_Now.b){
+      RGB_Light(RGB_Level.r, RGB_Level.g, RGB_Level.b);
+      RGB_Now = RGB_Level;
+    }
+    bool Buzzer_On = Buzzer_Level.r | Buzzer_Level.g | Buzzer_Level.b;
+    if(Buzzer_On != Buzzer_Now){
+      if(Buzzer_On) Buzzer_Open(); else Buzzer_Closs();
+      Buzzer_Now = Buzzer_On;
     }
-    else if(Buzzer_Flag && !Buzzer_indicate[0].Buzzer_Time){
-      Buzzer_Closs();  
-      Buzzer_Flag = 0;
-      Buzzer_indicate[0].Buzzer_Time = 0;
-      Buzzer_indicate[0].Buzzer_Flicker = 0;
-      if(Buzzer_indicate_Num > 0){
-        for (int i = 1; i < Buzzer_indicate_Num; i++) {
-          Buzzer_indicate[i-1] = Buzzer_indicate[i];  
-        }
-        Buzzer_indicate[Buzzer_indicate_Num - 1].Buzzer_Time = 0;
-        Buzzer_indicate[Buzzer_indicate_Num - 1].Buzzer_Flicker = 0;
-        Buzzer_indicate_Num --;
-      }
+
+    // Sleep until the next edge or a new request
+    if(Wait_Buzzer < Wait)
+      Wait = Wait_Buzzer;
+    TickType_t Ticks = portMAX_DELAY;
+    if(Wait != IND_IDLE){
+      Ticks = pdMS_TO_TICKS(Wait);
+      if(Ticks == 0) Ticks = 1;
     }
-    vTaskDelay(pdMS_TO_TICKS(50));
+    ulTaskNotifyTake(pdTRUE, Ticks);
   }
   vTaskDelete(NULL);
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <HardwareSerial.h>     // Reference the ESP32 built-in serial port library
+#include "Mill_Indicator.h"
 
 /*************************************************************  I/O  *************************************************************/
 #define TXD1              17    //The TXD of UART1 corresponds to GPIO   RS485/CAN
@@ -16,28 +17,23 @@
 #define Dutyfactor_MAX  255
 
 
-#define RGB_Indicate_Number  10 // Number of saved RGB indicator signals
-typedef struct { 
-  uint8_t Red = 0;
-  uint8_t Green = 0;
-  uint8_t Blue = 0;
-  uint16_t RGB_Time = 0;        // RGB lighting duration
-  uint16_t RGB_Flicker = 0;     // RGB flicker interval
-} RGB_Indicate;
-
-#define Buzzer_Indicate_Number  10 // Number of saved RGB indicator signals
-typedef struct { 
-  uint16_t Buzzer_Time = 0;         // Buzzer duration
-  uint16_t Buzzer_Flicker = 0;          // Buzzer interval duration
-} Buzzer_Indicate;
+/*********************************************************  Indicators  *********************************************************/
+// One task (IndicatorTask) plays Mill_Indicator patterns on both the RGB
+// LED and the buzzer. It sleeps until the next edge or a new request.
+#define Indicator_Stack   3072
+
 /*************************************************************  I/O  *************************************************************/
 void GPIO_Init();
 void RGB_Light(uint8_t red_val, uint8_t green_val, uint8_t blue_val);
-void RGB_Open_Time(uint8_t red_val, uint8_t green_val, uint8_t blue_val, uint16_t Time, uint16_t flicker_time);
-void RGBTask(void *parameter);
+void RGB_Open_Time(uint8_t red_val, uint8_t green_val, uint8_t blue_val, uint16_t Time, uint16_t flicker_time);   // normal priority
 
 void Set_Dutyfactor(uint16_t dutyfactor);
 void Buzzer_Open(void);
 void Buzzer_Closs(void);
-void Buzzer_Open_Time(uint16_t Time, uint16_t flicker_time); 
-void BuzzerTask(void *parameter);
+void Buzzer_Open_Time(uint16_t Time, uint16_t flicker_time);                                                     // normal priority
+
+bool Indicator_RGB(const IndPattern &Pattern, IndPrio Prio);           // false if that queue is full
+bool Indicator_Buzzer(const IndPattern &Pattern, IndPrio Prio);
+void Indicator_RGB_Background(const IndPattern *Pattern);              // NULL = dark
+void Indicator_Buzzer_Background(const IndPattern *Pattern);           // NULL = silent
+void IndicatorTask(void *parameter);
@@ -1,10 +1,30 @@
 #include "WS_PCF85063.h"
+#include "Mill_Memory.h"
+#include "Mill_TimeSync.h"
+#include <esp_timer.h>
 
 datetime_t datetime= {0};
 datetime_t Update_datetime= {0};
 static uint8_t decToBcd(int val);
 static int bcdToDec(uint8_t val);
 
+// Derived clock: one RTC read gives (epoch, esp_timer) and time is then
+// counted on the ESP32 monotonic clock. PCF85063Task re-reads the chip
+// every RTC_DRIFT_CHECK_MS to correct drift; PCF85063_Set_All re-bases.
+static volatile bool    RTC_Base_Valid = false;
+static volatile time_t  RTC_Base_Epoch = 0;
+static volatile int64_t RTC_Base_us    = 0;
+static portMUX_TYPE     RTC_Base_Mux   = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t         RTC_Drift_Corrections = 0;
+
+static void RTC_Set_Base(time_t epoch, int64_t now_us) {
+  portENTER_CRITICAL(&RTC_Base_Mux);
+  RTC_Base_Epoch = epoch;
+  RTC_Base_us    = now_us;
+  RTC_Base_Valid = true;
+  portEXIT_CRITICAL(&RTC_Base_Mux);
+}
+
 
 void Time_printf(void *parameter) {
   while(1){
@@ -19,12 +39,21 @@ void PCF85063_Init(void)      // PCF85063 initialized
 {
 	uint8_t Value = RTC_CTRL_1_DEFAULT|RTC_CTRL_1_CAP_SEL;
 
+  I2C_Add_Device(PCF85063_ADDRESS, "PCF85063", I2C_Prio_Normal, true);
 	I2C_Write(PCF85063_ADDRESS, RTC_CTRL_1_ADDR, &Value, 1);
   I2C_Read(PCF85063_ADDRESS, RTC_CTRL_1_ADDR,  &Value, 1);
 	if(Value & RTC_CTRL_1_STOP)
 		printf("PCF85063 failed to be initialized.state :%d\r\n",Value);
 	else
 		printf("PCF85063 is running,state :%d\r\n",Value);
+
+  // The only full date/time read until the first drift check. On a bus
+  // error the time stays unknown (PCF85063_Now_Epoch() == 0) and the
+  // first good read in PCF85063Task sets the base.
+  if(PCF85063_Read_Time(&datetime))
+    printf("PCF85063 : time read failed, time unknown\r\n");
+  else
+    RTC_Set_Base(datetime_to_epoch(datetime), esp_timer_get_time());
     
   // 
   // Update_datetime.year = 2024;
@@ -35,7 +64,7 @@ void PCF85063_Init(void)      // PCF85063 initialized
   // Update_datetime.minute = 50;
   // Update_datetime.second = 0;
   // PCF85063_Set_All(Update_datetime);
-  xTaskCreatePinnedToCore(
+  MILL_TASK_CREATE(
     PCF85063Task,    
     "PCF85063Task",   
     4096,                
@@ -55,14 +84,49 @@ void PCF85063_Init(void)      // PCF85063 initialized
   // );
 }
 
+// Drift correction only: the chip is read every RTC_DRIFT_CHECK_MS (it
+// used to be read every 100 ms) and the derived clock re-based when the
+// two disagree by a second or more.
 void PCF85063Task(void *parameter) {
   while(1){
-    PCF85063_Read_Time(&datetime);
-    vTaskDelay(pdMS_TO_TICKS(100));
+    vTaskDelay(pdMS_TO_TICKS(RTC_DRIFT_CHECK_MS));
+    datetime_t rtc;
+    if(PCF85063_Read_Time(&rtc))
+      continue;
+    int64_t now_us = esp_timer_get_time();
+    time_t  chip   = datetime_to_epoch(rtc);
+    time_t  ours   = PCF85063_Now_Epoch();
+    if(chip - ours >= 1 || ours - chip >= 1){
+      printf("PCF85063 : drift %ld s corrected\r\n", (long)(chip - ours));
+      RTC_Set_Base(chip, now_us);
+      RTC_Drift_Corrections++;
+    }
   }
   vTaskDelete(NULL);
 }
 
+time_t PCF85063_Now_Epoch(void)
+{
+  portENTER_CRITICAL(&RTC_Base_Mux);
+  bool    valid = RTC_Base_Valid;
+  time_t  epoch = RTC_Base_Epoch;
+  int64_t base  = RTC_Base_us;
+  portEXIT_CRITICAL(&RTC_Base_Mux);
+  if(!valid)
+    return 0;
+  return epoch + (time_t)((esp_timer_get_time() - base) / 1000000);
+}
+
+void PCF85063_Now(datetime_t *time)
+{
+  epoch_to_datetime(PCF85063_Now_Epoch(), time);
+}
+
+uint32_t PCF85063_Drift_Corrections(void)
+{
+  return RTC_Drift_Corrections;
+}
+
 void PCF85063_Reset()  // Reset PCF85063
 {
 	uint8_t Value = RTC_CTRL_1_DEFAULT|RTC_CTRL_1_CAP_SEL|RTC_CTRL_1_SR;
@@ -102,14 +166,18 @@ void PCF85063_Set_All(datetime_t time) // Set Time And Date
 	esp_err_t ret = I2C_Write(PCF85063_ADDRESS, RTC_SECOND_ADDR, buf, sizeof(buf));
 	if(ret != ESP_OK)
 		printf("PCF85063 : Failed to set the date and time\r\n");
+	else
+		RTC_Set_Base(datetime_to_epoch(time), esp_timer_get_time());
 }
 
-void PCF85063_Read_Time(datetime_t *time) // Read Time And Date
+bool PCF85063_Read_Time(datetime_t *time) // Read Time And Date; true on failure (I2C_Read convention)
 {
 	uint8_t buf[7] = {0};
 	esp_err_t ret = I2C_Read(PCF85063_ADDRESS, RTC_SECOND_ADDR, buf, sizeof(buf));
-	if(ret != ESP_OK)
+	if(ret != ESP_OK){
 		printf("PCF85063 : Time read failure\r\n");
+		return true;
+	}
 	else{
 		time->second = bcdToDec(buf[0] & 0x7F);
 		time->minute = bcdToDec(buf[1] & 0x7F);
@@ -119,6 +187,7 @@ void PCF85063_Read_Time(datetime_t *time) // Read Time And Date
 		time->month = bcdToDec(buf[5] & 0x1F);
 		time->year = bcdToDec(buf[6]) + YEAR_OFFSET;
 	}
+	return false;
 }
 
 void PCF85063_Enable_Alarm() // Enable Alarm and Clear Alarm flag
@@ -186,4 +255,24 @@ void datetime_to_str(char *datetime_str,datetime_t time)
 {
 	sprintf(datetime_str, " %d.%d.%d  %d:%d:%d  %s", time.year, time.month, 
 			time.day, time.hour, time.minute, time.second, Week[time.dotw]);
-} 
\ No newline at end of file
+} 
+
+// Calendar <-> Unix seconds (UTC); the arithmetic lives in Mill_TimeSync
+time_t datetime_to_epoch(datetime_t time)
+{
+  TsCivil c = {time.year, time.month, time.day, time.dotw,
+               time.hour, time.minute, time.second, 0};
+  return (time_t)(timesync_from_civil(c) / 1000);
+}
+void epoch_to_datetime(time_t epoch, datetime_t *time)
+{
+  TsCivil c;
+  timesync_to_civil((int64_t)epoch * 1000, c);
+  time->year   = c.year;
+  time->month  = c.month;
+  time->day    = c.day;
+  time->dotw   = c.dotw;
+  time->hour   = c.hour;
+  time->minute = c.minute;
+  time->second = c.second;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "I2C_Driver.h"
+#include <time.h>
 
 //PCF85063_ADDRESS
 #define PCF85063_ADDRESS    (0x51)
@@ -59,6 +60,9 @@
 
 #define RTC_TIMER_FLAG		  (0x08)
 
+// Derived clock: chip re-read interval for drift correction
+#define RTC_DRIFT_CHECK_MS  (600000)
+
 typedef struct {
   uint16_t year;
   uint8_t month;
@@ -82,7 +86,15 @@ void PCF85063_Set_Time(datetime_t time);
 void PCF85063_Set_Date(datetime_t date);
 void PCF85063_Set_All(datetime_t time);
 
-void PCF85063_Read_Time(datetime_t *time);
+bool PCF85063_Read_Time(datetime_t *time);                  // true on I2C failure
+
+// Time from the derived clock (boot read + ESP32 monotonic clock); no I2C
+time_t PCF85063_Now_Epoch(void);                            // 0 until PCF85063_Init()
+void PCF85063_Now(datetime_t *time);
+uint32_t PCF85063_Drift_Corrections(void);
+
+time_t datetime_to_epoch(datetime_t time);
+void epoch_to_datetime(time_t epoch, datetime_t *time);
 
 
 void PCF85063_Enable_Alarm(void);
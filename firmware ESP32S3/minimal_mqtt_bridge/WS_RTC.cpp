@@ -1,350 +1,201 @@
 #include "WS_RTC.h"
+#include "Mill_Memory.h"
 
-Timing_RTC CHx_State[Timing_events_Number_MAX];       // Set a maximum of Timing_events_Number_MAX timers
-char Event_str[Timing_events_Number_MAX][1000];
-static Timing_RTC CHx_State_Default;            // Event initial state
-const unsigned char Event_cycle[4][13] = {"Aperiodicity","everyday","Weekly","monthly"};
+// Relay timer events: Mill_Calendar records (RELAYS action, a = channels
+// to open, b = channels to close) in a min-heap keyed by next fire time.
+// The heap is shared between RTCTask and the Set / Del callers; every
+// access is a short critical section, relays are switched outside it.
+static CalEvent     RTC_Events[Timing_events_Number_MAX];
+static uint16_t     RTC_Heap[Timing_events_Number_MAX];
+static uint16_t     RTC_Pos[Timing_events_Number_MAX];
+static Calendar     RTC_Calendar;
+static portMUX_TYPE RTC_Calendar_Mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t RTCTask_Handle = NULL;
+
+static CalEvent     RTC_Due[Timing_events_Number_MAX];     // fired this pass
+static uint16_t     RTC_Due_Num = 0;
 
 void RTC_Init(void){
+  cal_init(RTC_Calendar, RTC_Events, RTC_Heap, RTC_Pos, Timing_events_Number_MAX);
+  RTC_Calendar.late_limit_s = RTC_LATE_LIMIT_S;
   PCF85063_Init();
-  xTaskCreatePinnedToCore(
+  MILL_TASK_CREATE(
     RTCTask,    
     "RTCTask",   
     4096,                
     NULL,                 
     3,                   
-    NULL,                 
+    &RTCTask_Handle,                 
     0                   
   );
 }
-uint8_t Timing_events_Num = 0;
-void RTCTask(void *parameter)
-{ 
-  static uint8_t Time_Old = 0;
-  while(1){
-    if(Timing_events_Num){
-      for (int i = 0; i < Timing_events_Number_MAX; i++){
-        if(CHx_State[i].Enable_Flag){
-          if(CHx_State[i].Time.hour == datetime.hour && CHx_State[i].Time.minute == datetime.minute && CHx_State[i].Time.second == datetime.second && datetime.second != Time_Old){       // The event time is consistent with the current time
-            switch(CHx_State[i].repetition_State){
-              case Repetition_NONE:
-                if(CHx_State[i].Time.year == datetime.year && CHx_State[i].Time.month == datetime.month && CHx_State[i].Time.day == datetime.day){ // Executes at the defined date and time
-                  TimerEvent_handling(CHx_State[i]);
-                  TimerEvent_Del(CHx_State[i]);
-                }
-                break;
-              case Repetition_everyday:
-                TimerEvent_handling(CHx_State[i]);
-                break;
-              case Repetition_Weekly:
-                if(CHx_State[i].Time.dotw == datetime.dotw){
-                  TimerEvent_handling(CHx_State[i]);
-                }
-                break;
-              case Repetition_monthly:
-                if(CHx_State[i].Time.day == datetime.day){
-                  TimerEvent_handling(CHx_State[i]);
-                }
-                break;
-              default:
-                printf("Event error!!!!\n");
-                break;
-            }
-          }
-        }
-      }
-    }
-    Time_Old = datetime.second;
-    vTaskDelay(pdMS_TO_TICKS(100));
-  }
-  vTaskDelete(NULL);
+
+static void RTC_Collect(const CalEvent &ev, uint32_t late_s, void *ctx)
+{
+  if(RTC_Due_Num < Timing_events_Number_MAX)
+    RTC_Due[RTC_Due_Num++] = ev;
 }
 
-void TimerEvent_handling(Timing_RTC event){
-  uint8_t Retain_channels = 0;  
-  printf("Event %d : \r\n", event.Event_Number);
-  char datetime_str[50];
-  datetime_to_str(datetime_str,event.Time);
+static void TimerEvent_handling(const CalEvent &ev)
+{
+  Status_adjustment Relay_n[Relay_Number_MAX];
   for (int i = 0; i < Relay_Number_MAX; i++) {
-    if(*(&(event.Relay_CH1)+i) == STATE_Retain)                     // Find the modified channel
-      Retain_channels ++;                                     // Number of unmodified channels  
+    if((ev.a >> i) & 0x01)
+      Relay_n[i] = STATE_Open;
+    else if((ev.b >> i) & 0x01)
+      Relay_n[i] = STATE_Closs;
+    else
+      Relay_n[i] = STATE_Retain;
   }
-  if(Retain_channels < Relay_Number_MAX - 1){  
-    printf("%s\r\n", datetime_str);
-    printf("CHx Open   : ");  
-    int j = 0;       
-    for (j = 0; j < Relay_Number_MAX; j++) {
-      if(*(&(event.Relay_CH1)+j) == STATE_Open)                          
-        printf("CH%d    ", j+1); 
-    } 
-    printf("\r\nCHx Closs  : ");         
-    for (j = 0; j < Relay_Number_MAX; j++) {
-      if(*(&(event.Relay_CH1)+j) == STATE_Closs)                          
-        printf("CH%d    ", j+1); 
-    }
-    if(Retain_channels){
-      printf("\r\nCHx Retain : ");         
-      for (j = 0; j < Relay_Number_MAX; j++) {
-        if(*(&(event.Relay_CH1)+j) == STATE_Retain)                          
-          printf("CH%d    ", j+1); 
-      }
+  char line[96];
+  cal_format(ev, line, sizeof(line));
+  printf("Event %s\r\n", line);
+  Relay_Immediate_CHxn(Relay_n, RTC_Mode);
+  printf("\r\n");
+}
+
+// Sleeps until the earliest event (capped at RTC_WAIT_MAX_MS so a drift
+// correction of the derived clock is picked up); never reads the PCF85063.
+void RTCTask(void *parameter)
+{ 
+  uint32_t missed_seen = 0;
+  while(1){
+    uint32_t now = (uint32_t)PCF85063_Now_Epoch();
+    PCF85063_Now(&datetime);
+
+    portENTER_CRITICAL(&RTC_Calendar_Mux);
+    RTC_Due_Num = 0;
+    cal_poll(RTC_Calendar, now, RTC_Collect, NULL);
+    uint32_t missed = RTC_Calendar.missed;
+    uint32_t next   = cal_next_s(RTC_Calendar);
+    portEXIT_CRITICAL(&RTC_Calendar_Mux);
+
+    if(missed != missed_seen){
+      printf("RTC : %lu event(s) missed by more than %d s, not executed\r\n", (unsigned long)(missed - missed_seen), RTC_LATE_LIMIT_S);
+      missed_seen = missed;
     }
-    printf("\r\n");   
-    Relay_Immediate_CHxn(&(event.Relay_CH1), RTC_Mode);
-    printf("\r\n");
-  }
-  else if(Retain_channels == Relay_Number_MAX - 1){           // Modified a channel                (use TimerEvent_CHx_Set())
-    printf("%s\r\n", datetime_str);
-    for (int x = 0; x < Relay_Number_MAX; x++) {
-      if(*(&(event.Relay_CH1)+x) != STATE_Retain){                   // Find the modified channel
-        if(*(&(event.Relay_CH1)+x)){
-          printf("CH%d Open\r\n", x); 
-          Relay_Immediate(x, true, RTC_Mode);
-          printf("\r\n");
-        }
-        else{
-          printf("CH%d Closs\r\n", x); 
-          Relay_Immediate(x, false, RTC_Mode);
-          printf("\r\n");
-        }
-        break;
-      }
+    for (uint16_t i = 0; i < RTC_Due_Num; i++)
+      TimerEvent_handling(RTC_Due[i]);
+
+    TickType_t wait = portMAX_DELAY;
+    if(next){
+      uint32_t dt = (next > now) ? next - now : 0;
+      uint32_t ms = (dt < RTC_WAIT_MAX_MS / 1000) ? dt * 1000 : RTC_WAIT_MAX_MS;
+      wait = pdMS_TO_TICKS(ms);
     }
+    ulTaskNotifyTake(pdTRUE, wait);
   }
-  else{
-    printf("Event error or no relay control!!!\r\n");
-  }
+  vTaskDelete(NULL);
 }
 
-void TimerEvent_CHx_Set(datetime_t time,uint8_t CHx, bool State, Repetition_event Repetition)
+static uint16_t TimerEvent_Add(datetime_t time, uint8_t Open_mask, uint8_t Closs_mask, Repetition_event Repetition)
 {
   char datetime_str[50];
   datetime_to_str(datetime_str,datetime);
   printf("Now Time: %s!!!!\r\n", datetime_str);
-  if(CHx > Relay_Number_MAX){
+
+  CalEvent spec = {};
+  spec.repeat = (CalRepeat)Repetition;
+  spec.action = CAL_ACT_RELAYS;
+  spec.a      = Open_mask;
+  spec.b      = Closs_mask;
+  if(Repetition == Repetition_NONE)
+    spec.when = (uint32_t)datetime_to_epoch(time);
+  else
+    spec.when = (uint32_t)time.hour * 3600 + time.minute * 60 + time.second;
+  if(Repetition == Repetition_Weekly)
+    spec.day = time.dotw;
+  else if(Repetition == Repetition_monthly)
+    spec.day = time.day;
+
+  portENTER_CRITICAL(&RTC_Calendar_Mux);
+  uint16_t id = cal_add(RTC_Calendar, spec, (uint32_t)PCF85063_Now_Epoch());
+  portEXIT_CRITICAL(&RTC_Calendar_Mux);
+
+  if(!id){
+    printf("Note : The number of scheduled events is full.\r\n");
+    return 0;
+  }
+  RGB_Open_Time(50, 36, 0, 1000, 0); 
+  spec.id = id;
+  char line[96];
+  cal_format(spec, line, sizeof(line));
+  printf("New timing event %s\r\n\r\n", line);
+  Buzzer_Open_Time(700, 0);
+  if(RTCTask_Handle != NULL)
+    xTaskNotifyGive(RTCTask_Handle);
+  return id;
+}
+
+void TimerEvent_CHx_Set(datetime_t time,uint8_t CHx, bool State, Repetition_event Repetition)
+{
+  if(!CHx || CHx > Relay_Number_MAX){
     printf("Timing_CHx_Set(function): Error passing parameter CHx!!!!\r\n");
     return;
   }
-  if(Timing_events_Num + 1 >= Timing_events_Number_MAX)
-  {
-    printf("Note : The number of scheduled events is full.\r\n");
-  }
-  else{
-    RGB_Open_Time(50, 36, 0, 1000, 0); 
-    CHx_State[Timing_events_Num].Enable_Flag = true;
-    CHx_State[Timing_events_Num].Event_Number = Timing_events_Num + 1;
-    *(&(CHx_State[Timing_events_Num].Relay_CH1)+CHx) = (Status_adjustment)State;
-    CHx_State[Timing_events_Num].Time = time;
-    CHx_State[Timing_events_Num].repetition_State = Repetition;
-    Timing_events_Num ++;
-    datetime_to_str(datetime_str,time);
-    if(State){
-      printf("New timing event%d :\r\n        %s set CH%d Open  ----- %s\r\n\r\n", Timing_events_Num, datetime_str, CHx, Event_cycle[Repetition]);
-      sprintf(Event_str[Timing_events_Num-1], "Event %d : %s set CH%d Open  ----- %s\\n\\n", Timing_events_Num, datetime_str, CHx, Event_cycle[Repetition]);
-    }
-    else{
-      printf("New timing event%d :\r\n        %s set CH%d Closs ----- %s\r\n\r\n", Timing_events_Num, datetime_str, CHx, Event_cycle[Repetition]);
-      sprintf(Event_str[Timing_events_Num-1], "Event %d : %s set CH%d Closs  ----- %s\\n\\n", Timing_events_Num, datetime_str, CHx, Event_cycle[Repetition]);
-    }
-    Buzzer_Open_Time(700, 0);
-  }
+  uint8_t bit = (uint8_t)(1u << (CHx - 1));
+  TimerEvent_Add(time, State ? bit : 0, State ? 0 : bit, Repetition);
 }
 
 void TimerEvent_CHxs_Set(datetime_t time,uint8_t PinState, Repetition_event Repetition)
 {
-
-  char datetime_str[50];
-  datetime_to_str(datetime_str,datetime);
-  printf("Now Time: %s!!!!\r\n", datetime_str);
-  if(Timing_events_Num + 1 >= Timing_events_Number_MAX)
-  {
-    printf("Note : The number of scheduled events is full.\r\n");
-  }
-  else{
-    RGB_Open_Time(50, 36, 0, 1000, 0); 
-    CHx_State[Timing_events_Num].Enable_Flag = true;
-    CHx_State[Timing_events_Num].Event_Number = Timing_events_Num + 1;
-    for (int i = 0; i < Relay_Number_MAX; i++) {
-      *(&(CHx_State[Timing_events_Num].Relay_CH1)+i) = (Status_adjustment)((PinState >> i) & 0x01); 
-    }
-    CHx_State[Timing_events_Num].Time = time;
-    CHx_State[Timing_events_Num].repetition_State = Repetition;
-    Timing_events_Num ++;
-    datetime_to_str(datetime_str,time);
-    printf("New timing event%d :\r\n       %s \r\n",Timing_events_Num, datetime_str);
-    printf("        CHx   :");
-    for (int i = 0; i < Relay_Number_MAX; i++) 
-      printf("CH%d      ", i+1);
-    printf("\r\n        State :");
-    for (int i = 0; i < Relay_Number_MAX; i++) {
-      if((PinState >> i) & 0x01)
-        printf("Open     ");
-      else
-        printf("Closs    ");
-    }
-    printf("\r\n");
-    printf("        ----- %s\r\n\r\n", Event_cycle[Repetition]);
-    printf("\r\n");  
-    Buzzer_Open_Time(700, 0);
-
-    int len = 0;  
-    char Event_content[1000];  
-    len += snprintf(Event_content + len, sizeof(Event_content) - len, "&nbsp;&nbsp;&nbsp;&nbsp;CHx&nbsp;&nbsp;:");
-    for (int i = 0; i < Relay_Number_MAX; i++) {
-      len += snprintf(Event_content + len, sizeof(Event_content) - len, "CH%d&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;", i + 1);
-    }
-    len += snprintf(Event_content + len, sizeof(Event_content) - len, "\\n &nbsp;&nbsp;&nbsp;&nbsp;State :");
-    for (int i = 0; i < Relay_Number_MAX; i++) {
-      if ((PinState >> i) & 0x01)  
-        len += snprintf(Event_content + len, sizeof(Event_content) - len, "Open&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;");
-      else
-        len += snprintf(Event_content + len, sizeof(Event_content) - len, "Closs&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;");
-    }
-    len += snprintf(Event_content + len, sizeof(Event_content) - len, "\\n&nbsp;&nbsp;&nbsp;&nbsp;----- %s\\n\\n", Event_cycle[Repetition]);
-    // printf("%s\r\n", Event_content);
-    sprintf(Event_str[Timing_events_Num-1], "Event %d : %s \\n%s", Timing_events_Num, datetime_str,Event_content);
-  }
+  TimerEvent_Add(time, PinState, (uint8_t)~PinState, Repetition);
 }
+
 void TimerEvent_CHxn_Set(datetime_t time,Status_adjustment *Relay_n, Repetition_event Repetition)
 {
-  char datetime_str[50];
-  datetime_to_str(datetime_str,datetime);
-  printf("Now Time: %s!!!!\r\n", datetime_str);
-  if(Timing_events_Num + 1 >= Timing_events_Number_MAX)
-  {
-    printf("Note : The number of scheduled events is full.\r\n");
-  }
-  else{
-    RGB_Open_Time(50, 36, 0, 1000, 0); 
-    CHx_State[Timing_events_Num].Enable_Flag = true;
-    CHx_State[Timing_events_Num].Event_Number = Timing_events_Num + 1;
-    for (int i = 0; i < Relay_Number_MAX; i++) {
-      *(&(CHx_State[Timing_events_Num].Relay_CH1)+i) = Relay_n[i]; 
-    }
-    CHx_State[Timing_events_Num].Time = time;
-    CHx_State[Timing_events_Num].repetition_State = Repetition;
-    Timing_events_Num ++;
-    datetime_to_str(datetime_str,time);
-    printf("New timing event%d :\r\n       %s \r\n",Timing_events_Num, datetime_str);
-    printf("        CHx   :");
-    for (int i = 0; i < Relay_Number_MAX; i++) 
-      printf("CH%d      ", i+1);
-    printf("\r\n        State :");
-    for (int i = 0; i < Relay_Number_MAX; i++) {
-      if(Relay_n[i] == STATE_Open)
-        printf("Open     ");
-      else if(Relay_n[i] == STATE_Closs)
-        printf("Closs    ");
-      else if(Relay_n[i] == STATE_Retain)
-        printf("Retain   ");
-    }
-    printf("\r\n");
-    printf("        ----- %s\r\n\r\n", Event_cycle[Repetition]);
-    printf("\r\n");
-    Buzzer_Open_Time(700, 0);
-    
-    int len = 0;  
-    char Event_content[1000];  
-    len += snprintf(Event_content + len, sizeof(Event_content) - len, "&nbsp;&nbsp;&nbsp;&nbsp;CHx&nbsp;&nbsp;:");
-    for (int i = 0; i < Relay_Number_MAX; i++) {
-      len += snprintf(Event_content + len, sizeof(Event_content) - len, "CH%d&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;", i + 1);
-    }
-    len += snprintf(Event_content + len, sizeof(Event_content) - len, "\\n&nbsp;&nbsp;&nbsp;&nbsp;State&nbsp;:");
-    for (int i = 0; i < Relay_Number_MAX; i++) {
-      if (Relay_n[i] == STATE_Open)
-        len += snprintf(Event_content + len, sizeof(Event_content) - len, "Open&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;");
-      else if(Relay_n[i] == STATE_Closs)
-        len += snprintf(Event_content + len, sizeof(Event_content) - len, "Closs&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;");
-      else if(Relay_n[i] == STATE_Retain)
-        len += snprintf(Event_content + len, sizeof(Event_content) - len, "Retain&nbsp;&nbsp;&nbsp;");
-    }
-    len += snprintf(Event_content + len, sizeof(Event_content) - len, "\\n&nbsp;&nbsp;&nbsp;&nbsp;----- %s\\n\\n", Event_cycle[Repetition]);
-    // printf("%s\r\n", Event_content);  
-    sprintf(Event_str[Timing_events_Num-1], "Event %d : %s \\n%s", Timing_events_Num, datetime_str,Event_content);
+  uint8_t Open_mask = 0, Closs_mask = 0;
+  for (int i = 0; i < Relay_Number_MAX; i++) {
+    if(Relay_n[i] == STATE_Open)
+      Open_mask |= (uint8_t)(1u << i);
+    else if(Relay_n[i] == STATE_Closs)
+      Closs_mask |= (uint8_t)(1u << i);
   }
+  TimerEvent_Add(time, Open_mask, Closs_mask, Repetition);
 }
 
-void TimerEvent_printf(Timing_RTC event){
-  uint8_t Retain_channels = 0;
-  uint8_t open[8]={0};      
-  printf("Event %d : \r\n", event.Event_Number);
-  char datetime_str[50];
-  datetime_to_str(datetime_str,event.Time);
-  for (int i = 0; i < Relay_Number_MAX; i++) {
-    if(*(&(event.Relay_CH1)+i) == STATE_Retain)                     // Find the modified channel
-      Retain_channels ++;                                     // Number of unmodified channels  
-    else
-      open[i] = *(&(event.Relay_CH1)+i);
-  }
-  if(Retain_channels == 0){                                   // All channels have been modified   (use TimerEvent_CHxs_Set())   
-    printf("%s\r\n", datetime_str);
-    printf(" CHx Open  : ");         
-    for (int j = 0; j < Relay_Number_MAX; j++) {
-      if(open[j])                          
-        printf("CH%d    ", j); 
-    } 
-    printf("\r\n CHx Closs : ");         
-    for (int k = 0; k < Relay_Number_MAX; k++) {
-      if(!open[k])                          
-        printf("CH%d    ", k); 
-    }
-    printf("\r\n");    
-  }
-  else if(Retain_channels == Relay_Number_MAX - 1){           // Modified a channel                (use TimerEvent_CHx_Set())
-    printf("%s    ,", datetime_str);
-    for (int x = 0; x < Relay_Number_MAX; x++) {
-      if(*(&(event.Relay_CH1)+x) != STATE_Retain){                   // Find the modified channel
-        if(*(&(event.Relay_CH1)+x))
-          printf("CH%d Open\r\n", x); 
-        else
-          printf("CH%d Closs\r\n", x); 
-        break;
-      }
-    }
-  }
-  else{
-    printf("%s\r\n", datetime_str);
-    printf("CHx Open   : ");  
-    int j = 0;       
-    for (j = 0; j < Relay_Number_MAX; j++) {
-      if(open[j] == STATE_Open)                          
-        printf("CH%d    ", j+1); 
-    } 
-    printf("\r\nCHx Closs  : ");         
-    for (j = 0; j < Relay_Number_MAX; j++) {
-      if(open[j] == STATE_Closs)                          
-        printf("CH%d    ", j+1); 
-    }
-    printf("\r\nCHx Retain : ");         
-    for (j = 0; j < Relay_Number_MAX; j++) {
-      if(open[j] == STATE_Retain)                          
-        printf("CH%d    ", j+1); 
-    }
-    printf("\r\n");   
-  }
+uint16_t TimerEvent_Count(void)
+{
+  return RTC_Calendar.count;
+}
+
+size_t TimerEvent_str(uint16_t index, char *out, size_t len)
+{
+  CalEvent ev;
+  portENTER_CRITICAL(&RTC_Calendar_Mux);
+  bool valid = index < RTC_Calendar.count;
+  if(valid)
+    ev = RTC_Events[index];
+  portEXIT_CRITICAL(&RTC_Calendar_Mux);
+  if(!valid){
+    if(len) out[0] = '\0';
+    return 0;
+  }
+  return cal_format(ev, out, len);
 }
 
 void TimerEvent_printf_ALL(void)
 {
+  char line[96];
   printf("/******************* Current RTC event *******************/ \r\n");
-  for (int i = 0; i < Timing_events_Number_MAX; i++) {
-    if(CHx_State[i].Enable_Flag)
-      TimerEvent_printf(CHx_State[i]);
+  for (uint16_t i = 0; i < TimerEvent_Count(); i++) {
+    if(TimerEvent_str(i, line, sizeof(line)))
+      printf("%s\r\n", line);
   }
   printf("/******************* Current RTC event *******************/\r\n\r\n ");
 }
-void TimerEvent_Del(Timing_RTC event){
-  RGB_Open_Time(20, 0, 50, 1000, 0); 
-  printf("Example Delete an RTC event%d\r\n\r\n",event.Event_Number);
-  for (int i = event.Event_Number; i < Timing_events_Number_MAX; i++) {
-    CHx_State[i].Event_Number = CHx_State[i].Event_Number -1;
-    CHx_State[i-1] = CHx_State[i];  
+
+void TimerEvent_Del_Number(uint16_t Event_Number){
+  portENTER_CRITICAL(&RTC_Calendar_Mux);
+  bool removed = cal_remove(RTC_Calendar, Event_Number);
+  portEXIT_CRITICAL(&RTC_Calendar_Mux);
+  if(!removed){
+    printf("RTC event%d not found\r\n\r\n", Event_Number);
+    return;
   }
-  CHx_State[Timing_events_Number_MAX - 1] = CHx_State_Default;
-  memset(Event_str[Timing_events_Number_MAX - 1], 0, sizeof(Event_str[Timing_events_Number_MAX - 1]));
-  Timing_events_Num --;
-}
-void TimerEvent_Del_Number(uint8_t Event_Number){
-  TimerEvent_Del(CHx_State[Event_Number - 1]);
+  RGB_Open_Time(20, 0, 50, 1000, 0); 
+  printf("Example Delete an RTC event%d\r\n\r\n", Event_Number);
   Buzzer_Open_Time(700, 300); 
-}
\ No newline at end of file
+  if(RTCTask_Handle != NULL)
+    xTaskNotifyGive(RTCTask_Handle);
+}
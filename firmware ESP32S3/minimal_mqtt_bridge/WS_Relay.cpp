@@ -1,4 +1,6 @@
 #include "WS_Relay.h"
+#include "Mill_Supervisor.h"
+#include "Mill_Memory.h"
 
 bool Failure_Flag = 0;
 /*************************************************************  Relay I/O  *************************************************************/
@@ -52,12 +54,14 @@ bool Relay_CHxs_PinState(uint8_t PinState)
 
 void RelayFailTask(void *parameter) {
   while(1){
+    supervisor_checkin(SUP_TASK_RELAY_FAIL);
     if(Failure_Flag)
     {
       Failure_Flag = 0;
       printf("Error: Relay control failed!!!\r\n");
-      RGB_Open_Time(60,0,0,5000,500);
-      Buzzer_Open_Time(5000, 500);
+      // 5 x 500 ms red + beep, ahead of any queued notification
+      Indicator_RGB(ind_blink(60, 0, 0, 500, 500, 5, 500, 1), IND_PRIO_SAFETY);
+      Indicator_Buzzer(ind_blink(1, 0, 0, 500, 500, 5, 500, 1), IND_PRIO_SAFETY);
     }
     vTaskDelay(pdMS_TO_TICKS(50));
   }
@@ -66,7 +70,7 @@ void RelayFailTask(void *parameter) {
 void Relay_Init(void)
 {
   TCA9554PWR_Init(0x00, 0x00);
-  xTaskCreatePinnedToCore(
+  MILL_TASK_CREATE(
     RelayFailTask,    
     "RelayFailTask",   
     4096,                
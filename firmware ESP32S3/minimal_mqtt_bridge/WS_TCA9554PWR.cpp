@@ -1,37 +1,31 @@
 #include "WS_TCA9554PWR.h"
 
 /*****************************************************  Operation register REG   ****************************************************/   
+static uint8_t REG_Last[4];                               // last good value per register, returned when a read fails
 uint8_t Read_REG(uint8_t REG)                             // Read the value of the TCA9554PWR register REG
 {
-  Wire.beginTransmission(TCA9554_ADDRESS);                
-  Wire.write(REG);                                        
-  uint8_t result = Wire.endTransmission();               
-  if (result != 0) {                                     
+  uint8_t bitsStatus;
+  if (I2C_Read(TCA9554_ADDRESS, REG, &bitsStatus, 1)) {
     printf("Data Transfer Failure !!!\r\n");
+    return REG < 4 ? REG_Last[REG] : 0;
   }
-  Wire.requestFrom(TCA9554_ADDRESS, 1);                   
-  uint8_t bitsStatus = Wire.read();                        
-  return bitsStatus;                                     
+  if (REG < 4) REG_Last[REG] = bitsStatus;
+  return bitsStatus;
 }
 uint8_t Write_REG(uint8_t REG,uint8_t Data)              // Write Data to the REG register of the TCA9554PWR
 {
-  Wire.beginTransmission(TCA9554_ADDRESS);                
-  Wire.write(REG);                                        
-  Wire.write(Data);                                       
-  uint8_t result = Wire.endTransmission();                  
-  if (result != 0) {    
+  if (I2C_Write(TCA9554_ADDRESS, REG, &Data, 1)) {
     printf("Data write failure!!!\r\n");
     return -1;
   }
-  return 0;                                             
+  if (REG < 4) REG_Last[REG] = Data;
+  return 0;
 }
 /********************************************************** Set EXIO mode **********************************************************/       
 void Mode_EXIO(uint8_t Pin,uint8_t State)                 // Set the mode of the TCA9554PWR Pin. The default is Output mode (output mode or input mode). State: 0= Output mode 1= input mode   
 {
-  uint8_t bitsStatus = Read_REG(TCA9554_CONFIG_REG);      
-  uint8_t Data = (0x01 << (Pin-1)) | bitsStatus;   
-  uint8_t result = Write_REG(TCA9554_CONFIG_REG,Data); 
-  if (result != 0) { 
+  uint8_t Mask = 0x01 << (Pin-1);
+  if (I2C_Update_Bits(TCA9554_ADDRESS, TCA9554_CONFIG_REG, Mask, State ? Mask : 0, NULL)) {
     printf("I/O Configuration Failure !!!\r\n");
   }
 }
@@ -58,18 +52,16 @@ uint8_t Read_EXIOS(uint8_t REG = TCA9554_INPUT_REG)       // Read the level of a
 /********************************************************** Set the EXIO output status **********************************************************/  
 bool Set_EXIO(uint8_t Pin,uint8_t State)                  // Sets the level state of the Pin without affecting the other pins
 {
-  uint8_t Data;
   if(State < 2 && Pin < 9 && Pin > 0){  
-    uint8_t bitsStatus = Read_EXIOS(TCA9554_OUTPUT_REG);
-    if(State == 1)                                     
-      Data = (0x01 << (Pin-1)) | bitsStatus; 
-    else if(State == 0)                  
-      Data = (~(0x01 << (Pin-1))) & bitsStatus;      
-    uint8_t result = Write_REG(TCA9554_OUTPUT_REG,Data);  
-    if (result != 0) {                         
+    // Read-modify-write runs inside the I2C manager, so concurrent callers
+    // (RTC timers, MQTT commands) cannot overwrite each other's bits.
+    uint8_t Mask = 0x01 << (Pin-1);
+    uint8_t Data;
+    if (I2C_Update_Bits(TCA9554_ADDRESS, TCA9554_OUTPUT_REG, Mask, State ? Mask : 0, &Data)) {
       printf("Failed to set GPIO!!!\r\n");
       return 0;
     }
+    REG_Last[TCA9554_OUTPUT_REG] = Data;
     return 1;
   }
   else                                           
@@ -87,20 +79,30 @@ bool Set_EXIOS(uint8_t PinState)                          // Set 7 pins to the P
   }
   return 1;
 }
+bool Set_EXIOS_Emergency(uint8_t PinState)                // Same write, straight to the bus past the I2C manager (supervisor trip / shutdown only)
+{
+  if (I2C_Emergency_Write(TCA9554_ADDRESS, TCA9554_OUTPUT_REG, &PinState, 1)) {
+    printf("Failed to set GPIO (emergency)!!!\r\n");
+    return 0;
+  }
+  REG_Last[TCA9554_OUTPUT_REG] = PinState;
+  return 1;
+}
 /********************************************************** Flip EXIO state **********************************************************/  
 bool Set_Toggle(uint8_t Pin)                              // Flip the level of the TCA9554PWR Pin
 {
-    uint8_t bitsStatus = Read_EXIO(Pin);    
-    uint8_t result = Set_EXIO(Pin,(bool)!bitsStatus); 
-    if (!result) {                         
+    uint8_t Data;
+    if (Pin < 1 || Pin > 8 || I2C_Toggle_Bits(TCA9554_ADDRESS, TCA9554_OUTPUT_REG, 0x01 << (Pin-1), &Data)) {
       printf("Failed to Toggle GPIO!!!\r\n");
       return 0;
     }
+    REG_Last[TCA9554_OUTPUT_REG] = Data;
     return 1;
 }
 /********************************************************* TCA9554PWR Initializes the device ***********************************************************/  
 void TCA9554PWR_Init(uint8_t PinMode, uint8_t PinState)                  // Set the seven pins to PinState state, for example :PinState=0x23, 0010 0011 State  (Output mode or input mode) 0= Output mode 1= Input mode. The default value is output mode
 {                    
+  I2C_Add_Device(TCA9554_ADDRESS, "TCA9554", I2C_Prio_High, false);
   Set_EXIOS(PinState);
   Mode_EXIOS(PinMode);    
 }
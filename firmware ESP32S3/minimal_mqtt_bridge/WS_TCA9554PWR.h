@@ -36,6 +36,7 @@ uint8_t Read_EXIOS(uint8_t REG);
 /********************************************************** Set the EXIO output status **********************************************************/  
 bool Set_EXIO(uint8_t Pin,uint8_t State);                                           // Sets the level state of the Pin without affecting the other pins
 bool Set_EXIOS(uint8_t PinState);                                                   // Set 7 pins to the PinState state such as :PinState=0x23, 0010 0011 state (the highest bit is not used)
+bool Set_EXIOS_Emergency(uint8_t PinState);                                         // Same, straight to the bus past the I2C manager (supervisor trip / shutdown only)
 /********************************************************** Flip EXIO state **********************************************************/  
 bool Set_Toggle(uint8_t Pin);                                                       // Flip the level of the TCA9554PWR Pin
 /********************************************************* TCA9554PWR Initializes the device ***********************************************************/  
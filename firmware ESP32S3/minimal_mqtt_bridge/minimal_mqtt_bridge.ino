@@ -28,16 +28,110 @@
  *  v0.14 – Read LC108 live block (PV/MV1/MV2/MVFB/STATUS/SV) in one Modbus
  *          transaction, expose output_pct and decoded mode/alarm flags
  *          (run/man/prg/op1/op2/au1/au2/atu) via pid_ln2 in JSON.
+ *  v0.15 – Move LC108 Modbus master into Mill_LC108 with per-slave health:
+ *          adaptive timeouts, bounded retries, backoff for dead slaves and
+ *          a hysteresis score driving pid_ln2.comm_ok. Publish
+ *          mill/status/diag with RS-485 error counters by class.
+ *  v0.16 – Optional Modbus TCP server (port 502) for the plant historian:
+ *          register image of state, cycles, interlocks and PID snapshots,
+ *          command coils, request-rate / latency counters.
+ *  v0.17 – Commit the mill state as one POD MillSnapshot through a
+ *          double-buffered sequence latch; publishers and the Modbus image
+ *          read consistent copies. fault_reason is now a FaultReason enum
+ *          (no heap String), fault_code is derived from it.
+ *  v0.18 – Mill state machine moved into Mill_StateMachine as a
+ *          compile-time [state][event] transition table with guards,
+ *          actions and substates (published as "substate"). START is no
+ *          longer accepted in FAULT; RESET_FAULT is the only way out.
+ *  v0.19 – Task-liveness supervisor: loop / DIN / relay-fail / Ethernet
+ *          tasks check in against deadlines, the TWDT is fed only while
+ *          all are on time, relays are forced off before a reset. Reset
+ *          cause and last-good loop timings are published on diag.
+ *  v0.20 – DINTask is event-driven (pin-change interrupt + debounce) and
+ *          the single reader of the DIN pins; interlocks and diag use its
+ *          8-bit input word, subscribers get change notifications.
+ *  v0.21 – Runtime I/O map (Mill_IoMap): interlock signals → DIN channel
+ *          + polarity, relay roles → channel, set with SET_IOMAP (IDLE
+ *          only) and kept in NVS. Interlocks are one mask compare.
+ *  v0.22 – Relay output scheduler (Mill_Outputs): ordered, staggered
+ *          switch-on per state with minimum on/off times per role;
+ *          safety switch-off stays immediate.
+ *  v0.23 – Optional closed-loop LN2 valve control (Mill_Ln2Control):
+ *          hysteresis or time-proportioning PI on the LN2 relay from the
+ *          LC108 PV, set with SET_CONFIG ln2_*; falls back to the
+ *          state-following valve when the LC108 is offline.
+ *  v0.24 – Recipe ETA estimator (Mill_Eta): observed cycle wall time,
+ *          HOLD / FAULT dwell, PV cool-down rate and LN2 duty give an
+ *          "eta" block in the status JSON.
+ *  v0.25 – LC108 plausibility checks (Mill_Anomaly): stuck PV, rate of
+ *          change, oscillation, MV1 saturation / runaway on every poll,
+ *          reported in diag; optional FAULT_DEVICE (SET_CONFIG
+ *          anom_fault) on stuck / runaway.
+ *  v0.26 – Time sync with the Pi over MQTT (Mill_TimeSync): round-trip
+ *          compensated UTC offset, slewed; PCF85063 seeded at boot and
+ *          refreshed from it. Status / diag carry "ts" + "ts_ms", module
+ *          log lines a UTC prefix.
+ *  v0.27 – WS RTC library: the 100 ms PCF85063 polling task is gone;
+ *          time comes from one boot read plus the ESP32 monotonic clock
+ *          (drift-checked every 10 min), timer events sit in a min-heap
+ *          and RTCTask sleeps until the next one. Diag "i2c" reports
+ *          bus transactions per minute.
+ *  v0.28 – Calendar scheduler (Mill_Calendar): 16-byte events in a
+ *          min-heap, text formatted on request. SCHEDULE_ADD / _DEL /
+ *          _LIST on mill/cmd/control for timed recipe starts / stops
+ *          (up to 256, NVS-backed); the WS relay timers use it too.
+ *  v0.29 – I2C manager task (I2CTask): all bus traffic is queued, relay
+ *          expander first; same-device requests are merged, register
+ *          read-modify-writes are atomic, a stuck bus is freed by SCL
+ *          clocking. Diag "i2c" adds recoveries + per-device stats.
+ *  v0.30 – One IndicatorTask (Mill_Indicator) replaces RGBTask and
+ *          BuzzerTask: pattern descriptors in O(1) rings, SAFETY
+ *          patterns preempt, the task sleeps until the next edge. The
+ *          LED shows the FAULT blink code, MQTT loss or the mill state.
+ *  v0.31 – Status JSON written by Mill_StatusJson into a static buffer
+ *          (shared with the Pi fleet load generator). Commands carrying
+ *          "seq" are acknowledged on mill/status/ack.
+ *  v0.32 – Device-scoped topics mill/<id>/… (id from SET_DEVICE_ID or
+ *          the MAC), built once at boot; broadcast commands on
+ *          mill/all/cmd/control, acked per device with its id.
+ *  v0.33 – Retained birth / last will on mill/<id>/status/online, a
+ *          retained compact snapshot (status/last) and config echo
+ *          (status/config); retained writes are rate-limited.
+ *  v0.34 – Command topics subscribed at QoS 1 on a persistent session;
+ *          a (seq, cmd) window (Mill_CmdDedup) acks redeliveries as
+ *          DUPLICATE, commands with an old "ts" are acked STALE.
+ *  v0.35 – Config schema v1 (Mill_Config): one key table, validated in
+ *          one pass and applied whole or not at all, run / cool times
+ *          (RUN_COOLING phase between cycles, motor off), RUN-locked
+ *          keys, mill/<id>/cmd/config, refusal reason in the ack.
+ *  v0.36 – Memory budget (Mill_Memory): no heap use by the sketch after
+ *          setup() (diag and command bodies in static buffers, no
+ *          String), task stacks static with MILL_STATIC_ALLOC; diag
+ *          "mem" reports heap free / min / largest block against the
+ *          end of setup() and per-task stack high-water marks.
+ *  v0.37 – Staged boot: no 2 s serial wait, relays forced off first,
+ *          Ethernet started before the local setup so the PHY negotiates
+ *          meanwhile; MQTT connects on GOT_IP and publishes status at
+ *          once, first LC108 poll on the first loop pass. Diag "boot"
+ *          reports the time to each stage (timing_ms).
+ *  v0.38 – Firmware update (Mill_Ota): OTA_UPDATE pulls an image over
+ *          HTTP from the Pi into the inactive app slot, 1 KB at a time
+ *          from loop() with an incremental SHA-256; IDLE only, progress
+ *          on mill/<id>/status/ota. A new image is marked valid after
+ *          60 s in a row of supervisor_healthy() (loop and tasks on time,
+ *          broker not required); if that has not happened by 300 s it
+ *          rolls back, but only from IDLE.
  *
- * Status JSON schema (mill/status/state):
+ * Status JSON schema (mill/<id>/status/state):
  *  {
  *    "state": "IDLE" | "RUN" | "HOLD" | "FAULT",
+ *    "substate": "IDLE_READY" | "RUN_ACTIVE" | "HOLD_USER" | "FAULT_INTERLOCK" | …,
  *    "cycle_current":    <uint>,      // seconds elapsed in current cycle
  *    "cycle_target":     <uint>,      // seconds per cycle
  *    "time_remaining_s": <uint>,      // seconds remaining in current cycle
  *    "cycle_total":      <uint>,      // requested total cycles in recipe
  *    "cycle_index":      <uint>,      // 0 when idle, 1..cycle_total when running/completed
- *    "fault_code":       <uint>,      // 0 = none; 1=ESTOP, 2=LID, 3=DOOR, 10=INTERLOCK
+ *    "fault_code":       <uint>,      // 0 = none; 1=ESTOP, 2=LID, 3=DOOR, 10=INTERLOCK, 20=PID_ANOMALY
  *    "fault_reason":     "<string>",  // e.g. "LID_OPEN"
  *    "pid": {
  *      "pv_c": <float>               // legacy LN2 PV for existing UI (°C)
@@ -46,7 +140,8 @@
  *      "pv_c":       <float>,        // LN2 PV (°C), from LC108 Modbus
  *      "sv_c":       <float>,        // LN2 setpoint (°C), from LC108 Modbus
  *      "output_pct": <float>,        // MV1 (%), 0–100.0
- *      "comm_ok":    true|false,     // RS-485 comm health for last poll
+ *      "comm_ok":    true|false,     // LC108 online (health score with hysteresis,
+ *                                    // survives a single failed poll)
  *      "status_raw": <uint>,         // raw STATUS register (bitfield)
  *      "run":        true|false,     // decoded mode/LED bits
  *      "man":        true|false,
@@ -61,18 +156,54 @@
  *      "door_closed": true|false,
  *      "estop_ok":    true|false,
  *      "lid_locked":  true|false
+ *    },
+ *    "eta": {
+ *      "valid":         true|false,  // recipe in progress
+ *      "recipe_s":      <uint>,      // est. seconds until the recipe ends
+ *      "cycle_ratio":   <float>,     // cycle wall time / cycle_target
+ *      "last_cycle_s":  <uint>,
+ *      "stall_s":       <uint>,      // HOLD + FAULT time this recipe
+ *      "cool_rate_cpm": <float>,     // PV trend, °C/min
+ *      "time_to_sv_s":  <int>,       // -1 = unknown
+ *      "ln2_open_s":    <int>        // est. LN2 valve-open s left, -1 = unknown
  *    }
  *  }
  */
 
 #include <Arduino.h>
 #include <PubSubClient.h>
+#include <Preferences.h>
 
 #include "WS_GPIO.h"
 #include "WS_DIN.h"
 #include "WS_Relay.h"
 #include "I2C_Driver.h"
 #include "WS_ETH.h"
+#include "Mill_Snapshot.h"
+#include "Mill_StateMachine.h"
+#include "Mill_StatusJson.h"
+#include "Mill_Topics.h"
+#include "Mill_Retain.h"
+#include "Mill_CmdDedup.h"
+#include "Mill_Config.h"
+#include "Mill_LC108.h"
+#include "Mill_ModbusMap.h"
+#include "Mill_ModbusTcp.h"
+#include "Mill_Supervisor.h"
+#include "Mill_Memory.h"
+#include "Mill_IoMap.h"
+#include "Mill_Outputs.h"
+#include "Mill_Ln2Control.h"
+#include "Mill_Eta.h"
+#include "Mill_Anomaly.h"
+#include "Mill_TimeSync.h"
+#include "Mill_Calendar.h"
+#include "Mill_Ota.h"
+#include "WS_PCF85063.h"
+#include <esp_timer.h>
+#include <esp_mac.h>
+#include <esp_heap_caps.h>
+#include <esp_ota_ops.h>
 
 // -------------------------------------------------------------------
 // RS-485 / Serial1 for LC108 controllers
@@ -89,11 +220,6 @@ HardwareSerial &rs485 = Serial1;
 // Externals from Waveshare libs
 // -------------------------------------------------------------------
 
-// From WS_DIN.cpp (not declared in .h)
-extern bool DIN_Read_CH1(void);
-extern bool DIN_Read_CH2(void);
-extern bool DIN_Read_CH3(void);
-
 // Auto DIN→relay mapping flag we want OFF
 extern bool Relay_Immediate_Enable;
 
@@ -108,9 +234,16 @@ static const IPAddress ETH_DNS(192, 168, 50, 2);  // Pi as DNS (not critical)
 
 static const char *MQTT_HOST          = "192.168.50.2";
 static const uint16_t MQTT_PORT       = 1883;
-static const char *MQTT_CLIENT_ID     = "nu-cryo-esp32-s3";
-static const char *MQTT_STATUS_TOPIC  = "mill/status/state";
-static const char *MQTT_CMD_SUB_TOPIC = "mill/cmd/control";
+
+// mill/<id>/… topics, built once in setup() (Mill_Topics)
+static MillTopics  topics;
+static const char *DEVICE_NVS_NAMESPACE = "device";
+static const char *DEVICE_NVS_KEY       = "id";
+
+static const char *FW_VERSION = "0.38";
+
+// Birth / last will on topics.online (retained)
+static const char *MQTT_WILL_PAYLOAD = "{\"online\":false}";
 
 // Generic network client from ESP32 Ethernet stack (via ETH.h)
 NetworkClient netClient;
@@ -121,55 +254,35 @@ PubSubClient  mqttClient(netClient);
 static const bool STATUS_SERIAL_DEBUG = true;
 
 // -------------------------------------------------------------------
-// Mill state machine
+// Mill state machine (transition table lives in Mill_StateMachine.cpp)
 // -------------------------------------------------------------------
 
-enum MillState {
-  MILL_IDLE = 0,
-  MILL_RUN,
-  MILL_HOLD,
-  MILL_FAULT
-};
-
-MillState millState            = MILL_IDLE;
-MillState lastStateBeforeFault = MILL_IDLE;  // used for soft-fault logic
+// State, substate, fault reason, cycle timing and interlock inputs; only
+// loop() and the command handlers touch it, everyone else reads the
+// snapshot.
+MillContext mill;
 
 // -------------------------------------------------------------------
 // Interlocks & process variables
 // -------------------------------------------------------------------
 
-// Hardware mapping (DIN pins):
-//   CH1 → E-Stop OK
-//   CH2 → Lid locked
-//   CH3 → Door closed (physically wired later; may be mirrored to CH2)
-bool estop_ok    = false;
-bool lid_locked  = false;
-bool door_closed = false;
+// Signal → DIN channel / polarity and relay role → channel come from the
+// I/O map (Mill_IoMap), loaded from NVS at boot and changed at run time
+// with SET_IOMAP. Factory default:
+//   CH1 → E-Stop OK, CH2 → Lid locked, door mirrored to CH2 until the
+//   DI3 switch is wired; relays CH1 motor, CH2 fault, CH3 LN2, CH4 fan.
+// Results land in mill.estop_ok / mill.lid_locked / mill.door_closed and
+// mill.interlocks_ok (every mapped signal, including overtemp / aux).
+IoMapConfig   ioMapCfg;
+IoMapCompiled ioMap;
 
-// Mirror door to lid while DI3 switch not wired, for bring-up.
-// Set to false when real door switch is installed.
-bool mirror_door_to_lid = true;
+static const char *IOMAP_NVS_NAMESPACE = "iomap";
+static const char *IOMAP_NVS_KEY       = "cfg";
 
 // -------------------------------------------------------------------
 // PID snapshots (LN2 – via LC108 Modbus)
 // -------------------------------------------------------------------
 
-struct PidSnapshot {
-  bool     comm_ok;      // true if last poll was successful
-  float    pv_c;         // process variable (°C)
-  float    sv_c;         // setpoint (°C)
-  float    output_pct;   // controller MV1 output (%)
-  uint16_t status_raw;   // raw STATUS register
-  bool     run;
-  bool     man;
-  bool     prg;
-  bool     op1;
-  bool     op2;
-  bool     au1;
-  bool     au2;
-  bool     atu;
-};
-
 PidSnapshot pid_ln2 = {
   false,   // comm_ok
   0.0f,    // pv_c
@@ -181,8 +294,13 @@ PidSnapshot pid_ln2 = {
   false, false, false    // au1, au2, atu
 };
 
-// Legacy scalar LN2 PV (kept for backwards compatibility with Node-RED)
-float ln2_pv_c = 0.0f;
+// LN2 valve control mode + tuning (SET_CONFIG ln2_*, RAM only). STATE
+// keeps the valve open whenever the state wants LN2 and leaves the
+// temperature to the LC108's own output.
+Ln2Controller ln2Ctl;
+
+// Recipe ETA / LN2-remaining estimator, fed once per loop pass
+MillEta millEta;
 
 // -------------------------------------------------------------------
 // LC108 (LN2 Controller) Modbus configuration (LN2 channel)
@@ -191,65 +309,23 @@ float ln2_pv_c = 0.0f;
 // LN2 controller is Modbus ID 3 on the shared RS-485 bus
 static const uint8_t  LC108_LN2_ADDR    = 3;
 
-// LC108 manual uses 1-based register numbering; Modbus FC03 uses 0-based
-// addresses. If the PV is register 1, SV is register 6 in the manual,
-// their FC03 addresses are 0 and 5 respectively.
-static const uint16_t LC108_REG_PV_ADDR = 0;   // PV  (°C × 10), register 1 → address 0
-static const uint16_t LC108_REG_SV_ADDR = 5;   // SV  (°C × 10), register 6 → address 5
-
-// "Live block" as per your map: PV, MV1, MV2, MVFB, STATUS, SV
-static const uint16_t LC108_REG_LIVE_BASE  = 0;  // PV
-static const uint16_t LC108_REG_LIVE_COUNT = 6;  // PV..SV (0..5)
-
-static const uint32_t LC108_TIMEOUT_MS  = 50;  // per-request timeout
-
-// STATUS bit masks (adjust if your map differs)
-static const uint16_t LC108_STAT_RUN  = 0x0001;
-static const uint16_t LC108_STAT_MAN  = 0x0002;
-static const uint16_t LC108_STAT_PRG  = 0x0004;
-static const uint16_t LC108_STAT_OP1  = 0x0010;
-static const uint16_t LC108_STAT_OP2  = 0x0020;
-static const uint16_t LC108_STAT_AU1  = 0x0040;
-static const uint16_t LC108_STAT_AU2  = 0x0080;
-static const uint16_t LC108_STAT_ATU  = 0x0100;
-
-// Live-block struct for a single FC03 read
-struct Lc108LiveBlock {
-  int16_t  pv_x10;      // signed PV (°C × 10)
-  uint16_t mv1_raw;     // 0..1000 => 0..100 %
-  uint16_t mv2_raw;
-  uint16_t mvfb_raw;
-  uint16_t status_raw;
-  int16_t  sv_x10;      // signed SV (°C × 10)
-};
-
-// -------------------------------------------------------------------
-// Cycle timing
-// -------------------------------------------------------------------
+// Per-slave bus handle + health (adaptive timeout, retries, backoff)
+Lc108Slave lc108Ln2;
 
-// cycle_target: seconds per cycle
-// cycle_total:  number of cycles requested
-// cycle_index:  0 when idle, 1..cycle_total when running/completed
-uint32_t cycle_current    = 0;
-uint32_t cycle_target     = 0;
-uint32_t time_remaining_s = 0;
-
-uint32_t cycle_total      = 0;
-uint32_t cycle_index      = 0;
-
-unsigned long lastCycleTickMs = 0;
+// Plausibility checks on every good LN2 sample. Serious findings (stuck
+// PV, runaway) only fault the mill when anom_fault is enabled.
+AnomDetector anomLn2;
+bool         anomFaultEnabled = false;   // config anom_fault (RAM only)
+uint8_t      anomLn2Rising    = 0;       // new flags since the loop last looked
+uint32_t     anomCyclesAvg    = 0;       // CPU cycles per sample (EWMA 1/16)
+uint32_t     anomCyclesMax    = 0;
 
 // -------------------------------------------------------------------
 // Relay control (logical mapping)
 // -------------------------------------------------------------------
 
-// Physical channels 1..8 on the Waveshare relay board
-#define RELAY_MOTOR_ENABLE_CH     1   // shaker motor contactor
-#define RELAY_FAULT_INDICATOR_CH  2   // fault lamp / buzzer
-#define RELAY_LN2_VALVE_CH        3   // LN2 solenoid (simple state-based for now)
-#define RELAY_CABINET_FAN_CH      4   // enclosure / cabinet fan
-
-bool motorRelayState = false;   // our view of CH1
+// Which role is wanted in which state, switch-on order, stagger and
+// minimum on/off times live in Mill_Outputs; channels come from ioMap.
 
 // Helper: set a relay channel with basic sanity/error logging
 bool setRelayChannel(uint8_t ch, bool on) {
@@ -267,18 +343,16 @@ bool setRelayChannel(uint8_t ch, bool on) {
 }
 
 // -------------------------------------------------------------------
-// Interlock tracking & fault info
+// Interlock tracking
 // -------------------------------------------------------------------
 
-bool allInterlocksOk() {
-  return estop_ok && lid_locked && door_closed;
-}
-
 bool lastInterlocksOk = false;
 
-// Fault metadata for Node-RED
-uint8_t fault_code   = 0;       // 0 = none; 1=ESTOP, 2=LID, 3=DOOR, 10=INTERLOCK
-String  fault_reason = "";      // e.g. "ESTOP_OPEN", "LID_OPEN", etc.
+// -------------------------------------------------------------------
+// Shared snapshot (written by loop(), read by publishers / Modbus / tasks)
+// -------------------------------------------------------------------
+
+SnapshotLatch<MillSnapshot> millSnapshot;
 
 // -------------------------------------------------------------------
 // MQTT timing
@@ -291,377 +365,366 @@ unsigned long lastMqttReconnectAttempt = 0;
 const unsigned long MQTT_RECONNECT_MS  = 2000;  // 2 s
 
 bool lastMqttConnected = false;
+bool lastNetUp         = false;
+uint32_t mqttReconnects = 0;   // successful connects after the first
+
+unsigned long lastDiagPublishMs       = 0;
+const unsigned long DIAG_PUBLISH_MS   = 5000;   // 0.2 Hz diagnostics
+
+// PubSubClient's packet buffer (allocated once in setup()) bounds both
+// directions: diag is the largest frame out, a command body is copied
+// into one static buffer of the same size on the way in
+const uint16_t MQTT_BUFFER_SIZE = 2688;
+const size_t   DIAG_JSON_MAX    = 2432;   // ~2.1 KB with 10 tasks in "mem" + "ota"
+
+// Retained snapshot / config echo: each write lands in the broker's
+// persistence, so state changes go out at most every 2 s and the PV is
+// refreshed once a minute; config echoes at most every 5 s
+const uint32_t RETAIN_LAST_GAP_MS     = 2000;
+const uint32_t RETAIN_LAST_REFRESH_MS = 60000;
+const uint32_t RETAIN_CONFIG_GAP_MS   = 5000;
+RetainSlot retainLast;
+RetainSlot retainConfig;
+
+// QoS 1 commands: redeliveries by (seq, cmd), and a max age for commands
+// the broker queued while we were offline. STOP / HOLD only make the
+// mill safer and run whatever their age.
+CmdDedup cmdDedup;
+const uint32_t CMD_MAX_AGE_S = 30;
+uint32_t cmdStale = 0;
+
+// Background pattern on the RGB LED (serviceIndicators)
+uint16_t indicatorKey = 0xFFFF;
+
+// I2C bus load between diag publishes
+uint32_t      i2cTxLast     = 0;
+unsigned long i2cTxLastMs   = 0;
+
+// -------------------------------------------------------------------
+// Time sync (Pi over MQTT → UTC offset → PCF85063)
+// -------------------------------------------------------------------
+
+// Only touched from the loop task (mqttCallback runs inside
+// mqttClient.loop()), so no locking.
+TimeSync timeSync;
+
+unsigned long lastTimeReqMs = 0;
+const unsigned long TIME_SYNC_MS      = 60000;  // once disciplined
+const unsigned long TIME_SYNC_FAST_MS = 5000;   // until the Pi first answers
+
+// PCF85063 holds whole seconds: write it just after a UTC second edge
+const uint64_t RTC_WRITE_MS      = 600000;      // holdover refresh
+const uint16_t RTC_WRITE_EDGE_MS = 50;
+uint64_t lastRtcWriteMono = 0;
+bool     rtcWriteDue      = false;
+
+// Monotonic ms since boot; 64-bit, does not wrap like millis()
+static inline uint64_t monoMs() {
+  return (uint64_t)(esp_timer_get_time() / 1000);
+}
+
+static inline int64_t utcNowMs() {
+  return timesync_utc_ms(timeSync, monoMs());
+}
 
 // -------------------------------------------------------------------
-// PID polling timing (LN2 via Modbus)
+// Boot timing (diag "boot": ms since the app started, 0 = not yet)
 // -------------------------------------------------------------------
 
-unsigned long lastPidPollMs = 0;
-const unsigned long PID_POLL_MS = 1000;  // 1 s poll for LN2 PID
+struct BootTiming {
+  uint32_t safe_ms;     // relay expander written, all off
+  uint32_t setup_ms;    // setup() done
+  uint32_t net_ms;      // Ethernet link up with IP
+  uint32_t mqtt_ms;     // first broker connect
+  uint32_t status_ms;   // first status frame published
+  uint32_t pid_ms;      // first good LC108 poll
+};
+BootTiming bootTiming;
+
+// First call per milestone only
+static void bootMark(uint32_t &slot, const char *what) {
+  if (slot != 0) return;
+  slot = (uint32_t)monoMs() | 1u;
+  Serial.print("[BOOT] ");
+  Serial.print(what);
+  Serial.print(" at ");
+  Serial.print(slot);
+  Serial.println(" ms");
+}
 
 // -------------------------------------------------------------------
-// Forward declarations
+// Mill schedule (Mill_Calendar): timed recipe starts / stops, NVS-backed
 // -------------------------------------------------------------------
 
-void mqttCallback(char *topic, byte *payload, unsigned int length);
-void mqttReconnect();
-void publishStatus();
-void checkInterlocks();
-void handleCommand(const String &cmd);
-void handleConfig(const String &body);
-void updateCycleTimer();
-void updateRelayFromState();
-void updateFaultRelayFromState();
-void updateLn2RelayFromState();
-void updateFanRelayFromState();
-void pollPidLn2();
+static const uint16_t MILL_SCHEDULE_MAX = 256;          // 20 B per event
+static CalEvent schedEvents[MILL_SCHEDULE_MAX];
+static uint16_t schedHeap[MILL_SCHEDULE_MAX];
+static uint16_t schedPos[MILL_SCHEDULE_MAX];
+Calendar millSchedule;
 
-// Modbus helpers
-uint16_t modbus_crc16(const uint8_t *data, uint16_t len);
-bool lc108_read_holding(uint8_t slave,
-                        uint16_t reg,
-                        uint16_t count,
-                        uint16_t *out);
-bool lc108_read_u16(uint8_t addr, uint16_t reg, uint16_t *out);
-bool lc108_read_live_block(uint8_t addr, Lc108LiveBlock &out);
+// Events load before UTC is known; the heap is rebuilt once it is, and
+// again whenever time sync steps the clock
+bool     schedTimeKnown = false;
+uint32_t schedSteps     = 0;
+uint32_t schedSkipped   = 0;    // START due outside IDLE, not executed
+
+static const char *SCHED_NVS_NAMESPACE = "sched";
+static const char *SCHED_NVS_KEY       = "ev";
 
 // -------------------------------------------------------------------
-// Interlocks
+// Firmware update (Mill_Ota): HTTP pull into the inactive app slot
 // -------------------------------------------------------------------
 
-void checkInterlocks() {
-  // Raw DIN reads: HIGH = 1, LOW = 0 (because of INPUT_PULLUP)
-  bool din_estop = DIN_Read_CH1();
-  bool din_lid   = DIN_Read_CH2();
-  bool din_door  = mirror_door_to_lid ? din_lid : DIN_Read_CH3();
-
-  // Invert semantics so:
-  //   LOW  (pressed / closed to GND) = OK
-  //   HIGH (released / open / broken) = FAULT
-  estop_ok    = (din_estop == LOW);
-  lid_locked  = (din_lid   == LOW);
-  door_closed = (din_door  == LOW);
-}
+// Command, transfer and health check all run on the loop task. The image
+// passes through one 1 KB slice on its way to esp_ota_write(); at most
+// OTA_PASS_BYTES per loop pass, so a transfer never holds the loop.
+OtaSession     ota;
+NetworkClient  otaClient;
+static uint8_t otaSlice[1024];
+const size_t   OTA_PASS_BYTES = 4096;
+uint8_t        otaPctSent     = 0;     // progress published in 10 % steps
+
+struct OtaFlash {
+  const esp_partition_t *part;
+  esp_ota_handle_t       handle;
+};
+OtaFlash otaFlash;
+
+// A new image boots PENDING_VERIFY (verifyRollbackLater): it is kept once
+// the control loop and every supervised task have run on time for
+// OTA_HEALTH_UP_MS in a row (supervisor_healthy(); the broker does not
+// count, an outage must not roll back a good image). If that has not
+// happened by OTA_HEALTH_DEADLINE_MS it is rolled back, but only from
+// IDLE. A crash or watchdog reset before then rolls back in the bootloader.
+const uint32_t OTA_HEALTH_UP_MS       = 60000;
+const uint32_t OTA_HEALTH_DEADLINE_MS = 300000;
+bool           otaPendingVerify       = false;
+uint32_t       otaHealthyFromMs       = 0;         // start of the current healthy stretch
+bool           otaRollbackWaiting     = false;     // deadline passed outside IDLE
+const char    *otaRolledBack          = nullptr;   // label of the image that was refused
 
 // -------------------------------------------------------------------
-// publishStatus Debugging wrapper
+// PID polling timing (LN2 via Modbus)
 // -------------------------------------------------------------------
 
-bool publishStatusWithDebug(const char *topic, const char *payload) {
-  bool ok = mqttClient.publish(topic, payload);
-  if (!ok) {
-    Serial.print("[MQTT] publishStatus() FAILED for topic ");
-    Serial.println(topic);
-  }
-  return ok;
-}
+unsigned long lastPidPollMs = 0;
+const unsigned long PID_POLL_MS = 1000;  // 1 s poll for LN2 PID (backs off when dead)
 
 // -------------------------------------------------------------------
-// Cycle timer
+// Modbus TCP register image (served to SCADA, refreshed from loop())
 // -------------------------------------------------------------------
 
-void updateCycleTimer() {
-  unsigned long now = millis();
-
-  if (millState == MILL_RUN && cycle_target > 0 && cycle_total > 0 && cycle_index > 0) {
-    if (lastCycleTickMs == 0) {
-      lastCycleTickMs = now;
-      return;
-    }
-
-    unsigned long dt = now - lastCycleTickMs;
-    if (dt >= 1000) {
-      uint32_t inc = dt / 1000;
-      lastCycleTickMs += inc * 1000;
-
-      cycle_current += inc;
-      if (cycle_current >= cycle_target) {
-        // End of this cycle
-        cycle_current    = cycle_target;
-        time_remaining_s = 0;
-
-        if (cycle_index < cycle_total) {
-          // Start next cycle
-          cycle_index++;
-          cycle_current    = 0;
-          time_remaining_s = cycle_target;
-          Serial.print("[CYCLE] Starting next cycle ");
-          Serial.print(cycle_index);
-          Serial.print(" / ");
-          Serial.println(cycle_total);
-        } else {
-          // All cycles complete → go to IDLE
-          millState        = MILL_IDLE;
-          cycle_index      = 0;
-          cycle_current    = 0;
-          time_remaining_s = 0;
-          Serial.println("[CYCLE] All cycles complete → IDLE");
-        }
-      } else {
-        time_remaining_s = cycle_target - cycle_current;
-      }
-    }
-  } else {
-    // Not running: keep tick anchor fresh so we don't "jump" later
-    lastCycleTickMs = now;
-  }
-}
+MbImage  mbImage;
+uint16_t mbHeartbeat = 0;
 
 // -------------------------------------------------------------------
-// Relay control (CH1 follows RUN state)
+// Forward declarations
 // -------------------------------------------------------------------
 
-void updateRelayFromState() {
-  bool wantMotor = (millState == MILL_RUN);
-
-  if (wantMotor != motorRelayState) {
-    if (setRelayChannel(RELAY_MOTOR_ENABLE_CH, wantMotor)) {
-      motorRelayState = wantMotor;
-      Serial.print("[RELAY] MOTOR CH");
-      Serial.print(RELAY_MOTOR_ENABLE_CH);
-      Serial.println(wantMotor ? " → ON" : " → OFF");
-    } else {
-      Serial.println("[RELAY] Failed to set motor relay");
-    }
-  }
-}
+void mqttCallback(char *topic, byte *payload, unsigned int length);
+void mqttReconnect();
+void publishStatus(const MillSnapshot &snap);
+void commitMillSnapshot();
+void checkInterlocks();
+MillAckResult handleCommand(const char *cmd);
+MillAckResult handleConfig(const char *body, char *detail, size_t detailLen);
+static MillConfig liveConfig();
+MillAckResult handleIoMap(const char *body, char *detail, size_t detailLen);
+void loadIoMap();
+void pollPidLn2();
+void publishDiag(const MillSnapshot &snap);
+void refreshModbusImage(const MillSnapshot &snap);
+bool modbusCommand(MbCoil coil);
+static bool configToken(const char *body, const char *key, char *out, size_t outLen);
+void seedTimeFromRtc();
+void requestTimeSync();
+void handleTimeResponse(const char *body, uint64_t t3);
+void serviceRtc();
+void loadSchedule();
+MillAckResult handleScheduleAdd(const char *body, char *detail, size_t detailLen);
+MillAckResult handleScheduleDel(const char *body, char *detail, size_t detailLen);
+void publishSchedule();
+void serviceSchedule();
+void serviceIndicators(const MillSnapshot &snap);
+void loadDeviceId();
+MillAckResult handleDeviceId(const char *body);
+void publishRetained(const MillSnapshot &snap);
+static const char *otaImageStateStr(esp_ota_img_states_t st);
+void otaBootCheck();
+void serviceOta();
 
 // -------------------------------------------------------------------
-// Fault relay (CH2) follows FAULT state
+// Interlocks
 // -------------------------------------------------------------------
 
-void updateFaultRelayFromState() {
-  static bool lastFaultRelay = false;
-
-  bool wantFault = (millState == MILL_FAULT);
+// Reads DINTask's debounced input word; no GPIO access here. Polarity
+// comes from the I/O map (default: LOW / closed to GND = OK).
+void checkInterlocks() {
+  uint8_t din = DIN_Get_Word();
 
-  if (wantFault != lastFaultRelay) {
-    if (setRelayChannel(RELAY_FAULT_INDICATOR_CH, wantFault)) {
-      lastFaultRelay = wantFault;
-      Serial.print("[RELAY] FAULT CH");
-      Serial.print(RELAY_FAULT_INDICATOR_CH);
-      Serial.println(wantFault ? " → ON" : " → OFF");
-    } else {
-      Serial.println("[RELAY] Failed to set fault relay");
-    }
-  }
+  mill.interlocks_ok = io_interlocks_ok(ioMap, din);   // all mapped signals
+  mill.estop_ok      = io_signal_ok(ioMap, din, IO_SIG_ESTOP);
+  mill.lid_locked    = io_signal_ok(ioMap, din, IO_SIG_LID);
+  mill.door_closed   = io_signal_ok(ioMap, din, IO_SIG_DOOR);
 }
 
 // -------------------------------------------------------------------
-// LN2 valve relay (CH3) – simple state-based
-// For now: ON in RUN or HOLD; OFF otherwise.
-// Later: may add PV-based control or hysteresis here.
+// I/O map (NVS + SET_IOMAP)
 // -------------------------------------------------------------------
 
-void updateLn2RelayFromState() {
-  static bool lastLn2 = false;
+// Stored config if present and valid, factory default otherwise
+void loadIoMap() {
+  IoMapConfig cfg;
+  bool fromNvs = false;
 
-  bool wantLn2 = (millState == MILL_RUN || millState == MILL_HOLD);
-
-  if (wantLn2 != lastLn2) {
-    if (setRelayChannel(RELAY_LN2_VALVE_CH, wantLn2)) {
-      lastLn2 = wantLn2;
-      Serial.print("[RELAY] LN2 CH");
-      Serial.print(RELAY_LN2_VALVE_CH);
-      Serial.println(wantLn2 ? " → ON" : " → OFF");
-    } else {
-      Serial.println("[RELAY] Failed to set LN2 relay");
+  Preferences prefs;
+  if (prefs.begin(IOMAP_NVS_NAMESPACE, true)) {
+    if (prefs.getBytesLength(IOMAP_NVS_KEY) == sizeof(cfg) &&
+        prefs.getBytes(IOMAP_NVS_KEY, &cfg, sizeof(cfg)) == sizeof(cfg)) {
+      fromNvs = true;
     }
+    prefs.end();
   }
-}
 
-// -------------------------------------------------------------------
-// Cabinet fan relay (CH4)
-// For now: ON in RUN, HOLD, or FAULT; OFF in IDLE.
-// -------------------------------------------------------------------
-
-void updateFanRelayFromState() {
-  static bool lastFan = false;
-
-  bool wantFan = (millState == MILL_RUN ||
-                  millState == MILL_HOLD ||
-                  millState == MILL_FAULT);
-
-  if (wantFan != lastFan) {
-    if (setRelayChannel(RELAY_CABINET_FAN_CH, wantFan)) {
-      lastFan = wantFan;
-      Serial.print("[RELAY] FAN CH");
-      Serial.print(RELAY_CABINET_FAN_CH);
-      Serial.println(wantFan ? " → ON" : " → OFF");
-    } else {
-      Serial.println("[RELAY] Failed to set fan relay");
+  const char *err = nullptr;
+  if (!fromNvs || !io_map_compile(cfg, ioMap, &err)) {
+    if (fromNvs) {
+      Serial.print("[IOMAP] stored map rejected (");
+      Serial.print(err);
+      Serial.println("), using default");
     }
+    io_map_default(cfg);
+    io_map_compile(cfg, ioMap, &err);
   }
+  ioMapCfg = cfg;
+
+  char spec[IO_MAP_SPEC_MAX];
+  io_map_format(ioMapCfg, spec, sizeof(spec));
+  Serial.print("[IOMAP] ");
+  Serial.print(fromNvs ? "NVS: " : "default: ");
+  Serial.println(spec);
 }
 
-// -------------------------------------------------------------------
-// LC108: Read holding registers via RS-485 (function 0x03)
-//
-// slave   = Modbus device address (1..247)
-// reg     = start register *address* (0-based)
-// count   = number of 16-bit registers
-// out[]   = caller-provided array of length >= count
-//
-// Returns true on success, false on any error (timeout/CRC/etc).
-// -------------------------------------------------------------------
-bool lc108_read_holding(uint8_t slave,
-                        uint16_t reg,
-                        uint16_t count,
-                        uint16_t *out) {
-  if (count == 0 || count > 16) {
-    return false;  // sanity limit
-  }
-
-  // Build request: [slave][0x03][reg hi][reg lo][cnt hi][cnt lo][CRClo][CRChi]
-  uint8_t req[8];
-  req[0] = slave;
-  req[1] = 0x03;               // Read Holding Registers
-  req[2] = (reg >> 8) & 0xFF;
-  req[3] = (reg     ) & 0xFF;
-  req[4] = (count >> 8) & 0xFF;
-  req[5] = (count     ) & 0xFF;
-
-  uint16_t crc = modbus_crc16(req, 6);
-  req[6] = crc & 0xFF;
-  req[7] = (crc >> 8) & 0xFF;
-
-  // Clear any stale bytes in RX buffer
-  while (rs485.available()) {
-    (void)rs485.read();
-  }
-
-  // Send request
-  rs485.write(req, sizeof(req));
-  rs485.flush();
-
-  // Expected response:
-  // [slave][0x03][byteCount][data ...][CRClo][CRChi]
-  // byteCount = 2 * count
-  const uint8_t expectedByteCount = 2 * count;
-  const uint8_t expectedLen       = 5 + expectedByteCount;
-  if (expectedLen > 64) {
-    return false;  // safety
-  }
-
-  uint8_t resp[64];
-  size_t  got = rs485.readBytes(resp, expectedLen);
-
-  if (got != expectedLen) {
-    // Timeout / short frame
-    Serial.print("[LC108] read_holding: short read got=");
-    Serial.print(got);
-    Serial.print(" expected=");
-    Serial.println(expectedLen);
-    return false;
+// {"cmd":"SET_IOMAP","map":"estop=1L,lid=2L,door=3L;motor=1,fault=2,ln2=3,fan=4"}
+// Only accepted in IDLE; all relays are dropped before the new map applies.
+// detail gets the reason for the ack when refused.
+MillAckResult handleIoMap(const char *body, char *detail, size_t detailLen) {
+  if (mill.state != MILL_IDLE) {
+    snprintf(detail, detailLen, "NOT_IDLE");
+    Serial.println("[IOMAP] SET_IOMAP refused (only in IDLE)");
+    return MILL_ACK_BLOCKED;
   }
 
-  // Check header
-  if (resp[0] != slave || resp[1] != 0x03 || resp[2] != expectedByteCount) {
-    Serial.print("[LC108] read_holding: bad header id=");
-    Serial.print(resp[0]);
-    Serial.print(" func=");
-    Serial.print(resp[1]);
-    Serial.print(" bc=");
-    Serial.println(resp[2]);
-    return false;
+  const char *key    = strstr(body, "\"map\"");
+  const char *colon  = key ? strchr(key + 5, ':') : nullptr;
+  const char *quote1 = colon ? strchr(colon, '\"') : nullptr;
+  const char *quote2 = quote1 ? strchr(quote1 + 1, '\"') : nullptr;
+  if (!quote2) {
+    snprintf(detail, detailLen, "NO_MAP");
+    Serial.println("[IOMAP] SET_IOMAP missing \"map\"");
+    return MILL_ACK_REJECTED;
   }
-
-  // Check CRC
-  uint16_t crcRx   = resp[expectedLen - 2] | (uint16_t(resp[expectedLen - 1]) << 8);
-  uint16_t crcCalc = modbus_crc16(resp, expectedLen - 2);
-  if (crcRx != crcCalc) {
-    Serial.print("[LC108] read_holding: CRC mismatch resp=0x");
-    Serial.print(crcRx, HEX);
-    Serial.print(" calc=0x");
-    Serial.println(crcCalc, HEX);
-    return false;
+  char spec[IO_MAP_SPEC_MAX];
+  size_t specLen = (size_t)(quote2 - quote1 - 1);
+  if (specLen >= sizeof(spec)) {
+    snprintf(detail, detailLen, "TOO_LONG");
+    Serial.println("[IOMAP] rejected: map too long");
+    return MILL_ACK_REJECTED;
   }
-
-  // Extract registers
-  for (uint8_t i = 0; i < count; ++i) {
-    uint8_t hi = resp[3 + 2 * i];
-    uint8_t lo = resp[4 + 2 * i];
-    out[i] = (uint16_t(hi) << 8) | lo;
+  memcpy(spec, quote1 + 1, specLen);
+  spec[specLen] = '\0';
+
+  IoMapConfig   cfg;
+  IoMapCompiled compiled;
+  const char   *err = nullptr;
+  if (!io_map_parse(spec, cfg, &err) ||
+      !io_map_compile(cfg, compiled, &err)) {
+    snprintf(detail, detailLen, "%s", err);
+    Serial.print("[IOMAP] rejected: ");
+    Serial.println(err);
+    return MILL_ACK_REJECTED;
   }
 
-  return true;
-}
+  // Old role→channel assignments are void: everything off, then switch
+  supervisor_safe_outputs();
+  outputs_reset(millis());
+  ioMapCfg = cfg;
+  ioMap    = compiled;
+  checkInterlocks();
 
-// -------------------------------------------------------------------
-// Modbus CRC-16 (standard polynomial 0xA001, initial 0xFFFF)
-// -------------------------------------------------------------------
-uint16_t modbus_crc16(const uint8_t *data, uint16_t len) {
-  uint16_t crc = 0xFFFF;
-  for (uint16_t pos = 0; pos < len; ++pos) {
-    crc ^= data[pos];
-    for (uint8_t i = 0; i < 8; ++i) {
-      if (crc & 0x0001) {
-        crc >>= 1;
-        crc ^= 0xA001;
-      } else {
-        crc >>= 1;
-      }
-    }
+  Preferences prefs;
+  if (prefs.begin(IOMAP_NVS_NAMESPACE, false)) {
+    prefs.putBytes(IOMAP_NVS_KEY, &ioMapCfg, sizeof(ioMapCfg));
+    prefs.end();
   }
-  return crc;
+
+  Serial.print("[IOMAP] applied + saved: ");
+  Serial.println(spec);
+  return MILL_ACK_DONE;
 }
 
 // -------------------------------------------------------------------
-// Low-level: read one holding register (function 0x03) as uint16_t
-//  addr  = slave address
-//  reg   = starting register *address* (0-based)
-//  out   = filled with raw 16-bit value on success
-// Returns true on success, false on timeout/CRC/protocol error.
+// publishStatus Debugging wrapper
 // -------------------------------------------------------------------
-bool lc108_read_u16(uint8_t addr, uint16_t reg, uint16_t *out) {
-  if (!out) return false;
 
-  uint16_t tmp = 0;
-  if (!lc108_read_holding(addr, reg, 1, &tmp)) {
-    return false;
+bool publishStatusWithDebug(const char *topic, const char *payload) {
+  bool ok = mqttClient.publish(topic, payload);
+  if (!ok) {
+    Serial.print("[MQTT] publishStatus() FAILED for topic ");
+    Serial.println(topic);
   }
-
-  *out = tmp;
-  return true;
+  return ok;
 }
 
 // -------------------------------------------------------------------
-// LC108: read the "live" block (PV..SV) in one transaction
+// State machine log hook
 // -------------------------------------------------------------------
-bool lc108_read_live_block(uint8_t addr, Lc108LiveBlock &out) {
-  uint16_t regs[LC108_REG_LIVE_COUNT];
 
-  if (!lc108_read_holding(addr, LC108_REG_LIVE_BASE,
-                          LC108_REG_LIVE_COUNT, regs)) {
-    return false;
+// Module log sink; lines carry UTC (hh:mm:ss.mmm) once time is known
+void millLogToSerial(const char *line) {
+  int64_t utc = utcNowMs();
+  if (utc > 0) {
+    TsCivil c;
+    timesync_to_civil(utc, c);
+    char stamp[16];
+    snprintf(stamp, sizeof(stamp), "%02u:%02u:%02u.%03u ",
+             c.hour, c.minute, c.second, c.ms);
+    Serial.print(stamp);
   }
-
-  out.pv_x10     = (int16_t)regs[0];
-  out.mv1_raw    = regs[1];
-  out.mv2_raw    = regs[2];
-  out.mvfb_raw   = regs[3];
-  out.status_raw = regs[4];
-  out.sv_x10     = (int16_t)regs[5];
-
-  return true;
+  Serial.println(line);
 }
 
 // -------------------------------------------------------------------
 // LN2 PID polling (real LC108 over RS-485 / Modbus RTU)
 //
 // Reads PV/MV1/MV2/MVFB/STATUS/SV from LC108 and updates pid_ln2 + ln2_pv_c.
-// On any error, comm_ok is set false and previous PV/SV/flags are kept.
+// Non-blocking: called every pass while a poll is in flight, it returns
+// at once until the response (or the last retry) is in, so loop() never
+// waits on RS-485. comm_ok follows the slave's health score, so a single
+// glitch (already retried) does not flash a comm error on the HMI. On
+// error the previous PV/SV/flags are kept.
 // -------------------------------------------------------------------
 void pollPidLn2() {
   Lc108LiveBlock live;
 
-  if (!lc108_read_live_block(LC108_LN2_ADDR, live)) {
-    pid_ln2.comm_ok = false;
-    Serial.println("[LC108] pollPidLn2: comm error (timeout/CRC/header)");
+  Lc108PollStatus st = lc108_poll_live_block(lc108Ln2, live);
+  if (st == LC108_POLL_BUSY) return;
+  bool ok = (st == LC108_POLL_OK);
+  if (ok) bootMark(bootTiming.pid_ms, "first PID poll");
+  pid_ln2.comm_ok = lc108Ln2.h.online;
+  if (!pid_ln2.comm_ok) {
+    anom_gap(anomLn2);                 // detectors restart once it is back
+  }
+
+  if (!ok) {
+    Serial.print("[LC108] pollPidLn2: comm error (");
+    Serial.print(lc108_error_str(lc108Ln2.h.last_error));
+    Serial.print(", score=");
+    Serial.print(lc108Ln2.h.score);
+    Serial.println(")");
     return;
   }
 
-  pid_ln2.comm_ok    = true;
   pid_ln2.pv_c       = live.pv_x10 / 10.0f;
   pid_ln2.sv_c       = live.sv_x10 / 10.0f;
   pid_ln2.output_pct = live.mv1_raw / 10.0f;   // 0..1000 → 0.0..100.0 %
@@ -678,8 +741,21 @@ void pollPidLn2() {
   pid_ln2.au2 = (s & LC108_STAT_AU2);
   pid_ln2.atu = (s & LC108_STAT_ATU);
 
-  // Keep legacy scalar in sync for any old wiring
-  ln2_pv_c = pid_ln2.pv_c;
+  // Plausibility checks on the raw registers (integer only)
+  uint8_t  before = anomLn2.flags;
+  uint32_t c0     = ESP.getCycleCount();
+  uint8_t  flags  = anom_sample(anomLn2, live.pv_x10, live.sv_x10, live.mv1_raw, millis());
+  uint32_t cyc    = ESP.getCycleCount() - c0;
+  anomCyclesAvg   = (anomCyclesAvg == 0) ? cyc : anomCyclesAvg + ((int32_t)(cyc - anomCyclesAvg) >> 4);
+  if (cyc > anomCyclesMax) anomCyclesMax = cyc;
+
+  if (flags != before) {
+    char list[40];
+    anom_flags_str(flags, list, sizeof(list));
+    Serial.print("[ANOM] pid_ln2: ");
+    Serial.println(flags ? list : "clear");
+  }
+  anomLn2Rising |= flags & (uint8_t)~before;
 
   Serial.print("[LC108] PV=");
   Serial.print(pid_ln2.pv_c, 2);
@@ -689,336 +765,1154 @@ void pollPidLn2() {
   Serial.print(pid_ln2.output_pct, 1);
   Serial.print("%  STATUS=0x");
   Serial.print(pid_ln2.status_raw, HEX);
-  Serial.println("  (ID=3)");
+  Serial.print("  (ID=");
+  Serial.print(lc108Ln2.addr);
+  Serial.print(", tmo=");
+  Serial.print(lc108Ln2.h.timeout_ms);
+  Serial.println(" ms)");
+}
+
+// -------------------------------------------------------------------
+// Snapshot commit (loop task is the only writer)
+// -------------------------------------------------------------------
+
+// Same inputs for the estimator update and its snapshot
+static EtaInputs etaInputs() {
+  EtaInputs in;
+  in.state            = mill.state;
+  in.cycle_index      = mill.cycle_index;
+  in.cycle_total      = mill.cycle_total;
+  in.cycle_target     = mill.cycle_target;
+  in.cool_target      = mill.cool_target;
+  in.cooling          = mill.cool_phase;
+  in.time_remaining_s = mill.time_remaining_s;
+  in.pv_ok            = pid_ln2.comm_ok;
+  in.pv_c             = pid_ln2.pv_c;
+  in.sv_c             = isnan(ln2Ctl.sv_c) ? pid_ln2.sv_c : ln2Ctl.sv_c;
+  in.ln2_open         = outputs_role_on(IO_RELAY_LN2);
+  return in;
+}
+
+void commitMillSnapshot() {
+  MillSnapshot s;
+  s.seq                = millSnapshot.sequence() + 2;   // value after commit
+  s.commit_ms          = millis();
+  s.state              = mill.state;
+  s.substate           = mill.substate;
+  s.state_before_fault = mill.state_before_fault;
+  s.fault              = mill.fault;
+  s.cycle_current      = mill.cycle_current;
+  s.cycle_target       = mill.cycle_target;
+  s.time_remaining_s   = mill.time_remaining_s;
+  s.cycle_total        = mill.cycle_total;
+  s.cycle_index        = mill.cycle_index;
+  s.estop_ok           = mill.estop_ok;
+  s.lid_locked         = mill.lid_locked;
+  s.door_closed        = mill.door_closed;
+  s.pid_ln2            = pid_ln2;
+  s.utc_ms             = utcNowMs();
+  eta_snapshot(millEta, etaInputs(), s.eta);
+
+  millSnapshot.commit(s);
 }
 
 // -------------------------------------------------------------------
 // Status JSON publish
 // -------------------------------------------------------------------
 
-void publishStatus() {
-  String json;
-  json.reserve(400);
-
-  json += "{";
-
-  // state
-  json += "\"state\":\"";
-  switch (millState) {
-    case MILL_IDLE:  json += "IDLE";  break;
-    case MILL_RUN:   json += "RUN";   break;
-    case MILL_HOLD:  json += "HOLD";  break;
-    case MILL_FAULT: json += "FAULT"; break;
-  }
-  json += "\",";
-
-  // cycle_current
-  json += "\"cycle_current\":";
-  json += String(cycle_current);
-  json += ",";
-
-  // cycle_target
-  json += "\"cycle_target\":";
-  json += String(cycle_target);
-  json += ",";
-
-  // time_remaining_s
-  json += "\"time_remaining_s\":";
-  json += String(time_remaining_s);
-  json += ",";
-
-  // cycle_total
-  json += "\"cycle_total\":";
-  json += String(cycle_total);
-  json += ",";
-
-  // cycle_index
-  json += "\"cycle_index\":";
-  json += String(cycle_index);
-  json += ",";
-
-  // fault_code
-  json += "\"fault_code\":";
-  json += String(fault_code);
-  json += ",";
-
-  // fault_reason (string)
-  json += "\"fault_reason\":\"";
-  json += fault_reason;
-  json += "\",";
-
-  // legacy pid block (for existing UI) – uses ln2_pv_c
-  json += "\"pid\":{";
-  json += "\"pv_c\":";
-  json += String(ln2_pv_c, 1);
-  json += "},";
-
-  // richer LN2 PID snapshot (new)
-  json += "\"pid_ln2\":{";
-  json += "\"pv_c\":";
-  json += String(pid_ln2.pv_c, 1);
-  json += ",\"sv_c\":";
-  json += String(pid_ln2.sv_c, 1);
-  json += ",\"output_pct\":";
-  json += String(pid_ln2.output_pct, 1);
-  json += ",\"comm_ok\":";
-  json += pid_ln2.comm_ok ? "true" : "false";
-  json += ",\"status_raw\":";
-  json += String(pid_ln2.status_raw);
-  json += ",\"run\":";
-  json += pid_ln2.run ? "true" : "false";
-  json += ",\"man\":";
-  json += pid_ln2.man ? "true" : "false";
-  json += ",\"prg\":";
-  json += pid_ln2.prg ? "true" : "false";
-  json += ",\"op1\":";
-  json += pid_ln2.op1 ? "true" : "false";
-  json += ",\"op2\":";
-  json += pid_ln2.op2 ? "true" : "false";
-  json += ",\"au1\":";
-  json += pid_ln2.au1 ? "true" : "false";
-  json += ",\"au2\":";
-  json += pid_ln2.au2 ? "true" : "false";
-  json += ",\"atu\":";
-  json += pid_ln2.atu ? "true" : "false";
-  json += "},";
-
-  // interlocks
-  json += "\"interlocks\":{";
-  json += "\"door_closed\":";
-  json += door_closed ? "true" : "false";
-  json += ",";
-  json += "\"estop_ok\":";
-  json += estop_ok ? "true" : "false";
-  json += ",";
-  json += "\"lid_locked\":";
-  json += lid_locked ? "true" : "false";
-  json += "}";
-
-  json += "}";
+void publishStatus(const MillSnapshot &snap) {
+  // Loop task only (commands and FAULT entry publish from there too)
+  static char json[MILL_STATUS_JSON_MAX];
+  size_t len = mill_status_json(snap, json, sizeof(json));
+  if (len == 0) {
+    Serial.println("[STATUS] JSON too long; frame dropped");
+    return;
+  }
 
   if (STATUS_SERIAL_DEBUG) {
     Serial.print("[STATUS] len=");
-    Serial.println(json.length());
+    Serial.println(len);
     Serial.print("[STATUS] ");
     Serial.println(json);
   }
 
   // Use debug wrapper so we can see if MQTT actually sends
-  publishStatusWithDebug(MQTT_STATUS_TOPIC, json.c_str());
+  if (publishStatusWithDebug(topics.status, json)) {
+    bootMark(bootTiming.status_ms, "first status");
+  }
+
+  publishRetained(snap);
 }
 
 // -------------------------------------------------------------------
-// Command handling
+// Retained snapshot + config echo (rate-limited, Mill_Retain)
 // -------------------------------------------------------------------
 
-void handleCommand(const String &cmd) {
-  // Always evaluate commands against *fresh* interlock state
-  checkInterlocks();
-  bool currentOk = allInterlocksOk();
-
-  // ---------------------------------------------------------------
-  // RESET_FAULT
-  // ---------------------------------------------------------------
-  if (cmd == "RESET_FAULT") {
-    if (millState == MILL_FAULT && currentOk) {
-
-      // "Soft" access fault:
-      //  - LID_OPEN (code 2) or DOOR_OPEN (code 3)
-      //  - occurred while we were in HOLD
-      //  - and we actually had a recipe defined
-      bool softAccessHoldFault =
-        ((fault_code == 2 /* LID_OPEN */ ||
-          fault_code == 3 /* DOOR_OPEN */) &&
-         lastStateBeforeFault == MILL_HOLD &&
-         cycle_total > 0);
-
-      if (softAccessHoldFault) {
-        // Restore HOLD and keep timing + cycle position
-        millState = MILL_HOLD;
-        Serial.println("[CMD] RESET_FAULT → HOLD (access fault cleared, timing preserved)");
-      } else {
-        // All other faults: fall back to a "hard" reset to IDLE
-        millState        = MILL_IDLE;
-        cycle_current    = 0;
-        time_remaining_s = 0;
-        cycle_index      = 0;  // reset multi-cycle index, but keep recipe config
-        Serial.println("[CMD] RESET_FAULT → IDLE, fault cleared");
-      }
+// {"id","fw", schema v1 keys (same names SET_CONFIG takes), "iomap"}
+static size_t configEchoJson(char *buf, size_t cap) {
+  char body[MILL_CONFIG_JSON_MAX];
+  if (mill_config_json(liveConfig(), body, sizeof(body)) == 0) return 0;
+  char ioSpec[IO_MAP_SPEC_MAX];
+  io_map_format(ioMapCfg, ioSpec, sizeof(ioSpec));
 
-      // Clear fault metadata either way
-      fault_code   = 0;
-      fault_reason = "";
-      lastStateBeforeFault = millState;
-    } else {
-      Serial.println("[CMD] RESET_FAULT ignored (not in FAULT or interlocks bad)");
+  int n = snprintf(buf, cap, "{\"id\":\"%s\",\"fw\":\"%s\",%s,\"iomap\":\"%s\"}",
+                   topics.id, FW_VERSION, body, ioSpec);
+  return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+void publishRetained(const MillSnapshot &snap) {
+  if (!mqttClient.connected()) return;
+  uint32_t now = millis();
+
+  static char last[MILL_LAST_JSON_MAX];
+  uint32_t key = mill_last_key(snap);
+  if (retain_due(retainLast, key, now)) {
+    size_t len = mill_last_json(snap, last, sizeof(last));
+    if (len && mqttClient.publish(topics.last, last, true)) {
+      retain_sent(retainLast, key, now);
     }
+  }
+
+  // The echo is built each time (~350 B snprintf); its hash is the key
+  static char cfg[MILL_ID_MAX + MILL_CONFIG_JSON_MAX + IO_MAP_SPEC_MAX + 48];
+  size_t len = configEchoJson(cfg, sizeof(cfg));
+  if (len == 0) return;
+  key = retain_hash(cfg, len);
+  if (retain_due(retainConfig, key, now) && mqttClient.publish(topics.config, cfg, true)) {
+    retain_sent(retainConfig, key, now);
+  }
+}
+
+// -------------------------------------------------------------------
+// Diagnostics JSON publish (mill/<id>/status/diag, low rate)
+// -------------------------------------------------------------------
+
+void publishDiag(const MillSnapshot &snap) {
+  const Lc108Health &h = lc108Ln2.h;
+
+  // Loop task only, like publishStatus()
+  static char json[DIAG_JSON_MAX];
+  JsonOut o = { json, sizeof(json), 0, false };
+
+  json_put(o, "{\"ts\":%lld,\"ts_ms\":%lld,", (long long)(snap.utc_ms / 1000), (long long)snap.utc_ms);
+
+  // clock discipline
+  uint64_t mono = monoMs();
+  json_put(o, "\"time\":{\"src\":\"%s\",\"rtt_ms\":%lu,\"err_ms\":%ld,\"slew_ms\":%ld,\"age_s\":",
+           timesync_source_str(timeSync.src), (unsigned long)timeSync.rtt_ms,
+           (long)timeSync.err_ms, (long)timeSync.slew_left_ms);
+  if (timeSync.src == TIME_SRC_SYNC) {
+    json_put(o, "%lu", (unsigned long)((mono - timeSync.last_sync_mono) / 1000));
+  } else {
+    json_put(o, "null");
+  }
+  json_put(o, ",\"samples\":%lu,\"rejects\":%lu,\"steps\":%lu},", (unsigned long)timeSync.samples,
+           (unsigned long)timeSync.rejects, (unsigned long)timeSync.steps);
+
+  // I2C bus load (TCA9554 relays + PCF85063)
+  uint32_t i2cTx = I2C_Get_Transactions();
+  unsigned long i2cNow = millis();
+  uint32_t i2cPerMin = (i2cTxLastMs != 0 && i2cNow != i2cTxLastMs)
+                         ? (uint32_t)((uint64_t)(i2cTx - i2cTxLast) * 60000UL / (i2cNow - i2cTxLastMs))
+                         : 0;
+  i2cTxLast   = i2cTx;
+  i2cTxLastMs = i2cNow;
+  json_put(o, "\"i2c\":{\"tx_per_min\":%lu,\"total\":%lu,\"recoveries\":%lu,\"devices\":[",
+           (unsigned long)i2cPerMin, (unsigned long)i2cTx, (unsigned long)I2C_Get_Recoveries());
+  I2C_Device_Stats i2cDev[I2C_Max_Devices];
+  uint8_t i2cN = I2C_Get_Stats(i2cDev, I2C_Max_Devices);
+  for (uint8_t i = 0; i < i2cN; i++) {
+    json_put(o, "%s{\"addr\":%u,\"name\":\"%s\",\"ok\":%lu,\"err\":%lu,\"merged\":%lu,\"avg_us\":%lu,\"max_us\":%lu}",
+             i ? "," : "", (unsigned)i2cDev[i].Addr, i2cDev[i].Name ? i2cDev[i].Name : "",
+             (unsigned long)i2cDev[i].Ok, (unsigned long)i2cDev[i].Errors,
+             (unsigned long)i2cDev[i].Merged, (unsigned long)i2cDev[i].Lat_Avg_us,
+             (unsigned long)i2cDev[i].Lat_Max_us);
+  }
+  json_put(o, "]},");
+
+  // calendar
+  json_put(o, "\"schedule\":{\"count\":%u,\"next_s\":%lu,\"fired\":%lu,\"missed\":%lu,\"skipped\":%lu},",
+           (unsigned)millSchedule.count, (unsigned long)cal_next_s(millSchedule),
+           (unsigned long)millSchedule.fired, (unsigned long)millSchedule.missed,
+           (unsigned long)schedSkipped);
+
+  json_put(o, "\"fault_code\":%u,\"fault_msg\":\"%s\",", (unsigned)snap.fault, faultReasonStr(snap.fault));
+
+  // per-device health
+  json_put(o, "\"devices\":{\"pid_ln2\":{\"online\":%s,\"score\":%u,\"timeout_ms\":%lu,"
+              "\"rtt_ms\":%.1f,\"poll_ms\":%lu,\"last_error\":\"%s\"}},",
+           h.online ? "true" : "false", (unsigned)h.score, (unsigned long)h.timeout_ms,
+           (double)(h.srtt_us / 1000.0f), (unsigned long)lc108_poll_interval_ms(lc108Ln2, PID_POLL_MS),
+           lc108_error_str(h.last_error));
+
+  // bus / broker counters
+  json_put(o, "\"comm\":{\"rs485_errors\":%lu,\"rs485_timeouts\":%lu,\"rs485_short\":%lu,"
+              "\"rs485_header\":%lu,\"rs485_crc\":%lu,\"rs485_retries\":%lu,\"rs485_ok\":%lu,",
+           (unsigned long)lc108_error_total(h), (unsigned long)h.timeouts,
+           (unsigned long)h.short_frames, (unsigned long)h.bad_header, (unsigned long)h.crc_errors,
+           (unsigned long)h.retries, (unsigned long)h.ok);
+  json_put(o, "\"mqtt_reconnects\":%lu,\"retained_writes\":%lu,\"retained_held\":%lu,"
+              "\"cmd_duplicates\":%lu,\"cmd_stale\":%lu},",
+           (unsigned long)mqttReconnects, (unsigned long)(retainLast.writes + retainConfig.writes),
+           (unsigned long)(retainLast.held + retainConfig.held),
+           (unsigned long)cmdDedup.duplicates, (unsigned long)cmdStale);
+
+  // active I/O map
+  char ioSpec[IO_MAP_SPEC_MAX];
+  io_map_format(ioMapCfg, ioSpec, sizeof(ioSpec));
+  json_put(o, "\"iomap\":\"%s\",", ioSpec);
+
+  // debounced DIN word (bit n = CH(n+1), 1 = HIGH) + change count
+  json_put(o, "\"din\":{\"word\":%u,\"changes\":%lu},", (unsigned)DIN_Get_Word(),
+           (unsigned long)DIN_Get_Changes());
+
+  // LC108 plausibility (flags now, counters / cost since boot)
+  char anomList[40];
+  anom_flags_str(anomLn2.flags, anomList, sizeof(anomList));
+  json_put(o, "\"anomaly\":{\"pid_ln2\":{\"flags\":\"%s\",\"pv_var\":%.2f,\"roc_cps\":%.1f,"
+              "\"osc_period_s\":%lu,\"sat_s\":%lu,\"samples\":%lu},",
+           anomList, (double)(anomLn2.var / 100.0f), (double)(anomLn2.roc_last / 10.0f),
+           (unsigned long)(anom_osc_period_ms(anomLn2) / 1000UL),
+           (unsigned long)(anomLn2.sat_total_ms / 1000UL), (unsigned long)anomLn2.samples);
+  json_put(o, "\"fault\":%s,\"cpu_cycles\":{\"avg\":%lu,\"max\":%lu}},",
+           anomFaultEnabled ? "true" : "false", (unsigned long)anomCyclesAvg,
+           (unsigned long)anomCyclesMax);
+
+  // LN2 valve control + valve usage (this boot)
+  json_put(o, "\"ln2ctl\":{\"mode\":\"%s\",\"closed_loop\":%s,\"sv_c\":",
+           ln2ctl_mode_str(ln2Ctl.cfg.mode), ln2Ctl.closed_loop ? "true" : "false");
+  if (isnan(ln2Ctl.sv_c)) {
+    json_put(o, "null");
+  } else {
+    json_put(o, "%.1f", (double)ln2Ctl.sv_c);
+  }
+  json_put(o, ",\"duty\":%.2f,\"open_s\":%lu,\"cycles\":%lu},", (double)ln2Ctl.duty,
+           (unsigned long)(ln2Ctl.open_ms_total / 1000UL), (unsigned long)ln2Ctl.valve_cycles);
+
+  // control loop timing (this boot)
+  json_put(o, "\"loop\":{\"avg_us\":%lu,\"max_us\":%lu},",
+           (unsigned long)supervisor_loop_avg_us(), (unsigned long)supervisor_loop_max_us());
+
+  // heap against the end of setup(), stack high-water marks
+  MemReport m;
+  mem_report(m);
+  json_put(o, "\"mem\":{\"static\":%s,\"heap_free\":%lu,\"heap_min\":%lu,\"heap_largest\":%lu,"
+              "\"heap_setup\":%lu,\"alloc_failures\":%lu,\"static_bytes\":%lu,\"tasks\":[",
+           MILL_STATIC_ALLOC ? "true" : "false", (unsigned long)m.heap_free,
+           (unsigned long)m.heap_min, (unsigned long)m.heap_largest, (unsigned long)m.heap_setup,
+           (unsigned long)m.alloc_failures, (unsigned long)m.static_bytes);
+  for (uint8_t i = 0; i < m.task_count; i++) {
+    json_put(o, "%s{\"name\":\"%s\",\"stack\":%lu,\"hwm\":%lu}", i ? "," : "", m.task[i].name,
+             (unsigned long)m.task[i].stack_bytes, (unsigned long)m.task[i].hwm_bytes);
+  }
+  json_put(o, "]},");
+
+  // app slots + the last transfer of this boot
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  esp_ota_img_states_t   img     = ESP_OTA_IMG_UNDEFINED;
+  if (running) esp_ota_get_state_partition(running, &img);
+  json_put(o, "\"ota\":{\"running\":\"%s\",\"image\":\"%s\",\"rolled_back\":",
+           running ? running->label : "", otaImageStateStr(img));
+  if (otaRolledBack) {
+    json_put(o, "\"%s\"", otaRolledBack);
+  } else {
+    json_put(o, "null");
+  }
+  json_put(o, ",\"last\":\"%s\",\"error\":\"%s\"},", ota_state_str(ota.state),
+           ota_error_str(ota.error));
+
+  // reset cause + what the previous boot left behind
+  const SupBootInfo &b = supervisor_boot_info();
+  json_put(o, "\"boot\":{\"reset_reason\":\"%s\",\"count\":%lu",
+           supervisor_reset_reason_str(b.reset_reason), (unsigned long)b.boot_count);
+  json_put(o, ",\"timing_ms\":{\"safe\":%lu,\"setup\":%lu,\"net\":%lu,\"mqtt\":%lu,"
+              "\"status\":%lu,\"pid\":%lu}",
+           (unsigned long)bootTiming.safe_ms, (unsigned long)bootTiming.setup_ms,
+           (unsigned long)bootTiming.net_ms, (unsigned long)bootTiming.mqtt_ms,
+           (unsigned long)bootTiming.status_ms, (unsigned long)bootTiming.pid_ms);
+  if (b.valid) {
+    json_put(o, ",\"stalled\":\"%s\",\"phase\":\"%s\",\"late_ms\":%lu,\"prev_uptime_s\":%lu,"
+                "\"prev_loop_avg_us\":%lu,\"prev_loop_max_us\":%lu",
+             supervisor_task_str(b.stalled_task), supervisor_phase_str(b.stalled_phase),
+             (unsigned long)b.stalled_late_ms, (unsigned long)b.uptime_s,
+             (unsigned long)b.loop_avg_us, (unsigned long)b.loop_max_us);
+  }
+  json_put(o, "}}");
+
+  if (o.overflow) {
+    Serial.println("[DIAG] JSON too long; frame dropped");
     return;
   }
+  publishStatusWithDebug(topics.diag, json);
+}
 
-  // ---------------------------------------------------------------
-  // START (fresh start) or RESUME from HOLD
-  // ---------------------------------------------------------------
-  if (cmd == "START") {
-    Serial.println("[CMD] START received");
-    if (!currentOk) {
-      Serial.println("[CMD] START ignored → interlock not OK");
-      return;
-    }
+// -------------------------------------------------------------------
+// Time sync
+// -------------------------------------------------------------------
 
-    if (cycle_target == 0 || cycle_total == 0) {
-      Serial.println("[CMD] START ignored → no cycle config (cycle_target or total_cycles is 0)");
-      return;
-    }
+// Boot: coarse UTC from the PCF85063 until the Pi answers
+void seedTimeFromRtc() {
+  datetime_t dt;
+  if (PCF85063_Read_Time(&dt)) {
+    Serial.println("[TIME] RTC read failed, waiting for Pi");
+    return;
+  }
+  if (dt.year < 2024 || dt.month < 1 || dt.month > 12 || dt.day < 1) {
+    Serial.println("[TIME] RTC not set, waiting for Pi");
+    return;
+  }
+  TsCivil c = { dt.year, dt.month, dt.day, dt.dotw, dt.hour, dt.minute, dt.second, 0 };
+  timesync_seed(timeSync, timesync_from_civil(c), monoMs());
 
-    // Decide if this should be a RESUME (from HOLD) or a fresh START
-    bool resumeFromHold =
-      (millState == MILL_HOLD &&
-       cycle_total > 0 &&
-       cycle_target > 0 &&
-       cycle_index > 0 &&
-       cycle_current < cycle_target);
-
-    if (resumeFromHold) {
-      // RESUME: keep cycle_current & time_remaining_s as frozen in HOLD
-      millState       = MILL_RUN;
-      lastCycleTickMs = millis();  // restart timing from "now"
-      Serial.print("[CMD] RESUME → RUN at t=");
-      Serial.print(cycle_current);
-      Serial.print(" / ");
-      Serial.print(cycle_target);
-      Serial.print(" s, cycle ");
-      Serial.print(cycle_index);
-      Serial.print(" / ");
-      Serial.println(cycle_total);
-    } else {
-      // Fresh START: reset timing
-      millState        = MILL_RUN;
-      cycle_current    = 0;
-      time_remaining_s = cycle_target;
+  char line[48];
+  snprintf(line, sizeof(line), "[TIME] RTC %04u-%02u-%02u %02u:%02u:%02u UTC",
+           dt.year, dt.month, dt.day, dt.hour, dt.minute, dt.second);
+  Serial.println(line);
+}
 
-      if (cycle_index == 0) {
-        cycle_index = 1;
-      }
-      lastCycleTickMs = millis();
+void requestTimeSync() {
+  uint64_t t0 = monoMs();
+  uint32_t id = timesync_request(timeSync, t0);
 
-      Serial.print("[CMD] START → RUN: cycle_target_s=");
-      Serial.print(cycle_target);
-      Serial.print(" total_cycles=");
-      Serial.println(cycle_total);
-    }
+  char payload[64];
+  snprintf(payload, sizeof(payload), "{\"id\":%lu,\"t0\":%llu}",
+           (unsigned long)id, (unsigned long long)t0);
+  mqttClient.publish(topics.time_req, payload);
+}
 
-    lastStateBeforeFault = millState;
+static bool timeField(const char *body, const char *key, int64_t &out) {
+  char tok[24];
+  if (!configToken(body, key, tok, sizeof(tok))) return false;
+  char *end = nullptr;
+  long long v = strtoll(tok, &end, 10);
+  if (end == tok || *end != '\0') return false;
+  out = v;
+  return true;
+}
+
+// t3 is taken on entry to mqttCallback, before any parsing / printing
+void handleTimeResponse(const char *body, uint64_t t3) {
+  int64_t id, t0, t1, t2;
+  if (!timeField(body, "\"id\"", id) || !timeField(body, "\"t0\"", t0) ||
+      !timeField(body, "\"t1\"", t1) || !timeField(body, "\"t2\"", t2)) {
+    Serial.println("[TIME] malformed response");
+    return;
+  }
+  TimeSource before = timeSync.src;
+  if (!timesync_response(timeSync, (uint32_t)id, (uint64_t)t0, t1, t2, t3)) {
+    Serial.println("[TIME] response rejected (stale or slow)");
     return;
   }
 
-  // ---------------------------------------------------------------
-  // HOLD
-  // ---------------------------------------------------------------
-  if (cmd == "HOLD") {
-    if (millState == MILL_RUN) {
-      millState = MILL_HOLD;
-      Serial.println("[CMD] HOLD → HOLD");
-      lastStateBeforeFault = millState;
-    } else {
-      Serial.println("[CMD] HOLD ignored (not in RUN)");
+  Serial.print("[TIME] sync rtt=");
+  Serial.print(timeSync.rtt_ms);
+  Serial.print(" ms err=");
+  Serial.print(timeSync.err_ms);
+  Serial.println(before == TIME_SRC_SYNC ? " ms" : " ms (stepped)");
+
+  if (lastRtcWriteMono == 0 || t3 - lastRtcWriteMono >= RTC_WRITE_MS) {
+    rtcWriteDue = true;
+  }
+}
+
+// Refresh the PCF85063 right after a UTC second edge (≤ 50 ms late)
+void serviceRtc() {
+  if (!rtcWriteDue || timeSync.src != TIME_SRC_SYNC) return;
+
+  uint64_t mono = monoMs();
+  int64_t  utc  = timesync_utc_ms(timeSync, mono);
+  TsCivil  c;
+  timesync_to_civil(utc, c);
+  if (c.ms >= RTC_WRITE_EDGE_MS) return;
+
+  datetime_t dt;
+  dt.year   = c.year;
+  dt.month  = c.month;
+  dt.day    = c.day;
+  dt.dotw   = c.dotw;
+  dt.hour   = c.hour;
+  dt.minute = c.minute;
+  dt.second = c.second;
+  PCF85063_Set_All(dt);
+
+  rtcWriteDue      = false;
+  lastRtcWriteMono = mono;
+  Serial.println("[TIME] RTC updated");
+}
+
+// -------------------------------------------------------------------
+// Mill schedule
+// -------------------------------------------------------------------
+
+void saveSchedule() {
+  Preferences prefs;
+  if (!prefs.begin(SCHED_NVS_NAMESPACE, false)) return;
+  if (millSchedule.count) {
+    prefs.putBytes(SCHED_NVS_KEY, schedEvents, millSchedule.count * sizeof(CalEvent));
+  } else {
+    prefs.remove(SCHED_NVS_KEY);
+  }
+  prefs.end();
+}
+
+// Ids are handed out again at boot (in stored order)
+void loadSchedule() {
+  cal_init(millSchedule, schedEvents, schedHeap, schedPos, MILL_SCHEDULE_MAX);
+
+  static CalEvent stored[MILL_SCHEDULE_MAX];
+  size_t n = 0;
+  Preferences prefs;
+  if (prefs.begin(SCHED_NVS_NAMESPACE, true)) {
+    size_t len = prefs.getBytesLength(SCHED_NVS_KEY);
+    if (len % sizeof(CalEvent) == 0 && len <= sizeof(stored) &&
+        prefs.getBytes(SCHED_NVS_KEY, stored, len) == len) {
+      n = len / sizeof(CalEvent);
     }
-    return;
+    prefs.end();
+  }
+  for (size_t i = 0; i < n; ++i) {
+    cal_add(millSchedule, stored[i], 0);
   }
+  Serial.print("[SCHED] ");
+  Serial.print(millSchedule.count);
+  Serial.println(" event(s) loaded");
+}
 
-  // ---------------------------------------------------------------
-  // STOP
-  // ---------------------------------------------------------------
-  if (cmd == "STOP") {
-    if (millState == MILL_RUN || millState == MILL_HOLD) {
-      millState        = MILL_IDLE;
-      cycle_current    = 0;
-      time_remaining_s = 0;
-      cycle_index      = 0;  // reset multi-cycle on STOP
-      Serial.println("[CMD] STOP → IDLE");
-      lastStateBeforeFault = millState;
-    } else {
-      Serial.println("[CMD] STOP ignored (not in RUN/HOLD)");
+// {"cmd":"SCHEDULE_ADD","repeat":"DAILY","at":"06:00","action":"START","cycles":5,"cycle_s":300}
+// ONCE takes "utc_s" (Unix s) instead of "at"; WEEKLY / MONTHLY need "day".
+// detail gets the reason for the ack when refused.
+MillAckResult handleScheduleAdd(const char *body, char *detail, size_t detailLen) {
+  int64_t utcMs = utcNowMs();
+  if (utcMs <= 0) {
+    snprintf(detail, detailLen, "NO_TIME");
+    Serial.println("[SCHED] SCHEDULE_ADD refused (time not known yet)");
+    return MILL_ACK_BLOCKED;
+  }
+
+  CalEvent spec;
+  memset(&spec, 0, sizeof(spec));
+  char tok[16];
+  int64_t v;
+
+  spec.repeat = CAL_ONCE;
+  if (configToken(body, "\"repeat\"", tok, sizeof(tok)) &&
+      !cal_repeat_from_str(tok, spec.repeat)) {
+    snprintf(detail, detailLen, "BAD_REPEAT");
+    Serial.print("[SCHED] repeat unknown: ");
+    Serial.println(tok);
+    return MILL_ACK_REJECTED;
+  }
+  if (!configToken(body, "\"action\"", tok, sizeof(tok)) ||
+      !cal_action_from_str(tok, spec.action) || spec.action == CAL_ACT_RELAYS) {
+    snprintf(detail, detailLen, "BAD_ACTION");
+    Serial.println("[SCHED] action must be START or STOP");   // relays follow the state machine
+    return MILL_ACK_REJECTED;
+  }
+
+  if (spec.repeat == CAL_ONCE) {
+    if (!timeField(body, "\"utc_s\"", v) || v <= 0 || v > (int64_t)UINT32_MAX) {
+      snprintf(detail, detailLen, "BAD_UTC_S");
+      Serial.println("[SCHED] ONCE needs utc_s");
+      return MILL_ACK_REJECTED;
     }
-    return;
+    spec.when = (uint32_t)v;
+  } else {
+    unsigned hh = 0, mm = 0, ss = 0;
+    if (!configToken(body, "\"at\"", tok, sizeof(tok)) ||
+        sscanf(tok, "%u:%u:%u", &hh, &mm, &ss) < 2 || hh > 23 || mm > 59 || ss > 59) {
+      snprintf(detail, detailLen, "BAD_AT");
+      Serial.println("[SCHED] repeating event needs at=\"HH:MM[:SS]\"");
+      return MILL_ACK_REJECTED;
+    }
+    spec.when = hh * 3600u + mm * 60u + ss;
   }
+  if (timeField(body, "\"day\"", v) && v >= 0 && v <= 31) spec.day = (uint8_t)v;
 
-  Serial.print("[CMD] Unknown command: ");
-  Serial.println(cmd);
+  if (spec.action == CAL_ACT_START) {
+    if (timeField(body, "\"cycles\"", v) && v > 0 && v <= 255)    spec.a = (uint8_t)v;
+    if (timeField(body, "\"cycle_s\"", v) && v > 0 && v <= 65535) spec.b = (uint16_t)v;
+  }
+
+  uint16_t id = cal_add(millSchedule, spec, (uint32_t)(utcMs / 1000));
+  if (id == 0) {
+    bool full = millSchedule.count >= millSchedule.cap;
+    snprintf(detail, detailLen, full ? "FULL" : "BAD_DAY");
+    Serial.println(full ? "[SCHED] rejected (full)" : "[SCHED] rejected (invalid day)");
+    return MILL_ACK_REJECTED;
+  }
+  saveSchedule();
+
+  char line[96];
+  cal_format(millSchedule.ev[millSchedule.count - 1], line, sizeof(line));
+  Serial.print("[SCHED] added ");
+  Serial.println(line);
+  return MILL_ACK_DONE;
+}
+
+// {"cmd":"SCHEDULE_DEL","id":3}   (id 0 = all)
+MillAckResult handleScheduleDel(const char *body, char *detail, size_t detailLen) {
+  int64_t id;
+  if (!timeField(body, "\"id\"", id) || id < 0 || id > 0xFFFF) {
+    snprintf(detail, detailLen, "BAD_ID");
+    Serial.println("[SCHED] SCHEDULE_DEL needs id");
+    return MILL_ACK_REJECTED;
+  }
+  if (id == 0) {
+    cal_clear(millSchedule);
+  } else if (!cal_remove(millSchedule, (uint16_t)id)) {
+    snprintf(detail, detailLen, "UNKNOWN_ID");
+    Serial.print("[SCHED] no event #");
+    Serial.println((long)id);
+    return MILL_ACK_REJECTED;
+  }
+  saveSchedule();
+  Serial.print("[SCHED] deleted ");
+  if (id == 0) Serial.println("all");
+  else         Serial.println((long)id);
+  return MILL_ACK_DONE;
+}
+
+// One message per event, then a summary; text is formatted here only
+void publishSchedule() {
+  char line[96];
+  char msg[160];
+  for (uint16_t i = 0; i < millSchedule.count; ++i) {
+    const CalEvent &ev = millSchedule.ev[i];
+    cal_format(ev, line, sizeof(line));
+    snprintf(msg, sizeof(msg), "{\"id\":%u,\"next_s\":%lu,\"text\":\"%s\"}",
+             ev.id, (unsigned long)ev.next_s, line);
+    mqttClient.publish(topics.schedule, msg);
+  }
+  snprintf(msg, sizeof(msg), "{\"count\":%u,\"next_s\":%lu}",
+           millSchedule.count, (unsigned long)cal_next_s(millSchedule));
+  mqttClient.publish(topics.schedule, msg);
+}
+
+static void scheduleFire(const CalEvent &ev, uint32_t late_s, void *ctx) {
+  char line[96];
+  cal_format(ev, line, sizeof(line));
+  Serial.print("[SCHED] fire ");
+  Serial.print(line);
+  Serial.print(" late=");
+  Serial.print(late_s);
+  Serial.println(" s");
+
+  if (ev.action == CAL_ACT_START) {
+    // Only from IDLE: START in RUN restarts the batch and in HOLD resumes
+    // it, neither of which a timer may do behind an operator's back
+    if (mill.state != MILL_IDLE) {
+      schedSkipped++;
+      Serial.print("[SCHED] START skipped (state ");
+      Serial.print(millStateStr(mill.state));
+      Serial.println(")");
+      return;
+    }
+    if (ev.a) mill.cycle_total = ev.a;
+    if (ev.b) {
+      mill.cycle_target     = ev.b;
+      mill.time_remaining_s = ev.b;
+    }
+    handleCommand("START");
+  } else if (ev.action == CAL_ACT_STOP) {
+    handleCommand("STOP");
+  }
+}
+
+// Cheap when nothing is due: one compare against the heap top
+void serviceSchedule() {
+  int64_t utcMs = utcNowMs();
+  if (utcMs <= 0) return;
+  uint32_t nowS = (uint32_t)(utcMs / 1000);
+
+  if (!schedTimeKnown || timeSync.steps != schedSteps) {
+    cal_resync(millSchedule, nowS);
+    schedTimeKnown = true;
+    schedSteps     = timeSync.steps;
+  }
+
+  uint32_t next = cal_next_s(millSchedule);
+  if (next == 0 || next > nowS) return;
+
+  uint16_t before = millSchedule.count;
+  cal_poll(millSchedule, nowS, scheduleFire, nullptr);
+  if (millSchedule.count != before) saveSchedule();   // one-shots consumed
+}
+
+// -------------------------------------------------------------------
+// Local indicators (RGB LED + buzzer, played by IndicatorTask)
+// -------------------------------------------------------------------
+
+// FAULT blink code: n red flashes, then a pause
+static uint8_t faultBlinkCode(FaultReason f) {
+  switch (f) {
+    case FAULT_ESTOP_OPEN:     return 1;
+    case FAULT_LID_OPEN:       return 2;
+    case FAULT_DOOR_OPEN:      return 3;
+    case FAULT_INTERLOCK_OPEN: return 4;
+    case FAULT_PID_ANOMALY:    return 5;
+    default:                   return 6;
+  }
+}
+
+// Background follows FAULT code > MQTT lost > state; only pushed when it
+// changes. Entering FAULT also beeps at SAFETY priority.
+void serviceIndicators(const MillSnapshot &snap) {
+  bool connected = mqttClient.connected();
+  uint16_t key;
+  if (snap.state == MILL_FAULT)  key = 0x100 | faultBlinkCode(snap.fault);
+  else if (!connected)           key = 0x200;
+  else                           key = snap.state;
+  if (key == indicatorKey) return;
+  bool enteredFault = (key >> 8) == 1 && (indicatorKey >> 8) != 1;
+  indicatorKey = key;
+
+  IndPattern p;
+  if (snap.state == MILL_FAULT) {
+    p = ind_blink(60, 0, 0, 250, 250, faultBlinkCode(snap.fault), 1500, 0);
+  } else if (!connected) {
+    p = ind_blink(0, 0, 60, 100, 100, 2, 1800, 0);
+  } else if (snap.state == MILL_RUN) {
+    p = ind_blink(0, 60, 0, 500, 0, 1, 500, 0);
+  } else if (snap.state == MILL_HOLD) {
+    p = ind_blink(50, 36, 0, 1000, 0, 1, 0, 0);      // steady amber
+  } else {
+    p = ind_blink(0, 20, 0, 50, 0, 1, 2950, 0);      // idle heartbeat
+  }
+  Indicator_RGB_Background(&p);
+
+  if (enteredFault) {
+    Indicator_Buzzer(ind_blink(1, 0, 0, 150, 150, 3, 0, 1), IND_PRIO_SAFETY);
+  }
+}
+
+// -------------------------------------------------------------------
+// Command handling
+// -------------------------------------------------------------------
+
+MillAckResult handleCommand(const char *cmd) {
+  // Always evaluate commands against *fresh* interlock state
+  checkInterlocks();
+
+  MillEvent ev;
+  if (!millEventFromCommand(cmd, ev)) {
+    Serial.print("[CMD] Unknown command: ");
+    Serial.println(cmd);
+    return MILL_ACK_REJECTED;
+  }
+
+  // Guards, actions and the RESET_FAULT soft-access HOLD restore are all
+  // in the transition table; successful transitions log as [FSM].
+  MillDispatchResult r = millDispatch(mill, ev, millis());
+  if (r == MILL_DISPATCH_IGNORED) {
+    Serial.print("[CMD] ");
+    Serial.print(cmd);
+    Serial.print(" ignored in ");
+    Serial.println(millStateStr(mill.state));
+  } else if (r == MILL_DISPATCH_BLOCKED) {
+    Serial.print("[CMD] ");
+    Serial.print(cmd);
+    Serial.print(" blocked by ");
+    Serial.println(millTransition(mill.state, ev).guard_name);
+  }
+  return millAckFromDispatch(r);
 }
 
 // -------------------------------------------------------------------
 // SET_CONFIG handler
 // -------------------------------------------------------------------
 
-void handleConfig(const String &body) {
-  // --- cycle_target_s ------------------------------------------------
-  int keyPos = body.indexOf("cycle_target_s");
-  if (keyPos >= 0) {
-    int colonPos = body.indexOf(':', keyPos);
-    if (colonPos >= 0) {
-      int idx = colonPos + 1;
-      while (idx < (int)body.length() && (body[idx] == ' ' || body[idx] == '\"')) {
-        idx++;
-      }
-      int start = idx;
-      while (idx < (int)body.length() && isDigit(body[idx])) {
-        idx++;
-      }
-      if (idx > start) {
-        uint32_t val = body.substring(start, idx).toInt();
-
-        if (val == 0) {
-          // Explicitly disable timing
-          cycle_target     = 0;
-          time_remaining_s = 0;
-          Serial.println("[CFG] cycle_target_s DISABLED (0)");
-        } else if (val <= 24UL * 3600UL) {
-          cycle_target     = val;
-          time_remaining_s = val;
-          Serial.print("[CFG] cycle_target_s set to ");
-          Serial.print(val);
-          Serial.println(" s");
-        } else {
-          Serial.print("[CFG] cycle_target_s out of range: ");
-          Serial.println(val);
-        }
-      }
+// Raw value token after "key": (quotes stripped), "" if absent.
+static bool configToken(const char *body, const char *key, char *out, size_t outLen) {
+  const char *p = strstr(body, key);
+  if (!p) return false;
+  p = strchr(p, ':');
+  if (!p) return false;
+
+  p++;
+  while (*p == ' ' || *p == '\"') {
+    p++;
+  }
+  size_t n = 0;
+  while (*p && n + 1 < outLen) {
+    char c = *p;
+    if (c == ',' || c == '}' || c == '\"' || c == ' ') break;
+    out[n++] = c;
+    p++;
+  }
+  out[n] = '\0';
+  return n > 0;
+}
+
+// Current settings in schema form (the FSM, LN2 controller and anomaly
+// flag stay the owners; this is a copy)
+static MillConfig liveConfig() {
+  MillConfig c;
+  c.run_time_s   = mill.cycle_target;
+  c.cool_time_s  = mill.cool_target;
+  c.total_cycles = mill.cycle_total;
+  c.ln2          = ln2Ctl.cfg;
+  c.anom_fault   = anomFaultEnabled;
+  return c;
+}
+
+// Commit a validated config; `changed` = CfgResult.changed
+static void applyConfig(const MillConfig &c, uint16_t changed) {
+  mill.cycle_target = c.run_time_s;
+  mill.cool_target  = c.cool_time_s;
+  mill.cycle_total  = c.total_cycles;
+  if (mill.state == MILL_IDLE) {
+    mill.time_remaining_s = c.run_time_s;
+    if (c.total_cycles == 0) mill.cycle_index = 0;
+  }
+
+  // Any key inside the Ln2Config: the controller restarts clean with the
+  // new set
+  uint16_t ln2Keys = 0;
+  for (uint8_t i = 0; i < MILL_CONFIG_KEY_COUNT; ++i) {
+    uint16_t off = MILL_CONFIG_KEYS[i].offset;
+    if (off >= offsetof(MillConfig, ln2) && off < offsetof(MillConfig, ln2) + sizeof(Ln2Config)) {
+      ln2Keys |= (uint16_t)(1u << i);
     }
   }
+  if (changed & ln2Keys) ln2ctl_configure(ln2Ctl, c.ln2);
+  anomFaultEnabled = c.anom_fault;
+}
 
-  // --- total_cycles --------------------------------------------------
-  keyPos = body.indexOf("total_cycles");
-  if (keyPos >= 0) {
-    int colonPos = body.indexOf(':', keyPos);
-    if (colonPos >= 0) {
-      int idx = colonPos + 1;
-      while (idx < (int)body.length() && (body[idx] == ' ' || body[idx] == '\"')) {
-        idx++;
-      }
-      int start = idx;
-      while (idx < (int)body.length() && isDigit(body[idx])) {
-        idx++;
-      }
-      if (idx > start) {
-        uint32_t val = body.substring(start, idx).toInt();
-
-        if (val == 0) {
-          // Explicitly disable multi-cycle
-          cycle_total = 0;
-          cycle_index = 0;
-          Serial.println("[CFG] total_cycles DISABLED (0)");
-        } else if (val <= 9999UL) {
-          cycle_total = val;
-          Serial.print("[CFG] total_cycles set to ");
-          Serial.println(val);
-        } else {
-          Serial.print("[CFG] total_cycles out of range: ");
-          Serial.println(val);
-        }
+// SET_CONFIG on cmd/control, or any message on cmd/config: validated
+// against schema v1 as a whole, then applied at once (or not at all).
+// detail gets "<key> <reason>" for the ack when refused.
+MillAckResult handleConfig(const char *body, char *detail, size_t detailLen) {
+  MillConfig live = liveConfig();
+  MillConfig staged;
+  CfgResult  r;
+  if (!mill_config_parse(body, strlen(body), mill.state, live, staged, r)) {
+    snprintf(detail, detailLen, "%s%s%s", r.key, r.key[0] ? " " : "",
+             mill_config_status_str(r.status));
+    Serial.print("[CFG] rejected, nothing applied: ");
+    Serial.println(detail);
+    return (r.status == CFG_NOT_HOT) ? MILL_ACK_BLOCKED : MILL_ACK_REJECTED;
+  }
+  if (r.changed == 0) {
+    Serial.println("[CFG] no change");
+    return MILL_ACK_DONE;
+  }
+
+  applyConfig(staged, r.changed);
+  for (uint8_t i = 0; i < MILL_CONFIG_KEY_COUNT; ++i) {
+    if (!(r.changed & (1u << i))) continue;
+    Serial.print("[CFG] ");
+    Serial.print(MILL_CONFIG_KEYS[i].key);
+    Serial.println(" changed");
+  }
+  char cfg[MILL_CONFIG_JSON_MAX];
+  if (mill_config_json(staged, cfg, sizeof(cfg))) {
+    Serial.print("[CFG] now {");
+    Serial.print(cfg);
+    Serial.println("}");
+  }
+  return MILL_ACK_DONE;
+}
+
+// -------------------------------------------------------------------
+// Modbus TCP: image refresh + command coils
+// -------------------------------------------------------------------
+
+// Copies the cached state into the register image. Fixed size, no bus
+// access; the server answers every request straight from this image.
+void refreshModbusImage(const MillSnapshot &snap) {
+  mbImage.reg[MB_REG_STATE]       = (uint16_t)snap.state;
+  mbImage.reg[MB_REG_FAULT_CODE]  = (uint16_t)snap.fault;
+  mbImage.reg[MB_REG_CYCLE_INDEX] = (uint16_t)snap.cycle_index;
+  mbImage.reg[MB_REG_CYCLE_TOTAL] = (uint16_t)snap.cycle_total;
+  mb_image_set_u32(mbImage, MB_REG_CYCLE_CURRENT, snap.cycle_current);
+  mb_image_set_u32(mbImage, MB_REG_CYCLE_TARGET,  snap.cycle_target);
+  mb_image_set_u32(mbImage, MB_REG_TIME_REMAIN,   snap.time_remaining_s);
+  mbImage.reg[MB_REG_INTERLOCKS]  = (snap.estop_ok    ? 0x0001 : 0) |
+                                    (snap.lid_locked  ? 0x0002 : 0) |
+                                    (snap.door_closed ? 0x0004 : 0);
+  mb_image_set_u32(mbImage, MB_REG_UPTIME, millis() / 1000);
+  mbImage.reg[MB_REG_MQTT_OK]     = mqttClient.connected() ? 1 : 0;
+  mbImage.reg[MB_REG_HEARTBEAT]   = ++mbHeartbeat;
+
+  const MbServerStats &st = modbusTcp_stats();
+  mbImage.reg[MB_REG_SRV_RPS]     = st.rps;
+  mbImage.reg[MB_REG_SRV_LAT_AVG] = st.lat_avg_us;
+  mbImage.reg[MB_REG_SRV_LAT_MAX] = st.lat_max_us;
+  mb_image_set_u32(mbImage, MB_REG_SRV_REQUESTS, st.requests);
+  mbImage.reg[MB_REG_SRV_EXCEPT]  = (uint16_t)st.exceptions;
+
+  // PID slot 0 = LN2 (other slots stay zero until those PIDs exist)
+  uint16_t *pid = &mbImage.reg[MB_REG_PID_BASE + 0 * MB_REG_PID_STRIDE];
+  pid[MB_PID_COMM_OK] = snap.pid_ln2.comm_ok ? 1 : 0;
+  pid[MB_PID_PV_X10]  = (uint16_t)(int16_t)lroundf(snap.pid_ln2.pv_c * 10.0f);
+  pid[MB_PID_SV_X10]  = (uint16_t)(int16_t)lroundf(snap.pid_ln2.sv_c * 10.0f);
+  pid[MB_PID_OUT_X10] = (uint16_t)lroundf(snap.pid_ln2.output_pct * 10.0f);
+  pid[MB_PID_STATUS]  = snap.pid_ln2.status_raw;
+  pid[MB_PID_SCORE]   = lc108Ln2.h.score;
+  pid[MB_PID_ERRORS]  = (uint16_t)lc108_error_total(lc108Ln2.h);
+
+  mb_image_set_bit(mbImage, MB_DI_ESTOP_OK,    snap.estop_ok);
+  mb_image_set_bit(mbImage, MB_DI_LID_LOCKED,  snap.lid_locked);
+  mb_image_set_bit(mbImage, MB_DI_DOOR_CLOSED, snap.door_closed);
+  for (uint8_t m = MILL_IDLE; m <= MILL_FAULT; ++m) {
+    mb_image_set_bit(mbImage, MB_DI_STATE_IDLE + m, snap.state == m);
+  }
+  mb_image_set_bit(mbImage, MB_DI_MQTT_OK, mqttClient.connected());
+  mb_image_set_bit(mbImage, MB_DI_PID_COMM_BASE + 0, snap.pid_ln2.comm_ok);
+}
+
+// Coil write → same command path as mill/cmd/control.
+bool modbusCommand(MbCoil coil) {
+  switch (coil) {
+    case MB_COIL_START:       handleCommand("START");       break;
+    case MB_COIL_STOP:        handleCommand("STOP");        break;
+    case MB_COIL_HOLD:        handleCommand("HOLD");        break;
+    case MB_COIL_RESUME:      handleCommand("RESUME");      break;
+    case MB_COIL_RESET_FAULT: handleCommand("RESET_FAULT"); break;
+    default:                  return false;
+  }
+  Serial.print("[MODBUS] coil command ");
+  Serial.println((int)coil);
+  return true;
+}
+
+// -------------------------------------------------------------------
+// Device id (topic namespace)
+// -------------------------------------------------------------------
+
+// Stored id if there is a valid one, else the MAC-derived default
+void loadDeviceId() {
+  char id[MILL_ID_MAX] = "";
+  Preferences prefs;
+  if (prefs.begin(DEVICE_NVS_NAMESPACE, true)) {
+    prefs.getString(DEVICE_NVS_KEY, id, sizeof(id));
+    prefs.end();
+  }
+  if (!mill_topics_build(topics, id)) {
+    uint8_t mac[6] = { 0 };
+    esp_efuse_mac_get_default(mac);
+    mill_id_from_mac(mac, id);
+    mill_topics_build(topics, id);
+  }
+  Serial.print("[MQTT] Device id ");
+  Serial.print(topics.id);
+  Serial.print(", topics mill/");
+  Serial.print(topics.id);
+  Serial.println("/…");
+}
+
+// {"cmd":"SET_DEVICE_ID","id":"line2"}; "id":"" goes back to the MAC
+// default. Stored in NVS, used from the next boot (the broker session
+// and every subscriber keep the current topics until then).
+MillAckResult handleDeviceId(const char *body) {
+  char id[MILL_ID_MAX + 1] = "";
+  bool given = configToken(body, "\"id\"", id, sizeof(id));
+  if (!given && !strstr(body, "\"id\"")) return MILL_ACK_REJECTED;
+  if (given && !mill_id_valid(id)) {
+    Serial.print("[MQTT] SET_DEVICE_ID rejected: ");
+    Serial.println(id);
+    return MILL_ACK_REJECTED;
+  }
+
+  Preferences prefs;
+  if (!prefs.begin(DEVICE_NVS_NAMESPACE, false)) return MILL_ACK_REJECTED;
+  if (given) prefs.putString(DEVICE_NVS_KEY, id);
+  else       prefs.remove(DEVICE_NVS_KEY);
+  prefs.end();
+
+  Serial.print("[MQTT] Device id set to ");
+  Serial.print(given ? id : "(MAC default)");
+  Serial.println("; applies after reboot");
+  return MILL_ACK_DONE;
+}
+
+// -------------------------------------------------------------------
+// Firmware update
+// -------------------------------------------------------------------
+
+// Arduino core hook: leave a new image PENDING_VERIFY for serviceOta()'s
+// health check instead of marking it valid before setup()
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+
+static const char *otaImageStateStr(esp_ota_img_states_t st) {
+  switch (st) {
+    case ESP_OTA_IMG_NEW:            return "NEW";
+    case ESP_OTA_IMG_PENDING_VERIFY: return "PENDING_VERIFY";
+    case ESP_OTA_IMG_VALID:          return "VALID";
+    case ESP_OTA_IMG_INVALID:        return "INVALID";
+    case ESP_OTA_IMG_ABORTED:        return "ABORTED";
+    default:                         return "UNDEFINED";
+  }
+}
+
+// OtaSink over esp_ota_*. Sequential writes: each sector is erased when
+// the write reaches it, not the whole slot in esp_ota_begin() (seconds,
+// past the loop deadline).
+static bool otaFlashBegin(void *ctx, uint32_t size) {
+  OtaFlash &f = *(OtaFlash *)ctx;
+  f.part = esp_ota_get_next_update_partition(nullptr);
+  if (!f.part || size > f.part->size) {
+    Serial.println("[OTA] No app slot for this image");
+    return false;
+  }
+  esp_err_t err = esp_ota_begin(f.part, OTA_WITH_SEQUENTIAL_WRITES, &f.handle);
+  if (err != ESP_OK) {
+    Serial.print("[OTA] esp_ota_begin: ");
+    Serial.println(esp_err_to_name(err));
+    return false;
+  }
+  Serial.print("[OTA] Writing ");
+  Serial.print(size);
+  Serial.print(" B to ");
+  Serial.println(f.part->label);
+  return true;
+}
+
+static bool otaFlashWrite(void *ctx, const uint8_t *data, size_t len) {
+  OtaFlash &f = *(OtaFlash *)ctx;
+  uint32_t t0 = millis();
+  esp_err_t err = esp_ota_write(f.handle, data, len);
+  ota.flash_ms += millis() - t0;
+  return err == ESP_OK;
+}
+
+// Length and SHA-256 already match; esp_ota_end() checks the image
+// header and its own checksum before the slot becomes the boot slot
+static bool otaFlashFinish(void *ctx) {
+  OtaFlash &f = *(OtaFlash *)ctx;
+  esp_err_t err = esp_ota_end(f.handle);
+  if (err == ESP_OK) err = esp_ota_set_boot_partition(f.part);
+  if (err != ESP_OK) {
+    Serial.print("[OTA] Image refused: ");
+    Serial.println(esp_err_to_name(err));
+    return false;
+  }
+  return true;
+}
+
+static void otaFlashAbort(void *ctx) {
+  esp_ota_abort(((OtaFlash *)ctx)->handle);
+}
+
+void publishOtaStatus() {
+  char json[256];
+  if (ota_json(ota, millis(), json, sizeof(json)) == 0) return;
+  if (mqttClient.connected()) mqttClient.publish(topics.ota, json);
+}
+
+// Transfer over (any outcome): report, and boot the new image if verified
+static void otaEnded() {
+  otaClient.stop();
+  publishOtaStatus();
+  Serial.print("[OTA] ");
+  Serial.print(ota_state_str(ota.state));
+  Serial.print(" (");
+  Serial.print(ota_error_str(ota.error));
+  Serial.print(") ");
+  Serial.print(ota.written);
+  Serial.print(" B in ");
+  Serial.print(ota.t_end_ms - ota.t_start_ms);
+  Serial.print(" ms, flash ");
+  Serial.print(ota.flash_ms);
+  Serial.print(" ms, heap min ");
+  Serial.println(ota.heap_min);
+  if (ota.state != OTA_DONE) return;
+
+  // Clean DISCONNECT (no will); the new image publishes its own birth.
+  // The supervisor's shutdown handler switches the relays off.
+  Serial.println("[OTA] Rebooting into the new image");
+  mqttClient.disconnect();
+  delay(100);
+  esp_restart();
+}
+
+// {"cmd":"OTA_UPDATE","url":"http://192.168.50.2:8000/fw.bin",
+//  "sha256":"<64 hex>","size":1234567}; size optional (Content-Length).
+// IDLE only; the transfer itself runs in serviceOta().
+MillAckResult handleOtaUpdate(const char *body, char *detail, size_t detailLen) {
+  const char *refused = nullptr;
+  if (ota_active(ota))                refused = "BUSY";
+  else if (mill.state != MILL_IDLE)  refused = "NOT_IDLE";
+  else if (otaPendingVerify)         refused = "VERIFYING";   // this image is not confirmed yet
+  if (refused) {
+    snprintf(detail, detailLen, "%s", refused);
+    Serial.print("[OTA] OTA_UPDATE refused: ");
+    Serial.println(refused);
+    return MILL_ACK_BLOCKED;
+  }
+
+  char     url[OTA_URL_MAX];
+  char     host[OTA_HOST_MAX];
+  char     path[OTA_PATH_MAX];
+  uint16_t port = 0;
+  char     sha[66];       // one too many digits must still read as wrong
+  char     sizeTok[12];
+  if (!configToken(body, "\"url\"", url, sizeof(url)) || !ota_url_parse(url, host, port, path)) {
+    snprintf(detail, detailLen, "BAD_URL");
+    return MILL_ACK_REJECTED;
+  }
+  if (!configToken(body, "\"sha256\"", sha, sizeof(sha))) sha[0] = '\0';
+  uint32_t size = configToken(body, "\"size\"", sizeTok, sizeof(sizeTok))
+                    ? (uint32_t)strtoul(sizeTok, nullptr, 10) : 0;
+
+  OtaSink sink = { otaFlashBegin, otaFlashWrite, otaFlashFinish, otaFlashAbort, &otaFlash };
+  if (!ota_start(ota, sink, sha, size, millis())) {
+    snprintf(detail, detailLen, "BAD_SHA256");
+    return MILL_ACK_REJECTED;
+  }
+
+  // Blocks up to the connection timeout, like an MQTT connect
+  Serial.print("[OTA] GET ");
+  Serial.println(url);
+  char req[OTA_HOST_MAX + OTA_PATH_MAX + 64];
+  size_t reqLen = ota_http_request(host, path, req, sizeof(req));
+  otaClient.setConnectionTimeout(2000);
+  if (!otaClient.connect(host, port) || otaClient.write((const uint8_t *)req, reqLen) != reqLen) {
+    ota_fail(ota, OTA_ERR_CONNECT, millis());
+    otaEnded();
+    snprintf(detail, detailLen, "CONNECT");
+    return MILL_ACK_REJECTED;
+  }
+  otaPctSent = 0;
+  publishOtaStatus();
+  return MILL_ACK_DONE;
+}
+
+MillAckResult handleOtaAbort() {
+  if (!ota_active(ota)) return MILL_ACK_IGNORED;
+  ota_fail(ota, OTA_ERR_ABORTED, millis());
+  otaEnded();
+  return MILL_ACK_DONE;
+}
+
+// setup(): is this a new image on probation, or did the last one fail?
+void otaBootCheck() {
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  esp_ota_img_states_t   st      = ESP_OTA_IMG_UNDEFINED;
+  if (running && esp_ota_get_state_partition(running, &st) == ESP_OK &&
+      st == ESP_OTA_IMG_PENDING_VERIFY) {
+    otaPendingVerify = true;
+    Serial.print("[OTA] New image in ");
+    Serial.print(running->label);
+    Serial.println(", pending health check");
+  }
+  const esp_partition_t *invalid = esp_ota_get_last_invalid_partition();
+  if (invalid) {
+    otaRolledBack = invalid->label;
+    Serial.print("[OTA] Image in ");
+    Serial.print(invalid->label);
+    Serial.println(" was rolled back");
+  }
+}
+
+// Loop pass: health check of a new image, then one transfer slice
+void serviceOta() {
+  if (otaPendingVerify) {
+    uint32_t up = (uint32_t)monoMs();
+    if (!supervisor_healthy()) otaHealthyFromMs = up;
+    if (up - otaHealthyFromMs >= OTA_HEALTH_UP_MS) {
+      esp_ota_mark_app_valid_cancel_rollback();
+      otaPendingVerify = false;
+      Serial.println("[OTA] Health check passed; image marked valid");
+    } else if (up >= OTA_HEALTH_DEADLINE_MS) {
+      // Never reboot under a run: wait for the cycle to end
+      if (mill.state == MILL_IDLE) {
+        Serial.println("[OTA] Health check failed; rolling back");
+        esp_ota_mark_app_invalid_rollback_and_reboot();   // reboots
+      } else if (!otaRollbackWaiting) {
+        otaRollbackWaiting = true;
+        Serial.println("[OTA] Health check failed; rollback waits for IDLE");
       }
     }
   }
+
+  if (!ota_active(ota)) return;
+  uint32_t now = millis();
+
+  // The mill always wins: START (or a fault) ends the transfer
+  if (mill.state != MILL_IDLE) {
+    ota_fail(ota, OTA_ERR_ABORTED, now);
+    otaEnded();
+    return;
+  }
+
+  size_t budget = OTA_PASS_BYTES;
+  while (budget > 0 && ota_active(ota)) {
+    int avail = otaClient.available();
+    if (avail <= 0) break;
+    size_t n = (size_t)avail;
+    if (n > sizeof(otaSlice)) n = sizeof(otaSlice);
+    if (n > budget) n = budget;
+    int got = otaClient.read(otaSlice, n);
+    if (got <= 0) break;
+    ota_feed(ota, otaSlice, (size_t)got, millis());
+    budget -= (size_t)got;
+  }
+  now = millis();
+  if (ota_active(ota) && !otaClient.connected() && otaClient.available() <= 0) {
+    ota_end_of_stream(ota, now);
+  }
+  if (ota_stalled(ota, now)) ota_fail(ota, OTA_ERR_STALLED, now);
+
+  uint32_t heap = (uint32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  if (heap < ota.heap_min) ota.heap_min = heap;
+
+  if (!ota_active(ota)) {
+    otaEnded();
+  } else if (ota_progress_pct(ota) >= otaPctSent + 10) {
+    otaPctSent = ota_progress_pct(ota) / 10 * 10;
+    publishOtaStatus();
+  }
+}
+
+// -------------------------------------------------------------------
+// Command ack (mill/<id>/status/ack, only for commands carrying "seq")
+// -------------------------------------------------------------------
+
+// "seq" of a command body; false if absent or not a number
+static bool commandSeq(const char *body, uint32_t &seq) {
+  char tok[12];
+  if (!configToken(body, "\"seq\"", tok, sizeof(tok))) return false;
+  char *end = nullptr;
+  unsigned long v = strtoul(tok, &end, 10);
+  if (end == tok || *end != '\0') return false;
+  seq = (uint32_t)v;
+  return true;
+}
+
+// Queued too long on the broker (sender "ts", Unix s)? Only judged once
+// our clock is known; commands without "ts" are never stale.
+static bool commandStale(const char *body, const char *cmd) {
+  if (strcmp(cmd, "STOP") == 0 || strcmp(cmd, "HOLD") == 0) return false;
+  char tok[16];
+  if (!configToken(body, "\"ts\"", tok, sizeof(tok))) return false;
+  int64_t utcMs = utcNowMs();
+  if (utcMs <= 0) return false;
+  long long ts = atoll(tok);
+  return ts > 0 && utcMs / 1000 - ts > (long long)CMD_MAX_AGE_S;
+}
+
+// Commands that configure one board (wiring, calendar, id, firmware):
+// only on the mill's own topic, never from mill/all/cmd/control
+static bool commandPerMill(const char *cmd) {
+  static const char *const PER_MILL[] = {
+    "SET_IOMAP", "SCHEDULE_ADD", "SCHEDULE_DEL", "SET_DEVICE_ID", "OTA_UPDATE"
+  };
+  for (const char *c : PER_MILL) {
+    if (strcmp(cmd, c) == 0) return true;
+  }
+  return false;
+}
+
+void publishAck(uint32_t seq, const char *cmd, MillAckResult result, const char *detail) {
+  char json[MILL_ACK_JSON_MAX];
+  if (mill_ack_json(topics.id, seq, cmd, result, mill.state, mill.substate,
+                    json, sizeof(json), detail) == 0) {
+    return;
+  }
+  mqttClient.publish(topics.ack, json);
 }
 
 // -------------------------------------------------------------------
@@ -1026,35 +1920,83 @@ void handleConfig(const String &body) {
 // -------------------------------------------------------------------
 
 void mqttCallback(char *topic, byte *payload, unsigned int length) {
-  String t(topic);
-  String body;
-  body.reserve(length + 1);
-  for (unsigned int i = 0; i < length; ++i) {
-    body += static_cast<char>(payload[i]);
-  }
+  uint64_t rxMono = monoMs();   // time-sync t3, before anything else
+
+  // Payload is not NUL-terminated and lives in PubSubClient's buffer,
+  // which a publish from a handler (ack, schedule list) overwrites.
+  // Runs inside mqttClient.loop() on the loop task only.
+  static char body[MQTT_BUFFER_SIZE + 1];
+  if (length >= sizeof(body)) length = sizeof(body) - 1;
+  memcpy(body, payload, length);
+  body[length] = '\0';
 
   Serial.print("[MQTT] RX topic=");
-  Serial.print(t);
+  Serial.print(topic);
   Serial.print(" payload=");
   Serial.println(body);
 
-  if (t == MQTT_CMD_SUB_TOPIC) {
-    int cmdPos = body.indexOf("\"cmd\"");
-    if (cmdPos >= 0) {
-      int colonPos = body.indexOf(':', cmdPos);
-      if (colonPos >= 0) {
-        int quote1 = body.indexOf('\"', colonPos);
-        int quote2 = body.indexOf('\"', quote1 + 1);
-        if (quote1 >= 0 && quote2 > quote1) {
-          String cmd = body.substring(quote1 + 1, quote2);
-          if (cmd == "SET_CONFIG") {
-            handleConfig(body);
-          } else {
-            handleCommand(cmd);
-          }
-        }
-      }
+  MillTopicKind kind = mill_topic_kind(topics, topic);
+  if (kind == MILL_TOPIC_CMD || kind == MILL_TOPIC_CMD_ALL || kind == MILL_TOPIC_CONFIG) {
+    // cmd/config carries the config keys alone; it is SET_CONFIG
+    char cmd[24];
+    if (kind == MILL_TOPIC_CONFIG) {
+      strcpy(cmd, "SET_CONFIG");
+    } else {
+      const char *key    = strstr(body, "\"cmd\"");
+      const char *colon  = key ? strchr(key + 5, ':') : nullptr;
+      const char *quote1 = colon ? strchr(colon, '\"') : nullptr;
+      const char *quote2 = quote1 ? strchr(quote1 + 1, '\"') : nullptr;
+      if (!quote2) return;
+      size_t n = (size_t)(quote2 - quote1 - 1);
+      if (n >= sizeof(cmd)) n = sizeof(cmd) - 1;   // no command is that long; fails as unknown
+      memcpy(cmd, quote1 + 1, n);
+      cmd[n] = '\0';
+    }
+
+    uint32_t seq = 0;
+    bool hasSeq = commandSeq(body, seq);
+    MillAckResult result = MILL_ACK_DONE;
+    char detail[48] = "";
+    if (hasSeq && cmd_dedup_seen(cmdDedup, seq, cmd, millis())) {
+      Serial.print("[CMD] duplicate seq ");
+      Serial.print(seq);
+      Serial.println("; not executed again");
+      result = MILL_ACK_DUPLICATE;
+    } else if (commandStale(body, cmd)) {
+      Serial.print("[CMD] ");
+      Serial.print(cmd);
+      Serial.println(" is stale (queued while offline); dropped");
+      cmdStale++;
+      result = MILL_ACK_STALE;
+    } else if (kind != MILL_TOPIC_CMD && commandPerMill(cmd)) {
+      Serial.print("[CMD] ");
+      Serial.print(cmd);
+      Serial.println(" refused from the broadcast topic");
+      snprintf(detail, sizeof(detail), "BROADCAST");
+      result = MILL_ACK_REJECTED;
+    } else if (strcmp(cmd, "SET_CONFIG") == 0) {
+      result = handleConfig(body, detail, sizeof(detail));
+    } else if (strcmp(cmd, "SET_IOMAP") == 0) {
+      result = handleIoMap(body, detail, sizeof(detail));
+    } else if (strcmp(cmd, "SCHEDULE_ADD") == 0) {
+      result = handleScheduleAdd(body, detail, sizeof(detail));
+    } else if (strcmp(cmd, "SCHEDULE_DEL") == 0) {
+      result = handleScheduleDel(body, detail, sizeof(detail));
+    } else if (strcmp(cmd, "SCHEDULE_LIST") == 0) {
+      publishSchedule();
+    } else if (strcmp(cmd, "SET_DEVICE_ID") == 0) {
+      result = handleDeviceId(body);
+    } else if (strcmp(cmd, "OTA_UPDATE") == 0) {
+      // A fleet is updated one mill at a time (never broadcast, above)
+      result = handleOtaUpdate(body, detail, sizeof(detail));
+    } else if (strcmp(cmd, "OTA_ABORT") == 0) {
+      result = handleOtaAbort();
+    } else {
+      result = handleCommand(cmd);
     }
+    if (hasSeq) publishAck(seq, cmd, result, detail);
+  } else if (kind == MILL_TOPIC_TIME_RESP) {
+    handleTimeResponse(body, rxMono);
   } else {
     Serial.println("[MQTT] Unknown topic; ignoring");
   }
@@ -1074,11 +2016,46 @@ void mqttReconnect() {
   Serial.print(":");
   Serial.println(MQTT_PORT);
 
-  if (mqttClient.connect(MQTT_CLIENT_ID)) {
+  // Last will: the broker marks the mill offline (retained) if the
+  // session dies without a DISCONNECT. Persistent session (clean = false)
+  // so QoS 1 commands sent while we were away are delivered on return.
+  if (mqttClient.connect(topics.client_id, nullptr, nullptr, topics.online, 1, true,
+                         MQTT_WILL_PAYLOAD, false)) {
+    static bool everConnected = false;
+    if (everConnected) {
+      mqttReconnects++;
+    }
+    everConnected = true;
+
     Serial.println("[MQTT] Connected");
-    mqttClient.subscribe(MQTT_CMD_SUB_TOPIC);
+    bootMark(bootTiming.mqtt_ms, "MQTT connected");
+    mqttClient.subscribe(topics.cmd, 1);                 // commands: QoS 1
+    mqttClient.subscribe(MILL_TOPIC_CMD_BROADCAST, 1);
+    mqttClient.subscribe(topics.cmd_config, 1);
     Serial.print("[MQTT] Subscribed to ");
-    Serial.println(MQTT_CMD_SUB_TOPIC);
+    Serial.print(topics.cmd);
+    Serial.print(" + ");
+    Serial.print(MILL_TOPIC_CMD_BROADCAST);
+    Serial.print(" + ");
+    Serial.println(topics.cmd_config);
+    mqttClient.subscribe(topics.time_resp);
+
+    // Birth (retained, replaces the will's "offline"); the snapshot and
+    // config echo follow with the next status frame
+    const SupBootInfo &b = supervisor_boot_info();
+    char birth[128];
+    snprintf(birth, sizeof(birth),
+             "{\"online\":true,\"fw\":\"%s\",\"reset_reason\":\"%s\",\"boot_count\":%lu}",
+             FW_VERSION, supervisor_reset_reason_str(b.reset_reason), (unsigned long)b.boot_count);
+    mqttClient.publish(topics.online, birth, true);
+    retain_reset(retainLast);
+    retain_reset(retainConfig);
+
+    // Ask for time right away after every (re)connect, and publish the
+    // status on this loop pass instead of up to a period later
+    lastTimeReqMs = millis();
+    requestTimeSync();
+    lastStatusPublishMs = millis() - STATUS_PUBLISH_MS;
   } else {
     Serial.print("[MQTT] Connect failed, rc=");
     Serial.println(mqttClient.state());
@@ -1090,23 +2067,34 @@ void mqttReconnect() {
 // -------------------------------------------------------------------
 
 void setup() {
+  // No wait for a serial monitor: relays go safe first. A monitor that
+  // is already open still sees everything.
   Serial.begin(115200);
-  delay(2000);
   Serial.println();
-  Serial.println("Nu-Cryo minimal_mqtt_bridge v0.14 (Ethernet + cycles + relays + LC108 live block)");
+  Serial.print("Nu-Cryo minimal_mqtt_bridge v");
+  Serial.print(FW_VERSION);
+  Serial.println(" (LN2 cryo mill controller, MQTT + Modbus TCP bridge)");
 
-  // RGB/Buzzer and local GPIO
-  GPIO_Init();
+  // ---- Stage 1: safe outputs -----------------------------------------
+  // The TCA9554 keeps its outputs across an ESP reset; until Relay_Init()
+  // has written it, relays are wherever the last boot left them.
+
+  // Reset cause, previous-boot record, TWDT + supervisor task
+  supervisor_begin();
+  otaBootCheck();
 
-  // I2C + relay expander
+  // I2C + relay expander (all channels off)
   I2C_Init();
   Relay_Init();
+  bootMark(bootTiming.safe_ms, "relays safe");
 
-  // We do NOT want DIN to auto-drive relays
-  Relay_Immediate_Enable = false;
+  // ---- Stage 2: start what runs on its own ---------------------------
+  // W5500 reset + auto-negotiation take seconds in the PHY, so they start
+  // before everything local; the loop connects MQTT on the link's GOT_IP
+  // and polls the LC108 on its first pass.
 
-  // Initialize digital inputs + background task
-  DIN_Init();
+  // RGB/Buzzer (IndicatorTask); EthernetTask flashes it on link-up
+  GPIO_Init();
 
   // Bring up Ethernet via Waveshare helper
   ETH_Init();
@@ -1115,39 +2103,76 @@ void setup() {
   ETH.config(ETH_LOCAL_IP, ETH_GATEWAY, ETH_SUBNET, ETH_DNS);
 
   // Bring up RS-485 serial (Serial1) for LC108 Modbus
-  rs485.begin(9600, SERIAL_8N1, RS485_RX_PIN, RS485_TX_PIN);
-  rs485.setTimeout(LC108_TIMEOUT_MS);
+  lc108_begin(rs485, RS485_RX_PIN, RS485_TX_PIN, 9600);
+  lc108_slave_init(lc108Ln2, LC108_LN2_ADDR, "pid_ln2");
+
+  // ---- Stage 3: local state (while the PHY negotiates) ---------------
+
+  // UTC from the PCF85063 until the Pi answers a time request
+  TimeSyncConfig timeCfg;
+  timesync_default_config(timeCfg);
+  timesync_init(timeSync, timeCfg);
+  seedTimeFromRtc();
+
+  // We do NOT want DIN to auto-drive relays
+  Relay_Immediate_Enable = false;
+
+  // Initialize digital inputs + background task
+  DIN_Init();
 
-  // MQTT client setup
+  // MQTT client setup (topics and client id from the device id)
+  loadDeviceId();
+  retain_init(retainLast, RETAIN_LAST_GAP_MS, RETAIN_LAST_REFRESH_MS);
+  retain_init(retainConfig, RETAIN_CONFIG_GAP_MS, 0);
+  cmd_dedup_init(cmdDedup);
   mqttClient.setServer(MQTT_HOST, MQTT_PORT);
   mqttClient.setCallback(mqttCallback);
   // Larger MQTT packet size for richer JSON payloads
-  mqttClient.setBufferSize(512);   // bump to 768/1024 later if JSON grows
+  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);  // diag carries boot / loop / iomap / anomaly / mem records
+  // Bound a connect attempt against a dead broker well inside the
+  // supervisor's loop deadline
+  netClient.setConnectionTimeout(2000);
+  mqttClient.setSocketTimeout(2);
+
+  // Modbus TCP server for SCADA (serves a cached image only)
+  mb_image_clear(mbImage);
+  modbusTcp_begin();
+
+  // State machine starts in IDLE/IDLE_READY with cycle config "not
+  // configured" (cycle_target = cycle_total = 0)
+  millSetLog(millLogToSerial);
+  millInit(mill, millis());
+
+  // I/O map before the first interlock evaluation
+  loadIoMap();
+  loadSchedule();
 
   // Initial interlock read
   checkInterlocks();
-  lastInterlocksOk = allInterlocksOk();
-
-  // Ensure relays are in a known state
-  motorRelayState = false;
-  setRelayChannel(RELAY_MOTOR_ENABLE_CH, false);
-  setRelayChannel(RELAY_FAULT_INDICATOR_CH, false);
-  setRelayChannel(RELAY_LN2_VALVE_CH, false);
-  setRelayChannel(RELAY_CABINET_FAN_CH, false);
-
-  // Initialize cycle config as "not configured"
-  cycle_target      = 0;
-  cycle_total       = 0;
-  cycle_index       = 0;
-  cycle_current     = 0;
-  time_remaining_s  = 0;
-
-  fault_code        = 0;
-  fault_reason      = "";
-  lastStateBeforeFault = millState;
-
-  lastCycleTickMs   = millis();
-  lastPidPollMs     = millis();
+  lastInterlocksOk = millInterlocksOk(mill);
+
+  // Ensure relays are in a known state (all eight, whatever the map)
+  supervisor_safe_outputs();
+  outputs_begin(setRelayChannel, millLogToSerial);
+
+  Ln2Config ln2Cfg;
+  ln2ctl_default_config(ln2Cfg);
+  ln2ctl_init(ln2Ctl, ln2Cfg);
+  eta_init(millEta);
+
+  AnomConfig anomCfg;
+  anom_default_config(anomCfg);
+  anom_init(anomLn2, anomCfg);
+
+  // First LC108 poll on the first loop pass, not a period later
+  lastPidPollMs = millis() - PID_POLL_MS;
+
+  // Heap baseline for diag "mem"; nothing below allocates
+  mem_setup_done();
+  bootMark(bootTiming.setup_ms, "setup done");
+
+  // Arm the loop slot last so setup() time is not counted against it
+  supervisor_checkin(SUP_TASK_LOOP);
 }
 
 // -------------------------------------------------------------------
@@ -1156,6 +2181,9 @@ void setup() {
 
 void loop() {
   unsigned long now = millis();
+  uint32_t loopStartUs = micros();
+  supervisor_checkin(SUP_TASK_LOOP);
+  supervisor_phase(SUP_PHASE_MQTT);
 
   // Track connection edges for debugging
   bool nowConnected = mqttClient.connected();
@@ -1171,8 +2199,17 @@ void loop() {
   // --------------------------------------------------------------------
   // 1) Maintain MQTT connection
   // --------------------------------------------------------------------
+  // No attempt (and no connect timeout) while the link has no IP; the
+  // first one goes out on the pass that sees it come up
+  bool netUp = ETH_Connected();
+  if (netUp && !lastNetUp) {
+    bootMark(bootTiming.net_ms, "network up");
+    lastMqttReconnectAttempt = now - MQTT_RECONNECT_MS;
+  }
+  lastNetUp = netUp;
+
   if (!mqttClient.connected()) {
-    if (now - lastMqttReconnectAttempt >= MQTT_RECONNECT_MS) {
+    if (netUp && now - lastMqttReconnectAttempt >= MQTT_RECONNECT_MS) {
       lastMqttReconnectAttempt = now;
       mqttReconnect();
     }
@@ -1180,54 +2217,41 @@ void loop() {
     mqttClient.loop();
   }
 
+  // Scheduled recipe starts / stops (same path as mill/cmd/control)
+  serviceSchedule();
+
   // --------------------------------------------------------------------
   // 2) Cycle timer (advance RUN timing before we potentially enter FAULT)
   // --------------------------------------------------------------------
-  updateCycleTimer();
+  supervisor_phase(SUP_PHASE_CYCLE);
+  millCycleTick(mill, now);
 
   // --------------------------------------------------------------------
   // 3) Interlock monitoring → FAULT on open
   // --------------------------------------------------------------------
+  supervisor_phase(SUP_PHASE_INTERLOCKS);
   checkInterlocks();
-  bool currentOk = allInterlocksOk();
+  bool currentOk = millInterlocksOk(mill);
 
   if (!currentOk) {
-    MillState prevState = millState;
-
-    // Decide which input caused the fault
-    if (!estop_ok) {
-      fault_code   = 1;
-      fault_reason = "ESTOP_OPEN";
-    } else if (!lid_locked) {
-      fault_code   = 2;
-      fault_reason = "LID_OPEN";
-    } else if (!door_closed) {
-      fault_code   = 3;
-      fault_reason = "DOOR_OPEN";
-    } else {
-      fault_code   = 10;
-      fault_reason = "INTERLOCK_OPEN";
+    // Decide which input caused the fault (kept current while latched,
+    // unless a device fault is what latched it)
+    if (mill.substate != SUB_FAULT_DEVICE) {
+      mill.fault = millInterlockFault(mill);
     }
 
-    // Only log + force publish on transition into FAULT
-    if (millState != MILL_FAULT) {
-      // If we were RUN or HOLD, keep whatever timing snapshot we had,
-      // but make sure cycle_index is at least 1 so UI can show the
-      // cycle on which the fault occurred.
-      if ((prevState == MILL_RUN || prevState == MILL_HOLD) &&
-          cycle_total > 0 && cycle_index == 0) {
-        cycle_index = 1;
-      }
-
-      millState            = MILL_FAULT;
-      lastStateBeforeFault = prevState;
-
+    // Only log + force publish on transition into FAULT; the table's
+    // enterFault action keeps cycle_index >= 1 for the UI
+    if (millDispatch(mill, EV_INTERLOCK_TRIP, now) == MILL_DISPATCH_DONE) {
       Serial.print("[SAFETY] Interlock opened → FAULT (");
-      Serial.print(fault_reason);
+      Serial.print(faultReasonStr(mill.fault));
       Serial.println(")");
 
       // Immediately push a FAULT status frame
-      publishStatus();
+      MillSnapshot faultSnap;
+      commitMillSnapshot();
+      millSnapshot.read(faultSnap);
+      publishStatus(faultSnap);
     }
   }
 
@@ -1235,32 +2259,112 @@ void loop() {
   lastInterlocksOk = currentOk;
 
   // --------------------------------------------------------------------
-  // 4) LN2 PID polling (real LC108 Modbus, once per PID_POLL_MS)
+  // 4) LN2 PID polling (real LC108 Modbus, once per PID_POLL_MS,
+  //    stretched by exponential backoff while the slave stays dead).
+  //    A poll spans passes: each one only sends or collects bytes.
   // --------------------------------------------------------------------
-  if (now - lastPidPollMs >= PID_POLL_MS) {
+  supervisor_phase(SUP_PHASE_PID);
+  if (lc108_busy(lc108Ln2)) {
+    pollPidLn2();
+  } else if (now - lastPidPollMs >= lc108_poll_interval_ms(lc108Ln2, PID_POLL_MS)) {
     lastPidPollMs = now;
     pollPidLn2();
   }
 
+  // Stuck PV / runaway → FAULT_DEVICE (opt-in; RUN / HOLD only)
+  uint8_t rising = anomLn2Rising;
+  anomLn2Rising  = 0;
+  if (anomFaultEnabled && (rising & ANOM_SERIOUS)) {
+    if (millDispatch(mill, EV_DEVICE_FAULT, now) == MILL_DISPATCH_DONE) {
+      Serial.println("[SAFETY] LN2 PID implausible → FAULT (PID_ANOMALY)");
+
+      MillSnapshot faultSnap;
+      commitMillSnapshot();
+      millSnapshot.read(faultSnap);
+      publishStatus(faultSnap);
+    }
+  }
+
+  // --------------------------------------------------------------------
+  // 5) Drive relays based on mill.state
+  // --------------------------------------------------------------------
+  supervisor_phase(SUP_PHASE_RELAYS);
+  // Switch-ons are ordered (fan → LN2 → motor) and staggered; switch-offs
+  // are immediate, and ignore minimum on times while unsafe
+  bool unsafe = (mill.state == MILL_FAULT) || !mill.interlocks_ok;
+
+  // Closed-loop LN2 only withholds the valve; the state still decides
+  // whether LN2 is allowed at all
+  Ln2Inputs ln2In;
+  ln2In.wanted     = !unsafe &&
+                     (outputs_wanted_mask(mill.state) & (1u << IO_RELAY_LN2));
+  ln2In.comm_ok    = pid_ln2.comm_ok;
+  ln2In.pv_c       = pid_ln2.pv_c;
+  ln2In.lc108_sv_c = pid_ln2.sv_c;
+  ln2In.valve_open = outputs_role_on(IO_RELAY_LN2);
+  uint8_t inhibit  = ln2ctl_update(ln2Ctl, ln2In, now) ? 0 : (uint8_t)(1u << IO_RELAY_LN2);
+
+  // Cooling phase between cycles: motor off, LN2 / fan as in RUN
+  if (mill.substate == SUB_RUN_COOLING) inhibit |= (uint8_t)(1u << IO_RELAY_MOTOR);
+
+  outputs_update(ioMap, mill.state, unsafe, now, inhibit);
+
+  // Recipe ETA: O(1) per pass, after this pass's relay changes
+  eta_update(millEta, etaInputs(), now);
+
+  // --------------------------------------------------------------------
+  // 5a) Commit this pass as one consistent snapshot; everything below
+  //     (and any other task) reads the snapshot, not the working globals
+  // --------------------------------------------------------------------
+  commitMillSnapshot();
+  MillSnapshot snap;
+  millSnapshot.read(snap);
+
+  // --------------------------------------------------------------------
+  // 5b) Modbus TCP: refresh cached image, then answer SCADA requests
+  // --------------------------------------------------------------------
+  supervisor_phase(SUP_PHASE_MODBUS);
+  refreshModbusImage(snap);
+  modbusTcp_loop(mbImage, modbusCommand);
+
   // --------------------------------------------------------------------
-  // 5) Drive relays based on millState
+  // 5c) Firmware update: new-image health check, one transfer slice
   // --------------------------------------------------------------------
-  updateRelayFromState();       // CH1 motor
-  updateFaultRelayFromState();  // CH2 fault indicator
-  updateLn2RelayFromState();    // CH3 LN2 valve
-  updateFanRelayFromState();    // CH4 cabinet fan
+  supervisor_phase(SUP_PHASE_OTA);
+  serviceOta();
 
   // --------------------------------------------------------------------
   // 6) Periodic status publish (runs in ALL states, including FAULT)
   // --------------------------------------------------------------------
+  supervisor_phase(SUP_PHASE_PUBLISH);
   if (mqttClient.connected() &&
       (now - lastStatusPublishMs >= STATUS_PUBLISH_MS)) {
     lastStatusPublishMs = now;
-    publishStatus();
+    publishStatus(snap);
+  }
+
+  if (mqttClient.connected() &&
+      (now - lastDiagPublishMs >= DIAG_PUBLISH_MS)) {
+    lastDiagPublishMs = now;
+    publishDiag(snap);
+  }
+
+  // RGB background: FAULT blink code, MQTT lost, RUN / HOLD / IDLE
+  serviceIndicators(snap);
+
+  // Time sync: fast until the Pi answers, then once a minute
+  unsigned long timeSyncMs = (timeSync.src == TIME_SRC_SYNC) ? TIME_SYNC_MS
+                                                             : TIME_SYNC_FAST_MS;
+  if (mqttClient.connected() && (now - lastTimeReqMs >= timeSyncMs)) {
+    lastTimeReqMs = now;
+    requestTimeSync();
   }
+  serviceRtc();
 
   // --------------------------------------------------------------------
-  // 7) Let FreeRTOS tasks (DIN, RGB, Buzzer, ETH) breathe
+  // 7) Let FreeRTOS tasks (DIN, indicators, ETH) breathe
   // --------------------------------------------------------------------
+  supervisor_phase(SUP_PHASE_IDLE);
+  supervisor_loop_done(micros() - loopStartUs);
   delay(10);
 }
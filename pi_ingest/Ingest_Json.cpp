@@ -0,0 +1,223 @@
+#include "Ingest_Json.h"
+
+#include <math.h>
+#include <string.h>
+
+// -------------------------------------------------------------------
+// Parser state
+// -------------------------------------------------------------------
+
+struct Walker {
+  const char *p;
+  const char *end;
+  JsonLeafFn  fn;
+  void       *ctx;
+  char        path[JSON_MAX_PATH];
+  size_t      path_len;
+};
+
+static void skipWs(Walker &w) {
+  while (w.p < w.end && (*w.p == ' ' || *w.p == '\t' || *w.p == '\n' || *w.p == '\r')) w.p++;
+}
+
+// Leaves w.p on the closing quote's successor; out = raw contents
+static bool parseString(Walker &w, const char *&out, size_t &outLen) {
+  if (w.p >= w.end || *w.p != '"') return false;
+  const char *start = ++w.p;
+  while (w.p < w.end && *w.p != '"') {
+    if (*w.p == '\\') {
+      if (++w.p >= w.end) return false;
+    }
+    w.p++;
+  }
+  if (w.p >= w.end) return false;
+  out    = start;
+  outLen = (size_t)(w.p - start);
+  w.p++;
+  return true;
+}
+
+static bool parseNumber(Walker &w, double &out) {
+  const char *p = w.p;
+  bool neg = false;
+  if (p < w.end && *p == '-') { neg = true; p++; }
+  if (p >= w.end || *p < '0' || *p > '9') return false;
+
+  // Integer part exact up to 2^53, which covers ts_ms
+  uint64_t ip = 0;
+  while (p < w.end && *p >= '0' && *p <= '9') ip = ip * 10 + (uint64_t)(*p++ - '0');
+  double v = (double)ip;
+
+  if (p < w.end && *p == '.') {
+    p++;
+    uint64_t frac = 0;
+    int      digits = 0;
+    while (p < w.end && *p >= '0' && *p <= '9') {
+      if (digits < 18) { frac = frac * 10 + (uint64_t)(*p - '0'); digits++; }
+      p++;
+    }
+    static const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+    v += (double)frac / POW10[digits];
+  }
+  if (p < w.end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool eneg = false;
+    if (p < w.end && (*p == '+' || *p == '-')) eneg = (*p++ == '-');
+    int e = 0;
+    while (p < w.end && *p >= '0' && *p <= '9') e = e * 10 + (*p++ - '0');
+    v *= pow(10.0, eneg ? -e : e);
+  }
+  out = neg ? -v : v;
+  w.p = p;
+  return true;
+}
+
+static bool literal(Walker &w, const char *lit) {
+  size_t n = strlen(lit);
+  if ((size_t)(w.end - w.p) < n || memcmp(w.p, lit, n) != 0) return false;
+  w.p += n;
+  return true;
+}
+
+static void emit(Walker &w, JsonLeaf &leaf) {
+  leaf.path     = w.path;
+  leaf.path_len = w.path_len;
+  w.fn(leaf, w.ctx);
+}
+
+// -------------------------------------------------------------------
+// Values
+// -------------------------------------------------------------------
+
+static bool parseValue(Walker &w, uint8_t depth);
+
+// Appends ".key" (or "key" at the top) and returns the old length
+static size_t pushKey(Walker &w, const char *key, size_t keyLen) {
+  size_t old = w.path_len;
+  size_t sep = (old > 0) ? 1 : 0;
+  if (old + sep + keyLen >= JSON_MAX_PATH) keyLen = JSON_MAX_PATH - 1 - old - sep;
+  if (sep) w.path[w.path_len++] = '.';
+  memcpy(w.path + w.path_len, key, keyLen);
+  w.path_len += keyLen;
+  w.path[w.path_len] = '\0';
+  return old;
+}
+
+static void popKey(Walker &w, size_t old) {
+  w.path_len = old;
+  w.path[old] = '\0';
+}
+
+static bool parseObject(Walker &w, uint8_t depth) {
+  w.p++;                                   // '{'
+  skipWs(w);
+  if (w.p < w.end && *w.p == '}') { w.p++; return true; }
+  while (true) {
+    skipWs(w);
+    const char *key;
+    size_t keyLen;
+    if (!parseString(w, key, keyLen)) return false;
+    skipWs(w);
+    if (w.p >= w.end || *w.p != ':') return false;
+    w.p++;
+    size_t old = pushKey(w, key, keyLen);
+    bool ok = parseValue(w, depth + 1);
+    popKey(w, old);
+    if (!ok) return false;
+    skipWs(w);
+    if (w.p >= w.end) return false;
+    if (*w.p == ',') { w.p++; continue; }
+    if (*w.p == '}') { w.p++; return true; }
+    return false;
+  }
+}
+
+static bool parseArray(Walker &w, uint8_t depth) {
+  w.p++;                                   // '['
+  size_t old = w.path_len;
+  if (w.path_len + 2 < JSON_MAX_PATH) {
+    w.path[w.path_len++] = '[';
+    w.path[w.path_len++] = ']';
+  }
+  w.path[w.path_len] = '\0';
+
+  bool ok = true;
+  skipWs(w);
+  if (w.p < w.end && *w.p == ']') {
+    w.p++;
+  } else {
+    while (true) {
+      if (!parseValue(w, depth + 1)) { ok = false; break; }
+      skipWs(w);
+      if (w.p >= w.end) { ok = false; break; }
+      if (*w.p == ',') { w.p++; continue; }
+      if (*w.p == ']') { w.p++; break; }
+      ok = false;
+      break;
+    }
+  }
+  popKey(w, old);
+  return ok;
+}
+
+static bool parseValue(Walker &w, uint8_t depth) {
+  if (depth > JSON_MAX_DEPTH) return false;
+  skipWs(w);
+  if (w.p >= w.end) return false;
+
+  JsonLeaf leaf;
+  memset(&leaf, 0, sizeof(leaf));
+  switch (*w.p) {
+    case '{': return parseObject(w, depth);
+    case '[': return parseArray(w, depth);
+    case '"':
+      if (!parseString(w, leaf.str, leaf.str_len)) return false;
+      leaf.type = JSON_STRING;
+      break;
+    case 't':
+      if (!literal(w, "true")) return false;
+      leaf.type = JSON_BOOL;
+      leaf.b    = true;
+      break;
+    case 'f':
+      if (!literal(w, "false")) return false;
+      leaf.type = JSON_BOOL;
+      break;
+    case 'n':
+      if (!literal(w, "null") && !literal(w, "nan")) return false;
+      leaf.type = JSON_NULL;
+      break;
+    case 'i':
+      if (!literal(w, "inf")) return false;
+      leaf.type = JSON_NULL;
+      break;
+    default:
+      if (literal(w, "-inf")) {
+        leaf.type = JSON_NULL;
+        break;
+      }
+      if (!parseNumber(w, leaf.num)) return false;
+      leaf.type = JSON_NUMBER;
+      break;
+  }
+  emit(w, leaf);
+  return true;
+}
+
+// -------------------------------------------------------------------
+// API
+// -------------------------------------------------------------------
+
+bool json_walk(const char *s, size_t len, JsonLeafFn fn, void *ctx) {
+  Walker w;
+  w.p        = s;
+  w.end      = s + len;
+  w.fn       = fn;
+  w.ctx      = ctx;
+  w.path[0]  = '\0';
+  w.path_len = 0;
+  if (!parseValue(w, 0)) return false;
+  skipWs(w);
+  return w.p == w.end;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+ * Ingest_Json.h
+ *
+ * Single-pass walker for the firmware's status / diag JSON. No DOM and no
+ * allocation: every scalar leaf is handed to a callback with its dotted
+ * path ("pid_ln2.pv_c"; array elements add "[]").
+ *
+ * Only what the firmware emits needs to be fast; anything else is still
+ * walked correctly or rejected as malformed. String values are passed
+ * raw (escapes not decoded). Arduino's String(float) prints a missing
+ * reading as nan / inf; those bare words are taken as null.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum JsonType : uint8_t {
+  JSON_NUMBER = 0,
+  JSON_BOOL,
+  JSON_STRING,
+  JSON_NULL
+};
+
+struct JsonLeaf {
+  const char *path;        // NUL-terminated, valid during the callback
+  size_t      path_len;
+  JsonType    type;
+  double      num;         // JSON_NUMBER
+  bool        b;           // JSON_BOOL
+  const char *str;         // JSON_STRING, not terminated
+  size_t      str_len;
+};
+
+typedef void (*JsonLeafFn)(const JsonLeaf &leaf, void *ctx);
+
+static const size_t  JSON_MAX_PATH  = 96;
+static const uint8_t JSON_MAX_DEPTH = 8;
+
+// false if `s` is not one well-formed JSON value (leaves already reported
+// stay reported).
+bool json_walk(const char *s, size_t len, JsonLeafFn fn, void *ctx);
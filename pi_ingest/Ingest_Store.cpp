@@ -0,0 +1,561 @@
+#include "Ingest_Store.h"
+#include "Ingest_Json.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// -------------------------------------------------------------------
+// Schema
+// -------------------------------------------------------------------
+
+const ColumnDef STORE_COLUMNS[] = {
+  { "ts_ms",         "ts_ms",                  COL_TS,    0 },   // must stay first
+  { "state",         "state",                  COL_STATE, 0 },
+  { "cycle_index",   "cycle_index",            COL_INT,   0 },
+  { "cycle_total",   "cycle_total",            COL_INT,   0 },
+  { "cycle_current", "cycle_current",          COL_INT,   0 },
+  { "cycle_target",  "cycle_target",           COL_INT,   0 },
+  { "time_remain_s", "time_remaining_s",       COL_INT,   0 },
+  { "fault_code",    "fault_code",             COL_INT,   0 },
+  { "pv_c",          "pid_ln2.pv_c",           COL_FIXED, 1 },
+  { "sv_c",          "pid_ln2.sv_c",           COL_FIXED, 1 },
+  { "output_pct",    "pid_ln2.output_pct",     COL_FIXED, 1 },
+  { "comm_ok",       "pid_ln2.comm_ok",        COL_BOOL,  0 },
+  { "status_raw",    "pid_ln2.status_raw",     COL_INT,   0 },
+  { "door_closed",   "interlocks.door_closed", COL_BOOL,  0 },
+  { "estop_ok",      "interlocks.estop_ok",    COL_BOOL,  0 },
+  { "lid_locked",    "interlocks.lid_locked",  COL_BOOL,  0 },
+  { "eta_recipe_s",  "eta.recipe_s",           COL_INT,   0 },
+  { "cool_rate_cpm", "eta.cool_rate_cpm",      COL_FIXED, 2 },
+  { "time_to_sv_s",  "eta.time_to_sv_s",       COL_INT,   0 },
+};
+const uint8_t STORE_NCOLS = sizeof(STORE_COLUMNS) / sizeof(STORE_COLUMNS[0]);
+
+static const size_t FILE_HDR_LEN  = 8;
+static const size_t COL_HDR_LEN   = 20;
+static const size_t BLOCK_HDR_LEN = 32;
+
+static const double POW10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+static uint8_t colOrder(const ColumnDef &c) {
+  return (c.kind == COL_TS) ? 2 : 1;
+}
+
+int store_column_index(const char *name) {
+  for (uint8_t i = 0; i < STORE_NCOLS; ++i) {
+    if (strcmp(STORE_COLUMNS[i].name, name) == 0) return i;
+  }
+  return -1;
+}
+
+double store_value(int col, int64_t raw) {
+  if (raw == STORE_NULL) return NAN;
+  const ColumnDef &c = STORE_COLUMNS[col];
+  if (c.kind == COL_FIXED) return (double)raw / POW10[c.scale];
+  return (double)raw;
+}
+
+// -------------------------------------------------------------------
+// JSON → row
+// -------------------------------------------------------------------
+
+static int8_t stateCode(const char *s, size_t n) {
+  if (n == 4 && memcmp(s, "IDLE", 4) == 0)  return STATE_IDLE;
+  if (n == 3 && memcmp(s, "RUN", 3) == 0)   return STATE_RUN;
+  if (n == 4 && memcmp(s, "HOLD", 4) == 0)  return STATE_HOLD;
+  if (n == 5 && memcmp(s, "FAULT", 5) == 0) return STATE_FAULT;
+  return -1;
+}
+
+static void rowLeaf(const JsonLeaf &leaf, void *ctx) {
+  StoreRow &row = *(StoreRow *)ctx;
+  for (uint8_t i = 0; i < STORE_NCOLS; ++i) {
+    const ColumnDef &c = STORE_COLUMNS[i];
+    if (strcmp(c.path, leaf.path) != 0) continue;
+    switch (leaf.type) {
+      case JSON_NUMBER:
+        row.v[i] = (c.kind == COL_FIXED) ? llround(leaf.num * POW10[c.scale]) : llround(leaf.num);
+        break;
+      case JSON_BOOL:
+        row.v[i] = leaf.b ? 1 : 0;
+        break;
+      case JSON_STRING:
+        if (c.kind == COL_STATE) {
+          int8_t s = stateCode(leaf.str, leaf.str_len);
+          if (s >= 0) row.v[i] = s;
+        }
+        break;
+      case JSON_NULL:
+        break;
+    }
+    return;
+  }
+}
+
+bool store_row_from_json(const char *json, size_t len, int64_t recv_ms, StoreRow &row) {
+  for (uint8_t i = 0; i < STORE_NCOLS; ++i) row.v[i] = STORE_NULL;
+  if (!json_walk(json, len, rowLeaf, &row)) return false;
+  if (row.v[0] == STORE_NULL || row.v[0] <= 0) row.v[0] = recv_ms;
+  return true;
+}
+
+// -------------------------------------------------------------------
+// Varint columns
+// -------------------------------------------------------------------
+
+static inline uint64_t zigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t u) {
+  return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+static inline uint8_t *putVarint(uint8_t *p, uint64_t v) {
+  while (v >= 0x80) {
+    *p++ = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (uint8_t)v;
+  return p;
+}
+
+static inline bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v) {
+  v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (p >= end) return false;
+    uint8_t b = *p++;
+    v |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+static uint8_t *encodeColumn(const int64_t *v, uint32_t n, uint8_t order, uint8_t *p) {
+  bool    have      = false;
+  int64_t prev      = 0;
+  int64_t prevDelta = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    if (v[i] == STORE_NULL) {
+      *p++ = 0;
+      continue;
+    }
+    int64_t d;
+    if (!have) {
+      d    = v[i];
+      have = true;
+    } else {
+      int64_t delta = (int64_t)((uint64_t)v[i] - (uint64_t)prev);
+      d = (order == 2) ? (int64_t)((uint64_t)delta - (uint64_t)prevDelta) : delta;
+      prevDelta = delta;
+    }
+    prev = v[i];
+    p = putVarint(p, zigzag(d) + 1);
+  }
+  return p;
+}
+
+static bool decodeColumn(const uint8_t *p, const uint8_t *end, uint32_t n, uint8_t order, int64_t *out) {
+  bool    have      = false;
+  int64_t prev      = 0;
+  int64_t prevDelta = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    uint64_t u;
+    if (!getVarint(p, end, u)) return false;
+    if (u == 0) {
+      out[i] = STORE_NULL;
+      continue;
+    }
+    int64_t d = unzigzag(u - 1);
+    if (!have) {
+      prev = d;
+      have = true;
+    } else {
+      int64_t delta = (order == 2) ? (int64_t)((uint64_t)prevDelta + (uint64_t)d) : d;
+      prevDelta = delta;
+      prev = (int64_t)((uint64_t)prev + (uint64_t)delta);
+    }
+    out[i] = prev;
+  }
+  return p == end;
+}
+
+// -------------------------------------------------------------------
+// CRC-32 (IEEE)
+// -------------------------------------------------------------------
+
+uint32_t store_crc32(const uint8_t *p, size_t len) {
+  static uint32_t table[256];
+  static bool ready = false;
+  if (!ready) {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    ready = true;
+  }
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; ++i) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFu;
+}
+
+// -------------------------------------------------------------------
+// Reader
+// -------------------------------------------------------------------
+
+bool store_map(StoreFile &f, const char *path) {
+  memset(&f, 0, sizeof(f));
+  f.fd = open(path, O_RDONLY);
+  if (f.fd < 0) return false;
+
+  struct stat st;
+  if (fstat(f.fd, &st) != 0 || (size_t)st.st_size < FILE_HDR_LEN) {
+    close(f.fd);
+    f.fd = -1;
+    return false;
+  }
+  f.size = (size_t)st.st_size;
+  void *m = mmap(nullptr, f.size, PROT_READ, MAP_SHARED, f.fd, 0);
+  if (m == MAP_FAILED) {
+    close(f.fd);
+    f.fd = -1;
+    return false;
+  }
+  f.map = (const uint8_t *)m;
+
+  uint16_t version;
+  memcpy(&version, f.map + 4, 2);
+  memcpy(&f.ncols, f.map + 6, 2);
+  if (memcmp(f.map, "MCOL", 4) != 0 || version != STORE_VERSION || f.ncols == 0 || f.ncols > 32 ||
+      f.size < FILE_HDR_LEN + f.ncols * COL_HDR_LEN) {
+    store_unmap(f);
+    return false;
+  }
+
+  for (int i = 0; i < 32; ++i) f.col_map[i] = -1;
+  for (uint16_t fc = 0; fc < f.ncols; ++fc) {
+    const uint8_t *h = f.map + FILE_HDR_LEN + fc * COL_HDR_LEN;
+    char name[17];
+    memcpy(name, h, 16);
+    name[16] = '\0';
+    f.col_order[fc] = h[18];
+    int col = store_column_index(name);
+    if (col >= 0) f.col_map[col] = fc;
+  }
+  f.first_block = FILE_HDR_LEN + f.ncols * COL_HDR_LEN;
+  return true;
+}
+
+void store_unmap(StoreFile &f) {
+  if (f.map) munmap((void *)f.map, f.size);
+  if (f.fd >= 0) close(f.fd);
+  f.map = nullptr;
+  f.fd  = -1;
+}
+
+bool store_next_block(const StoreFile &f, size_t &offset, StoreBlockInfo &info, bool check_crc) {
+  size_t hdr = BLOCK_HDR_LEN + 4 * (size_t)f.ncols;
+  if (offset + hdr > f.size) return false;
+  const uint8_t *h = f.map + offset;
+  if (memcmp(h, "BLK1", 4) != 0) return false;
+
+  uint32_t crc;
+  memcpy(&info.rows, h + 4, 4);
+  memcpy(&info.t_min, h + 8, 8);
+  memcpy(&info.t_max, h + 16, 8);
+  memcpy(&info.payload_len, h + 24, 4);
+  memcpy(&crc, h + 28, 4);
+  if (info.rows == 0 || info.rows > STORE_BLOCK_ROWS) return false;
+  if (offset + hdr + info.payload_len > f.size) return false;
+
+  uint32_t prevEnd = 0;
+  for (uint16_t c = 0; c < f.ncols; ++c) {
+    uint32_t e;
+    memcpy(&e, h + BLOCK_HDR_LEN + 4 * c, 4);
+    if (e < prevEnd || e > info.payload_len) return false;
+    prevEnd = e;
+  }
+
+  info.offset = offset;
+  info.crc_ok = true;
+  if (check_crc) {
+    info.crc_ok = store_crc32(h + hdr, info.payload_len) == crc;
+    if (!info.crc_ok) return false;
+  }
+  offset += hdr + info.payload_len;
+  return true;
+}
+
+bool store_decode_column(const StoreFile &f, const StoreBlockInfo &b, int col, int64_t *out) {
+  if (col < 0 || col >= STORE_NCOLS) return false;
+  int fc = f.col_map[col];
+  if (fc < 0) return false;
+  const uint8_t *h       = f.map + b.offset;
+  const uint8_t *payload = h + BLOCK_HDR_LEN + 4 * (size_t)f.ncols;
+  uint32_t begin = 0, end;
+  if (fc > 0) memcpy(&begin, h + BLOCK_HDR_LEN + 4 * (fc - 1), 4);
+  memcpy(&end, h + BLOCK_HDR_LEN + 4 * fc, 4);
+  return decodeColumn(payload + begin, payload + end, b.rows, f.col_order[fc], out);
+}
+
+uint64_t store_query_block(const StoreFile &f, const StoreBlockInfo &b, int64_t from_ms, int64_t to_ms,
+                           const int *cols, int ncols, StoreRowFn fn, void *ctx) {
+  if (b.t_max < from_ms || b.t_min > to_ms) return 0;
+
+  // Reused across calls: one block's worth per requested column
+  static thread_local std::vector<int64_t> ts(STORE_BLOCK_ROWS);
+  static thread_local std::vector<int64_t> vals;
+  static thread_local std::vector<int64_t> row;
+  vals.resize((size_t)ncols * STORE_BLOCK_ROWS);
+  row.resize((size_t)ncols);
+
+  if (!store_decode_column(f, b, 0, ts.data())) return 0;
+  for (int c = 0; c < ncols; ++c) {
+    int64_t *out = &vals[(size_t)c * STORE_BLOCK_ROWS];
+    if (!store_decode_column(f, b, cols[c], out)) {
+      for (uint32_t r = 0; r < b.rows; ++r) out[r] = STORE_NULL;
+    }
+  }
+  uint64_t emitted = 0;
+  for (uint32_t r = 0; r < b.rows; ++r) {
+    if (ts[r] < from_ms || ts[r] > to_ms) continue;
+    for (int c = 0; c < ncols; ++c) row[c] = vals[(size_t)c * STORE_BLOCK_ROWS + r];
+    fn(ts[r], row.data(), ctx);
+    emitted++;
+  }
+  return emitted;
+}
+
+uint64_t store_query_file(const StoreFile &f, int64_t from_ms, int64_t to_ms,
+                          const int *cols, int ncols, StoreRowFn fn, void *ctx) {
+  uint64_t emitted = 0;
+  size_t off = f.first_block;
+  StoreBlockInfo b;
+  while (store_next_block(f, off, b, false)) {
+    emitted += store_query_block(f, b, from_ms, to_ms, cols, ncols, fn, ctx);
+  }
+  return emitted;
+}
+
+std::vector<std::string> store_list(const char *dir) {
+  std::vector<std::string> out;
+  DIR *d = opendir(dir);
+  if (!d) return out;
+  while (struct dirent *e = readdir(d)) {
+    size_t n = strlen(e->d_name);
+    if (n > 5 && strcmp(e->d_name + n - 5, ".mcol") == 0) out.push_back(std::string(dir) + "/" + e->d_name);
+  }
+  closedir(d);
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+// -------------------------------------------------------------------
+// Writer
+// -------------------------------------------------------------------
+
+static bool writeAll(int fd, const uint8_t *p, size_t n) {
+  while (n > 0) {
+    ssize_t k = write(fd, p, n);
+    if (k < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += k;
+    n -= (size_t)k;
+  }
+  return true;
+}
+
+static void closePartition(StoreWriter &w) {
+  if (w.fd >= 0) close(w.fd);
+  w.fd = -1;
+  w.path.clear();
+}
+
+// Opens (or creates) `name`, cutting off a torn last block
+static bool openPartition(StoreWriter &w, const std::string &name) {
+  closePartition(w);
+  std::string path = w.dir + "/" + name;
+
+  size_t validEnd = 0;
+  StoreFile f;
+  if (store_map(f, path.c_str())) {
+    bool same = f.ncols == STORE_NCOLS;
+    for (uint8_t c = 0; same && c < STORE_NCOLS; ++c) same = f.col_map[c] == c;
+    if (!same) {
+      store_unmap(f);
+      fprintf(stderr, "[STORE] %s has another schema, not appending\n", path.c_str());
+      return false;
+    }
+    size_t off = f.first_block;
+    StoreBlockInfo b;
+    while (store_next_block(f, off, b, true)) {}
+    validEnd = off;
+    if (validEnd < f.size) {
+      fprintf(stderr, "[STORE] %s: dropping %zu B torn tail\n", path.c_str(), f.size - validEnd);
+    }
+    store_unmap(f);
+  }
+
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "[STORE] open %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  if (validEnd == 0) {
+    // New (or unreadable) file: header first
+    uint8_t hdr[FILE_HDR_LEN + 32 * COL_HDR_LEN];
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, "MCOL", 4);
+    memcpy(hdr + 4, &STORE_VERSION, 2);
+    uint16_t n = STORE_NCOLS;
+    memcpy(hdr + 6, &n, 2);
+    for (uint8_t c = 0; c < STORE_NCOLS; ++c) {
+      uint8_t *h = hdr + FILE_HDR_LEN + c * COL_HDR_LEN;
+      strncpy((char *)h, STORE_COLUMNS[c].name, 16);
+      h[16] = STORE_COLUMNS[c].kind;
+      h[17] = STORE_COLUMNS[c].scale;
+      h[18] = colOrder(STORE_COLUMNS[c]);
+    }
+    size_t len = FILE_HDR_LEN + STORE_NCOLS * COL_HDR_LEN;
+    if (ftruncate(fd, 0) != 0 || !writeAll(fd, hdr, len)) {
+      close(fd);
+      return false;
+    }
+    validEnd = len;
+  } else if (ftruncate(fd, (off_t)validEnd) != 0) {
+    close(fd);
+    return false;
+  }
+  lseek(fd, (off_t)validEnd, SEEK_SET);
+
+  w.fd   = fd;
+  w.path = path;
+  w.partitions++;
+  fprintf(stderr, "[STORE] writing %s\n", path.c_str());
+  return true;
+}
+
+bool store_writer_open(StoreWriter &w, const char *dir, uint32_t flush_ms) {
+  w.dir            = dir;
+  w.flush_ms       = flush_ms;
+  w.fd             = -1;
+  w.in_batch       = false;
+  w.day            = -1;
+  w.raw.assign((size_t)STORE_NCOLS * STORE_BLOCK_ROWS, STORE_NULL);
+  w.enc.resize(BLOCK_HDR_LEN + 4 * STORE_NCOLS + (size_t)STORE_NCOLS * STORE_BLOCK_ROWS * 10);
+  w.rows           = 0;
+  w.block_start_ms = 0;
+  w.rows_total     = 0;
+  w.blocks_total   = 0;
+  w.bytes_total    = 0;
+  w.partitions     = 0;
+  mkdir(dir, 0755);
+  struct stat st;
+  return stat(dir, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool store_flush(StoreWriter &w) {
+  if (w.rows == 0) return true;
+  if (w.fd < 0) {
+    w.rows = 0;
+    return false;
+  }
+
+  uint8_t *hdr     = w.enc.data();
+  uint8_t *payload = hdr + BLOCK_HDR_LEN + 4 * STORE_NCOLS;
+  uint8_t *p       = payload;
+  for (uint8_t c = 0; c < STORE_NCOLS; ++c) {
+    p = encodeColumn(&w.raw[(size_t)c * STORE_BLOCK_ROWS], w.rows, colOrder(STORE_COLUMNS[c]), p);
+    uint32_t e = (uint32_t)(p - payload);
+    memcpy(hdr + BLOCK_HDR_LEN + 4 * c, &e, 4);
+  }
+
+  int64_t tmin = INT64_MAX, tmax = INT64_MIN;
+  for (uint32_t r = 0; r < w.rows; ++r) {
+    tmin = std::min(tmin, w.raw[r]);
+    tmax = std::max(tmax, w.raw[r]);
+  }
+  uint32_t payloadLen = (uint32_t)(p - payload);
+  uint32_t crc        = store_crc32(payload, payloadLen);
+  memcpy(hdr, "BLK1", 4);
+  memcpy(hdr + 4, &w.rows, 4);
+  memcpy(hdr + 8, &tmin, 8);
+  memcpy(hdr + 16, &tmax, 8);
+  memcpy(hdr + 24, &payloadLen, 4);
+  memcpy(hdr + 28, &crc, 4);
+
+  size_t total = (size_t)(p - hdr);
+  bool ok = writeAll(w.fd, hdr, total) && fdatasync(w.fd) == 0;
+  if (!ok) fprintf(stderr, "[STORE] write %s: %s\n", w.path.c_str(), strerror(errno));
+
+  w.blocks_total++;
+  w.bytes_total += total;
+  w.rows = 0;
+  return ok;
+}
+
+bool store_tick(StoreWriter &w, int64_t now_ms) {
+  if (w.rows > 0 && now_ms - w.block_start_ms >= (int64_t)w.flush_ms) return store_flush(w);
+  return true;
+}
+
+static int32_t dayOf(int64_t t_ms) {
+  int64_t d = t_ms / 86400000;
+  if (t_ms < 0 && d * 86400000 != t_ms) d--;
+  return (int32_t)d;
+}
+
+static std::string partitionName(bool batch, int64_t t_ms) {
+  time_t s = (time_t)(t_ms / 1000);
+  struct tm tm;
+  gmtime_r(&s, &tm);
+  char buf[40];
+  if (batch) strftime(buf, sizeof(buf), "batch-%Y%m%dT%H%M%SZ.mcol", &tm);
+  else       strftime(buf, sizeof(buf), "day-%Y%m%d.mcol", &tm);
+  return buf;
+}
+
+bool store_append(StoreWriter &w, const StoreRow &row, int64_t now_ms) {
+  int64_t t  = row.v[0];
+  int     st = (row.v[1] == STORE_NULL) ? -1 : (int)row.v[1];
+
+  // Batch: first RUN outside a batch until the next IDLE
+  bool ok = true;
+  if (!w.in_batch && st == STATE_RUN) {
+    ok = store_flush(w);
+    w.in_batch = true;
+    openPartition(w, partitionName(true, t));
+  } else if ((w.in_batch && st == STATE_IDLE) || (!w.in_batch && (w.fd < 0 || dayOf(t) != w.day))) {
+    ok = store_flush(w);
+    w.in_batch = false;
+    w.day      = dayOf(t);
+    openPartition(w, partitionName(false, t));
+  }
+
+  if (w.rows == 0) w.block_start_ms = now_ms;
+  for (uint8_t c = 0; c < STORE_NCOLS; ++c) w.raw[(size_t)c * STORE_BLOCK_ROWS + w.rows] = row.v[c];
+  w.rows++;
+  w.rows_total++;
+
+  if (w.rows >= STORE_BLOCK_ROWS) ok = store_flush(w) && ok;
+  else                            ok = store_tick(w, now_ms) && ok;
+  return ok;
+}
+
+void store_writer_close(StoreWriter &w) {
+  store_flush(w);
+  closePartition(w);
+}
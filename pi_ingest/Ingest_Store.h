@@ -0,0 +1,169 @@
+#pragma once
+
+/*
+ * Ingest_Store.h
+ *
+ * Columnar time-series files for mill status frames.
+ *
+ * Partitions: one file per batch (first RUN after IDLE until the next
+ * IDLE, named by its first frame) and one per UTC day for everything in
+ * between:
+ *
+ *   <dir>/batch-20260301T081500Z.mcol
+ *   <dir>/day-20260301.mcol
+ *
+ * File layout (little endian, append only):
+ *
+ *   "MCOL" u16 version u16 ncols
+ *   ncols x { char name[16]; u8 kind; u8 scale; u8 order; u8 0 }
+ *   blocks:
+ *     "BLK1" u32 rows i64 t_min i64 t_max u32 payload_len u32 crc32
+ *     u32 col_end[ncols]             // end of each column in the payload
+ *     payload: the columns one after another
+ *
+ * Each column is a run of LEB128 varints: value 0 = missing, otherwise
+ * zigzag(delta) + 1, delta against the previous present value (order 1)
+ * or the previous delta (order 2, timestamps). Decimals are stored as
+ * fixed point (value * 10^scale). A 1 Hz status frame costs ~20 B here
+ * against ~700 B of JSON.
+ *
+ * Blocks hold up to STORE_BLOCK_ROWS rows and are written whole (flushed
+ * when full, on a partition change, or after flush_ms). A reader maps the
+ * file, skips blocks by t_min / t_max and decodes only the columns it was
+ * asked for. A torn block at the end (power loss) is cut off when the
+ * writer reopens the file.
+ *
+ * Memory: the writer keeps one block of raw values (STORE_BLOCK_ROWS x
+ * columns x 8 B) plus its encoding buffer, whatever the message rate.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// -------------------------------------------------------------------
+// Schema (version 1)
+// -------------------------------------------------------------------
+
+enum ColKind : uint8_t {
+  COL_TS = 0,              // UTC ms
+  COL_INT,
+  COL_FIXED,               // decimal, scale digits
+  COL_BOOL,
+  COL_STATE                // "IDLE" 0, "RUN" 1, "HOLD" 2, "FAULT" 3
+};
+
+struct ColumnDef {
+  const char *name;        // ≤ 15 chars, used by queries
+  const char *path;        // JSON path in mill/status/state
+  ColKind     kind;
+  uint8_t     scale;       // COL_FIXED: decimals kept
+};
+
+extern const ColumnDef STORE_COLUMNS[];
+extern const uint8_t   STORE_NCOLS;
+
+static const uint16_t STORE_VERSION    = 1;
+static const uint32_t STORE_BLOCK_ROWS = 4096;
+static const int64_t  STORE_NULL       = INT64_MIN;
+
+enum MillStateCode : uint8_t {
+  STATE_IDLE = 0,
+  STATE_RUN,
+  STATE_HOLD,
+  STATE_FAULT
+};
+
+struct StoreRow {
+  int64_t v[32];           // column order of STORE_COLUMNS; STORE_NULL = missing
+};
+
+// Decode one status frame. recv_ms is used when the frame has no ts_ms
+// (or 0: MCU time not known yet). false if the JSON is malformed.
+bool store_row_from_json(const char *json, size_t len, int64_t recv_ms, StoreRow &row);
+
+int  store_column_index(const char *name);       // -1 if unknown
+double store_value(int col, int64_t raw);        // fixed point → double
+
+// -------------------------------------------------------------------
+// Writer
+// -------------------------------------------------------------------
+
+struct StoreWriter {
+  std::string dir;
+  uint32_t    flush_ms;
+
+  // open partition
+  int         fd;
+  std::string path;
+  bool        in_batch;
+  int32_t     day;             // days since epoch of the day partition
+
+  // current block
+  std::vector<int64_t> raw;    // [col * STORE_BLOCK_ROWS + row]
+  std::vector<uint8_t> enc;
+  uint32_t    rows;
+  int64_t     block_start_ms;  // wall clock of the first row in the block
+
+  // totals
+  uint64_t    rows_total;
+  uint64_t    blocks_total;
+  uint64_t    bytes_total;
+  uint32_t    partitions;
+};
+
+bool store_writer_open(StoreWriter &w, const char *dir, uint32_t flush_ms);
+// Appends (partitioning by state / UTC day) and flushes when due.
+bool store_append(StoreWriter &w, const StoreRow &row, int64_t now_ms);
+// Flush if the block is older than flush_ms (call when idle).
+bool store_tick(StoreWriter &w, int64_t now_ms);
+bool store_flush(StoreWriter &w);
+void store_writer_close(StoreWriter &w);
+
+// -------------------------------------------------------------------
+// Reader
+// -------------------------------------------------------------------
+
+struct StoreFile {
+  int            fd;
+  const uint8_t *map;
+  size_t         size;
+  uint16_t       ncols;
+  size_t         first_block;  // offset of the first block
+  int            col_map[32];  // STORE_COLUMNS index → column in this file, -1 = absent
+  uint8_t        col_order[32];
+};
+
+bool store_map(StoreFile &f, const char *path);
+void store_unmap(StoreFile &f);
+
+struct StoreBlockInfo {
+  size_t   offset;
+  uint32_t rows;
+  int64_t  t_min;
+  int64_t  t_max;
+  uint32_t payload_len;
+  bool     crc_ok;             // only checked when asked to
+};
+
+// Walks block headers; false at the end or at a torn / corrupt block.
+bool store_next_block(const StoreFile &f, size_t &offset, StoreBlockInfo &info, bool check_crc);
+
+// Decodes column `col` (STORE_COLUMNS index) of a block; out gets `rows`
+// raw values. false if the column is absent or damaged.
+bool store_decode_column(const StoreFile &f, const StoreBlockInfo &b, int col, int64_t *out);
+
+// Calls fn for each row with t in [from_ms, to_ms], in file / block
+// order. vals[i] = raw value of cols[i].
+typedef void (*StoreRowFn)(int64_t t_ms, const int64_t *vals, void *ctx);
+uint64_t store_query_block(const StoreFile &f, const StoreBlockInfo &b, int64_t from_ms, int64_t to_ms,
+                           const int *cols, int ncols, StoreRowFn fn, void *ctx);
+uint64_t store_query_file(const StoreFile &f, int64_t from_ms, int64_t to_ms,
+                          const int *cols, int ncols, StoreRowFn fn, void *ctx);
+
+// All *.mcol files of `dir`, sorted by name.
+std::vector<std::string> store_list(const char *dir);
+
+uint32_t store_crc32(const uint8_t *p, size_t len);
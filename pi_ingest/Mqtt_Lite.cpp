@@ -0,0 +1,333 @@
+#include "Mqtt_Lite.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// -------------------------------------------------------------------
+// Packet helpers
+// -------------------------------------------------------------------
+
+enum : uint8_t {
+  PKT_CONNECT   = 0x10,
+  PKT_CONNACK   = 0x20,
+  PKT_PUBLISH   = 0x30,
+  PKT_PUBACK    = 0x40,
+  PKT_SUBSCRIBE = 0x82,
+  PKT_SUBACK    = 0x90,
+  PKT_PINGREQ   = 0xC0,
+  PKT_PINGRESP  = 0xD0,
+  PKT_DISCONNECT = 0xE0
+};
+
+int64_t mqtt_now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void putU16(std::vector<uint8_t> &b, uint16_t v) {
+  b.push_back((uint8_t)(v >> 8));
+  b.push_back((uint8_t)v);
+}
+
+static void putStr(std::vector<uint8_t> &b, const void *s, size_t n) {
+  putU16(b, (uint16_t)n);
+  b.insert(b.end(), (const uint8_t *)s, (const uint8_t *)s + n);
+}
+
+// Fixed header + remaining length in front of `body`
+static std::vector<uint8_t> frame(uint8_t type, const std::vector<uint8_t> &body) {
+  std::vector<uint8_t> out;
+  out.reserve(body.size() + 5);
+  out.push_back(type);
+  size_t n = body.size();
+  do {
+    uint8_t d = n % 128;
+    n /= 128;
+    if (n) d |= 0x80;
+    out.push_back(d);
+  } while (n);
+  out.insert(out.end(), body.begin(), body.end());
+  return out;
+}
+
+static bool sendAll(MqttClient &c, const std::vector<uint8_t> &pkt) {
+  const uint8_t *p = pkt.data();
+  size_t n = pkt.size();
+  while (n > 0) {
+    ssize_t k = send(c.fd, p, n, MSG_NOSIGNAL);
+    if (k < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        struct pollfd pfd = { c.fd, POLLOUT, 0 };
+        if (poll(&pfd, 1, 1000) <= 0) return false;
+        continue;
+      }
+      return false;
+    }
+    p += k;
+    n -= (size_t)k;
+  }
+  c.last_tx_ms = mqtt_now_ms();
+  return true;
+}
+
+// Length of the packet at p (0 = incomplete, SIZE_MAX = malformed or
+// larger than max); hdr = fixed header length
+static size_t packetLen(const uint8_t *p, size_t avail, size_t max, size_t &hdr) {
+  size_t mult = 1, rem = 0, i = 1;
+  while (true) {
+    if (i >= avail) return 0;
+    uint8_t d = p[i++];
+    rem += (d & 0x7F) * mult;
+    if (!(d & 0x80)) break;
+    mult *= 128;
+    if (i > 4) return SIZE_MAX;
+  }
+  hdr = i;
+  if (hdr + rem > max) return SIZE_MAX;
+  return (avail >= hdr + rem) ? hdr + rem : 0;
+}
+
+static bool handlePacket(MqttClient &c, const uint8_t *p, size_t hdr, size_t len) {
+  uint8_t type = p[0] & 0xF0;
+  const uint8_t *body = p + hdr;
+  size_t blen = len - hdr;
+
+  switch (type) {
+    case PKT_PUBLISH: {
+      uint8_t qos = (p[0] >> 1) & 0x03;
+      if (blen < 2) return false;
+      size_t tlen = ((size_t)body[0] << 8) | body[1];
+      size_t off  = 2 + tlen;
+      uint16_t id = 0;
+      if (qos > 0) {
+        if (off + 2 > blen) return false;
+        id = (uint16_t)((body[off] << 8) | body[off + 1]);
+        off += 2;
+      }
+      if (off > blen) return false;
+      c.rx_msgs++;
+      if (c.on_message) c.on_message((const char *)body + 2, tlen, body + off, blen - off, c.ctx);
+      if (qos == 1) {
+        std::vector<uint8_t> ack;
+        putU16(ack, id);
+        return sendAll(c, frame(PKT_PUBACK, ack));
+      }
+      return qos == 0;                 // QoS 2 is never subscribed to
+    }
+    case PKT_PUBACK:
+      c.puback_rx++;
+      return true;
+    case PKT_PINGRESP:
+      c.ping_sent_ms = 0;
+      return true;
+    case PKT_SUBACK:
+      if (blen >= 3 && body[2] == 0x80) {
+        fprintf(stderr, "[MQTT] subscription refused\n");
+        return false;
+      }
+      return true;
+    default:
+      return true;
+  }
+}
+
+// -------------------------------------------------------------------
+// API
+// -------------------------------------------------------------------
+
+void mqtt_init(MqttClient &c, MqttMessageFn fn, void *ctx, size_t max_packet) {
+  c.fd           = -1;
+  c.connected    = false;
+  c.keepalive_s  = 30;
+  c.last_tx_ms   = 0;
+  c.ping_sent_ms = 0;
+  c.next_id      = 1;
+  c.max_packet   = max_packet;
+  c.rx.assign(max_packet, 0);
+  c.rx_len       = 0;
+  c.on_message   = fn;
+  c.ctx          = ctx;
+  c.rx_msgs = c.rx_bytes = c.tx_msgs = c.puback_rx = 0;
+}
+
+bool mqtt_connect(MqttClient &c, const char *host, uint16_t port, const char *client_id,
+                  uint16_t keepalive_s, const MqttWill *will, int timeout_ms) {
+  mqtt_close(c);
+
+  char portStr[8];
+  snprintf(portStr, sizeof(portStr), "%u", port);
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *res = nullptr;
+  if (getaddrinfo(host, portStr, &hints, &res) != 0) return false;
+  for (struct addrinfo *a = res; a; a = a->ai_next) {
+    c.fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (c.fd < 0) continue;
+    if (connect(c.fd, a->ai_addr, a->ai_addrlen) == 0) break;
+    close(c.fd);
+    c.fd = -1;
+  }
+  freeaddrinfo(res);
+  if (c.fd < 0) return false;
+  int one = 1;
+  setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  std::vector<uint8_t> b;
+  putStr(b, "MQTT", 4);
+  b.push_back(4);                                // 3.1.1
+  uint8_t flags = 0x02;                          // clean session
+  if (will) flags |= 0x04 | (uint8_t)((will->qos & 3) << 3) | (will->retain ? 0x20 : 0);
+  b.push_back(flags);
+  putU16(b, keepalive_s);
+  putStr(b, client_id, strlen(client_id));
+  if (will) {
+    putStr(b, will->topic, strlen(will->topic));
+    putStr(b, will->payload, will->len);
+  }
+  if (!sendAll(c, frame(PKT_CONNECT, b))) {
+    mqtt_close(c);
+    return false;
+  }
+
+  // CONNACK: 4 bytes, return code in the last
+  uint8_t ack[4];
+  size_t got = 0;
+  int64_t deadline = mqtt_now_ms() + timeout_ms;
+  while (got < sizeof(ack)) {
+    int left = (int)(deadline - mqtt_now_ms());
+    struct pollfd pfd = { c.fd, POLLIN, 0 };
+    if (left <= 0 || poll(&pfd, 1, left) <= 0) break;
+    ssize_t k = recv(c.fd, ack + got, sizeof(ack) - got, 0);
+    if (k <= 0) break;
+    got += (size_t)k;
+  }
+  if (got < sizeof(ack) || ack[0] != PKT_CONNACK || ack[3] != 0) {
+    if (got == sizeof(ack)) fprintf(stderr, "[MQTT] connect refused, code %u\n", ack[3]);
+    mqtt_close(c);
+    return false;
+  }
+
+  c.connected    = true;
+  c.keepalive_s  = keepalive_s;
+  c.ping_sent_ms = 0;
+  c.rx_len       = 0;
+  return true;
+}
+
+bool mqtt_subscribe(MqttClient &c, const char *filter, uint8_t qos) {
+  if (!c.connected) return false;
+  std::vector<uint8_t> b;
+  putU16(b, c.next_id++);
+  if (c.next_id == 0) c.next_id = 1;
+  putStr(b, filter, strlen(filter));
+  b.push_back(qos);
+  return sendAll(c, frame(PKT_SUBSCRIBE, b));
+}
+
+bool mqtt_publish(MqttClient &c, const char *topic, const void *payload, size_t len,
+                  uint8_t qos, bool retain) {
+  if (!c.connected) return false;
+  std::vector<uint8_t> b;
+  b.reserve(len + strlen(topic) + 4);
+  putStr(b, topic, strlen(topic));
+  if (qos > 0) {
+    putU16(b, c.next_id++);
+    if (c.next_id == 0) c.next_id = 1;
+  }
+  b.insert(b.end(), (const uint8_t *)payload, (const uint8_t *)payload + len);
+  uint8_t type = PKT_PUBLISH | (uint8_t)((qos > 0 ? 1 : 0) << 1) | (retain ? 1 : 0);
+  if (!sendAll(c, frame(type, b))) {
+    c.connected = false;
+    return false;
+  }
+  c.tx_msgs++;
+  return true;
+}
+
+bool mqtt_poll(MqttClient &c, int timeout_ms) {
+  if (!c.connected) return false;
+
+  // Keepalive: ping at 3/4 of the interval, give up after a full one
+  int64_t now = mqtt_now_ms();
+  int64_t ka  = (int64_t)c.keepalive_s * 1000;
+  if (ka > 0) {
+    if (c.ping_sent_ms && now - c.ping_sent_ms > ka) {
+      fprintf(stderr, "[MQTT] no PINGRESP, dropping connection\n");
+      c.connected = false;
+      return false;
+    }
+    if (!c.ping_sent_ms && now - c.last_tx_ms >= ka * 3 / 4) {
+      std::vector<uint8_t> none;
+      if (!sendAll(c, frame(PKT_PINGREQ, none))) {
+        c.connected = false;
+        return false;
+      }
+      c.ping_sent_ms = now;
+    }
+    int64_t untilPing = c.last_tx_ms + ka * 3 / 4 - now;
+    if (!c.ping_sent_ms && untilPing < timeout_ms) timeout_ms = (int)(untilPing > 0 ? untilPing : 0);
+  }
+
+  struct pollfd pfd = { c.fd, POLLIN, 0 };
+  int r = poll(&pfd, 1, timeout_ms);
+  if (r < 0) return errno == EINTR;
+  if (r == 0) return true;
+
+  ssize_t k = recv(c.fd, c.rx.data() + c.rx_len, c.max_packet - c.rx_len, 0);
+  if (k <= 0) {
+    if (k < 0 && (errno == EINTR || errno == EAGAIN)) return true;
+    c.connected = false;
+    return false;
+  }
+  c.rx_len   += (size_t)k;
+  c.rx_bytes += (size_t)k;
+
+  // Dispatch every complete packet, keep the partial tail
+  size_t off = 0;
+  while (off < c.rx_len) {
+    size_t hdr = 0;
+    size_t len = packetLen(c.rx.data() + off, c.rx_len - off, c.max_packet, hdr);
+    if (len == 0) break;
+    if (len == SIZE_MAX) {
+      fprintf(stderr, "[MQTT] oversized packet, dropping connection\n");
+      c.connected = false;
+      return false;
+    }
+    if (!handlePacket(c, c.rx.data() + off, hdr, len)) {
+      c.connected = false;
+      return false;
+    }
+    off += len;
+  }
+  if (off > 0) {
+    memmove(c.rx.data(), c.rx.data() + off, c.rx_len - off);
+    c.rx_len -= off;
+  }
+  return true;
+}
+
+void mqtt_close(MqttClient &c) {
+  if (c.fd >= 0) {
+    if (c.connected) {
+      std::vector<uint8_t> none;
+      sendAll(c, frame(PKT_DISCONNECT, none));
+    }
+    close(c.fd);
+  }
+  c.fd        = -1;
+  c.connected = false;
+  c.rx_len    = 0;
+}
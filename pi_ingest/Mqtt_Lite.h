@@ -0,0 +1,72 @@
+#pragma once
+
+/*
+ * Mqtt_Lite.h
+ *
+ * Minimal MQTT 3.1.1 client over a plain TCP socket, for the Pi-side
+ * tools (no libmosquitto needed to build them).
+ *
+ *  - CONNECT (clean session, optional will), SUBSCRIBE, PUBLISH at QoS 0
+ *    or 1, keepalive PINGREQ; incoming QoS 1 is acknowledged.
+ *  - Single threaded: mqtt_poll() waits on the socket, reads whatever
+ *    arrived and hands complete PUBLISH packets to the callback.
+ *  - The receive buffer is bounded by max_packet; a larger packet drops
+ *    the connection rather than growing memory.
+ *  - No reconnect logic: on failure the caller closes and connects again.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+typedef void (*MqttMessageFn)(const char *topic, size_t topic_len,
+                              const uint8_t *payload, size_t len, void *ctx);
+
+struct MqttWill {
+  const char *topic;
+  const void *payload;
+  size_t      len;
+  uint8_t     qos;
+  bool        retain;
+};
+
+struct MqttClient {
+  int      fd;
+  bool     connected;
+  uint16_t keepalive_s;
+  int64_t  last_tx_ms;
+  int64_t  ping_sent_ms;           // 0 = no ping outstanding
+  uint16_t next_id;
+  size_t   max_packet;
+
+  std::vector<uint8_t> rx;
+  size_t   rx_len;
+
+  MqttMessageFn on_message;
+  void    *ctx;
+
+  // counters
+  uint64_t rx_msgs;
+  uint64_t rx_bytes;
+  uint64_t tx_msgs;
+  uint64_t puback_rx;              // acks for our QoS 1 publishes
+};
+
+void mqtt_init(MqttClient &c, MqttMessageFn fn, void *ctx, size_t max_packet = 65536);
+
+// Blocking connect + CONNACK (timeout_ms). false on refusal / timeout.
+bool mqtt_connect(MqttClient &c, const char *host, uint16_t port, const char *client_id,
+                  uint16_t keepalive_s, const MqttWill *will = nullptr, int timeout_ms = 5000);
+
+bool mqtt_subscribe(MqttClient &c, const char *filter, uint8_t qos);
+bool mqtt_publish(MqttClient &c, const char *topic, const void *payload, size_t len,
+                  uint8_t qos = 0, bool retain = false);
+
+// Waits up to timeout_ms for data, dispatches messages, keeps the session
+// alive. false once the connection is gone.
+bool mqtt_poll(MqttClient &c, int timeout_ms);
+
+void mqtt_close(MqttClient &c);
+
+int64_t mqtt_now_ms();             // CLOCK_MONOTONIC
@@ -0,0 +1,555 @@
+/*
+ * mill_fleet.cpp
+ *
+ * Load generator: N virtual mill controllers plus one HMI-like observer
+ * against a real broker, to find where the broker (and whatever else is
+ * subscribed, e.g. Node-RED) stops keeping up.
+ *
+ * Each virtual mill runs the firmware's own state machine
+ * (Mill_StateMachine.cpp), status serializer (Mill_StatusJson.cpp),
+ * topic layout (Mill_Topics.cpp) and command dedup (Mill_CmdDedup.cpp),
+ * has its own broker connection and
+ *
+ *   publishes   mill/<id>/status/state   at -r Hz, QoS 0
+ *   subscribes  mill/<id>/cmd/control    START / STOP with "seq", QoS 1
+ *               mill/all/cmd/control     (broadcast)
+ *   answers on  mill/<id>/status/ack     (firmware v0.31+ ack payload)
+ *
+ * with <id> = sim-000, sim-001, …. The observer subscribes to
+ * mill/+/status/# and sends each mill -c commands per second (or, with
+ * -bcast, -c broadcasts per second that every mill acks), timing
+ * command → ack. For every (N, rate) pair of the sweep it reports
+ *
+ *   status frames sent / received and drop %, observer rx msg/s and B/s,
+ *   command → ack p50 / p90 / p99 / max, commands never acked,
+ *   publishes the generator itself sent late (> 1 period behind).
+ *
+ *   mill_fleet [-h host] [-p port] [-n 1,10,50] [-r 1,5,10] [-s secs] [-c cmd_hz] [-bcast] [-csv]
+ *
+ * Build (from pi_ingest/):
+ *
+ *   FW="../firmware ESP32S3/minimal_mqtt_bridge"
+ *   g++ -std=c++17 -O2 -Wall -I"$FW" mill_fleet.cpp Mqtt_Lite.cpp \
+ *       "$FW/Mill_StateMachine.cpp" "$FW/Mill_StatusJson.cpp" "$FW/Mill_Topics.cpp" \
+ *       "$FW/Mill_Retain.cpp" "$FW/Mill_CmdDedup.cpp" -o mill_fleet
+ *
+ * Single threaded (one poll() over all sockets); if "late" is not 0 the
+ * generator, not the broker, is the limit for that step. Each mill holds
+ * one socket: raise `ulimit -n` above ~1000 mills.
+ */
+
+#include "Mqtt_Lite.h"
+
+#include "Mill_CmdDedup.h"
+#include "Mill_StateMachine.h"
+#include "Mill_StatusJson.h"
+#include "Mill_Topics.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+  stopRequested = 1;
+}
+
+static int64_t monoUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t wallMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Raw token after "key": in a flat JSON object (quotes stripped)
+static bool jsonToken(const char *s, size_t len, const char *key, char *out, size_t outLen) {
+  std::string body(s, len);
+  size_t k = body.find(key);
+  if (k == std::string::npos) return false;
+  size_t i = body.find(':', k);
+  if (i == std::string::npos) return false;
+  ++i;
+  while (i < body.size() && (body[i] == ' ' || body[i] == '"')) ++i;
+  size_t n = 0;
+  while (i < body.size() && n + 1 < outLen) {
+    char c = body[i++];
+    if (c == ',' || c == '}' || c == '"' || c == ' ') break;
+    out[n++] = c;
+  }
+  out[n] = '\0';
+  return n > 0;
+}
+
+// "mill/sim-012/status/ack" → 12, -1 if not one of ours
+static int simIndex(const char *topic, size_t len) {
+  static const char PREFIX[] = "mill/sim-";
+  size_t k = sizeof(PREFIX) - 1;
+  if (len <= k || memcmp(topic, PREFIX, k) != 0) return -1;
+  int idx = 0;
+  size_t i = k;
+  while (i < len && topic[i] >= '0' && topic[i] <= '9') idx = idx * 10 + (topic[i++] - '0');
+  return (i > k && i < len && topic[i] == '/') ? idx : -1;
+}
+
+static bool endsWith(const char *topic, size_t len, const char *suffix) {
+  size_t k = strlen(suffix);
+  return len >= k && memcmp(topic + len - k, suffix, k) == 0;
+}
+
+// -------------------------------------------------------------------
+// Virtual mill
+// -------------------------------------------------------------------
+
+struct VirtualMill {
+  int         index;
+  MqttClient  mqtt;
+  MillContext ctx;
+  float       pv_c;
+
+  MillTopics  topics;
+  CmdDedup    dedup;
+
+  int64_t     nextPubUs;
+  int64_t     periodUs;
+  uint64_t    published;
+  uint64_t    late;
+  uint64_t    commands;
+};
+
+static void fillSnapshot(const VirtualMill &m, MillSnapshot &s) {
+  memset(&s, 0, sizeof(s));
+  s.utc_ms             = wallMs();
+  s.state              = m.ctx.state;
+  s.substate           = m.ctx.substate;
+  s.state_before_fault = m.ctx.state_before_fault;
+  s.fault              = m.ctx.fault;
+  s.cycle_current      = m.ctx.cycle_current;
+  s.cycle_target       = m.ctx.cycle_target;
+  s.time_remaining_s   = m.ctx.time_remaining_s;
+  s.cycle_total        = m.ctx.cycle_total;
+  s.cycle_index        = m.ctx.cycle_index;
+  s.estop_ok           = m.ctx.estop_ok;
+  s.lid_locked         = m.ctx.lid_locked;
+  s.door_closed        = m.ctx.door_closed;
+
+  bool run = (m.ctx.state == MILL_RUN);
+  s.pid_ln2.comm_ok    = true;
+  s.pid_ln2.pv_c       = m.pv_c;
+  s.pid_ln2.sv_c       = -150.0f;
+  s.pid_ln2.output_pct = run ? 100.0f : 0.0f;
+  s.pid_ln2.run        = true;
+  s.pid_ln2.op1        = run;
+
+  s.eta.valid          = m.ctx.cycle_index > 0;
+  s.eta.cycle_ratio    = 1.0f;
+  s.eta.time_to_sv_s   = -1;
+  s.eta.ln2_open_s     = -1;
+}
+
+static void millOnMessage(const char *topic, size_t topic_len, const uint8_t *payload, size_t len, void *p) {
+  VirtualMill &m = *(VirtualMill *)p;
+  (void)topic;
+  (void)topic_len;
+  const char *body = (const char *)payload;
+  char cmd[24], seqTok[12];
+  if (!jsonToken(body, len, "\"cmd\"", cmd, sizeof(cmd))) return;
+  m.commands++;
+  bool hasSeq = jsonToken(body, len, "\"seq\"", seqTok, sizeof(seqTok));
+  uint32_t seq = hasSeq ? (uint32_t)strtoul(seqTok, nullptr, 10) : 0;
+
+  uint32_t now = (uint32_t)(monoUs() / 1000);
+  millCycleTick(m.ctx, now);
+  MillEvent ev;
+  MillAckResult result;
+  if (hasSeq && cmd_dedup_seen(m.dedup, seq, cmd, now)) {
+    result = MILL_ACK_DUPLICATE;
+  } else {
+    result = millEventFromCommand(cmd, ev) ? millAckFromDispatch(millDispatch(m.ctx, ev, now))
+                                           : MILL_ACK_REJECTED;
+  }
+
+  if (!hasSeq) return;
+  char json[MILL_ACK_JSON_MAX];
+  size_t n = mill_ack_json(m.topics.id, seq, cmd, result,
+                           m.ctx.state, m.ctx.substate, json, sizeof(json));
+  if (n) mqtt_publish(m.mqtt, m.topics.ack, json, n);
+}
+
+static bool millPublish(VirtualMill &m) {
+  uint32_t now = (uint32_t)(monoUs() / 1000);
+  millCycleTick(m.ctx, now);
+  float target = (m.ctx.state == MILL_RUN) ? -150.0f : 20.0f;
+  m.pv_c += (target - m.pv_c) * 0.02f;
+
+  MillSnapshot snap;
+  fillSnapshot(m, snap);
+  char json[MILL_STATUS_JSON_MAX];
+  size_t n = mill_status_json(snap, json, sizeof(json));
+  if (n == 0 || !mqtt_publish(m.mqtt, m.topics.status, json, n)) return false;
+  m.published++;
+  return true;
+}
+
+// -------------------------------------------------------------------
+// Observer (HMI side)
+// -------------------------------------------------------------------
+
+static const uint32_t SEQ_WINDOW = 64;   // commands in flight per mill
+
+struct PendingCmd {
+  uint32_t seq;
+  int64_t  sent_us;                      // 0 = acked / free
+};
+
+struct Observer {
+  MqttClient mqtt;
+  int        nMills;
+
+  std::vector<uint64_t> statusRx;        // per mill
+  std::vector<uint32_t> nextSeq;
+  std::vector<int64_t>  nextCmdUs;
+  std::vector<PendingCmd> pending;       // [mill * SEQ_WINDOW + seq % SEQ_WINDOW]
+
+  std::vector<uint32_t> latencyUs;
+  uint64_t   cmdsSent;
+  uint64_t   cmdsOverwritten;            // window wrapped before the ack
+  uint64_t   acksUnknown;
+  uint64_t   rxMsgs;
+  uint64_t   rxBytes;
+};
+
+static void observerOnMessage(const char *topic, size_t topic_len, const uint8_t *payload, size_t len, void *p) {
+  Observer &o = *(Observer *)p;
+  o.rxMsgs++;
+  o.rxBytes += len;
+  int idx = simIndex(topic, topic_len);
+  if (idx < 0 || idx >= o.nMills) return;
+
+  if (endsWith(topic, topic_len, "/status/state")) {
+    o.statusRx[idx]++;
+  } else if (endsWith(topic, topic_len, "/status/ack")) {
+    char seqTok[12];
+    if (!jsonToken((const char *)payload, len, "\"seq\"", seqTok, sizeof(seqTok))) return;
+    uint32_t seq = (uint32_t)strtoul(seqTok, nullptr, 10);
+    PendingCmd &pc = o.pending[(size_t)idx * SEQ_WINDOW + seq % SEQ_WINDOW];
+    if (pc.sent_us == 0 || pc.seq != seq) {
+      o.acksUnknown++;
+      return;
+    }
+    o.latencyUs.push_back((uint32_t)(monoUs() - pc.sent_us));
+    pc.sent_us = 0;
+  }
+}
+
+static void expectAck(Observer &o, int idx, uint32_t seq, int64_t sent_us) {
+  PendingCmd &pc = o.pending[(size_t)idx * SEQ_WINDOW + seq % SEQ_WINDOW];
+  if (pc.sent_us != 0) o.cmdsOverwritten++;
+  pc.seq     = seq;
+  pc.sent_us = sent_us;
+}
+
+static int commandBody(char *body, size_t len, uint32_t seq) {
+  return snprintf(body, len, "{\"cmd\":\"%s\",\"source\":\"FLEET\",\"seq\":%lu}",
+                  (seq & 1) ? "STOP" : "START", (unsigned long)seq);
+}
+
+// One mill; idx < 0: one broadcast, acked by every mill
+static void observerSend(Observer &o, int idx) {
+  char topic[MILL_TOPIC_MAX], body[96];
+  uint32_t seq = o.nextSeq[idx < 0 ? 0 : idx]++;
+  int n = commandBody(body, sizeof(body), seq);
+  if (idx >= 0) snprintf(topic, sizeof(topic), "mill/sim-%03d/cmd/control", idx);
+  else          snprintf(topic, sizeof(topic), "%s", MILL_TOPIC_CMD_BROADCAST);
+
+  int64_t now = monoUs();
+  if (!mqtt_publish(o.mqtt, topic, body, (size_t)n, 1)) return;      // commands: QoS 1
+  o.cmdsSent += (idx >= 0) ? 1 : (uint64_t)o.nMills;
+  if (idx >= 0) {
+    expectAck(o, idx, seq, now);
+  } else {
+    for (int i = 0; i < o.nMills; ++i) expectAck(o, i, seq, now);
+  }
+}
+
+// -------------------------------------------------------------------
+// One sweep step
+// -------------------------------------------------------------------
+
+struct StepResult {
+  int      mills;
+  double   rate_hz;
+  double   secs;
+  uint64_t status_tx;
+  uint64_t status_rx;
+  uint64_t late;
+  double   rx_msg_s;
+  double   rx_kb_s;
+  uint64_t cmds;
+  uint64_t acks;
+  uint32_t p50_us, p90_us, p99_us, max_us;
+  bool     ok;
+};
+
+static uint32_t percentile(std::vector<uint32_t> &v, double q) {
+  if (v.empty()) return 0;
+  size_t k = (size_t)(q * (double)(v.size() - 1) + 0.5);
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+// Poll every socket once (waiting up to timeout_ms for the first data)
+static bool pumpAll(std::vector<VirtualMill> &mills, Observer &obs, int timeout_ms,
+                    std::vector<struct pollfd> &pfds, bool keepalive) {
+  pfds.resize(mills.size() + 1);
+  for (size_t i = 0; i < mills.size(); ++i) pfds[i] = { mills[i].mqtt.fd, POLLIN, 0 };
+  pfds[mills.size()] = { obs.mqtt.fd, POLLIN, 0 };
+  if (poll(pfds.data(), pfds.size(), timeout_ms) < 0) return true;
+
+  bool ok = true;
+  for (size_t i = 0; i < mills.size(); ++i) {
+    if ((pfds[i].revents || keepalive) && !mqtt_poll(mills[i].mqtt, 0)) ok = false;
+  }
+  // Drain the observer: it receives N times what any one mill does
+  if (pfds[mills.size()].revents || keepalive) {
+    for (int k = 0; k < 64; ++k) {
+      if (!mqtt_poll(obs.mqtt, 0)) { ok = false; break; }
+      struct pollfd one = { obs.mqtt.fd, POLLIN, 0 };
+      if (poll(&one, 1, 0) <= 0) break;
+    }
+  }
+  return ok;
+}
+
+static StepResult runStep(const char *host, uint16_t port, int nMills, double rateHz,
+                          double secs, double cmdHz, bool bcast) {
+  StepResult r;
+  memset(&r, 0, sizeof(r));
+  r.mills   = nMills;
+  r.rate_hz = rateHz;
+
+  Observer obs;
+  obs.nMills = nMills;
+  obs.statusRx.assign(nMills, 0);
+  obs.nextSeq.assign(nMills, 1);
+  obs.nextCmdUs.assign(nMills, 0);
+  obs.pending.assign((size_t)nMills * SEQ_WINDOW, PendingCmd{ 0, 0 });
+  obs.cmdsSent = obs.cmdsOverwritten = obs.acksUnknown = obs.rxMsgs = obs.rxBytes = 0;
+  mqtt_init(obs.mqtt, observerOnMessage, &obs, 1 << 20);
+
+  char clientId[32];
+  snprintf(clientId, sizeof(clientId), "mill-fleet-hmi-%d", (int)getpid());
+  if (!mqtt_connect(obs.mqtt, host, port, clientId, 30) ||
+      !mqtt_subscribe(obs.mqtt, "mill/+/status/state", 0) ||
+      !mqtt_subscribe(obs.mqtt, "mill/+/status/ack", 0)) {
+    fprintf(stderr, "[FLEET] observer cannot connect to %s:%u\n", host, port);
+    mqtt_close(obs.mqtt);
+    return r;
+  }
+
+  // Heap once per step; the vector is never resized while clients point into it
+  std::vector<VirtualMill> mills(nMills);
+  int64_t periodUs = (int64_t)(1e6 / rateHz);
+  for (int i = 0; i < nMills; ++i) {
+    VirtualMill &m = mills[i];
+    m.index = i;
+    char id[MILL_ID_MAX];
+    snprintf(id, sizeof(id), "sim-%03d", i);
+    mill_topics_build(m.topics, id);
+    m.pv_c        = 20.0f;
+    m.periodUs    = periodUs;
+    m.published = m.late = m.commands = 0;
+
+    millInit(m.ctx, (uint32_t)(monoUs() / 1000));
+    m.ctx.cycle_target  = 60;
+    m.ctx.cycle_total   = 3;
+    m.ctx.interlocks_ok = true;
+    m.ctx.estop_ok      = true;
+    m.ctx.lid_locked    = true;
+    m.ctx.door_closed   = true;
+
+    cmd_dedup_init(m.dedup);
+    mqtt_init(m.mqtt, millOnMessage, &m, 4096);
+    snprintf(clientId, sizeof(clientId), "mill-fleet-%d-%03d", (int)getpid(), i);
+    if (!mqtt_connect(m.mqtt, host, port, clientId, 30) ||
+        !mqtt_subscribe(m.mqtt, m.topics.cmd, 1) ||
+        !mqtt_subscribe(m.mqtt, MILL_TOPIC_CMD_BROADCAST, 1)) {
+      fprintf(stderr, "[FLEET] mill %d cannot connect\n", i);
+      for (int k = 0; k <= i; ++k) mqtt_close(mills[k].mqtt);
+      mqtt_close(obs.mqtt);
+      return r;
+    }
+  }
+
+  // Let the SUBACKs land before anything is counted
+  std::vector<struct pollfd> pfds;
+  int64_t settle = monoUs() + 300000;
+  while (monoUs() < settle) pumpAll(mills, obs, 20, pfds, false);
+
+  // Spread first publishes and commands over one period
+  int64_t start = monoUs();
+  int64_t cmdPeriodUs = cmdHz > 0 ? (int64_t)(1e6 / cmdHz) : 0;
+  for (int i = 0; i < nMills; ++i) {
+    mills[i].nextPubUs = start + periodUs * i / nMills;
+    obs.nextCmdUs[i]   = cmdPeriodUs ? start + cmdPeriodUs * i / nMills + cmdPeriodUs / 2 : INT64_MAX;
+    if (bcast && i > 0) obs.nextCmdUs[i] = INT64_MAX;   // slot 0 drives the broadcasts
+  }
+  int64_t end = start + (int64_t)(secs * 1e6);
+  int64_t nextKeepalive = start + 1000000;
+  bool ok = true;
+
+  while (!stopRequested && monoUs() < end) {
+    int64_t now = monoUs();
+    int64_t wake = end;
+    for (VirtualMill &m : mills) {
+      if (now >= m.nextPubUs) {
+        if (now - m.nextPubUs > m.periodUs) m.late++;
+        if (!millPublish(m)) ok = false;
+        m.nextPubUs += m.periodUs;
+        if (m.nextPubUs < now) m.nextPubUs = now + m.periodUs;   // don't burst to catch up
+      }
+      wake = std::min(wake, m.nextPubUs);
+    }
+    for (int i = 0; i < nMills; ++i) {
+      if (now >= obs.nextCmdUs[i]) {
+        observerSend(obs, bcast ? -1 : i);
+        obs.nextCmdUs[i] += cmdPeriodUs;
+      }
+      wake = std::min(wake, obs.nextCmdUs[i]);
+    }
+    bool keepalive = now >= nextKeepalive;
+    if (keepalive) nextKeepalive = now + 1000000;
+    int waitMs = (int)std::max<int64_t>(0, (wake - monoUs()) / 1000);
+    if (!pumpAll(mills, obs, waitMs, pfds, keepalive)) ok = false;
+  }
+  int64_t measured = monoUs() - start;
+
+  // Drain: late frames / acks still count, nothing new is sent
+  int64_t drainEnd = monoUs() + 1000000;
+  while (monoUs() < drainEnd) pumpAll(mills, obs, 20, pfds, false);
+
+  r.secs = (double)measured / 1e6;
+  for (int i = 0; i < nMills; ++i) {
+    r.status_tx += mills[i].published;
+    r.status_rx += obs.statusRx[i];
+    r.late      += mills[i].late;
+  }
+  r.rx_msg_s = (double)obs.rxMsgs / r.secs;
+  r.rx_kb_s  = (double)obs.rxBytes / 1024.0 / r.secs;
+  r.cmds     = obs.cmdsSent;
+  r.acks     = obs.latencyUs.size();
+  r.p50_us   = percentile(obs.latencyUs, 0.50);
+  r.p90_us   = percentile(obs.latencyUs, 0.90);
+  r.p99_us   = percentile(obs.latencyUs, 0.99);
+  r.max_us   = obs.latencyUs.empty() ? 0 : *std::max_element(obs.latencyUs.begin(), obs.latencyUs.end());
+  r.ok       = ok && obs.mqtt.connected;
+  if (!r.ok) fprintf(stderr, "[FLEET] a connection dropped during N=%d rate=%g\n", nMills, rateHz);
+  if (obs.acksUnknown || obs.cmdsOverwritten) {
+    fprintf(stderr, "[FLEET] %llu acks for unknown seq, %llu commands unacked past the window\n",
+            (unsigned long long)obs.acksUnknown, (unsigned long long)obs.cmdsOverwritten);
+  }
+
+  for (VirtualMill &m : mills) mqtt_close(m.mqtt);
+  mqtt_close(obs.mqtt);
+  return r;
+}
+
+// -------------------------------------------------------------------
+// main
+// -------------------------------------------------------------------
+
+static std::vector<double> parseList(const char *s) {
+  std::vector<double> out;
+  while (*s) {
+    char *end = nullptr;
+    double v = strtod(s, &end);
+    if (end == s) break;
+    if (v > 0) out.push_back(v);
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return out;
+}
+
+static void printResult(const StepResult &r, bool csv) {
+  double drop = r.status_tx ? 100.0 * (1.0 - (double)r.status_rx / (double)r.status_tx) : 0.0;
+  if (drop < 0) drop = 0;                  // frames of a previous step still in flight
+  if (csv) {
+    printf("%d,%g,%.1f,%llu,%llu,%.3f,%llu,%.1f,%.1f,%llu,%llu,%.2f,%.2f,%.2f,%.2f,%d\n",
+           r.mills, r.rate_hz, r.secs, (unsigned long long)r.status_tx, (unsigned long long)r.status_rx,
+           drop, (unsigned long long)r.late, r.rx_msg_s, r.rx_kb_s,
+           (unsigned long long)r.cmds, (unsigned long long)r.acks,
+           r.p50_us / 1000.0, r.p90_us / 1000.0, r.p99_us / 1000.0, r.max_us / 1000.0, r.ok ? 1 : 0);
+  } else {
+    printf("%5d %6g %9llu %9llu %7.3f %6llu %9.1f %8.1f %6llu %6llu %7.2f %7.2f %7.2f %8.2f%s\n",
+           r.mills, r.rate_hz, (unsigned long long)r.status_tx, (unsigned long long)r.status_rx,
+           drop, (unsigned long long)r.late, r.rx_msg_s, r.rx_kb_s,
+           (unsigned long long)r.cmds, (unsigned long long)r.acks,
+           r.p50_us / 1000.0, r.p90_us / 1000.0, r.p99_us / 1000.0, r.max_us / 1000.0,
+           r.ok ? "" : "  (disconnect)");
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  const char *host  = "127.0.0.1";
+  uint16_t    port  = 1883;
+  std::vector<double> counts = { 1, 10, 50 };
+  std::vector<double> rates  = { 1, 5, 10 };
+  double      secs  = 10;
+  double      cmdHz = 1;
+  bool        bcast = false;
+  bool        csv   = false;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-csv"))   { csv = true; continue; }
+    if (!strcmp(argv[i], "-bcast")) { bcast = true; continue; }
+    if (i + 1 >= argc) { fprintf(stderr, "missing value for %s\n", argv[i]); return 2; }
+    if      (!strcmp(argv[i], "-h")) host   = argv[++i];
+    else if (!strcmp(argv[i], "-p")) port   = (uint16_t)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n")) counts = parseList(argv[++i]);
+    else if (!strcmp(argv[i], "-r")) rates  = parseList(argv[++i]);
+    else if (!strcmp(argv[i], "-s")) secs   = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-c")) cmdHz  = atof(argv[++i]);
+    else {
+      fprintf(stderr, "usage: mill_fleet [-h host] [-p port] [-n 1,10,50] [-r 1,5,10] [-s secs] [-c cmd_hz] [-bcast] [-csv]\n");
+      return 2;
+    }
+  }
+  if (counts.empty() || rates.empty() || secs <= 0) {
+    fprintf(stderr, "-n / -r need positive values, -s > 0\n");
+    return 2;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  if (csv) {
+    printf("mills,rate_hz,secs,status_tx,status_rx,drop_pct,late,rx_msg_s,rx_kb_s,"
+           "cmds,acks,p50_ms,p90_ms,p99_ms,max_ms,ok\n");
+  } else {
+    printf("%5s %6s %9s %9s %7s %6s %9s %8s %6s %6s %7s %7s %7s %8s\n",
+           "mills", "Hz", "tx", "rx", "drop%", "late", "rx msg/s", "rx KB/s",
+           "cmds", "acks", "p50 ms", "p90 ms", "p99 ms", "max ms");
+  }
+  for (double n : counts) {
+    for (double rate : rates) {
+      if (stopRequested) return 1;
+      StepResult r = runStep(host, port, (int)n, rate, secs, cmdHz, bcast);
+      if (r.secs == 0) return 1;
+      printResult(r, csv);
+    }
+  }
+  return 0;
+}
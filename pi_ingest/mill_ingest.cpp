@@ -0,0 +1,592 @@
+/*
+ * mill_ingest.cpp
+ *
+ * Pi companion daemon: subscribes to the mill status topics and appends
+ * every mill/<id>/status/state frame to columnar files (Ingest_Store.h),
+ * one directory per mill (<dir>/<id>/), then answers range queries on
+ * them for the dashboard. It also answers the mills' clock requests
+ * (mill/<id>/time/req → time/resp, docs/protocol.md §9) from this host's
+ * UTC clock, so keep the Pi on NTP.
+ *
+ *   mill_ingest run   [-h host] [-p port] [-t filter] [-d dir] [-f flush_s] [-T 0|1]
+ *   mill_ingest query [-d dir] [-m id] -from <ms|-s> -to <ms|now> [-c col,col] [-every ms] [-json]
+ *   mill_ingest info  <file.mcol>
+ *   mill_ingest bench [frames]
+ *
+ * Build (Linux / Raspberry Pi OS, no extra packages):
+ *
+ *   g++ -std=c++17 -O2 -Wall mill_ingest.cpp Ingest_Store.cpp Ingest_Json.cpp Mqtt_Lite.cpp -o mill_ingest
+ *
+ * See README.md for the file format, a systemd unit and Node-RED usage.
+ */
+
+#include "Ingest_Json.h"
+#include "Ingest_Store.h"
+#include "Mqtt_Lite.h"
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+static const char *DEFAULT_DIR = "/var/lib/mill_ingest";
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+  stopRequested = 1;
+}
+
+static int64_t wallMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// -------------------------------------------------------------------
+// run: MQTT → store
+// -------------------------------------------------------------------
+
+struct IngestCtx {
+  std::string dir;
+  uint32_t    flush_ms;
+  std::map<std::string, std::unique_ptr<StoreWriter>> writers;   // by mill id
+  uint64_t    frames;
+  uint64_t    malformed;
+  uint64_t    other;          // diag, schedule, … (not stored)
+  uint64_t    write_errors;
+  MqttClient *mqtt;           // for time/resp
+  uint64_t    time_replies;
+};
+
+// Same rule as mill_id_valid() in the firmware (Mill_Topics); the id
+// becomes a directory name, so nothing else gets through
+static bool idValid(const std::string &id) {
+  if (id.empty() || id.size() > 16 || id == "all") return false;
+  for (char c : id) {
+    bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+              (c >= '0' && c <= '9') || c == '_' || c == '-';
+    if (!ok) return false;
+  }
+  return true;
+}
+
+// "mill/<id><suffix>" → id; false for any other topic
+static bool millTopicId(const char *topic, size_t n, const char *suffix, std::string &id) {
+  static const char PREFIX[] = "mill/";
+  size_t p = sizeof(PREFIX) - 1, k = strlen(suffix);
+  if (n <= p + k || memcmp(topic, PREFIX, p) != 0 || memcmp(topic + n - k, suffix, k) != 0) {
+    return false;
+  }
+  id.assign(topic + p, n - p - k);
+  return idValid(id);
+}
+
+// Integer value of "key": in a flat JSON object; false if absent
+static bool jsonInt(const std::string &body, const char *key, long long &out) {
+  std::string k = std::string("\"") + key + "\":";
+  size_t at = body.find(k);
+  if (at == std::string::npos) return false;
+  const char *v = body.c_str() + at + k.size();
+  while (*v == ' ') v++;
+  char *end = nullptr;
+  out = strtoll(v, &end, 10);
+  return end != v;
+}
+
+// Clock sync (docs/protocol.md §9): echo id and t0, add our UTC receive
+// (t1) and send (t2) times. t1 is taken before anything else so parsing
+// cost lands inside the [t1, t2] window the mill subtracts out.
+static void answerTimeReq(IngestCtx &ctx, const std::string &id, const uint8_t *payload, size_t len) {
+  int64_t t1 = wallMs();
+  std::string body((const char *)payload, len);
+  long long reqId = 0, t0 = 0;
+  if (!jsonInt(body, "id", reqId) || !jsonInt(body, "t0", t0)) {
+    ctx.malformed++;
+    return;
+  }
+  std::string topic = "mill/" + id + "/time/resp";
+  char out[128];
+  int n = snprintf(out, sizeof(out), "{\"id\":%lld,\"t0\":%lld,\"t1\":%lld,\"t2\":%lld}",
+                   reqId, t0, (long long)t1, (long long)wallMs());
+  if (mqtt_publish(*ctx.mqtt, topic.c_str(), out, (size_t)n, 0, false)) ctx.time_replies++;
+}
+
+static StoreWriter *writerFor(IngestCtx &ctx, const std::string &id) {
+  auto it = ctx.writers.find(id);
+  if (it != ctx.writers.end()) return it->second.get();
+  std::unique_ptr<StoreWriter> w(new StoreWriter());
+  std::string path = ctx.dir + "/" + id;
+  if (!store_writer_open(*w, path.c_str(), ctx.flush_ms)) {
+    fprintf(stderr, "[STORE] cannot use %s\n", path.c_str());
+    return nullptr;
+  }
+  fprintf(stderr, "[INGEST] new mill %s → %s\n", id.c_str(), path.c_str());
+  return (ctx.writers[id] = std::move(w)).get();
+}
+
+static void onMessage(const char *topic, size_t topic_len, const uint8_t *payload, size_t len, void *p) {
+  IngestCtx &ctx = *(IngestCtx *)p;
+  std::string id;
+  if (ctx.mqtt && millTopicId(topic, topic_len, "/time/req", id)) {
+    answerTimeReq(ctx, id, payload, len);
+    return;
+  }
+  if (!millTopicId(topic, topic_len, "/status/state", id)) {
+    ctx.other++;
+    return;
+  }
+  int64_t now = wallMs();
+  StoreRow row;
+  if (!store_row_from_json((const char *)payload, len, now, row)) {
+    ctx.malformed++;
+    return;
+  }
+  ctx.frames++;
+  StoreWriter *w = writerFor(ctx, id);
+  if (!w || !store_append(*w, row, now)) ctx.write_errors++;
+}
+
+static int cmdRun(int argc, char **argv) {
+  const char *host   = "127.0.0.1";
+  uint16_t    port   = 1883;
+  const char *filter = "mill/+/status/#";
+  const char *dir    = DEFAULT_DIR;
+  uint32_t    flushS = 30;
+  bool        timeSrv = true;
+  for (int i = 0; i + 1 < argc; i += 2) {
+    if      (!strcmp(argv[i], "-h")) host   = argv[i + 1];
+    else if (!strcmp(argv[i], "-p")) port   = (uint16_t)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "-t")) filter = argv[i + 1];
+    else if (!strcmp(argv[i], "-d")) dir    = argv[i + 1];
+    else if (!strcmp(argv[i], "-f")) flushS = (uint32_t)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "-T")) timeSrv = atoi(argv[i + 1]) != 0;
+    else { fprintf(stderr, "unknown option %s\n", argv[i]); return 2; }
+  }
+
+  IngestCtx ctx;
+  ctx.dir      = dir;
+  ctx.flush_ms = flushS * 1000;
+  ctx.frames = ctx.malformed = ctx.other = ctx.write_errors = ctx.time_replies = 0;
+  ctx.mqtt     = nullptr;
+  mkdir(dir, 0755);
+  struct stat st;
+  if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+    fprintf(stderr, "[STORE] cannot use %s\n", dir);
+    return 1;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  MqttClient mqtt;
+  mqtt_init(mqtt, onMessage, &ctx);
+  if (timeSrv) ctx.mqtt = &mqtt;
+  char clientId[32];
+  snprintf(clientId, sizeof(clientId), "mill-ingest-%d", (int)getpid());
+
+  uint32_t backoffMs   = 1000;
+  int64_t  nextTryMs   = 0;
+  int64_t  lastStatsMs = mqtt_now_ms();
+  uint64_t lastFrames  = 0;
+
+  while (!stopRequested) {
+    int64_t now = mqtt_now_ms();
+    if (!mqtt.connected) {
+      if (now < nextTryMs) {
+        usleep(100000);
+      } else if (mqtt_connect(mqtt, host, port, clientId, 30) && mqtt_subscribe(mqtt, filter, 0) &&
+                 (!timeSrv || mqtt_subscribe(mqtt, "mill/+/time/req", 0))) {
+        fprintf(stderr, "[MQTT] connected to %s:%u, subscribed to %s%s\n", host, port, filter,
+                timeSrv ? " and mill/+/time/req" : "");
+        backoffMs = 1000;
+      } else {
+        fprintf(stderr, "[MQTT] connect to %s:%u failed, retry in %u ms\n", host, port, backoffMs);
+        mqtt_close(mqtt);
+        nextTryMs = now + backoffMs;
+        backoffMs = std::min<uint32_t>(backoffMs * 2, 30000);
+      }
+    } else if (!mqtt_poll(mqtt, 500)) {
+      fprintf(stderr, "[MQTT] connection lost\n");
+      mqtt_close(mqtt);
+    }
+
+    int64_t wall = wallMs();
+    for (auto &kv : ctx.writers) store_tick(*kv.second, wall);
+
+    if (now - lastStatsMs >= 60000) {
+      uint64_t rows = 0, blocks = 0, bytes = 0;
+      for (auto &kv : ctx.writers) {
+        rows   += kv.second->rows_total;
+        blocks += kv.second->blocks_total;
+        bytes  += kv.second->bytes_total;
+      }
+      fprintf(stderr, "[INGEST] %zu mills, %.1f frames/s, %llu rows in %llu blocks (%llu B), malformed %llu, other %llu, write errors %llu, time replies %llu\n",
+              ctx.writers.size(), (double)(ctx.frames - lastFrames) * 1000.0 / (double)(now - lastStatsMs),
+              (unsigned long long)rows, (unsigned long long)blocks, (unsigned long long)bytes,
+              (unsigned long long)ctx.malformed, (unsigned long long)ctx.other,
+              (unsigned long long)ctx.write_errors, (unsigned long long)ctx.time_replies);
+      lastStatsMs = now;
+      lastFrames  = ctx.frames;
+    }
+  }
+
+  fprintf(stderr, "[INGEST] stopping, flushing %zu mills\n", ctx.writers.size());
+  mqtt_close(mqtt);
+  for (auto &kv : ctx.writers) store_writer_close(*kv.second);
+  return 0;
+}
+
+// -------------------------------------------------------------------
+// query: files → CSV / JSON
+// -------------------------------------------------------------------
+
+struct QueryCtx {
+  const int *cols;
+  int        ncols;
+  bool       json;
+  bool       first;
+  int64_t    every_ms;        // 0 = raw rows
+
+  // bucket (every_ms > 0): mean per column
+  int64_t    bucket;
+  double     sum[32];
+  uint32_t   cnt[32];
+  uint64_t   out_rows;
+};
+
+static void printRow(QueryCtx &q, int64_t t, const double *v) {
+  if (q.json) {
+    printf("%s{\"t\":%lld", q.first ? "" : ",\n", (long long)t);
+    for (int c = 0; c < q.ncols; ++c) {
+      if (isnan(v[c])) printf(",\"%s\":null", STORE_COLUMNS[q.cols[c]].name);
+      else             printf(",\"%s\":%.10g", STORE_COLUMNS[q.cols[c]].name, v[c]);
+    }
+    printf("}");
+  } else {
+    printf("%lld", (long long)t);
+    for (int c = 0; c < q.ncols; ++c) {
+      if (isnan(v[c])) printf(",");
+      else             printf(",%.10g", v[c]);
+    }
+    printf("\n");
+  }
+  q.first = false;
+  q.out_rows++;
+}
+
+static void flushBucket(QueryCtx &q) {
+  if (q.bucket == INT64_MIN) return;
+  double v[32];
+  for (int c = 0; c < q.ncols; ++c) v[c] = q.cnt[c] ? q.sum[c] / q.cnt[c] : NAN;
+  printRow(q, q.bucket * q.every_ms, v);
+  for (int c = 0; c < q.ncols; ++c) { q.sum[c] = 0; q.cnt[c] = 0; }
+}
+
+static void onRow(int64_t t, const int64_t *vals, void *p) {
+  QueryCtx &q = *(QueryCtx *)p;
+  if (q.every_ms <= 0) {
+    double v[32];
+    for (int c = 0; c < q.ncols; ++c) v[c] = store_value(q.cols[c], vals[c]);
+    printRow(q, t, v);
+    return;
+  }
+  int64_t b = t / q.every_ms;
+  if (b != q.bucket) {
+    flushBucket(q);
+    q.bucket = b;
+  }
+  for (int c = 0; c < q.ncols; ++c) {
+    if (vals[c] == STORE_NULL) continue;
+    q.sum[c] += store_value(q.cols[c], vals[c]);
+    q.cnt[c]++;
+  }
+}
+
+// "now", "-3600" (seconds before now) or absolute UTC ms
+static int64_t parseTime(const char *s, int64_t now) {
+  if (!strcmp(s, "now")) return now;
+  if (s[0] == '-') return now - atoll(s + 1) * 1000;
+  return atoll(s);
+}
+
+// Mill directories under dir (names that pass idValid)
+static std::vector<std::string> millIds(const char *dir) {
+  std::vector<std::string> out;
+  DIR *d = opendir(dir);
+  if (!d) return out;
+  while (struct dirent *e = readdir(d)) {
+    std::string name = e->d_name;
+    struct stat st;
+    if (idValid(name) && stat((std::string(dir) + "/" + name).c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+      out.push_back(name);
+    }
+  }
+  closedir(d);
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+struct QueryBlock {
+  size_t         file;
+  StoreBlockInfo info;
+};
+
+static int cmdQuery(int argc, char **argv) {
+  const char *dir   = DEFAULT_DIR;
+  std::string mill;
+  int64_t     now   = wallMs();
+  int64_t     from  = now - 3600 * 1000;
+  int64_t     to    = now;
+  std::string colList = "state,pv_c,sv_c,output_pct";
+  QueryCtx q;
+  memset(&q, 0, sizeof(q));
+  for (int i = 0; i < argc; ++i) {
+    if (!strcmp(argv[i], "-json")) { q.json = true; continue; }
+    if (i + 1 >= argc) { fprintf(stderr, "missing value for %s\n", argv[i]); return 2; }
+    if      (!strcmp(argv[i], "-d"))     dir        = argv[++i];
+    else if (!strcmp(argv[i], "-from"))  from       = parseTime(argv[++i], now);
+    else if (!strcmp(argv[i], "-to"))    to         = parseTime(argv[++i], now);
+    else if (!strcmp(argv[i], "-c"))     colList    = argv[++i];
+    else if (!strcmp(argv[i], "-every")) q.every_ms = atoll(argv[++i]);
+    else if (!strcmp(argv[i], "-m"))     mill       = argv[++i];
+    else { fprintf(stderr, "unknown option %s\n", argv[i]); return 2; }
+  }
+
+  // -m can be left out while only one mill has been recorded
+  if (mill.empty()) {
+    std::vector<std::string> ids = millIds(dir);
+    if (ids.size() != 1) {
+      fprintf(stderr, "%s: -m <id> needed, mills:", dir);
+      for (const std::string &id : ids) fprintf(stderr, " %s", id.c_str());
+      fprintf(stderr, "\n");
+      return 2;
+    }
+    mill = ids[0];
+  }
+  if (!idValid(mill)) { fprintf(stderr, "bad mill id %s\n", mill.c_str()); return 2; }
+  std::string millDir = std::string(dir) + "/" + mill;
+
+  int cols[32];
+  int ncols = 0;
+  size_t pos = 0;
+  while (pos <= colList.size() && ncols < 32) {
+    size_t comma = colList.find(',', pos);
+    if (comma == std::string::npos) comma = colList.size();
+    std::string name = colList.substr(pos, comma - pos);
+    int c = store_column_index(name.c_str());
+    if (c < 0) { fprintf(stderr, "unknown column %s\n", name.c_str()); return 2; }
+    cols[ncols++] = c;
+    pos = comma + 1;
+  }
+  q.cols   = cols;
+  q.ncols  = ncols;
+  q.first  = true;
+  q.bucket = INT64_MIN;
+
+  // Blocks of every partition in time order (a day file resumes after
+  // each batch, so whole files would interleave)
+  std::vector<StoreFile>  files;
+  std::vector<QueryBlock> blocks;
+  for (const std::string &path : store_list(millDir.c_str())) {
+    StoreFile f;
+    if (!store_map(f, path.c_str())) continue;
+    files.push_back(f);
+    size_t off = f.first_block;
+    QueryBlock qb;
+    qb.file = files.size() - 1;
+    while (store_next_block(f, off, qb.info, false)) {
+      if (qb.info.t_max >= from && qb.info.t_min <= to) blocks.push_back(qb);
+    }
+  }
+  std::stable_sort(blocks.begin(), blocks.end(),
+                   [](const QueryBlock &a, const QueryBlock &b) { return a.info.t_min < b.info.t_min; });
+
+  if (q.json) printf("[\n");
+  else {
+    printf("t_ms");
+    for (int c = 0; c < ncols; ++c) printf(",%s", STORE_COLUMNS[cols[c]].name);
+    printf("\n");
+  }
+  for (const QueryBlock &qb : blocks) {
+    store_query_block(files[qb.file], qb.info, from, to, cols, ncols, onRow, &q);
+  }
+  for (StoreFile &f : files) store_unmap(f);
+  if (q.every_ms > 0) flushBucket(q);
+  if (q.json) printf("\n]\n");
+  return 0;
+}
+
+// -------------------------------------------------------------------
+// info: block listing of one file
+// -------------------------------------------------------------------
+
+static int cmdInfo(int argc, char **argv) {
+  if (argc < 1) { fprintf(stderr, "info <file.mcol>\n"); return 2; }
+  StoreFile f;
+  if (!store_map(f, argv[0])) { fprintf(stderr, "%s: not a store file\n", argv[0]); return 1; }
+  printf("%s: %u columns, %zu B\n", argv[0], f.ncols, f.size);
+  size_t off = f.first_block;
+  StoreBlockInfo b;
+  uint64_t rows = 0;
+  uint32_t blocks = 0;
+  while (store_next_block(f, off, b, true)) {
+    printf("  block @%-9zu rows %-5u %lld..%lld  %u B\n", b.offset, b.rows,
+           (long long)b.t_min, (long long)b.t_max, b.payload_len);
+    rows += b.rows;
+    blocks++;
+  }
+  printf("%u blocks, %llu rows, %.1f B/row%s\n", blocks, (unsigned long long)rows,
+         rows ? (double)(off - f.first_block) / rows : 0.0,
+         off < f.size ? " (torn / corrupt tail)" : "");
+  store_unmap(f);
+  return 0;
+}
+
+// -------------------------------------------------------------------
+// bench: synthetic 1 Hz frames, ingest + query vs JSON re-parse
+// -------------------------------------------------------------------
+
+// Same fields and formatting as publishStatus() in the firmware
+static int makeFrame(char *out, size_t len, int64_t ts, uint32_t i) {
+  static const char *STATES[] = { "IDLE", "RUN", "HOLD", "FAULT" };
+  uint32_t phase  = (i / 600) % 8;
+  int      state  = (phase == 0) ? 0 : (phase == 7 ? 2 : 1);
+  double   pv     = -150.0 + 20.0 * sin(i / 300.0) + (i % 7) * 0.1;
+  return snprintf(out, len,
+    "{\"ts\":%lld,\"ts_ms\":%lld,\"state\":\"%s\",\"substate\":\"%s_ACTIVE\","
+    "\"cycle_current\":%u,\"cycle_target\":300,\"time_remaining_s\":%u,\"cycle_total\":8,"
+    "\"cycle_index\":%u,\"fault_code\":0,\"fault_reason\":\"\",\"pid\":{\"pv_c\":%.1f},"
+    "\"pid_ln2\":{\"pv_c\":%.1f,\"sv_c\":-150.0,\"output_pct\":%.1f,\"comm_ok\":true,\"status_raw\":%u,"
+    "\"run\":true,\"man\":false,\"prg\":false,\"op1\":%s,\"op2\":false,\"au1\":false,\"au2\":false,\"atu\":false},"
+    "\"interlocks\":{\"door_closed\":true,\"estop_ok\":true,\"lid_locked\":true},"
+    "\"eta\":{\"valid\":%s,\"recipe_s\":%u,\"cycle_ratio\":1.02,\"last_cycle_s\":305,\"stall_s\":0,"
+    "\"cool_rate_cpm\":%.2f,\"time_to_sv_s\":-1,\"ln2_open_s\":-1}}",
+    (long long)(ts / 1000), (long long)ts, STATES[state], STATES[state], i % 300, 300 - i % 300,
+    state ? phase : 0, pv, pv, 40.0 + 10.0 * cos(i / 50.0), 0x21u, (i & 1) ? "true" : "false",
+    state ? "true" : "false", (8 - phase) * 300, -2.0 * cos(i / 300.0));
+}
+
+struct BenchSum {
+  double   sum;
+  uint64_t n;
+};
+
+static void benchRow(int64_t, const int64_t *vals, void *p) {
+  BenchSum &s = *(BenchSum *)p;
+  if (vals[0] != STORE_NULL) { s.sum += vals[0]; s.n++; }
+}
+
+struct BenchLeaf {
+  int64_t t;
+  double  pv;
+};
+
+static void benchLeaf(const JsonLeaf &leaf, void *p) {
+  BenchLeaf &b = *(BenchLeaf *)p;
+  if (!strcmp(leaf.path, "ts_ms")) b.t = (int64_t)leaf.num;
+  else if (!strcmp(leaf.path, "pid_ln2.pv_c")) b.pv = leaf.num;
+}
+
+static double msSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static int cmdBench(int argc, char **argv) {
+  uint32_t n = (argc > 0) ? (uint32_t)atol(argv[0]) : 86400;   // one day at 1 Hz
+  char dir[] = "/tmp/mill_ingest_bench.XXXXXX";
+  if (!mkdtemp(dir)) return 1;
+  std::string jsonPath = std::string(dir) + "/frames.ndjson";
+  FILE *jf = fopen(jsonPath.c_str(), "w");
+
+  const int64_t t0 = 1767254400000LL;     // 2026-01-01 08:00:00 UTC
+  StoreWriter w;
+  store_writer_open(w, dir, 3600 * 1000);
+  char buf[1024];
+  uint64_t jsonBytes = 0;
+  double ingestMs = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    int len = makeFrame(buf, sizeof(buf), t0 + (int64_t)i * 1000, i);
+    fwrite(buf, 1, (size_t)len, jf);
+    fputc('\n', jf);
+    jsonBytes += (uint64_t)len;
+    auto ti = std::chrono::steady_clock::now();
+    StoreRow row;
+    store_row_from_json(buf, (size_t)len, 0, row);
+    store_append(w, row, t0 + (int64_t)i * 1000);
+    ingestMs += msSince(ti);
+  }
+  store_writer_close(w);
+  fclose(jf);
+
+  printf("%u frames: JSON %.0f B/frame, store %.1f B/row (%llu B, %u partition opens, %llu blocks)\n",
+         n, (double)jsonBytes / n, (double)w.bytes_total / n, (unsigned long long)w.bytes_total,
+         w.partitions, (unsigned long long)w.blocks_total);
+  printf("ingest (decode + encode + write): %.2f us/frame, %.0f frames/s\n",
+         ingestMs * 1000.0 / n, n / (ingestMs / 1000.0));
+
+  // Range query: one hour of pv_c from the middle
+  int64_t from = t0 + (int64_t)(n / 2) * 1000, to = from + 3600 * 1000;
+  int col = store_column_index("pv_c");
+
+  auto tq = std::chrono::steady_clock::now();
+  BenchSum s = { 0, 0 };
+  for (const std::string &path : store_list(dir)) {
+    StoreFile f;
+    if (!store_map(f, path.c_str())) continue;
+    store_query_file(f, from, to, &col, 1, benchRow, &s);
+    store_unmap(f);
+  }
+  double storeMs = msSince(tq);
+
+  auto tj = std::chrono::steady_clock::now();
+  BenchSum sj = { 0, 0 };
+  jf = fopen(jsonPath.c_str(), "r");
+  while (fgets(buf, sizeof(buf), jf)) {
+    BenchLeaf bl = { 0, NAN };
+    json_walk(buf, strcspn(buf, "\n"), benchLeaf, &bl);
+    if (bl.t >= from && bl.t <= to && !isnan(bl.pv)) { sj.sum += bl.pv * 10; sj.n++; }
+  }
+  fclose(jf);
+  double jsonMs = msSince(tj);
+
+  printf("1 h range query (pv_c): store %.2f ms (%llu rows), JSON re-parse %.1f ms (%llu rows), %.0fx\n",
+         storeMs, (unsigned long long)s.n, jsonMs, (unsigned long long)sj.n, jsonMs / storeMs);
+  if (s.n != sj.n || fabs(s.sum - sj.sum) > 0.5) {
+    printf("MISMATCH: store sum %.1f, JSON sum %.1f\n", s.sum, sj.sum);
+    return 1;
+  }
+
+  for (const std::string &path : store_list(dir)) unlink(path.c_str());
+  unlink(jsonPath.c_str());
+  rmdir(dir);
+  return 0;
+}
+
+// -------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: mill_ingest run|query|info|bench [options]\n");
+    return 2;
+  }
+  const char *cmd = argv[1];
+  if (!strcmp(cmd, "run"))   return cmdRun(argc - 2, argv + 2);
+  if (!strcmp(cmd, "query")) return cmdQuery(argc - 2, argv + 2);
+  if (!strcmp(cmd, "info"))  return cmdInfo(argc - 2, argv + 2);
+  if (!strcmp(cmd, "bench")) return cmdBench(argc - 2, argv + 2);
+  fprintf(stderr, "unknown command %s\n", cmd);
+  return 2;
+}
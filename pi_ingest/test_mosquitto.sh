@@ -0,0 +1,146 @@
+#!/bin/sh
+#
+# test_mosquitto.sh
+#
+# End-to-end check of mill_ingest against a real broker: starts a private
+# mosquitto, runs `mill_ingest run` into a scratch directory, publishes
+# known status frames and a time sync request with mosquitto_pub, then
+# compares the time/resp reply and `mill_ingest query` output with what
+# those frames must give. Exits non-zero on the first mismatch.
+#
+#   ./test_mosquitto.sh [port]      (default 18830; needs mosquitto,
+#                                    mosquitto_pub, mosquitto_sub, g++)
+#
+# mill_ingest is built from the sources next to this script into the
+# scratch directory, so the result always matches the tree.
+
+set -eu
+
+PORT=${1:-18830}
+HERE=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d /tmp/mill_ingest_test.XXXXXX)
+BIN="$WORK/mill_ingest"
+BROKER_PID=""
+INGEST_PID=""
+
+cleanup() {
+  [ -n "$INGEST_PID" ] && kill "$INGEST_PID" 2>/dev/null || true
+  [ -n "$BROKER_PID" ] && kill "$BROKER_PID" 2>/dev/null || true
+  wait 2>/dev/null || true
+  rm -rf "$WORK"
+}
+trap cleanup EXIT INT TERM
+
+fail() {
+  echo "FAIL: $*" >&2
+  for f in "$WORK"/*.log; do
+    [ -f "$f" ] && { echo "--- $(basename "$f")" >&2; cat "$f" >&2; }
+  done
+  exit 1
+}
+
+# expect <name> <got-file> <want-file>
+expect() {
+  if ! cmp -s "$2" "$3"; then
+    echo "--- $1: want" >&2; cat "$3" >&2
+    echo "--- $1: got" >&2;  cat "$2" >&2
+    fail "$1"
+  fi
+  echo "ok   $1"
+}
+
+# wait_for <seconds> <command...>
+wait_for() {
+  n=$(($1 * 10)); shift
+  while ! "$@" >/dev/null 2>&1; do
+    n=$((n - 1))
+    [ "$n" -gt 0 ] || return 1
+    sleep 0.1
+  done
+}
+
+for tool in mosquitto mosquitto_pub mosquitto_sub; do
+  command -v "$tool" >/dev/null || { echo "$tool not found" >&2; exit 2; }
+done
+
+(cd "$HERE" && g++ -std=c++17 -O2 -Wall mill_ingest.cpp Ingest_Store.cpp Ingest_Json.cpp Mqtt_Lite.cpp -o "$BIN") ||
+  fail "build"
+
+# ---------------------------------------------------------------------
+# Broker and daemon
+# ---------------------------------------------------------------------
+
+mosquitto -p "$PORT" >"$WORK/broker.log" 2>&1 &
+BROKER_PID=$!
+wait_for 5 mosquitto_pub -p "$PORT" -t mill/selftest -m ping || fail "broker did not start on $PORT"
+
+"$BIN" run -p "$PORT" -d "$WORK/data" -f 1 >"$WORK/ingest.log" 2>&1 &
+INGEST_PID=$!
+wait_for 5 grep -q "subscribed to" "$WORK/ingest.log" || fail "mill_ingest did not subscribe"
+
+# ---------------------------------------------------------------------
+# Time sync: id and t0 echoed, t1 <= t2 within the wall clock window
+# ---------------------------------------------------------------------
+
+mosquitto_sub -p "$PORT" -t mill/test/time/resp -C 1 -W 5 >"$WORK/resp.txt" &
+SUB_PID=$!
+sleep 0.3
+before=$(date +%s)000
+mosquitto_pub -p "$PORT" -t mill/test/time/req -m '{"id":42,"t0":123456789}'
+wait "$SUB_PID" || fail "no time/resp"
+after=$(( $(date +%s) + 1 ))000
+
+sed -n 's/^{"id":42,"t0":123456789,"t1":\([0-9]*\),"t2":\([0-9]*\)}$/\1 \2/p' "$WORK/resp.txt" >"$WORK/t12.txt"
+read -r t1 t2 <"$WORK/t12.txt" || fail "time/resp malformed: $(cat "$WORK/resp.txt")"
+[ "$before" -le "$t1" ] && [ "$t1" -le "$t2" ] && [ "$t2" -le "$after" ] ||
+  fail "time/resp t1=$t1 t2=$t2 outside [$before, $after]"
+echo "ok   time/resp"
+
+# ---------------------------------------------------------------------
+# Status frames → store → query
+# ---------------------------------------------------------------------
+
+T=1772352900000
+frame() {   # frame <dt_ms> <state> <pv> <sv> <out>
+  mosquitto_pub -p "$PORT" -t mill/test/status/state -m \
+    "{\"ts_ms\":$((T + $1)),\"state\":\"$2\",\"pid_ln2\":{\"pv_c\":$3,\"sv_c\":$4,\"output_pct\":$5,\"comm_ok\":true}}"
+}
+frame     0 IDLE     20.0 -150.0   0.0
+frame  1000 RUN       5.3 -150.0 100.0
+frame  2000 RUN     -40.1 -150.0 100.0
+frame  3000 HOLD   -149.8 -150.0  35.5
+frame  4000 FOO       nan -150.0  35.5
+mosquitto_pub -p "$PORT" -t mill/test/status/state -m '{"ts_ms":'    # malformed
+mosquitto_pub -p "$PORT" -t mill/test/status/diag  -m '{"heap":1}'  # not stored
+
+# SIGTERM flushes the open block
+sleep 0.5
+kill "$INGEST_PID"
+wait "$INGEST_PID" || fail "mill_ingest exit status"
+INGEST_PID=""
+
+"$BIN" query -d "$WORK/data" -m test -from 0 -to now >"$WORK/rows.csv" 2>>"$WORK/query.log" || fail "query"
+# state is stored as its code (0 IDLE, 1 RUN, 2 HOLD, 3 FAULT); an
+# unknown state name and nan are null
+cat >"$WORK/want.csv" <<EOF
+t_ms,state,pv_c,sv_c,output_pct
+1772352900000,0,20,-150,0
+1772352901000,1,5.3,-150,100
+1772352902000,1,-40.1,-150,100
+1772352903000,2,-149.8,-150,35.5
+1772352904000,,,-150,35.5
+EOF
+expect "query rows" "$WORK/rows.csv" "$WORK/want.csv"
+
+"$BIN" query -d "$WORK/data" -m test -from 0 -to now -c pv_c,comm_ok -every 2000 -json \
+  >"$WORK/buckets.json" 2>>"$WORK/query.log" || fail "query -every"
+cat >"$WORK/want.json" <<EOF
+[
+{"t":1772352900000,"pv_c":12.65,"comm_ok":1},
+{"t":1772352902000,"pv_c":-94.95,"comm_ok":1},
+{"t":1772352904000,"pv_c":null,"comm_ok":1}
+]
+EOF
+expect "query buckets" "$WORK/buckets.json" "$WORK/want.json"
+
+echo "PASS"